@@ -21,6 +21,9 @@ MaterialHandle_t IMaterialSystemWrapperSDK::InvalidMaterial() {
 IMaterial* IMaterialSystemWrapperSDK::GetMaterial(MaterialHandle_t handle) {
     return m_int->GetMaterial(handle);
 }
+int IMaterialSystemWrapperSDK::GetNumMaterials() {
+    return m_int->GetNumMaterials();
+}
 ITexture* IMaterialSystemWrapperSDK::FindTexture(char const* pTextureName, const char *pTextureGroupName, bool complain, int nAdditionalCreationFlags) {
     return m_int->FindTexture(pTextureName, pTextureGroupName, complain, nAdditionalCreationFlags);
 }
@@ -43,6 +46,9 @@ MaterialHandle_t IMaterialSystemWrapper081::InvalidMaterial() {
 IMaterial* IMaterialSystemWrapper081::GetMaterial(MaterialHandle_t handle) {
     return m_int->GetMaterial(handle);
 }
+int IMaterialSystemWrapper081::GetNumMaterials() {
+    return m_int->GetNumMaterials();
+}
 ITexture* IMaterialSystemWrapper081::FindTexture(char const* pTextureName, const char *pTextureGroupName, bool complain, int nAdditionalCreationFlags) {
     return m_int->FindTexture(pTextureName, pTextureGroupName, complain, nAdditionalCreationFlags);
 }
@@ -65,6 +71,9 @@ MaterialHandle_t IMaterialSystemWrapperGMod::InvalidMaterial() {
 IMaterial* IMaterialSystemWrapperGMod::GetMaterial(MaterialHandle_t handle) {
     return m_int->GetMaterial(handle);
 }
+int IMaterialSystemWrapperGMod::GetNumMaterials() {
+    return m_int->GetNumMaterials();
+}
 ITexture* IMaterialSystemWrapperGMod::FindTexture(char const* pTextureName, const char *pTextureGroupName, bool complain, int nAdditionalCreationFlags) {
     return m_int->FindTexture(pTextureName, pTextureGroupName, complain, nAdditionalCreationFlags);
 }
@@ -17,6 +17,7 @@ public:
 	MaterialHandle_t NextMaterial(MaterialHandle_t handle) override;
 	MaterialHandle_t InvalidMaterial() override;
 	IMaterial* GetMaterial(MaterialHandle_t handle) override;
+	int GetNumMaterials() override;
 	ITexture* FindTexture(char const* pTextureName, const char *pTextureGroupName, bool complain, int nAdditionalCreationFlags) override;
 };
 
@@ -34,6 +35,7 @@ public:
 	MaterialHandle_t NextMaterial(MaterialHandle_t handle) override;
 	MaterialHandle_t InvalidMaterial() override;
 	IMaterial* GetMaterial(MaterialHandle_t handle) override;
+	int GetNumMaterials() override;
 	ITexture* FindTexture(char const* pTextureName, const char *pTextureGroupName, bool complain, int nAdditionalCreationFlags) override;
 };
 
@@ -51,6 +53,7 @@ public:
 	MaterialHandle_t NextMaterial(MaterialHandle_t handle) override;
 	MaterialHandle_t InvalidMaterial() override;
 	IMaterial* GetMaterial(MaterialHandle_t handle) override;
+	int GetNumMaterials() override;
 	ITexture* FindTexture(char const* pTextureName, const char *pTextureGroupName, bool complain, int nAdditionalCreationFlags) override;
 };
 
@@ -209,6 +209,7 @@ public:
 	virtual MaterialHandle_t NextMaterial(MaterialHandle_t handle) = 0;
 	virtual MaterialHandle_t InvalidMaterial() = 0;
 	virtual IMaterial* GetMaterial(MaterialHandle_t handle) = 0;
+	virtual int GetNumMaterials() = 0;
 	virtual ITexture* FindTexture(char const* pTextureName, const char *pTextureGroupName, bool complain = true, int nAdditionalCreationFlags = 0) = 0;
 };
 
@@ -0,0 +1,148 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @file
+ * @brief The `D3DFORMAT` of frame buffers, and what's known about each format.
+ *
+ * Off Windows, the `D3DFMT_` values are declared here, with the same values as in `d3d9types.h`.
+ * This lets the frame buffers and the worker pool be built and tested without D3D.
+ */
+
+#ifdef _WIN32
+#include <d3d9.h>
+#else
+#ifndef MAKEFOURCC
+#define MAKEFOURCC(ch0, ch1, ch2, ch3) \
+    ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) | \
+    ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24))
+#endif
+
+enum D3DFORMAT : uint32_t
+{
+    D3DFMT_UNKNOWN              = 0,
+
+    D3DFMT_R8G8B8               = 20,
+    D3DFMT_A8R8G8B8             = 21,
+    D3DFMT_X8R8G8B8             = 22,
+    D3DFMT_R5G6B5               = 23,
+    D3DFMT_X1R5G5B5             = 24,
+    D3DFMT_A1R5G5B5             = 25,
+    D3DFMT_A4R4G4B4             = 26,
+    D3DFMT_R3G3B2               = 27,
+    D3DFMT_A8                   = 28,
+    D3DFMT_A8R3G3B2             = 29,
+    D3DFMT_X4R4G4B4             = 30,
+    D3DFMT_A2B10G10R10          = 31,
+    D3DFMT_A8B8G8R8             = 32,
+    D3DFMT_X8B8G8R8             = 33,
+    D3DFMT_G16R16               = 34,
+    D3DFMT_A2R10G10B10          = 35,
+    D3DFMT_A16B16G16R16         = 36,
+
+    D3DFMT_A8P8                 = 40,
+    D3DFMT_P8                   = 41,
+
+    D3DFMT_L8                   = 50,
+    D3DFMT_A8L8                 = 51,
+    D3DFMT_A4L4                 = 52,
+
+    D3DFMT_V8U8                 = 60,
+    D3DFMT_L6V5U5               = 61,
+    D3DFMT_X8L8V8U8             = 62,
+    D3DFMT_Q8W8V8U8             = 63,
+    D3DFMT_V16U16               = 64,
+    D3DFMT_A2W10V10U10          = 67,
+
+    D3DFMT_UYVY                 = MAKEFOURCC('U', 'Y', 'V', 'Y'),
+    D3DFMT_R8G8_B8G8            = MAKEFOURCC('R', 'G', 'B', 'G'),
+    D3DFMT_YUY2                 = MAKEFOURCC('Y', 'U', 'Y', '2'),
+    D3DFMT_G8R8_G8B8            = MAKEFOURCC('G', 'R', 'G', 'B'),
+    D3DFMT_DXT1                 = MAKEFOURCC('D', 'X', 'T', '1'),
+    D3DFMT_DXT2                 = MAKEFOURCC('D', 'X', 'T', '2'),
+    D3DFMT_DXT3                 = MAKEFOURCC('D', 'X', 'T', '3'),
+    D3DFMT_DXT4                 = MAKEFOURCC('D', 'X', 'T', '4'),
+    D3DFMT_DXT5                 = MAKEFOURCC('D', 'X', 'T', '5'),
+
+    D3DFMT_D16_LOCKABLE         = 70,
+    D3DFMT_D32                  = 71,
+    D3DFMT_D15S1                = 73,
+    D3DFMT_D24S8                = 75,
+    D3DFMT_D24X8                = 77,
+    D3DFMT_D24X4S4              = 79,
+    D3DFMT_D16                  = 80,
+
+    D3DFMT_D32F_LOCKABLE        = 82,
+    D3DFMT_D24FS8               = 83,
+
+    D3DFMT_D32_LOCKABLE         = 84,
+    D3DFMT_S8_LOCKABLE          = 85,
+
+    D3DFMT_L16                  = 81,
+
+    D3DFMT_VERTEXDATA           = 100,
+    D3DFMT_INDEX16              = 101,
+    D3DFMT_INDEX32              = 102,
+
+    D3DFMT_Q16W16V16U16         = 110,
+
+    D3DFMT_MULTI2_ARGB8         = MAKEFOURCC('M', 'E', 'T', '1'),
+
+    D3DFMT_R16F                 = 111,
+    D3DFMT_G16R16F              = 112,
+    D3DFMT_A16B16G16R16F        = 113,
+
+    D3DFMT_R32F                 = 114,
+    D3DFMT_G32R32F              = 115,
+    D3DFMT_A32B32G32R32F        = 116,
+
+    D3DFMT_CxV8U8               = 117,
+
+    D3DFMT_A1                   = 118,
+    D3DFMT_A2B10G10R10_XR_BIAS  = 119,
+    D3DFMT_BINARYBUFFER         = 199,
+
+    // Not in d3d9types.h. Declared so that switches over D3DFORMAT can use Helper::FOURCC_INTZ.
+    D3DFMT_FOURCC_INTZ          = MAKEFOURCC('I', 'N', 'T', 'Z'),
+
+    D3DFMT_FORCE_DWORD          = 0x7fffffff,
+};
+#endif
+
+namespace Helper
+{
+
+struct D3DFORMAT_info
+{
+    /// @brief Number of bytes between each pixel
+    uint32_t stride;
+    /// @brief The bit depth of each channel
+    uint8_t bitdepth[4];
+    /// @brief Number of channels
+    uint8_t num_channels;
+    /// @brief True if all bitdepths are equal
+    bool is_uniform_bitdepth;
+    bool is_float;
+    bool is_depth;
+};
+
+static constexpr D3DFORMAT FOURCC_INTZ = (D3DFORMAT)MAKEFOURCC('I', 'N', 'T', 'Z');
+/// @brief This is a bogus format ID to represent 24-bit RGB.
+/// @details Being for little-endian systems, this is technically BGR.
+static constexpr D3DFORMAT D3DFMT_B8G8R8 = (D3DFORMAT)0x7FFFFFFF;
+
+/**
+ * @brief Get detailed information about a D3D surface/texture format
+ * @param fmt One of the `D3DFMT_` or `FOURCC_` values
+ * @param out_info Location to store the info
+ * @return `true` if the info was returned
+ */
+bool GetD3DFormatInfo(D3DFORMAT fmt, D3DFORMAT_info* out_info);
+
+/// @brief Get the equivalent FFmpeg `pix_fmt` for a given `D3DFORMAT`.
+/// @details The chosen pix_fmt is in reverse order to account for little-endian.
+/// @param fmt One of the `D3DFMT_` or `FOURCC_` values
+/// @param skip_alpha If true, then it returns only equivalent formats that will skip the alpha channel
+/// @return `nullptr` if no equivalent `pix_fmt` exists
+const char* GetD3DFormatAsFFmpegPixFmt(D3DFORMAT fmt, bool skip_alpha);
+}
@@ -0,0 +1,102 @@
+#include "hash.h"
+#include <cstring>
+#include "simd.h"
+
+namespace Helper
+{
+
+static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+/// @brief Number of bytes consumed by each iteration of the accumulator loop
+static constexpr size_t STRIPE_LEN = 64;
+
+/// @brief Arbitrary bytes that are mixed into each stripe, borrowed from the XXH3 secret
+alignas(16) static const uint8_t STRIPE_KEY[STRIPE_LEN] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+};
+
+static inline uint64_t ReadU64(const uint8_t* ptr)
+{
+    uint64_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline uint64_t Avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+/// @brief Accumulate whole stripes into 8 lanes
+/// @return Number of bytes consumed
+static size_t AccumulateStripes(uint64_t* acc, const uint8_t* data, size_t len)
+{
+    size_t num_stripes = len / STRIPE_LEN;
+
+#ifdef SF_USE_SSE2
+    __m128i* xacc = (__m128i*)acc;
+    const __m128i* xkey = (const __m128i*)STRIPE_KEY;
+    for (size_t s = 0; s < num_stripes; ++s)
+    {
+        const uint8_t* stripe = data + s * STRIPE_LEN;
+        for (size_t i = 0; i < STRIPE_LEN / sizeof(__m128i); ++i)
+        {
+            __m128i d = _mm_loadu_si128((const __m128i*)stripe + i);
+            __m128i k = _mm_xor_si128(d, _mm_load_si128(xkey + i));
+            // Multiply the low and high 32 bits of each 64-bit lane
+            __m128i product = _mm_mul_epu32(k, _mm_shuffle_epi32(k, _MM_SHUFFLE(0, 3, 0, 1)));
+            __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+            xacc[i] = _mm_add_epi64(xacc[i], _mm_add_epi64(product, swapped));
+        }
+    }
+#else
+    for (size_t s = 0; s < num_stripes; ++s)
+    {
+        const uint8_t* stripe = data + s * STRIPE_LEN;
+        for (size_t i = 0; i < STRIPE_LEN / sizeof(uint64_t); ++i)
+        {
+            uint64_t d = ReadU64(stripe + i * 8);
+            uint64_t k = d ^ ReadU64(STRIPE_KEY + i * 8);
+            acc[i ^ 1] += d;
+            acc[i] += (k & 0xFFFFFFFF) * (k >> 32);
+        }
+    }
+#endif
+
+    return num_stripes * STRIPE_LEN;
+}
+
+uint64_t HashBytes(const void* data, size_t len, uint64_t seed)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    alignas(16) uint64_t acc[8] = {
+        seed ^ PRIME64_1, seed ^ PRIME64_2, seed ^ PRIME64_3, seed + PRIME64_1,
+        seed + PRIME64_2, seed + PRIME64_3, ~seed, seed,
+    };
+
+    size_t offset = AccumulateStripes(acc, bytes, len);
+
+    // Merge the lanes
+    uint64_t h = len * PRIME64_1;
+    for (size_t i = 0; i < 8; ++i)
+        h = (h ^ Avalanche(acc[i])) * PRIME64_1 + PRIME64_3;
+
+    // Mix the tail
+    for (; offset + 8 <= len; offset += 8)
+        h = (h ^ Avalanche(ReadU64(bytes + offset))) * PRIME64_1 + PRIME64_2;
+    for (; offset < len; ++offset)
+        h = (h ^ (bytes[offset] * PRIME64_3)) * PRIME64_1;
+
+    return Avalanche(h);
+}
+
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace Helper
+{
+    /**
+     * @brief A fast, non-cryptographic 64-bit hash for large buffers (like video frames).
+     *
+     * The inner loop is based on XXH3's SSE2 accumulator, but the output is not compatible with XXH3.
+     * Chain calls by passing the previous result as `seed`, such as when hashing each row of an image.
+     * @param seed Initial value, or the result of a previous call
+     */
+    uint64_t HashBytes(const void* data, size_t len, uint64_t seed = 0);
+}
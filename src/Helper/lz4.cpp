@@ -0,0 +1,233 @@
+#include "lz4.h"
+#include <vector>
+#include <bit>
+#include <cstring>
+#include <cassert>
+
+namespace Helper
+{
+
+static constexpr size_t MIN_MATCH = 4;
+/// @brief The last match must start at least this many bytes before the end of the block
+static constexpr size_t MF_LIMIT = 12;
+/// @brief The last bytes of a block are always literals
+static constexpr size_t LAST_LITERALS = 5;
+static constexpr size_t MAX_OFFSET = 65535;
+static constexpr int HASH_BITS = 16;
+/// @brief Incompressible data is skipped faster, by one more byte per this many failed searches
+static constexpr int SKIP_SHIFT = 6;
+/// @brief Literals and matches up to this long are copied with one fixed-size copy, when both buffers have room
+static constexpr size_t SHORT_COPY = 16;
+
+static inline uint32_t Read32(const uint8_t* ptr)
+{
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline uint64_t Read64(const uint8_t* ptr)
+{
+    uint64_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline uint32_t HashSequence(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/// @brief Count the matching bytes of `a` and `b`, stopping at `a_end`
+static inline size_t CountMatch(const uint8_t* a, const uint8_t* b, const uint8_t* a_end)
+{
+    const uint8_t* start = a;
+    while (a + 8 <= a_end)
+    {
+        uint64_t diff = Read64(a) ^ Read64(b);
+        if (diff)
+            return a - start + std::countr_zero(diff) / 8;
+        a += 8;
+        b += 8;
+    }
+    while (a < a_end && *a == *b)
+    {
+        ++a;
+        ++b;
+    }
+    return a - start;
+}
+
+static inline uint8_t* WriteLength(uint8_t* out, size_t len)
+{
+    for (; len >= 255; len -= 255)
+        *out++ = 255;
+    *out++ = (uint8_t)len;
+    return out;
+}
+
+static inline bool ReadLength(const uint8_t** in, const uint8_t* in_end, size_t* len)
+{
+    uint8_t byte;
+    do
+    {
+        if (*in >= in_end)
+            return false;
+        byte = *(*in)++;
+        *len += byte;
+    } while (byte == 255);
+    return true;
+}
+
+static uint8_t* WriteSequence(uint8_t* out, const uint8_t* literals, size_t literal_len, size_t offset, size_t match_len)
+{
+    uint8_t* token = out++;
+    *token = (uint8_t)((literal_len < 15 ? literal_len : 15) << 4);
+    if (literal_len >= 15)
+        out = WriteLength(out, literal_len - 15);
+    memcpy(out, literals, literal_len);
+    out += literal_len;
+    if (offset == 0)
+        return out; // The last sequence has no match
+
+    *out++ = (uint8_t)offset;
+    *out++ = (uint8_t)(offset >> 8);
+    match_len -= MIN_MATCH;
+    *token |= (uint8_t)(match_len < 15 ? match_len : 15);
+    if (match_len >= 15)
+        out = WriteLength(out, match_len - 15);
+    return out;
+}
+
+size_t LZ4Compress(const void* src, size_t src_len, void* dst, size_t dst_capacity)
+{
+    assert(src_len <= UINT32_MAX && "LZ4Compress only supports inputs smaller than 4 GB");
+    if (dst_capacity < LZ4CompressBound(src_len))
+        return 0;
+
+    const uint8_t* const base = (const uint8_t*)src;
+    const uint8_t* const end = base + src_len;
+    const uint8_t* anchor = base;
+    uint8_t* out = (uint8_t*)dst;
+
+    if (src_len > MF_LIMIT)
+    {
+        // Positions of recent sequences, relative to `base`
+        thread_local std::vector<uint32_t> table;
+        table.assign((size_t)1 << HASH_BITS, 0);
+
+        const uint8_t* const match_limit = end - MF_LIMIT;
+        const uint8_t* const match_end_limit = end - LAST_LITERALS;
+        const uint8_t* in = base + 1;
+        while (in < match_limit)
+        {
+            uint32_t sequence = Read32(in);
+            uint32_t& slot = table[HashSequence(sequence)];
+            const uint8_t* match = base + slot;
+            slot = (uint32_t)(in - base);
+
+            if ((size_t)(in - match) > MAX_OFFSET || Read32(match) != sequence)
+            {
+                in += 1 + ((in - anchor) >> SKIP_SHIFT);
+                continue;
+            }
+
+            // Extend the match backwards over any pending literals
+            while (in > anchor && match > base && in[-1] == match[-1])
+            {
+                --in;
+                --match;
+            }
+
+            size_t match_len = MIN_MATCH + CountMatch(in + MIN_MATCH, match + MIN_MATCH, match_end_limit);
+            out = WriteSequence(out, anchor, in - anchor, in - match, match_len);
+            in += match_len;
+            anchor = in;
+
+            // Give the next search a nearby candidate, which helps on repeating rows of pixels
+            if (in < match_limit)
+                table[HashSequence(Read32(in - 2))] = (uint32_t)(in - 2 - base);
+        }
+    }
+
+    out = WriteSequence(out, anchor, end - anchor, 0, 0);
+    return out - (uint8_t*)dst;
+}
+
+bool LZ4Decompress(const void* src, size_t src_len, void* dst, size_t dst_len)
+{
+    const uint8_t* in = (const uint8_t*)src;
+    const uint8_t* const in_end = in + src_len;
+    uint8_t* const out_start = (uint8_t*)dst;
+    uint8_t* out = out_start;
+    uint8_t* const out_end = out + dst_len;
+
+    while (in < in_end)
+    {
+        uint8_t token = *in++;
+
+        size_t literal_len = token >> 4;
+        if (literal_len < 15 && (size_t)(in_end - in) >= SHORT_COPY && (size_t)(out_end - out) >= SHORT_COPY)
+        {
+            // Noisy pixels make many short sequences. Copying a fixed size compiles to a couple of moves,
+            // instead of a call that has to branch on the length.
+            memcpy(out, in, SHORT_COPY);
+        }
+        else
+        {
+            if (literal_len == 15 && !ReadLength(&in, in_end, &literal_len))
+                return false;
+            if (literal_len > (size_t)(in_end - in) || literal_len > (size_t)(out_end - out))
+                return false;
+            memcpy(out, in, literal_len);
+        }
+        in += literal_len;
+        out += literal_len;
+
+        if (in == in_end)
+            break; // The last sequence has no match
+
+        if (in_end - in < 2)
+            return false;
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > (size_t)(out - out_start))
+            return false;
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && !ReadLength(&in, in_end, &match_len))
+            return false;
+        match_len += MIN_MATCH;
+        if (match_len > (size_t)(out_end - out))
+            return false;
+
+        const uint8_t* match = out - offset;
+        if (match_len <= SHORT_COPY && offset >= SHORT_COPY && (size_t)(out_end - out) >= SHORT_COPY)
+        {
+            memcpy(out, match, SHORT_COPY);
+            out += match_len;
+            continue;
+        }
+        if (offset >= match_len)
+        {
+            memcpy(out, match, match_len);
+            out += match_len;
+            continue;
+        }
+
+        // The match overlaps its own output, repeating every `offset` bytes.
+        // Each copy doubles the length of the repeated pattern, so runs of pixels are cheap.
+        for (size_t remaining = match_len; remaining > 0;)
+        {
+            size_t chunk = out - match;
+            if (chunk > remaining)
+                chunk = remaining;
+            memcpy(out, match, chunk);
+            out += chunk;
+            remaining -= chunk;
+        }
+    }
+
+    return out == out_end;
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace Helper
+{
+    /// @brief The largest possible output of @ref LZ4Compress, for an input of `len` bytes
+    constexpr size_t LZ4CompressBound(size_t len) { return len + len / 255 + 16; }
+
+    /**
+     * @brief Compress bytes into a single LZ4 block.
+     *
+     * The output is a raw LZ4 block (no frame header), readable by any LZ4 block decoder.
+     * This is a simple greedy compressor, tuned for speed on large buffers (like video frames).
+     * @param dst_capacity Must be at least @ref LZ4CompressBound of `src_len`
+     * @return Number of bytes written to `dst`, or 0 if `dst` is too small
+     */
+    size_t LZ4Compress(const void* src, size_t src_len, void* dst, size_t dst_capacity);
+    /**
+     * @brief Decompress a single LZ4 block. Malformed input is rejected instead of read out of bounds.
+     * @param dst_len The exact size of the decompressed data
+     * @return `false` if the input is malformed or doesn't decompress to exactly `dst_len` bytes
+     */
+    bool LZ4Decompress(const void* src, size_t src_len, void* dst, size_t dst_len);
+}
@@ -0,0 +1,35 @@
+#include "perf.h"
+
+namespace Helper
+{
+
+PerfCounter::PerfCounter(const char* name) : m_name(name)
+{
+    Registry().push_back(this);
+}
+
+void PerfCounter::Add(std::chrono::nanoseconds duration)
+{
+    m_calls.fetch_add(1, std::memory_order_relaxed);
+    m_total_ns.fetch_add((uint64_t)duration.count(), std::memory_order_relaxed);
+}
+
+void PerfCounter::Reset()
+{
+    m_calls.store(0, std::memory_order_relaxed);
+    m_total_ns.store(0, std::memory_order_relaxed);
+}
+
+const std::vector<PerfCounter*>& PerfCounter::GetAll()
+{
+    return Registry();
+}
+
+std::vector<PerfCounter*>& PerfCounter::Registry()
+{
+    // Function-local, so it's constructed before any global counters use it
+    static std::vector<PerfCounter*> counters;
+    return counters;
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace Helper
+{
+    /**
+     * @brief Accumulates the number of calls and time spent in a section of code.
+     * 
+     * Counters register themselves on construction and are listed in the dev tools tab.
+     * Declare them as static/global variables, because they are never unregistered.
+     * Scopes only time anything while @ref SetEnabled is on, so they can stay in hot paths.
+     */
+    class PerfCounter
+    {
+    public:
+        /// @brief Times a scope and adds it to the counter
+        class Scope
+        {
+        public:
+            Scope(PerfCounter& counter) : m_counter(IsEnabled() ? &counter : nullptr)
+            {
+                if (m_counter)
+                    m_start = std::chrono::steady_clock::now();
+            }
+            ~Scope()
+            {
+                if (m_counter)
+                    m_counter->Add(std::chrono::steady_clock::now() - m_start);
+            }
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            /// @brief `nullptr` if counters were disabled when the scope began
+            PerfCounter* m_counter;
+            std::chrono::steady_clock::time_point m_start;
+        };
+
+        /// @param name A string literal
+        PerfCounter(const char* name);
+        PerfCounter(const PerfCounter&) = delete;
+        PerfCounter& operator=(const PerfCounter&) = delete;
+
+        void Add(std::chrono::nanoseconds duration);
+        void Reset();
+        const char* GetName() const { return m_name; }
+        uint64_t GetCalls() const { return m_calls.load(std::memory_order_relaxed); }
+        uint64_t GetTotalNs() const { return m_total_ns.load(std::memory_order_relaxed); }
+
+        /// @brief Get every counter, in order of construction
+        static const std::vector<PerfCounter*>& GetAll();
+        /// @brief Scopes are timed. Off by default, and turned on from the dev tools tab.
+        static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+        static void SetEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+
+    private:
+        static std::vector<PerfCounter*>& Registry();
+
+        static inline std::atomic<bool> enabled = false;
+
+        const char* m_name;
+        std::atomic<uint64_t> m_calls = 0;
+        std::atomic<uint64_t> m_total_ns = 0;
+    };
+}
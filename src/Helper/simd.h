@@ -0,0 +1,88 @@
+#pragma once
+
+/**
+ * @file
+ * @brief Decides which SIMD instruction sets the pixel kernels are compiled with.
+ *
+ * `SF_USE_SSE2` is defined when SSE2 is part of the target's baseline, which is always true on x64.
+ *
+ * SSSE3 and F16C aren't part of the baseline, and the DLL isn't built for them.
+ * On x86, `SF_USE_SSSE3` and `SF_USE_F16C` are defined anyway: functions using them are compiled
+ * for their instruction set with `SF_TARGET`, and are only called when @ref Simd::HasSsse3 or
+ * @ref Simd::HasF16C report support at runtime.
+ *
+ * Kernels guarded by these have scalar fallbacks, which are used on every other target.
+ */
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define SF_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86)
+#define SF_USE_SSSE3
+#define SF_USE_F16C
+#include <intrin.h>
+/// @brief MSVC emits any intrinsic without targeting its instruction set
+#define SF_TARGET(isa)
+#elif defined(__x86_64__) || defined(__i386__)
+#define SF_USE_SSSE3
+#define SF_USE_F16C
+#include <immintrin.h>
+#include <cpuid.h>
+/// @brief Compile one function for an instruction set, like `"ssse3"`, that the rest of the file can't use
+#define SF_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#ifdef SF_USE_SSSE3
+#include <cstdint>
+
+namespace Simd
+{
+    struct CpuFeatures
+    {
+        bool ssse3 = false;
+        bool f16c = false;
+    };
+
+    inline CpuFeatures DetectCpuFeatures()
+    {
+        constexpr uint32_t SSSE3 = 1 << 9, OSXSAVE = 1 << 27, AVX = 1 << 28, F16C = 1 << 29;
+        CpuFeatures features;
+        uint32_t ecx;
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        ecx = (uint32_t)info[2];
+#else
+        uint32_t eax, ebx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+            return features;
+#endif
+        features.ssse3 = (ecx & SSSE3) != 0;
+        if ((ecx & (OSXSAVE | AVX | F16C)) != (OSXSAVE | AVX | F16C))
+            return features;
+
+        // F16C is VEX-encoded, so the OS must also save the AVX registers
+#ifdef _MSC_VER
+        uint64_t xcr0 = _xgetbv(0);
+#else
+        uint32_t xcr0_lo, xcr0_hi;
+        __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        uint64_t xcr0 = ((uint64_t)xcr0_hi << 32) | xcr0_lo;
+#endif
+        features.f16c = (xcr0 & 6) == 6;
+        return features;
+    }
+
+    /// @brief Detected once, on first use
+    inline const CpuFeatures& GetCpuFeatures()
+    {
+        static const CpuFeatures features = DetectCpuFeatures();
+        return features;
+    }
+
+    inline bool HasSsse3() { return GetCpuFeatures().ssse3; }
+    inline bool HasF16C() { return GetCpuFeatures().f16c; }
+}
+#endif
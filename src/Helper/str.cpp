@@ -2,6 +2,7 @@
 #include <cctype>
 #include <cstdarg>
 #include <vector>
+#include <Base/fnv1a.h>
 
 namespace Helper
 {
@@ -18,8 +19,10 @@ std::string sprintf(const char* fmt, ...)
         int len = std::vsnprintf(buffer.data(), buffer.size() + 1 /* Includes null-terminator */, fmt, va);
         va_end(va);
 
-        is_incomplete = len > buffer.size();
-        buffer.resize(len);
+        if (len < 0) // Invalid format
+            return {};
+        is_incomplete = (size_t)len > buffer.size();
+        buffer.resize((size_t)len);
     } while (is_incomplete);
     return buffer;
 }
@@ -103,4 +106,40 @@ size_t ParseNextCommand(const char* str, ParsedCommand* output)
     return str - begin;
 }
 
+/// @brief Fold one char of a path, without the locale lookup of `std::tolower`. Model paths are ASCII.
+static inline char FoldPathChar(char c)
+{
+    if (c == '\\')
+        return '/';
+    return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+}
+
+std::string NormalizePath(std::string_view path)
+{
+    std::string result(path);
+    for (char& c : result)
+        c = FoldPathChar(c);
+    return result;
+}
+
+size_t PathHash::operator()(std::string_view path) const
+{
+    size_t hash = fnv::internal::default_offset_basis_z();
+    for (char c : path)
+        hash = fnv::calculate(hash, (unsigned char)FoldPathChar(c));
+    return hash;
+}
+
+bool PathEqual::operator()(std::string_view lhs, std::string_view rhs) const
+{
+    if (lhs.size() != rhs.size())
+        return false;
+    for (size_t i = 0; i < lhs.size(); ++i)
+    {
+        if (FoldPathChar(lhs[i]) != FoldPathChar(rhs[i]))
+            return false;
+    }
+    return true;
+}
+
 }
\ No newline at end of file
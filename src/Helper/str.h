@@ -3,6 +3,7 @@
 #include <string>
 #include <string_view>
 #include <algorithm>
+#include <unordered_set>
 
 namespace Helper
 {
@@ -86,6 +87,26 @@ namespace Helper
 		return *lhs - *rhs;
 	}
 
+    /// @brief Lowercase the path's ASCII letters and replace backslashes with forward-slashes
+    std::string NormalizePath(std::string_view path);
+
+    /// @brief FNV-1a hash of a path, as if it was normalized with @ref NormalizePath
+    struct PathHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view path) const;
+    };
+
+    /// @brief Equality of paths as if they were normalized with @ref NormalizePath: lowercase, with `\` treated as `/`
+    struct PathEqual
+    {
+        using is_transparent = void;
+        bool operator()(std::string_view lhs, std::string_view rhs) const;
+    };
+
+    /// @brief A set of paths that can be searched with unnormalized paths, without allocating
+    using PathSet = std::unordered_set<std::string, PathHash, PathEqual>;
+
     struct ParsedCommand
     {
         std::string_view name;
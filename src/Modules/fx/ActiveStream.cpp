@@ -6,6 +6,7 @@
 #include <Helper/str.h>
 #include <Helper/d3d9.h>
 #include <Helper/defer.h>
+#include <Helper/perf.h>
 #include <Hooks/OverlayHook.h>
 #include <Hooks/fx/StudioRenderHook.h>
 #include <Hooks/fx/ModelRenderHook.h>
@@ -23,6 +24,9 @@
 #include <SDK/IPanel.h>
 #include <cstdio>
 
+static Helper::PerfCounter s_perf_pre_dme("ActiveStream::PreDrawModelExecute");
+static Helper::PerfCounter s_perf_update_materials("ActiveStream::UpdateMaterials");
+
 void ActiveStream::StartListening()
 {
     StudioRenderHook::OnDrawModelStaticProp.Listen(&ActiveStream::OnDrawStaticProp, this);
@@ -46,6 +50,7 @@ void ActiveStream::Set(const Stream::Ptr& stream)
     auto lock = WriteLock();
     m_should_update_materials = m_stream != stream;
     m_stream = stream;
+    UpdateRenderPlan();
     UpdateFog();
     UpdateConVars();
     UpdateHud();
@@ -55,11 +60,22 @@ void ActiveStream::Set(const Stream::Ptr& stream)
 void ActiveStream::SignalUpdate(const Stream::Ptr& stream, uint32_t flags)
 {
     auto lock = WriteLock();
+    if (flags & UPDATE_RENDER_PLAN)
+    {
+        // The edited stream may not be active, so its cached plan is dropped either way.
+        if (stream)
+            m_plan_cache.erase(stream.get());
+        else
+            m_plan_cache.clear();
+    }
+
     if (m_stream == nullptr)
         return;
     if (stream == nullptr || m_stream == stream)
     {
         m_should_update_materials |= (bool)(flags & UPDATE_MATERIALS);
+        if (flags & UPDATE_RENDER_PLAN)
+            UpdateRenderPlan();
         UpdateHud();
         if (flags & UPDATE_FOG)
             UpdateFog();
@@ -76,18 +92,8 @@ bool ActiveStream::DrawDepth()
     Shader::PixelShader::Ptr pixel_shader = nullptr;
     if (IsDepthAvailable())
     {
-        auto lock = ReadLock();
-        if (m_stream)
-        {
-            for (auto it = m_stream->begin<CameraTweak>(); it != m_stream->end<CameraTweak>(); ++it)
-            {
-                if (it->pixel_shader)
-                {
-                    pixel_shader = it->pixel_shader;
-                    break;
-                }
-            }
-        }
+        if (RenderPlan::ConstPtr plan = GetPlan())
+            pixel_shader = plan->pixel_shader;
     }
 
     if (!pixel_shader)
@@ -139,86 +145,78 @@ bool ActiveStream::DrawDepth()
 
 void ActiveStream::RenderView()
 {
-    auto lock = ReadLock();
-
     CViewSetup view_setup;
     Interfaces::hlclient->GetPlayerView(view_setup);
 
-    if (m_stream != nullptr) 
-    {
-        // Override FOV in view_setup
-        for (auto tweak = m_stream->begin<CameraTweak>(); tweak != m_stream->end<CameraTweak>(); ++tweak)
-        {
-            if (tweak->fov_override)
-                view_setup.fov = tweak->fov;
-        }
-    }
+    // Override FOV in view_setup
+    RenderPlan::ConstPtr plan = GetPlan();
+    if (plan && plan->fov_override)
+        view_setup.fov = plan->fov;
 
     Interfaces::hlclient->RenderView(view_setup, VIEW_CLEAR_COLOR, RENDERVIEW_DRAWVIEWMODEL | RENDERVIEW_DRAWHUD);
 }
 
 void ActiveStream::UpdateMaterials()
 {
-    auto lock = ReadLock();
+    static const RenderPlan::MaterialGroups NO_MATERIAL_GROUPS = {};
+    Helper::PerfCounter::Scope perf_scope(s_perf_update_materials);
     m_should_update_materials = false;
-    
-    for (   MaterialHandle_t handle = Interfaces::mat_system->FirstMaterial();
-            handle != Interfaces::mat_system->InvalidMaterial();
-            handle = Interfaces::mat_system->NextMaterial(handle)
-        )
+
+    RenderPlan::ConstPtr plan = GetPlan();
+    const RenderPlan::MaterialGroups& next_groups = plan ? plan->material_groups : NO_MATERIAL_GROUPS;
+    m_material_index.Refresh();
+    bool is_outdated = m_applied_material_generation != m_material_index.GetGeneration();
+
+    // Only touch the groups that differ from the applied ones, unless materials were (un)loaded
+    for (size_t i = 0; i < next_groups.size(); ++i)
     {
-        IMaterial* mat = Interfaces::mat_system->GetMaterial(handle);
-        bool was_affected = false;
-        if (m_stream)
-        {
-            for (auto tweak = m_stream->begin<MaterialTweak>(); tweak != m_stream->end<MaterialTweak>(); ++tweak)
-            {
-                if (tweak->IsMaterialAffected(mat))
-                {
-                    was_affected = true;
-                    SetMaterialColor(mat, tweak->color_multiply);
-                }
-            }
-        }
-        if (!was_affected)
-            RestoreMaterialParams(mat);
+        if (!is_outdated && next_groups[i] == m_applied_material_groups[i])
+            continue;
+        
+        if (next_groups[i].affected)
+            m_material_index.SetGroupColor(i, next_groups[i].color);
+        else
+            m_material_index.RestoreGroup(i);
     }
+    m_applied_material_groups = next_groups;
+    m_applied_material_generation = m_material_index.GetGeneration();
 }
 
 void ActiveStream::UpdateConVars()
 {
-    for (auto& convar : m_convars)
-        convar.Restore();
-    m_convars.clear();
+    RenderPlan::ConstPtr plan = GetPlan();
+    const std::vector<CommandTweak::ConVarValue>* next_convars = plan ? &plan->commands.convars : nullptr;
 
-    if (!m_stream)
-        return;
+    // Restore the ConVars that the next stream doesn't set
+    for (auto it = m_convars.begin(); it != m_convars.end();)
+    {
+        bool is_kept = next_convars && std::any_of(next_convars->begin(), next_convars->end(),
+            [&it](const CommandTweak::ConVarValue& next) { return next.convar == it->first; }
+        );
+        if (is_kept)
+            ++it;
+        else
+        {
+            it->second.Restore();
+            it = m_convars.erase(it);
+        }
+    }
 
-    auto tweak = m_stream->begin<CommandTweak>();
-    if (tweak == m_stream->end<CommandTweak>())
+    if (!plan)
         return;
-    
-    std::vector<Helper::ParsedCommand> parsed_cmds;
-    tweak->GetCommandList(&parsed_cmds);
 
-    for (auto& cmd : parsed_cmds)
+    // Only set the ConVars whose values differ
+    for (const CommandTweak::ConVarValue& next : plan->commands.convars)
     {
-        std::string cmd_name = std::string(cmd.name);
-        ConVar* cvar = Interfaces::cvar->FindVar(cmd_name.c_str());
-        if (!cvar)
-        {
-            // It's probably a command. Dispatch the command the lazy way.
-            cmd_name += ' ';
-            cmd_name += cmd.args;
-            Interfaces::engine->ExecuteClientCmd(cmd_name.c_str());
+        if (!strcmp(next.convar->GetString(), next.value.c_str()))
             continue;
-        }
-        
-        std::string args = std::string(cmd.args);
-        Helper::RestoringConVar restoring_cvar {cvar};
-        restoring_cvar.SetValue(args.c_str());
-        m_convars.push_back(std::move(restoring_cvar));
+        auto it = m_convars.try_emplace(next.convar, next.convar).first;
+        it->second.SetValue(next.value.c_str());
     }
+
+    // Dispatch the commands the lazy way
+    for (const std::string& cmd : plan->commands.commands)
+        Interfaces::engine->ExecuteClientCmd(cmd.c_str());
 }
 
 void ActiveStream::UpdateFog()
@@ -269,46 +267,47 @@ void ActiveStream::UpdateFog()
 
 int ActiveStream::OnDrawStaticProp()
 {
-    auto lock = ReadLock();
-    if (!m_stream)
-        return 0;
-
-    auto tweak = m_stream->begin<MaterialTweak>();
-    if (tweak == m_stream->end<MaterialTweak>())
+    RenderPlan::ConstPtr plan = GetPlan();
+    if (!plan || !plan->affect_props)
         return 0;
-    
-    if (!tweak->props)
-        return 0;
-    if (tweak->color_multiply[3] == 0)
+    if (plan->prop_color[3] == 0)
         return EventReturnFlags::NoOriginal;
     
     // We don't need to restore these values, because the callers always store and restore it.
-    Interfaces::studio_render->SetColorModulation(tweak->color_multiply.data());
-    Interfaces::studio_render->SetAlphaModulation(tweak->color_multiply[3]);
+    Interfaces::studio_render->SetColorModulation(plan->prop_color.data());
+    Interfaces::studio_render->SetAlphaModulation(plan->prop_color[3]);
     return 0;
 }
 
 int ActiveStream::PreDrawModelExecute(const DrawModelState_t& state, const ModelRenderInfo_t& pInfo, matrix3x4_t* pCustomBoneToWorld)
 {
-    auto lock = ReadLock();
-    if (!m_stream)
+    Helper::PerfCounter::Scope perf_scope(s_perf_pre_dme);
+    RenderPlan::ConstPtr plan = GetPlan();
+    if (!plan || plan->models.empty())
         return 0;
     
     CBaseEntity* entity = Interfaces::entlist->GetClientEntity(pInfo.entity_index);
+    bool use_cache = RenderPlan::filter_cache_enabled;
+    uint64_t affected_models = use_cache ? plan->GetAffectedModels(state.m_pStudioHdr) : plan->ClassifyModel(state.m_pStudioHdr);
+    if (entity)
+        affected_models |= use_cache ? plan->GetAffectedModels(pInfo.entity_index, entity) : plan->ClassifyEntity(entity);
 
-    for (auto tweak = m_stream->begin<ModelTweak>(); tweak != m_stream->end<ModelTweak>(); ++tweak)
+    for (size_t i = 0; i < plan->models.size(); ++i)
     {
-        bool is_affected = entity && tweak->IsEntityAffected(entity);
-        if (!is_affected)
+        const RenderPlan::ModelEntry& model = plan->models[i];
+        bool is_affected;
+        if (i < RenderPlan::MAX_CACHED_MODELS)
+            is_affected = (affected_models >> i) & 1;
+        else
         {
             // NOTE: DO NOT use `m_pStudioHdr->pszName()`. This crashes in 64-bit TF2.
-            is_affected = tweak->IsModelAffected(state.m_pStudioHdr->name);
+            is_affected = (entity && model.tweak->IsEntityAffected(entity)) || model.tweak->IsModelAffected(state.m_pStudioHdr->name);
         }
 
         if (!is_affected)
             continue;
         
-        if (tweak->IsEffectInvisible())
+        if (model.is_invisible)
             return EventReturnFlags::NoOriginal;
 
         // Store original draw parameters
@@ -318,19 +317,17 @@ int ActiveStream::PreDrawModelExecute(const DrawModelState_t& state, const Model
         Interfaces::render_view->GetColorModulation(m_last_dme_params.color.data());
         m_last_dme_params.color[3] = Interfaces::render_view->GetBlend();
         
-        Interfaces::render_view->SetColorModulation(tweak->color_multiply.data());
-        Interfaces::render_view->SetBlend(tweak->color_multiply[3]);
+        Interfaces::render_view->SetColorModulation(model.color.data());
+        Interfaces::render_view->SetBlend(model.color[3]);
 
-        if (tweak->custom_material)
-            Interfaces::model_render->ForcedMaterialOverride(tweak->custom_material->GetMaterial());
+        if (model.override_material)
+            Interfaces::model_render->ForcedMaterialOverride(model.material);
     }
     return 0;
 }
 
 int ActiveStream::PostDrawModelExecute(const DrawModelState_t& state, const ModelRenderInfo_t& pInfo, matrix3x4_t* pCustomBoneToWorld)
 {
-    auto lock = ReadLock();
-
     if (m_is_dme_affected)
     {
         Interfaces::model_render->ForcedMaterialOverride(m_last_dme_params.mat_override, m_last_dme_params.mat_override_type);
@@ -352,7 +349,7 @@ int ActiveStream::OnFrameStageNotify(enum ClientFrameStage_t stage)
     // Everything from this point needs to read the active stream. Acquire the reading lock.
     auto lock = ReadLock();
     UpdateRenderTarget();
-    if (m_should_update_materials)
+    if (m_should_update_materials || m_material_index.IsOutdated())
         UpdateMaterials();
 
     // Always call this so that commands like `cl_drawhud` don't override our changes
@@ -361,6 +358,28 @@ int ActiveStream::OnFrameStageNotify(enum ClientFrameStage_t stage)
     return 0;
 }
 
+void ActiveStream::UpdateRenderPlan()
+{
+    if (!m_stream)
+    {
+        m_plan.store(nullptr, std::memory_order_release);
+        return;
+    }
+
+    CachedPlan& cached = m_plan_cache[m_stream.get()];
+    // The plan is missing, or belongs to a deleted stream whose address was reused
+    if (!cached.plan || cached.stream.lock() != m_stream)
+    {
+        // Drop the plans of other deleted streams, so they don't pile up
+        std::erase_if(m_plan_cache, [this](const auto& entry) {
+            return entry.first != m_stream.get() && entry.second.stream.expired();
+        });
+        cached.stream = m_stream;
+        cached.plan = RenderPlan::Compile(*m_stream);
+    }
+    m_plan.store(cached.plan, std::memory_order_release);
+}
+
 void ActiveStream::UpdateViewMatricies()
 {
     CViewSetup view;
@@ -382,17 +401,11 @@ void ActiveStream::UpdateRenderTarget()
     IDirect3DSurface9* new_color = m_color;
     IDirect3DSurface9* new_depth = m_depth;
 
-    if (IsDepthAvailable() && m_stream)
+    RenderPlan::ConstPtr plan = GetPlan();
+    if (IsDepthAvailable() && plan && plan->pixel_shader)
     {
-        for (auto it = m_stream->begin<CameraTweak>(); it != m_stream->end<CameraTweak>(); ++it)
-        {
-            if (it->pixel_shader)
-            {
-                new_color = m_color_replacement;
-                new_depth = m_depth_replacement_surface;
-                break;
-            }
-        }
+        new_color = m_color_replacement;
+        new_depth = m_depth_replacement_surface;
     }
 
     if (new_color == m_color)
@@ -414,7 +427,8 @@ void ActiveStream::UpdateRenderTarget()
 
 void ActiveStream::UpdateHud()
 {
-    if (!m_stream)
+    RenderPlan::ConstPtr plan = GetPlan();
+    if (!plan)
         return;
 
     // Show/hide the HUD
@@ -430,9 +444,8 @@ void ActiveStream::UpdateHud()
     bool is_visible = Interfaces::panels->IsVisible(viewport);
     bool new_visibility = cl_drawhud->GetBool();
 
-    auto cam_tweak = m_stream->begin<CameraTweak>();
-    if (cam_tweak != m_stream->end<CameraTweak>() && cam_tweak->hud != CameraTweak::HUD_DEFAULT)
-        new_visibility = cam_tweak->hud == CameraTweak::HUD_ENABLED;
+    if (plan->hud != CameraTweak::HUD_DEFAULT)
+        new_visibility = plan->hud == CameraTweak::HUD_ENABLED;
     
     if (is_visible != new_visibility)
         Interfaces::panels->SetVisible(viewport, new_visibility);
@@ -440,29 +453,17 @@ void ActiveStream::UpdateHud()
 
 int ActiveStream::OnOverrideView(CViewSetup* view_setup)
 {
-    auto lock = ReadLock();
-    if (!m_stream)
-        return 0;
-    
-    for (auto tweak = m_stream->begin<CameraTweak>(); tweak != m_stream->end<CameraTweak>(); ++tweak)
-    {
-        if (tweak->fov_override)
-            view_setup->fov = tweak->fov;
-    }
+    RenderPlan::ConstPtr plan = GetPlan();
+    if (plan && plan->fov_override)
+        view_setup->fov = plan->fov;
     return 0;
 }
 
 int ActiveStream::OnViewDrawFade()
 {
-    auto lock = ReadLock();
-    if (!m_stream)
-        return 0;
-    
-    for (auto tweak = m_stream->begin<CameraTweak>(); tweak != m_stream->end<CameraTweak>(); ++tweak)
-    {
-        if (tweak->hide_fade)
-            return EventReturnFlags::NoOriginal;
-    }
+    RenderPlan::ConstPtr plan = GetPlan();
+    if (plan && plan->hide_fade)
+        return EventReturnFlags::NoOriginal;
     return 0;
 }
 
@@ -496,47 +497,6 @@ int ActiveStream::OnReset()
     return 0;
 }
 
-void ActiveStream::StoreMaterialParams(IMaterial* mat)
-{
-    auto it = m_affected_materials.find(mat);
-    if (it == m_affected_materials.end()) // Material will be added
-        it = m_affected_materials.insert(std::pair<IMaterial*, OldMaterialParams>(mat, {})).first;
-    else // Material will be validated
-    {
-        const auto& old_params = it->second;
-        if (mat->GetName() == old_params.name)
-            return; // The material already exists
-    }
-    
-    OldMaterialParams& params = it->second;
-    params.name = mat->GetName();
-    mat->GetColorModulation(&params.color[0], &params.color[1], &params.color[2]);
-    params.color[3] = mat->GetAlphaModulation();
-}
-
-void ActiveStream::RestoreMaterialParams(IMaterial* mat)
-{
-    auto it = m_affected_materials.find(mat);
-    if (it == m_affected_materials.end())
-        return;
-
-    const auto& old_params = it->second;
-    if (mat->GetName() == old_params.name)
-    {
-        mat->ColorModulate(old_params.color[0], old_params.color[1], old_params.color[2]);
-        mat->AlphaModulate(old_params.color[3]);
-    }
-    
-    m_affected_materials.erase(it);
-}
-
-void ActiveStream::SetMaterialColor(IMaterial* mat, const std::array<float, 4>& col)
-{
-    StoreMaterialParams(mat);
-    mat->ColorModulate(col[0], col[1], col[2]);
-    mat->AlphaModulate(col[3]);
-}
-
 void ActiveStream::InitializeDxStuff()
 {
     IDirect3DDevice9* device = g_hk_overlay.Device();
@@ -2,7 +2,10 @@
 #include <Modules/BaseModule.h>
 #include <Helper/engine.h>
 #include <Streams/Stream.h>
+#include <Streams/renderplan.h>
 #include <shared_mutex>
+#include <atomic>
+#include <memory>
 #include <unordered_map>
 #include <string>
 #include <mutex>
@@ -21,6 +24,9 @@ struct matrix3x4_t;
  * 
  * Some tweaks and properties (like @ref MaterialTweak) are applied once, when necessary.
  * If such special tweaks/values are modified, call @ref ActiveStream::SignalUpdate to make it re-apply them.
+ * 
+ * Render hooks read a @ref RenderPlan compiled from the stream, which is published without locking.
+ * Modifying a tweak has no effect on the render hooks until @ref ActiveStream::SignalUpdate is called.
  */
 class ActiveStream : public CModule
 {
@@ -30,6 +36,7 @@ public:
         UPDATE_MATERIALS = 1 << 0,
         UPDATE_FOG = 1 << 1,
         UPDATE_CONVARS = 1 << 2,
+        UPDATE_RENDER_PLAN = 1 << 3,
     };
 
     void StartListening() override;
@@ -51,7 +58,7 @@ public:
      * @brief Immediately update material colors.
      * 
      * Only the recorder should use this to update materials many times in a single frame.
-     * This calls @ref ReadLock.
+     * Only texture groups whose colors differ from the previous stream are updated.
      */
     void UpdateMaterials();
     /// @brief Acquire a lock for editing the active stream 
@@ -67,6 +74,8 @@ public:
     bool DrawDepth();
     /// @brief Replaces the call to hlclient->RenderView
     void RenderView();
+    /// @brief Get the active stream's compiled render plan, or `nullptr`. No locks are used.
+    RenderPlan::ConstPtr GetPlan() const { return m_plan.load(std::memory_order_acquire); }
 
 protected:
     int OnDrawStaticProp();
@@ -86,24 +95,21 @@ private:
         OverrideType_t mat_override_type = (OverrideType_t )0;
     };
 
-    struct OldMaterialParams
+    struct CachedPlan
     {
-        std::string name;
-        std::array<float, 4> color;
+        /// @brief Used to check that the key still refers to the same stream
+        std::weak_ptr<Stream> stream;
+        RenderPlan::ConstPtr plan;
     };
 
+    /// @brief Publish the plan for @ref m_stream, compiling it if necessary. Requires @ref WriteLock.
+    void UpdateRenderPlan();
     /// @brief Plz run in game thread
     void UpdateViewMatricies();
     void UpdateRenderTarget();
     void UpdateHud();
     void UpdateFog();
     void UpdateConVars();
-    /// @brief Store a material's original params (if not already stored)
-    void StoreMaterialParams(IMaterial* mat);
-    /// @brief Restore the original parameters to a material
-    void RestoreMaterialParams(IMaterial* mat);
-    /// @brief Override the material's color
-    void SetMaterialColor(IMaterial* mat, const std::array<float, 4>& col);
     IMaterial* CreateMatteMaterial();
     void InitializeDxStuff();
     
@@ -117,23 +123,30 @@ private:
     /// @brief Plz lock @ref m_matrices_mutex
     D3DMATRIX m_projection_matrix;
     std::mutex m_matrices_mutex;
-    /// @brief Was the last DrawModelExecute call affected?
+    /// @brief Was the last DrawModelExecute call affected? Only accessed by the render thread.
     bool m_is_dme_affected = false;
-    /// @brief Should we iterate all materials and update them?
+    /// @brief Should we update materials from the active plan?
     bool m_should_update_materials = false;
+    MaterialIndex m_material_index;
+    /// @brief The material colors that are currently applied
+    RenderPlan::MaterialGroups m_applied_material_groups;
+    /// @brief The @ref MaterialIndex generation that @ref m_applied_material_groups was applied to
+    uint32_t m_applied_material_generation = 0;
     bool m_should_update_fog = false;
-    std::vector<Helper::RestoringConVar> m_convars;
+    /// @brief ConVars overridden by the active stream
+    std::unordered_map<ConVar*, Helper::RestoringConVar> m_convars;
     /// @brief Parameters stored during the last DrawModelExecute call
     LastDrawParams m_last_dme_params;
-    /**
-     * @brief Affected materials.
-     * 
-     * There is no guarantee that pointers remain valid, or that the pointer hasn't been re-occupied.
-     * If a material is found in the map, check that their strings match.
-     */
-    std::unordered_map<IMaterial*, OldMaterialParams> m_affected_materials;
     /// @brief Pretty please don't access this without a @ref ReadLock and @ref WriteLock!
     Stream::Ptr m_stream;
+    /**
+     * @brief Compiled plans of recently active streams. Requires @ref WriteLock.
+     * @details Keyed by address, so each entry's owner is checked before its plan is used.
+     * Entries of deleted streams are dropped whenever a plan is compiled.
+     */
+    std::unordered_map<const Stream*, CachedPlan> m_plan_cache;
+    /// @brief The plan of @ref m_stream. Written with @ref WriteLock, but read without locking.
+    std::atomic<RenderPlan::ConstPtr> m_plan;
     std::shared_mutex m_mtx;
 };
 
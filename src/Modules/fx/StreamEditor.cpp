@@ -4,6 +4,7 @@
 #include <imgui/misc/cpp/imgui_stdlib.h>
 #include <nlohmann/json.hpp>
 #include <Helper/json.h>
+#include <Helper/imgui.h>
 #include "StreamEditor.h"
 #include "ActiveStream.h"
 #include "recorder.h"
@@ -303,15 +304,17 @@ void StreamEditor::ShowStreamEditor(const Stream::Ptr& stream)
     ImGui::SameLine();
     if (ImGui::Button("Remove##tweak"))
     {
-        if (current_tweak < tweaks_list->size())
-            tweaks_list->erase(tweaks_list->begin() + current_tweak);
+        {
+            auto lock = g_active_stream.WriteLock();
+            stream->RemoveTweak(current_tweak);
+        }
         // The removed tweak may have included semi-permanent effect.
         // Signal an update to ensure any semi-permanent effects are reset/recalculated.
         g_active_stream.SignalUpdate(stream);
     }
 
     ImGui::SetNextItemWidth(-1);
-    ImGui::ListBox("##Active tweaks", &current_tweak, tweaks_getter, tweaks_list, tweaks_list->size());
+    ImGui::ListBox("##Active tweaks", &current_tweak, tweaks_getter, (void*)tweaks_list, tweaks_list->size());
 
     if (current_tweak < tweaks_list->size())
     {;
@@ -321,6 +324,35 @@ void StreamEditor::ShowStreamEditor(const Stream::Ptr& stream)
         ImGui::EndChild();
         ImGui::PopStyleVar();
     }
+
+    ShowEncoderEditor(stream);
+}
+
+void StreamEditor::ShowEncoderEditor(const Stream::Ptr& stream)
+{
+    if (!ImGui::CollapsingHeader("Encoder"))
+        return;
+
+    bool has_override = stream->GetVideoConfig() != nullptr;
+    if (ImGui::Checkbox("Override encoder", &has_override))
+    {
+        // Start from the recorder's options, so only the differences need to be changed
+        auto lock = g_active_stream.WriteLock();
+        stream->SetVideoConfig(has_override ? std::make_shared<EncoderConfig>(g_recorder.GetVideoConfig()) : nullptr);
+    }
+    ImGui::SameLine();
+    Helper::ImGuiHelpMarker(
+        "Encode this stream differently from the recorder's settings.\n"
+        "For example, mattes and depth can use a fast encoder, while the main video uses a slow one.\n"
+        "The framerate is always the recorder's."
+    );
+
+    if (stream->GetVideoConfig())
+    {
+        ImGui::PushID("stream_videoconfig");
+        stream->GetVideoConfig()->ShowImguiControls(false);
+        ImGui::PopID();
+    }
 }
 
 void StreamEditor::PopupTweakCreator(const Stream::Ptr& stream)
@@ -345,8 +377,11 @@ void StreamEditor::PopupTweakCreator(const Stream::Ptr& stream)
         {
             if (choice >= 0 && choice < RenderTweak::default_tweaks.size())
             {
-                auto lock = g_active_stream.WriteLock();
-                stream->GetRenderTweaks().emplace_back(RenderTweak::default_tweaks.at(choice)->Clone());
+                {
+                    auto lock = g_active_stream.WriteLock();
+                    stream->AddTweak(RenderTweak::default_tweaks.at(choice)->Clone());
+                }
+                g_active_stream.SignalUpdate(stream);
             }
         }
 
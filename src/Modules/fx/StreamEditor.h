@@ -28,6 +28,8 @@ private:
     void PopupStreamRenamer(Stream::Ptr stream);
     void PopupStreamPresets();
     void ShowStreamEditor(const Stream::Ptr& stream);
+    /// @brief Edit the stream's encoder override
+    void ShowEncoderEditor(const Stream::Ptr& stream);
     void PopupTweakCreator(const Stream::Ptr& stream);
     void ShowTweakEditor(const RenderTweak::Ptr& render_tweak);
     /// @brief True if the name already exists 
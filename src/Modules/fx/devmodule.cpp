@@ -13,6 +13,8 @@
 #include <Helper/dxerr.h>
 #include <Helper/imgui.h>
 #include <Modules/GameEjector.h>
+#include <Helper/perf.h>
+#include <Streams/renderplan.h>
 
 #define PRINT_DXRESULT(expr) PrintDXResult(expr, #expr)
 
@@ -41,6 +43,7 @@ private:
     static void DisplayPropertyTree(RecvProp* prop);
     static void DisplayTataTableTree(RecvTable* table);
     static void DisplaySurfaceInfo(const D3DSURFACE_DESC& desc, const char* label);
+    static void DisplayPerfCounters();
 };
 
 DevModule g_devmodule;
@@ -125,6 +128,8 @@ int DevModule::OnTabBar()
         ImGui::TreePop();
     }
 
+    DisplayPerfCounters();
+
     if (m_buffers_initialized)
     {
         DisplaySurfaceInfo(m_rendertarget_desc, "Render target");
@@ -242,6 +247,50 @@ void DevModule::DisplaySurfaceInfo(const D3DSURFACE_DESC& desc, const char* labe
     }
 }
 
+void DevModule::DisplayPerfCounters()
+{
+    if (!ImGui::TreeNode("Performance counters"))
+        return;
+
+    bool enabled = Helper::PerfCounter::IsEnabled();
+    if (ImGui::Checkbox("Enable counters", &enabled))
+        Helper::PerfCounter::SetEnabled(enabled);
+    ImGui::SameLine();
+    Helper::ImGuiHelpMarker("Time the counted functions. This adds some overhead to every model draw.");
+
+    bool filter_cache = RenderPlan::filter_cache_enabled;
+    if (ImGui::Checkbox("Model filter caches", &filter_cache))
+        RenderPlan::filter_cache_enabled = filter_cache;
+    ImGui::SameLine();
+    if (ImGui::Button("Reset##perf"))
+    {
+        for (Helper::PerfCounter* counter : Helper::PerfCounter::GetAll())
+            counter->Reset();
+    }
+
+    if (ImGui::BeginTable("##perf_counters", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchProp))
+    {
+        ImGui::TableSetupColumn("Counter");
+        ImGui::TableSetupColumn("Calls");
+        ImGui::TableSetupColumn("Total (ms)");
+        ImGui::TableSetupColumn("Average (us)");
+        ImGui::TableHeadersRow();
+
+        for (Helper::PerfCounter* counter : Helper::PerfCounter::GetAll())
+        {
+            uint64_t calls = counter->GetCalls();
+            uint64_t total_ns = counter->GetTotalNs();
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(counter->GetName());
+            ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)calls);
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", total_ns / 1e6);
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", calls ? total_ns / 1e3 / calls : 0.0);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::TreePop();
+}
+
 static bool PrintDXResult(HRESULT err, const char* expr)
 {
     if (SUCCEEDED(err))
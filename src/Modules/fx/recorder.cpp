@@ -3,7 +3,10 @@
 #include <Helper/json.h>
 #include <Helper/ffmpeg.h>
 #include <Helper/defer.h>
+#include <Helper/perf.h>
 #include <Streams/videowriter.h>
+#include <Streams/calibration.h>
+#include <Base/Base.h>
 #include <Hooks/ClientHook.h>
 #include <Hooks/OverlayHook.h>
 #include <Hooks/fx/VideoModeHook.h>
@@ -25,11 +28,42 @@
 #include <varargs.h>
 #include <chrono>
 #include <array>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
 #include <cassert>
 #include <thread>
 
 static const std::string DEFAULT_STREAM_NAME = "video";
 
+struct StallPolicyDesc
+{
+    const char* name;
+    const char* desc;
+};
+/// @brief Indexed by `FramePool::StallPolicy`
+static const std::array<StallPolicyDesc, 4> STALL_POLICIES = {{
+    {"Block", "Wait for the encoders, however long it takes"},
+    {"Borrow backlog", "After the stall budget, move a waiting frame into the backlog and reuse it.\n"
+        "This needs the compressed backlog or burst capture. Otherwise, it blocks."},
+    {"Degrade", "After the stall budget, write the slowest stream's PNGs without compression, until the stalls stop"},
+    {"Drop", "After the stall budget, skip the frame and log it. The movie will be missing frames."},
+}};
+
+struct CaptureFormatDesc
+{
+    const char* name;
+    const char* desc;
+    D3DFORMAT format;
+};
+static const std::array<CaptureFormatDesc, 3> CAPTURE_FORMATS = {{
+    {"8-bit", "What the game normally renders. Fastest, and works with every encoder.", D3DFMT_A8R8G8B8},
+    {"16-bit float", "Keeps HDR render targets, with 11 bits of precision. Twice the memory of 8-bit.", D3DFMT_A16B16G16R16F},
+    {"32-bit float", "Keeps HDR render targets with full precision. Four times the memory of 8-bit.", D3DFMT_A32B32G32R32F},
+}};
+
+static Helper::PerfCounter s_perf_stall("CRecorder stall");
+
 static std::filesystem::path game_dir;
 static std::filesystem::path working_dir;
 static ConCommand sf_recorder_start("sf_recorder_start",
@@ -47,9 +81,64 @@ static ConCommand sf_recorder_start("sf_recorder_start",
 );
 static ConCommand sf_recorder_stop("sf_recorder_stop",
     [] { g_recorder.StopMovie(); },
-    "Stop the current recording"
+    "Stop the current recording or batch"
+);
+static ConCommand sf_recorder_batch("sf_recorder_batch",
+    [](const CCommand& cmd) {
+        if (cmd.ArgC() == 2) // Path was most likely passed in quotes, without spaces
+            g_recorder.StartBatch(cmd.Arg(1));
+        else if (cmd.ArgC() > 2) // Path was most likely passed without quotes
+            g_recorder.StartBatch(cmd.ArgS());
+        else
+            Interfaces::engine->ClientCmd_Unrestricted("echo sf_recorder_batch <job file>");
+    },
+    "Usage: sf_recorder_batch <job file>\n"
+    "Stop any current recording, and record every clip in a JSON job file.\n"
+    "The file is a list of clips like {\"demo\": \"demos/match\", \"start_tick\": 1000, \"end_tick\": 1500, \"streams\": [\"video\"]},\n"
+    "or an object with an \"output\" folder and a \"clips\" list. Clips are saved in the output folder by \"name\".\n"
+);
+static ConCommand sf_recorder_calibrate("sf_recorder_calibrate",
+    [](const CCommand& cmd) {
+        float target_fps = 0.f;
+        bool apply = false, force = false;
+        for (int i = 1; i < cmd.ArgC(); ++i)
+        {
+            if (!strcmp(cmd.Arg(i), "apply"))
+                apply = true;
+            else if (!strcmp(cmd.Arg(i), "force"))
+                force = true;
+            else
+                target_fps = (float)atof(cmd.Arg(i));
+        }
+        g_recorder.StartCalibration(target_fps, apply, force);
+    },
+    "Usage: sf_recorder_calibrate [target fps] [apply] [force]\n"
+    "Benchmark the image encoders and thread counts on the next few frames, and the output folder's write speed.\n"
+    "The settings with the smallest files that keep up with the target fps are recommended, or applied with \"apply\".\n"
+    "Results are cached per resolution and target. Use \"force\" to benchmark again.\n"
 );
 
+/// @brief Frames captured for the encoder calibration
+static constexpr size_t CALIBRATION_FRAMES = 3;
+
+static std::filesystem::path GetCalibrationCachePath() {
+    return Base::GetModuleDir() / "sparklyfx" / "calibration.json";
+}
+
+static nlohmann::json LoadCalibrationCache()
+{
+    std::ifstream file(GetCalibrationCachePath());
+    if (!file)
+        return nlohmann::json::object();
+    try {
+        nlohmann::json cache = nlohmann::json::parse(file);
+        if (cache.is_object())
+            return cache;
+    }
+    catch (const std::exception&) {}
+    return nlohmann::json::object();
+}
+
 void CRecorder::StartListening()
 {
     Interfaces::engine->ClientCmd_Unrestricted("echo SparklyFX is loaded. Press F11 or Insert to open the menu.");
@@ -161,8 +250,13 @@ int CRecorder::OnTabBar()
     if (clear_error_log)
         VideoLog::Clear();
 
-    if (ImGui::Button(IsRecordingMovie() ? "Stop" : "Start"))
+    if (ImGui::Button(IsRecordingMovie() || m_batch_num_clips > 0 ? "Stop" : "Start"))
         ToggleRecording(m_movie_path);
+    if (size_t num_clips = m_batch_num_clips; num_clips > 0)
+    {
+        ImGui::SameLine();
+        ImGui::Text("Batch: clip %zu / %zu", min(m_batch_clip + 1, num_clips), num_clips);
+    }
     
     m_record_bind.OnMenu("Record hotkey");
     
@@ -219,6 +313,25 @@ int CRecorder::OnTabBar()
     m_videoconfig.ShowImguiControls();
     ImGui::PopID();
 
+    if (ImGui::BeginCombo("Capture format", CAPTURE_FORMATS[m_capture_format].name))
+    {
+        for (size_t i = 0; i < CAPTURE_FORMATS.size(); ++i)
+        {
+            if (ImGui::Selectable(CAPTURE_FORMATS[i].name, i == (size_t)m_capture_format))
+                m_capture_format = (int)i;
+            if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNone))
+                ImGui::SetTooltip("%s", CAPTURE_FORMATS[i].desc);
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::SameLine();
+    Helper::ImGuiHelpMarker(
+        "The format that frames are copied into before encoding.\n"
+        "Float formats only add detail when the game renders in HDR, such as with \"mat_hdr_level 2\".\n"
+        "Use the EXR encoder to keep it, or pick a tonemap to bring it into 8-bit encoders.\n"
+        "Masks, depth and raw dumps need the 8-bit format."
+    );
+
     ImGui::SliderInt("Frame pool size", &m_framepool_size, 1, 128, "%d", ImGuiSliderFlags_AlwaysClamp);
     ImGui::SameLine();
     Helper::ImGuiHelpMarker(
@@ -226,11 +339,139 @@ int CRecorder::OnTabBar()
         "If your CPU has 8 cores, you may want a pool with 9 or 12 frames.\n"
         "Setting this value too high or too low can make it slower.\n"
     );
+    ImGui::SliderInt("Encoder threads", &m_encoder_threads, 0, 128, m_encoder_threads == 0 ? "One per core" : "%d", ImGuiSliderFlags_AlwaysClamp);
+    ImGui::SameLine();
+    Helper::ImGuiHelpMarker(
+        "The number of threads that encode frames.\n"
+        "The calibration sets this to the fewest threads that keep up, which leaves the other cores to the game."
+    );
+
+    if (m_calibrating)
+    {
+        ImGui::BeginDisabled();
+        ImGui::Button("Calibrating...");
+        ImGui::EndDisabled();
+    }
+    else if (ImGui::Button("Calibrate encoder"))
+        StartCalibration(0.f, false, false);
+    ImGui::SameLine();
+    Helper::ImGuiHelpMarker(
+        "Benchmark PNG and QOI on the next few frames with different thread counts, and the output folder's write speed.\n"
+        "This recommends the settings with the smallest files that keep up with the framerate.\n"
+        "Results are cached. Use \"sf_recorder_calibrate force\" to benchmark again."
+    );
+    {
+        std::scoped_lock lock{m_calibration_mtx};
+        if (m_calibration_result)
+        {
+            const CalibrationResult& result = *m_calibration_result;
+            if (!result.sustains_target)
+                ImGui::TextColored(ImVec4(1,1,0,1), "[!] Nothing kept up with %.0f fps. The fastest was:", m_calibration_fps);
+            ImGui::Text(
+                "%s, compression %d, %d threads, frame pool %d: %.0f fps, %.0f KB per frame",
+                result.encoder.c_str(), result.png_compression, result.num_threads, result.framepool_size, result.fps, result.kb_per_frame
+            );
+            ImGui::SameLine();
+            if (ImGui::Button("Apply##calibration"))
+                ApplyCalibration(result);
+        }
+    }
+
+    ImGui::Checkbox("Adaptive frame pool", &m_adaptive_framepool);
+    ImGui::SameLine();
+    Helper::ImGuiHelpMarker(
+        "While recording, add frames when the game waits on the encoders, and remove frames that aren't used.\n"
+        "The frame pool size is used as the starting size."
+    );
+    if (!m_adaptive_framepool)
+        ImGui::BeginDisabled();
+    ImGui::SliderInt("Frame pool RAM budget (MB)", &m_framepool_ram_budget, 64, 16384, "%d", ImGuiSliderFlags_AlwaysClamp);
+    if (!m_adaptive_framepool)
+        ImGui::EndDisabled();
+
+    ImGui::Checkbox("Compressed backlog", &m_backlog);
+    ImGui::SameLine();
+    Helper::ImGuiHelpMarker(
+        "When the encoders fall behind, idle threads compress frames in RAM so the game can keep going.\n"
+        "Frames are decompressed and encoded when the encoders catch up, or after the recording stops.\n"
+        "Compression needs some CPU time, so leave this off if your encoders keep up."
+    );
+    if (!m_backlog)
+        ImGui::BeginDisabled();
+    ImGui::SliderInt("Backlog RAM budget (MB)", &m_backlog_ram_budget, 64, 65536, "%d", ImGuiSliderFlags_AlwaysClamp);
+    ImGui::Checkbox("Spill to disk", &m_backlog_spill);
+    ImGui::SameLine();
+    Helper::ImGuiHelpMarker(
+        "When the backlog's RAM is full, write compressed frames to a scratch file instead of waiting.\n"
+        "Choose a folder on a fast drive. The file is deleted when all frames are written."
+    );
+    if (!m_backlog_spill)
+        ImGui::BeginDisabled();
+    std::string spill_path_str = m_backlog_spill_path.empty() ? "(movie folder)" : m_backlog_spill_path.u8string();
+    ImGui::InputText("##spill_folder", &spill_path_str, ImGuiInputTextFlags_ReadOnly); ImGui::SameLine();
+    if (ImGui::Button("Browse##spill_folder"))
+    {
+        auto optional_path = Helper::OpenFolderDialog(L"Select the scratch folder", &m_backlog_spill_path);
+        if (optional_path)
+            m_backlog_spill_path = std::move(*optional_path);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset##spill_folder"))
+        m_backlog_spill_path.clear();
+    ImGui::SliderInt("Spill budget (GB)", &m_backlog_spill_budget, 1, 1024, "%d", ImGuiSliderFlags_AlwaysClamp);
+    if (!m_backlog_spill)
+        ImGui::EndDisabled();
+    if (!m_backlog)
+        ImGui::EndDisabled();
+
+    ImGui::Checkbox("Burst capture", &m_burst);
+    ImGui::SameLine();
+    Helper::ImGuiHelpMarker(
+        "While recording, only copy frames into a preallocated block of RAM. Encoding starts after the recording stops.\n"
+        "This records short, heavy clips as fast as possible. A new recording can start while the last one is encoding.\n"
+        "When the RAM is full, frames go to the compressed backlog (if enabled), then to the encoders."
+    );
+    if (!m_burst)
+        ImGui::BeginDisabled();
+    ImGui::SliderInt("Burst RAM budget (MB)", &m_burst_ram_budget, 256, 262144, "%d", ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_Logarithmic);
+    ImGui::Checkbox("Large pages", &m_burst_large_pages);
+    ImGui::SameLine();
+    Helper::ImGuiHelpMarker(
+        "Allocate the burst RAM with large pages, which makes copying frames slightly faster.\n"
+        "This needs the \"Lock pages in memory\" privilege, and enough free contiguous RAM.\n"
+        "Normal pages are used if it fails."
+    );
+    if (!m_burst)
+        ImGui::EndDisabled();
+
+    if (ImGui::BeginCombo("Stall policy", STALL_POLICIES[(int)m_stall_policy].name))
+    {
+        for (size_t i = 0; i < STALL_POLICIES.size(); ++i)
+        {
+            if (ImGui::Selectable(STALL_POLICIES[i].name, i == (size_t)m_stall_policy))
+                m_stall_policy = (FramePool::StallPolicy)i;
+            if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNone))
+                ImGui::SetTooltip("%s", STALL_POLICIES[i].desc);
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::SameLine();
+    Helper::ImGuiHelpMarker(
+        "What to do when the game waits on the encoders for longer than the stall budget.\n"
+        "Each frame's wait is saved to stalls.csv in the movie's folder."
+    );
+    if (m_stall_policy == FramePool::StallPolicy::BLOCK)
+        ImGui::BeginDisabled();
+    ImGui::SliderInt("Stall budget (ms)", &m_stall_budget, 1, 1000, "%d", ImGuiSliderFlags_AlwaysClamp);
+    if (m_stall_policy == FramePool::StallPolicy::BLOCK)
+        ImGui::EndDisabled();
 
     int screen_w, screen_h;
     Interfaces::engine->GetScreenSize(screen_w, screen_h);
-    // Approximate framepool RAM, assuming a 32-bit XRGB framebuffer
-    float framepool_ram = screen_w * screen_h * 4;
+    // Approximate framepool RAM, with the pixel size of the capture format
+    Helper::D3DFORMAT_info capture_info;
+    Helper::GetD3DFormatInfo(CAPTURE_FORMATS[m_capture_format].format, &capture_info);
+    float framepool_ram = (float)screen_w * screen_h * capture_info.stride;
     framepool_ram = framepool_ram * m_framepool_size / (1024 * 1024);
     
     if (was_recording)
@@ -238,7 +479,29 @@ int CRecorder::OnTabBar()
     
     // Disabled text has less visual clutter
     ImGui::BeginDisabled();
-    ImGui::Text("Framepool RAM: %f MB", framepool_ram);
+    if (m_adaptive_framepool)
+        ImGui::Text("Framepool RAM: %f MB (up to %d MB)", framepool_ram, max(m_framepool_ram_budget, (int)framepool_ram));
+    else
+        ImGui::Text("Framepool RAM: %f MB", framepool_ram);
+    if (m_backlog)
+        ImGui::Text("Backlog RAM: up to %d MB", m_backlog_ram_budget);
+    if (m_burst)
+        ImGui::Text("Burst RAM: %d MB", m_burst_ram_budget);
+    ImGui::EndDisabled();
+
+    {
+        std::scoped_lock lock{m_draining_mtx};
+        for (const DrainingMovie& draining : m_draining_movies)
+        {
+            size_t num_pending = draining.movie->GetNumPending();
+            size_t num_written = draining.num_frames - min(num_pending, draining.num_frames);
+            std::string progress = Helper::sprintf("%zu / %zu frames", num_written, draining.num_frames);
+            ImGui::ProgressBar((float)num_written / draining.num_frames, ImVec2(-FLT_MIN, 0), progress.c_str());
+            ImGui::TextWrapped("Writing in the background: %s", draining.movie->GetRootPath().u8string().c_str());
+        }
+    }
+
+    ImGui::BeginDisabled();
     ImGui::Text("Framepool threads: %u", std::thread::hardware_concurrency());
     ImGui::TextWrapped("Game directory: %s", game_dir.u8string().c_str());
     ImGui::TextWrapped("Working directory: %s", working_dir.u8string().c_str());
@@ -265,6 +528,20 @@ int CRecorder::OnConfigSave()
         {"m_autoclose_menu",        m_autoclose_menu},
         {"m_autostop_recording",    m_autostop_recording},
         {"m_framepool_size",        m_framepool_size},
+        {"m_encoder_threads",       m_encoder_threads},
+        {"m_capture_format",        m_capture_format},
+        {"m_adaptive_framepool",    m_adaptive_framepool},
+        {"m_framepool_ram_budget",  m_framepool_ram_budget},
+        {"m_backlog",               m_backlog},
+        {"m_backlog_ram_budget",    m_backlog_ram_budget},
+        {"m_backlog_spill",         m_backlog_spill},
+        {"m_backlog_spill_path",    m_backlog_spill_path},
+        {"m_backlog_spill_budget",  m_backlog_spill_budget},
+        {"m_burst",                 m_burst},
+        {"m_burst_ram_budget",      m_burst_ram_budget},
+        {"m_burst_large_pages",     m_burst_large_pages},
+        {"m_stall_policy",          (int)m_stall_policy},
+        {"m_stall_budget",          m_stall_budget},
         {"m_movie_path",            m_movie_path},
         {"m_videoconfig",           m_videoconfig.ToJson()}
     };
@@ -286,11 +563,35 @@ int CRecorder::OnConfigLoad()
     Helper::FromJson(j, "m_autoclose_menu", m_autoclose_menu);
     Helper::FromJson(j, "m_autostop_recording", m_autostop_recording);
     Helper::FromJson(j, "m_framepool_size", safe_framepool_size);
+    Helper::FromJson(j, "m_encoder_threads", m_encoder_threads);
+    Helper::FromJson(j, "m_capture_format", m_capture_format);
+    Helper::FromJson(j, "m_adaptive_framepool", m_adaptive_framepool);
+    Helper::FromJson(j, "m_framepool_ram_budget", m_framepool_ram_budget);
+    Helper::FromJson(j, "m_backlog", m_backlog);
+    Helper::FromJson(j, "m_backlog_ram_budget", m_backlog_ram_budget);
+    Helper::FromJson(j, "m_backlog_spill", m_backlog_spill);
+    Helper::FromJson(j, "m_backlog_spill_path", m_backlog_spill_path);
+    Helper::FromJson(j, "m_backlog_spill_budget", m_backlog_spill_budget);
+    Helper::FromJson(j, "m_burst", m_burst);
+    Helper::FromJson(j, "m_burst_ram_budget", m_burst_ram_budget);
+    Helper::FromJson(j, "m_burst_large_pages", m_burst_large_pages);
+    int stall_policy = (int)m_stall_policy;
+    Helper::FromJson(j, "m_stall_policy", stall_policy);
+    if (stall_policy >= 0 && stall_policy < (int)STALL_POLICIES.size())
+        m_stall_policy = (FramePool::StallPolicy)stall_policy;
+    Helper::FromJson(j, "m_stall_budget", m_stall_budget);
     Helper::FromJson(j, "m_movie_path", m_movie_path);
     m_videoconfig.FromJson(Helper::FromJson(j, "m_videoconfig"));
     safe_framepool_size = min(safe_framepool_size, 128);
     safe_framepool_size = max(safe_framepool_size, 1);
     m_framepool_size = safe_framepool_size;
+    m_encoder_threads = max(0, min(m_encoder_threads, 128));
+    m_capture_format = max(0, min(m_capture_format, (int)CAPTURE_FORMATS.size() - 1));
+    m_framepool_ram_budget = max(m_framepool_ram_budget, 64);
+    m_backlog_ram_budget = max(m_backlog_ram_budget, 64);
+    m_backlog_spill_budget = max(m_backlog_spill_budget, 1);
+    m_burst_ram_budget = max(m_burst_ram_budget, 256);
+    m_stall_budget = max(m_stall_budget, 1);
     return 0;
 }
 
@@ -313,10 +614,16 @@ void CRecorder::StopMovie()
     std::scoped_lock lock{m_movie_mtx};
     m_do_stop_recording = true;
 }
+void CRecorder::StartBatch(const std::filesystem::path& job_path)
+{
+    std::scoped_lock lock{m_movie_mtx};
+    m_next_batch_path = job_path;
+    m_do_start_batch = true;
+}
 void CRecorder::ToggleRecording(const std::filesystem::path& path)
 {
     std::scoped_lock lock{m_movie_mtx};
-    if (m_is_recording_)
+    if (m_is_recording_ || m_batch_num_clips > 0)
         m_do_stop_recording = true;
     else {
         m_do_start_recording = true;
@@ -324,12 +631,13 @@ void CRecorder::ToggleRecording(const std::filesystem::path& path)
     }
 }
 
-bool CRecorder::SetupMovie(const std::filesystem::path& path)
+bool CRecorder::SetupMovie(const std::filesystem::path& path, const std::vector<std::string>* stream_names)
 {
     if (m_movie)
         return true;
     
-    VideoLog::Clear();
+    if (!m_batch) // Keep the log of every clip in a batch
+        VideoLog::Clear();
 
     if (path.empty())
     {
@@ -346,28 +654,108 @@ bool CRecorder::SetupMovie(const std::filesystem::path& path)
     int screen_w, screen_h;
     Interfaces::engine->GetScreenSize(screen_w, screen_h);
 
+    // Frames are copied from the render target with StretchRect, which must be able to convert to the capture format
+    const D3DFORMAT capture_format = CAPTURE_FORMATS[m_capture_format].format;
+    {
+        IDirect3DDevice9* device = g_hk_overlay.Device();
+        IDirect3D9* d3d;
+        device->GetDirect3D(&d3d);
+        defer { d3d->Release(); };
+        IDirect3DSurface9* render_target;
+        device->GetRenderTarget(0, &render_target);
+        defer { render_target->Release(); };
+
+        D3DSURFACE_DESC desc;
+        D3DDEVICE_CREATION_PARAMETERS params;
+        render_target->GetDesc(&desc);
+        device->GetCreationParameters(&params);
+        if (FAILED(d3d->CheckDeviceFormatConversion(params.AdapterOrdinal, params.DeviceType, desc.Format, capture_format)))
+        {
+            VideoLog::AppendError(
+                "The GPU can't copy the game's frames to the %s capture format. Use the 8-bit format instead.\n",
+                CAPTURE_FORMATS[m_capture_format].name
+            );
+            return false;
+        }
+    }
+
     // Create the Movie instance
     {
         auto lock = g_active_stream.ReadLock();
         std::vector<Stream::Ptr> dummy_stream_list;
         auto* stream_list = &g_stream_editor.GetStreams();
-        if (stream_list->empty()) // If there are no streams, make an empty one
+        if (stream_names && !stream_names->empty())
+        {
+            for (const std::string& name : *stream_names)
+            {
+                auto it = std::find_if(stream_list->begin(), stream_list->end(),
+                    [&name](const Stream::Ptr& stream) { return stream->GetName() == name; }
+                );
+                if (it == stream_list->end())
+                {
+                    VideoLog::AppendError("No stream is named '%s'\n", name.c_str());
+                    return false;
+                }
+                dummy_stream_list.push_back(*it);
+            }
+            stream_list = &dummy_stream_list;
+        }
+        else if (stream_list->empty()) // If there are no streams, make an empty one
         {
             dummy_stream_list.emplace_back(std::make_shared<Stream>("video"));
             stream_list = &dummy_stream_list;
         }
 
-        m_movie.emplace(
+        m_movie = std::make_unique<Movie>(
             screen_w, screen_h, path, *stream_list,
-            m_framepool_size, m_videoconfig
+            m_framepool_size, m_encoder_threads, m_videoconfig, m_batch_pool, capture_format
         );
     }
 
     if (m_movie->Failed())
     {
-        m_movie = std::nullopt;
+        m_movie = nullptr;
         return false;
     }
+    m_stall_times.clear();
+
+    // A batch's clips share a pool, which is only configured for the first clip
+    if (!m_batch_pool || m_movie->GetSharedFramePool() != m_batch_pool)
+    {
+        if (m_adaptive_framepool)
+        {
+            Helper::D3DFORMAT_info capture_info;
+            Helper::GetD3DFormatInfo(capture_format, &capture_info);
+            size_t frame_size = (size_t)screen_w * screen_h * capture_info.stride;
+            size_t max_frames = (size_t)m_framepool_ram_budget * 1024 * 1024 / frame_size;
+            m_movie->GetFramePool().SetAdaptiveLimits(1, max(max_frames, (size_t)m_framepool_size));
+        }
+        if (m_backlog)
+        {
+            m_movie->GetFramePool().SetBacklog((size_t)m_backlog_ram_budget * 1024 * 1024);
+            if (m_backlog_spill)
+            {
+                const std::filesystem::path& folder = m_backlog_spill_path.empty() ? m_movie->GetRootPath() : m_backlog_spill_path;
+                auto time = std::chrono::steady_clock::now().time_since_epoch();
+                std::filesystem::path spill_path = folder / Helper::sprintf(
+                    "backlog-%lld.tmp", (long long)std::chrono::duration_cast<std::chrono::milliseconds>(time).count()
+                );
+                if (!m_movie->GetFramePool().SetBacklogSpill(std::move(spill_path), (uint64_t)m_backlog_spill_budget << 30))
+                {
+                    m_movie = nullptr;
+                    return false;
+                }
+            }
+        }
+        if (m_burst && !m_movie->GetFramePool().SetBurst((size_t)m_burst_ram_budget * 1024 * 1024, m_burst_large_pages))
+        {
+            m_movie = nullptr;
+            return false;
+        }
+        m_movie->GetFramePool().SetStallPolicy(m_stall_policy, std::chrono::milliseconds(m_stall_budget));
+    }
+    if (m_batch)
+        m_batch_pool = m_movie->GetSharedFramePool();
 
     // Use engine_tool to record sound for us, otherwise we would need a signature to SND_StartMovie
     KeyValuesAD movie_params("movie_params");
@@ -376,7 +764,7 @@ bool CRecorder::SetupMovie(const std::filesystem::path& path)
     movie_params->SetFloat("framerate", m_videoconfig.framerate); // This one is a float. Dunno why.
     Interfaces::engine_tool->StartMovieRecording(movie_params);
 
-    if (m_autoresume_demo)
+    if (m_autoresume_demo || m_batch) // Batch clips are seeked while paused
         Interfaces::engine->ExecuteClientCmd("demo_resume");
     if (m_autoclose_menu)
         g_input.SetOverlayOpen(false);
@@ -411,9 +799,12 @@ void CRecorder::CleanupMovie()
         return;
 
     Interfaces::engine_tool->EndMovieRecording();
-    if (m_autopause_demo)
-        Interfaces::engine->ExecuteClientCmd("demo_pause");
-    g_stream_editor.OnEndMovie(); // This just sets the preview stream again
+    if (!m_batch) // Between clips, the batch seeks the demo itself, and keeps the streams warm
+    {
+        if (m_autopause_demo)
+            Interfaces::engine->ExecuteClientCmd("demo_pause");
+        g_stream_editor.OnEndMovie(); // This just sets the preview stream again
+    }
     
     // Sometimes the audio file cannot be renamed because the engine is still writing to it.
     // The solution? Retry a couple times in another thread.
@@ -421,7 +812,363 @@ void CRecorder::CleanupMovie()
     std::filesystem::path new_audio_path = m_movie->GetRootPath() / "audio.wav";
     std::filesystem::path old_audio_path = game_dir / m_movie->GetTempAudioName();
     std::thread(AttemptToMoveTempAudioFile, std::move(old_audio_path), std::move(new_audio_path)).detach();
-    m_movie = std::nullopt;
+    WriteStallTimes();
+
+    // Keep the movie alive until its queued frames are written, instead of dropping them
+    size_t num_pending = 0;
+    if (!m_movie->Failed())
+    {
+        if (!m_movie->IsFramePoolShared()) // A shared pool keeps capturing the next clip
+            m_movie->GetFramePool().EndCapture();
+        num_pending = m_movie->GetNumPending();
+    }
+    if (num_pending > 0)
+    {
+        VideoLog::Append(Helper::sprintf("Writing %zu remaining frames in the background\n", num_pending));
+        std::scoped_lock lock{m_draining_mtx};
+        m_draining_movies.push_back({std::move(m_movie), num_pending});
+    }
+    m_movie = nullptr;
+}
+
+bool CRecorder::SetupBatch(const std::filesystem::path& job_path)
+{
+    VideoLog::Clear();
+
+    std::ifstream file{job_path};
+    if (!file)
+    {
+        VideoLog::AppendError("Failed to open batch job '%s'\n", job_path.u8string().c_str());
+        return false;
+    }
+
+    std::string error;
+    std::optional<BatchJob> job = BatchJob::Parse(file, &error);
+    if (!job)
+    {
+        VideoLog::AppendError("Invalid batch job '%s': %s\n", job_path.u8string().c_str(), error.c_str());
+        return false;
+    }
+
+    m_batch_output = job->output.empty() ? m_movie_path : job->output;
+    m_batch_num_clips = job->clips.size();
+    m_batch_clip = 0;
+    m_batch.emplace(std::move(job->clips));
+    VideoLog::Append(Helper::sprintf("Starting a batch of %zu clips\n", m_batch->GetNumClips()));
+    return true;
+}
+
+void CRecorder::UpdateBatch()
+{
+    BatchScheduler::Observation observation;
+    observation.playing_demo = Interfaces::engine->IsPlayingDemo();
+    observation.loading = !Interfaces::engine->IsInGame() || Interfaces::engine->IsDrawingLoadingImage();
+    observation.tick = Interfaces::engine->GetDemoPlaybackTick();
+
+    const BatchClip* clip = m_batch->GetClip();
+    switch (m_batch->Update(observation))
+    {
+    case BatchScheduler::Action::NONE:
+        break;
+    case BatchScheduler::Action::PLAY_DEMO:
+        Interfaces::engine->ExecuteClientCmd(Helper::sprintf("playdemo \"%s\"", clip->demo.c_str()).c_str());
+        break;
+    case BatchScheduler::Action::SEEK:
+        // Seek relative to the start of the demo, and pause when the tick is reached
+        Interfaces::engine->ExecuteClientCmd(Helper::sprintf("demo_gototick %d 0 1", clip->start_tick).c_str());
+        break;
+    case BatchScheduler::Action::START:
+        VideoLog::Append(Helper::sprintf("Recording clip '%s' (%zu / %zu)\n",
+            clip->name.c_str(), m_batch->GetClipIndex() + 1, m_batch->GetNumClips()
+        ));
+        if (!SetupMovie(m_batch_output / clip->name, &clip->streams))
+            m_batch->Abort(); // The clip is stopped at the next update, which ends the batch
+        break;
+    case BatchScheduler::Action::STOP:
+        CleanupMovie();
+        m_batch_clip = m_batch->GetClipIndex();
+        break;
+    case BatchScheduler::Action::SKIP:
+        VideoLog::AppendError("Failed to load demo '%s'. Skipping clip '%s'.\n", clip->demo.c_str(), clip->name.c_str());
+        m_batch_clip = m_batch->GetClipIndex();
+        break;
+    case BatchScheduler::Action::FINISHED:
+        VideoLog::Append(Helper::sprintf("Finished a batch of %zu clips\n", m_batch->GetNumClips()));
+        CleanupBatch();
+        break;
+    }
+}
+
+void CRecorder::CleanupBatch()
+{
+    if (!m_batch)
+        return;
+
+    // The last clip's movie still references the pool, and finishes it when it's drained
+    if (m_batch_pool)
+        m_batch_pool->EndCapture();
+    m_batch_pool = nullptr;
+    m_batch = std::nullopt;
+    m_batch_clip = 0;
+    m_batch_num_clips = 0;
+
+    if (m_autopause_demo)
+        Interfaces::engine->ExecuteClientCmd("demo_pause");
+    g_stream_editor.OnEndMovie();
+}
+
+void CRecorder::UpdateDrainingMovies()
+{
+    std::vector<std::unique_ptr<Movie>> finished;
+    {
+        std::scoped_lock lock{m_draining_mtx};
+        for (auto it = m_draining_movies.begin(); it != m_draining_movies.end();)
+        {
+            if (it->movie->GetNumPending() > 0)
+            {
+                ++it;
+                continue;
+            }
+            finished.push_back(std::move(it->movie));
+            it = m_draining_movies.erase(it);
+        }
+    }
+
+    // Closing a movie waits on its writers, so the menu isn't blocked meanwhile
+    for (auto& movie : finished)
+    {
+        if (!movie->IsFramePoolShared()) // Otherwise, the pool is finished by its last movie
+            movie->GetFramePool().Finish();
+        VideoLog::Append(Helper::sprintf("Finished writing '%s'\n", movie->GetRootPath().u8string().c_str()));
+    }
+}
+
+FramePool::FramePtr CRecorder::PopEmptyFrame(const Stream& stream, size_t frame_index)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto frame = m_movie->GetFramePool().PopEmptyFrame();
+    auto stall = std::chrono::steady_clock::now() - start;
+    s_perf_stall.Add(stall);
+
+    if (m_stall_times.size() <= frame_index)
+        m_stall_times.resize(frame_index + 1);
+    m_stall_times[frame_index] += std::chrono::duration<float, std::milli>(stall).count();
+
+    if (!frame && !m_movie->GetFramePool().IsClosed())
+        VideoLog::Append(Helper::sprintf("Dropped frame %zu of stream '%s'\n", frame_index, stream.GetName().c_str()));
+    return frame;
+}
+
+void CRecorder::WriteStallTimes()
+{
+    if (m_stall_times.empty())
+        return;
+
+    float total = 0.f, worst = 0.f;
+    for (float stall : m_stall_times)
+    {
+        total += stall;
+        worst = max(worst, stall);
+    }
+    VideoLog::Append(Helper::sprintf(
+        "The game waited on the encoders for %.1f ms per frame on average, and %.1f ms at worst\n",
+        total / m_stall_times.size(), worst
+    ));
+
+    std::filesystem::path path = m_movie->GetRootPath() / "stalls.csv";
+    std::ofstream file(path);
+    if (!file)
+    {
+        VideoLog::AppendError("Failed to open file for writing: '%s'\n", path.u8string().c_str());
+        return;
+    }
+    file << "frame,stall_ms\n";
+    for (size_t i = 0; i < m_stall_times.size(); ++i)
+        file << i << ',' << m_stall_times[i] << '\n';
+}
+
+void CRecorder::StartCalibration(float target_fps, bool apply, bool force)
+{
+    if (target_fps <= 0.f)
+        target_fps = (float)m_videoconfig.framerate;
+    int screen_w, screen_h;
+    Interfaces::engine->GetScreenSize(screen_w, screen_h);
+    std::string key = Helper::sprintf("%dx%d@%g/%u", screen_w, screen_h, target_fps, std::thread::hardware_concurrency());
+
+    if (!force)
+    {
+        nlohmann::json cache = LoadCalibrationCache();
+        if (const nlohmann::json* j = Helper::FromJson(cache, key.c_str()))
+        {
+            CalibrationResult result;
+            Helper::FromJson(j, "encoder", result.encoder);
+            Helper::FromJson(j, "png_compression", result.png_compression);
+            Helper::FromJson(j, "framepool_size", result.framepool_size);
+            result.num_threads = max(1, result.framepool_size - 1); // Older caches only have the pool size
+            Helper::FromJson(j, "num_threads", result.num_threads);
+            Helper::FromJson(j, "fps", result.fps);
+            Helper::FromJson(j, "kb_per_frame", result.kb_per_frame);
+            Helper::FromJson(j, "sustains_target", result.sustains_target);
+            VideoLog::Append("Using the cached calibration. Run \"sf_recorder_calibrate force\" to benchmark again.\n");
+            if (apply)
+                ApplyCalibration(result);
+            std::scoped_lock lock{m_calibration_mtx};
+            m_calibration_fps = target_fps;
+            m_calibration_result = result;
+            return;
+        }
+    }
+
+    if (m_calibrating.exchange(true))
+    {
+        VideoLog::Append("The encoders are already being calibrated\n");
+        return;
+    }
+    VideoLog::Append("Calibrating the encoders. This can take a minute.\n");
+    std::scoped_lock lock{m_calibration_mtx};
+    m_do_calibrate = true;
+    m_calibration_fps = target_fps;
+    m_calibration_apply = apply;
+    m_calibration_key = std::move(key);
+}
+
+void CRecorder::UpdateCalibration()
+{
+    if (m_calibration_future.valid())
+    {
+        if (m_calibration_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+        std::optional<CalibrationResult> result = m_calibration_future.get();
+        std::scoped_lock lock{m_calibration_mtx};
+        if (result)
+        {
+            if (m_calibration_apply)
+                ApplyCalibration(*result);
+            m_calibration_result = std::move(result);
+        }
+        m_calibrating = false;
+        return;
+    }
+
+    float target_fps;
+    std::string key;
+    {
+        std::scoped_lock lock{m_calibration_mtx};
+        if (!m_do_calibrate)
+            return;
+        target_fps = m_calibration_fps;
+        key = m_calibration_key;
+    }
+
+    // Sample a few consecutive frames of the game, so the benchmark sees some motion
+    WaitForRenderQueue();
+    int screen_w, screen_h;
+    Interfaces::engine->GetScreenSize(screen_w, screen_h);
+    FrameBufferDx9 buffer(screen_w, screen_h, D3DFMT_A8R8G8B8);
+    CopyCurrentFrameToSurface(buffer.GetSurface());
+    m_calibration_frames.push_back(buffer.ToRgb());
+    if (m_calibration_frames.size() < CALIBRATION_FRAMES)
+        return;
+
+    {
+        std::scoped_lock lock{m_calibration_mtx};
+        m_do_calibrate = false;
+    }
+
+    auto benchmark = [frames = std::move(m_calibration_frames), output_dir = m_movie_path, target_fps, key]()
+        -> std::optional<CalibrationResult>
+    {
+        struct Setting
+        {
+            const EncoderConfig::TypeDesc* type;
+            int png_compression;
+        };
+        std::vector<Setting> settings;
+        EncoderCalibration calibration{frames.size()};
+        for (int compression : {0, 1, 3, 5, 7})
+        {
+            settings.push_back({EncoderConfig::TYPE_PNG, compression});
+            calibration.AddCandidate(Helper::sprintf("PNG, compression %d", compression), [&frames, compression](size_t i) {
+                thread_local std::ostringstream output;
+                thread_local IndexedImage indexed;
+                output.str({});
+                const FrameBufferRgb& frame = frames[i];
+                if (indexed.Build(frame.GetData(), frame.GetWidth(), frame.GetHeight()))
+                    ImageWriter::WritePNG(indexed, frame.GetWidth(), frame.GetHeight(), output, compression);
+                else
+                    ImageWriter::WritePNG(frame, output, compression);
+                return (size_t)output.tellp();
+            });
+        }
+        settings.push_back({EncoderConfig::TYPE_QOI, 0});
+        calibration.AddCandidate("QOI", [&frames](size_t i) {
+            thread_local std::ostringstream output;
+            output.str({});
+            ImageWriter::WriteQOI(frames[i], output);
+            return (size_t)output.tellp();
+        });
+
+        std::error_code err;
+        if (!output_dir.empty())
+            std::filesystem::create_directories(output_dir, err);
+        EncoderCalibration::Report report = calibration.Run(target_fps, std::thread::hardware_concurrency(), err ? "" : output_dir);
+        std::istringstream lines(calibration.FormatReport(report));
+        for (std::string line; std::getline(lines, line);)
+            VideoLog::Append(line + '\n');
+        if (report.best < 0)
+        {
+            VideoLog::AppendError("The calibration failed to encode the sample frames\n");
+            return std::nullopt;
+        }
+
+        const EncoderCalibration::Measurement& best = report.measurements[report.best];
+        CalibrationResult result;
+        result.encoder = settings[best.candidate].type->name;
+        result.png_compression = settings[best.candidate].png_compression;
+        result.num_threads = (int)best.num_threads;
+        result.framepool_size = result.num_threads + 1; // Add an extra frame to minimize idle time
+        result.fps = (float)best.sustained_fps;
+        result.kb_per_frame = (float)(best.bytes_per_frame / 1024);
+        result.sustains_target = report.sustains_target;
+        VideoLog::Append(Helper::sprintf(
+            "%s %s with %d threads and a frame pool of %d\n", report.sustains_target ? "Recommended:" : "Nothing kept up. Fastest:",
+            calibration.GetCandidateName(best.candidate).c_str(), result.num_threads, result.framepool_size
+        ));
+
+        nlohmann::json cache = LoadCalibrationCache();
+        cache[key] = {
+            {"encoder", result.encoder},
+            {"png_compression", result.png_compression},
+            {"num_threads", result.num_threads},
+            {"framepool_size", result.framepool_size},
+            {"fps", result.fps},
+            {"kb_per_frame", result.kb_per_frame},
+            {"sustains_target", result.sustains_target},
+        };
+        std::filesystem::create_directories(GetCalibrationCachePath().parent_path(), err);
+        std::ofstream file(GetCalibrationCachePath());
+        if (file)
+            file << cache.dump(4);
+        return result;
+    };
+    m_calibration_future = std::async(std::launch::async, std::move(benchmark));
+}
+
+void CRecorder::ApplyCalibration(const CalibrationResult& result)
+{
+    for (size_t i = 0; i < EncoderConfig::NumTypes(); ++i)
+    {
+        if (result.encoder == EncoderConfig::Types()[i].name)
+            m_videoconfig.type = &EncoderConfig::Types()[i];
+    }
+    m_videoconfig.png_compression = result.png_compression;
+    m_videoconfig.png_palette = true;
+    m_encoder_threads = max(1, result.num_threads);
+    m_framepool_size = max(1, result.framepool_size);
+    VideoLog::Append(Helper::sprintf(
+        "Applied the calibration: %s, compression %d, %d encoder threads, frame pool size %d\n",
+        result.encoder.c_str(), result.png_compression, m_encoder_threads, m_framepool_size
+    ));
 }
 
 void CRecorder::WaitForRenderQueue()
@@ -435,8 +1182,6 @@ void CRecorder::WaitForRenderQueue()
 
 void CRecorder::CopyCurrentFrameToSurface(IDirect3DSurface9* dst)
 {
-    WaitForRenderQueue();
-
     IDirect3DSurface9* render_target;
     g_hk_overlay.Device()->GetRenderTarget(0, &render_target);
     defer { render_target->Release(); };
@@ -452,6 +1197,7 @@ int CRecorder::OnFrameStageNotify(ClientFrameStage_t stage)
 
         // Print messages that were queued for the game thread
         VideoLog::GetConsoleQueue().ExecuteAndClear();
+        UpdateDrainingMovies();
 
         // Start/stop the movie
 
@@ -459,19 +1205,32 @@ int CRecorder::OnFrameStageNotify(ClientFrameStage_t stage)
         if (m_do_stop_recording)
         {
             m_do_stop_recording = false;
-            CleanupMovie();
+            if (m_batch && m_batch->IsRecording())
+                m_batch->Abort(); // Let the batch stop its clip, so the pool is shut down in one place
+            else
+            {
+                CleanupMovie();
+                CleanupBatch();
+            }
         }
 
-        if (m_do_start_recording)
+        if (m_do_start_recording || m_do_start_batch)
         {
-            m_do_start_recording = false;
             CleanupMovie();
+            CleanupBatch();
             
-            if (!SetupMovie(m_next_movie_path))
+            if (m_do_start_batch)
+                SetupBatch(m_next_batch_path);
+            else if (!SetupMovie(m_next_movie_path))
                 CleanupMovie();
+            m_do_start_recording = false;
+            m_do_start_batch = false;
         }
+
+        if (m_batch)
+            UpdateBatch();
         
-        m_is_recording_ = m_movie.has_value();
+        m_is_recording_ = m_movie != nullptr;
         return 0;
     }
 
@@ -479,7 +1238,10 @@ int CRecorder::OnFrameStageNotify(ClientFrameStage_t stage)
         return 0;
 
     if (!m_movie)
+    {
+        UpdateCalibration();
         return 0;
+    }
 
     if (m_movie->Failed() || m_movie->GetFramePool().IsClosed())
     {
@@ -501,11 +1263,13 @@ int CRecorder::OnFrameStageNotify(ClientFrameStage_t stage)
     if (m_movie->GetStreams().size() == 1 && m_movie->GetStreams()[0].stream->GetRenderTweaks().empty())
     {
         auto& [stream, writer] = m_movie->GetStreams().front();
-        auto frame = m_movie->GetFramePool().PopEmptyFrame();
+        auto frame = PopEmptyFrame(*stream, frame_index);
         if (frame == nullptr)
-            return 0; // The FramePool was closed
-        CopyCurrentFrameToSurface(frame->buffer.GetSurface());
+            return 0; // The FramePool was closed, or the frame was dropped
+        WaitForRenderQueue();
+        CopyCurrentFrameToSurface(static_cast<FrameBufferDx9&>(*frame->buffer).GetSurface());
         m_movie->GetFramePool().PushFullFrame(frame, frame_index, writer);
+        m_movie->GetFramePool().Adapt();
         return 0;
     }
     
@@ -513,19 +1277,27 @@ int CRecorder::OnFrameStageNotify(ClientFrameStage_t stage)
     for (auto& [stream, writer] : m_movie->GetStreams())
     {
         g_active_stream.Set(stream);
-        g_active_stream.SignalUpdate();
+        // Plans are cached per stream, so there's no need to recompile them every frame.
+        g_active_stream.SignalUpdate(nullptr, ~(uint32_t)ActiveStream::UPDATE_RENDER_PLAN);
         // Update the materials right now, instead of waiting for the next frame.
         g_active_stream.UpdateMaterials();
         g_active_stream.RenderView();
+        // Every stream renders into the same render target, so its copy must be made before the next stream renders.
+        // The copy is made from this thread, which needs the queued rendering on the device first.
         WaitForRenderQueue();
         g_active_stream.DrawDepth();
 
-        auto frame = m_movie->GetFramePool().PopEmptyFrame();
+        auto frame = PopEmptyFrame(*stream, frame_index);
         if (frame == nullptr)
-            break; // The FramePool was closed
-        CopyCurrentFrameToSurface(frame->buffer.GetSurface());
+        {
+            if (m_movie->GetFramePool().IsClosed())
+                break;
+            continue; // The frame was dropped
+        }
+        CopyCurrentFrameToSurface(static_cast<FrameBufferDx9&>(*frame->buffer).GetSurface());
         m_movie->GetFramePool().PushFullFrame(frame, frame_index, writer);
     }
+    m_movie->GetFramePool().Adapt();
 
     return 0;
 }
@@ -12,6 +12,9 @@
 #include <condition_variable>
 #include <Streams/movie.h>
 #include <Streams/videowriter.h>
+#include <Streams/batch.h>
+#include <optional>
+#include <future>
 
 class FramePool;
 class VideoWriter;
@@ -27,10 +30,37 @@ public:
     bool ShouldRecordFrame();
     void StartMovie() { return StartMovie(m_movie_path); }
     void StartMovie(const std::filesystem::path& path);
+    /// @brief Stop the current movie or batch
     void StopMovie();
     void ToggleRecording(const std::filesystem::path& path);
+    /// @brief Stop any current recording, and record the clips of a batch job file
+    void StartBatch(const std::filesystem::path& job_path);
+    /// @brief The encoder options of streams that don't override them
+    const EncoderConfig& GetVideoConfig() const { return m_videoconfig; }
+    /**
+     * @brief Benchmark the encoders on the next few frames, and recommend the settings that keep up with `target_fps`.
+     * @details A cached recommendation for this resolution and target is reused, unless `force` is set.
+     * @param target_fps If 0 or less, the encoder's framerate is used
+     * @param apply Apply the recommendation as soon as it's ready
+     */
+    void StartCalibration(float target_fps, bool apply, bool force);
 
 private:
+    /// @brief The settings recommended by the encoder calibration
+    struct CalibrationResult
+    {
+        /// @brief Name of an @ref EncoderConfig type
+        std::string encoder;
+        int png_compression = 0;
+        /// @brief The fewest encoder threads that kept up
+        int num_threads = 1;
+        int framepool_size = 1;
+        float fps = 0;
+        float kb_per_frame = 0;
+        /// @brief If `false`, nothing kept up with the target, and these are the fastest settings
+        bool sustains_target = false;
+    };
+
     int OnPostImguiInput();
     int OnDraw();
     int OnTabBar();
@@ -47,13 +77,40 @@ private:
     void WriteFrame(std::shared_ptr<Stream> stream);
     /// @brief Attempt to setup the movie.
     /// @details Only this call from the game thread.
+    /// @param stream_names Optional. Only record the streams with these names. All streams are recorded if empty.
     /// @return True if the movie is created or already exists
-    bool SetupMovie(const std::filesystem::path& path);
-    ///@brief Stop the movie, wait for writing to finish, and clean up.
+    bool SetupMovie(const std::filesystem::path& path, const std::vector<std::string>* stream_names = nullptr);
+    ///@brief Stop the movie and clean up. Frames that aren't written yet are finished in the background.
     ///@details Only call this from the game thread.
     void CleanupMovie();
-    /// @brief Waits for all rendering to finish
+    /// @brief Destroy the movies in @ref m_draining_movies that have finished writing
+    void UpdateDrainingMovies();
+    /**
+     * @brief Pop an empty frame from the movie's pool, and add the time it took to @ref m_stall_times.
+     * @return `nullptr` if the pool is closed, or if the stall policy dropped the frame (which is logged)
+     */
+    FramePool::FramePtr PopEmptyFrame(const Stream& stream, size_t frame_index);
+    /// @brief Log a summary of @ref m_stall_times, and write them to a CSV file in the movie's folder
+    void WriteStallTimes();
+    /// @brief Load a batch job file into @ref m_batch. Only call this from the game thread.
+    bool SetupBatch(const std::filesystem::path& job_path);
+    /// @brief Carry out the batch's next action. Only call this from the game thread.
+    void UpdateBatch();
+    /// @brief Stop the batch, and release its frame pool once its movies are written
+    void CleanupBatch();
+    /**
+     * @brief Capture sample frames for a requested calibration, and benchmark them in the background.
+     * @details Only call this from the game thread, while no movie is recording.
+     */
+    void UpdateCalibration();
+    /// @brief Use the encoder, thread count and frame pool size of a calibration
+    void ApplyCalibration(const CalibrationResult& result);
+    /**
+     * @brief Waits for the material system's queued rendering to reach the D3D device.
+     * @details This doesn't wait for the GPU. The frame pool's fences wait for the copies instead.
+     */
     void WaitForRenderQueue();
+    /// @brief Copy the render target. Call @ref WaitForRenderQueue beforehand, so the frame is fully queued.
     void CopyCurrentFrameToSurface(class IDirect3DSurface9* dst);
 
     /// @brief If `false`, this will prevent the engine from reading pixels during recording.
@@ -73,6 +130,34 @@ private:
     /// @brief Stop the recording when the menu is opened
     bool m_autostop_recording = false;
     int m_framepool_size = 1;
+    /// @brief Number of threads that encode frames. 0 uses one per CPU core.
+    int m_encoder_threads = 0;
+    /// @brief Index into the capture formats. Float formats keep HDR render targets.
+    int m_capture_format = 0;
+    /// @brief Let the frame pool grow and shrink while recording
+    bool m_adaptive_framepool = true;
+    /// @brief The most RAM an adaptive frame pool may use, in megabytes
+    int m_framepool_ram_budget = 1024;
+    /// @brief Compress frames into a RAM backlog while the encoders are behind
+    bool m_backlog = false;
+    /// @brief The most RAM the backlog may use, in megabytes
+    int m_backlog_ram_budget = 2048;
+    /// @brief Spill the backlog to a scratch file when its RAM budget is full
+    bool m_backlog_spill = false;
+    /// @brief The folder for the scratch file. If empty, the movie's folder is used.
+    std::filesystem::path m_backlog_spill_path;
+    /// @brief The most disk space the scratch file may use, in gigabytes
+    int m_backlog_spill_budget = 64;
+    /// @brief Only copy frames into RAM while recording, and encode them after the recording stops
+    bool m_burst = false;
+    /// @brief The size of the burst arena, in megabytes
+    int m_burst_ram_budget = 8192;
+    /// @brief Try to allocate the burst arena with large pages
+    bool m_burst_large_pages = false;
+    /// @brief What to do when the game waits on the encoders for longer than @ref m_stall_budget
+    FramePool::StallPolicy m_stall_policy = FramePool::StallPolicy::BLOCK;
+    /// @brief In milliseconds
+    int m_stall_budget = 20;
     EncoderConfig m_videoconfig;
     /// @brief The root directory to contain all movie files
     std::filesystem::path m_movie_path;
@@ -87,16 +172,69 @@ private:
     bool m_do_stop_recording = false;
     /// @brief Signal to start a recording with @ref m_next_movie_path in the game thread
     bool m_do_start_recording = false;
+    /// @brief Path of the next batch job file
+    std::filesystem::path m_next_batch_path;
+    /// @brief Signal to start a batch with @ref m_next_batch_path in the game thread
+    bool m_do_start_batch = false;
     std::atomic<bool> m_is_recording_ = false;
+    /// @brief The batch's current clip, for the menu. Only written by the game thread.
+    std::atomic<size_t> m_batch_clip = 0;
+    /// @brief The number of clips in the batch, or 0 when no batch is running. Only written by the game thread.
+    std::atomic<size_t> m_batch_num_clips = 0;
+
+    // === Calibration state === //
+
+    /// @brief Protects all members under the "Calibration state" comment
+    std::mutex m_calibration_mtx;
+    /// @brief Signal to capture sample frames and calibrate in the game thread
+    bool m_do_calibrate = false;
+    float m_calibration_fps = 60.f;
+    /// @brief Apply the recommendation as soon as it's ready
+    bool m_calibration_apply = false;
+    /// @brief Key of the calibration in the cache file
+    std::string m_calibration_key;
+    /// @brief The latest recommendation, for the menu
+    std::optional<CalibrationResult> m_calibration_result;
+    std::atomic<bool> m_calibrating = false;
+    /// @brief Sample frames of the requested calibration. Only accessed by the game thread.
+    std::vector<FrameBufferRgb> m_calibration_frames;
+    /// @brief The running benchmark. Only accessed by the game thread.
+    std::future<std::optional<CalibrationResult>> m_calibration_future;
+
+    // === Draining movie state === //
+
+    /// @brief A stopped movie that is still writing its queued frames
+    struct DrainingMovie
+    {
+        std::unique_ptr<Movie> movie;
+        /// @brief Number of frames that were queued when the movie stopped, for the progress bar
+        size_t num_frames;
+    };
+
+    /// @brief Protects @ref m_draining_movies, which the menu reads
+    std::mutex m_draining_mtx;
+    std::vector<DrainingMovie> m_draining_movies;
 
     // === Hidden movie state === //
     
     /**
-     * @brief The current movie. Equal to `std::nullopt` while not recording.
+     * @brief The current movie. Equal to `nullptr` while not recording.
+     * 
+     * Must be exclusively accessed by the game thread.
+     */
+    std::unique_ptr<Movie> m_movie;
+    /// @brief Milliseconds that each frame of @ref m_movie waited for an empty frame buffer
+    std::vector<float> m_stall_times;
+    /**
+     * @brief The running batch job. Each clip is recorded to its own movie.
      * 
      * Must be exclusively accessed by the game thread.
      */
-    std::optional<Movie> m_movie;
+    std::optional<BatchScheduler> m_batch;
+    /// @brief The folder to contain the batch's clips
+    std::filesystem::path m_batch_output;
+    /// @brief Shared by every movie of the batch, so frame buffers and threads stay warm between clips
+    std::shared_ptr<FramePool> m_batch_pool;
 };
 
 inline CRecorder g_recorder;
\ No newline at end of file
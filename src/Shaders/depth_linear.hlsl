@@ -3,12 +3,13 @@
 
 sampler depth_tex : register(s0);
 const float4x4 inv_projection : register(c0);
-const float3 depth_params : register(c4); // depth_near, depth_far, spherical_correction [0,1]
+const float4 depth_params : register(c4); // depth_near, depth_far, spherical_correction [0,1], pack_rgb [0,1]
 
 float4 main(float4 uv : COLOR0) : COLOR {
     float depth_near = depth_params[0];
     float depth_far = depth_params[1];
     float spherical_correction = depth_params[2];
+    float pack_rgb = depth_params[3];
     float depth = tex2D(depth_tex, uv.xy).x;
     float3 pos = reconstructPositionWithZ(uv.xy, depth, inv_projection);
 
@@ -18,5 +19,7 @@ float4 main(float4 uv : COLOR0) : COLOR {
     depth /= depth_far - depth_near;
     depth = clamp(depth, 0, 1);
 
+    if (pack_rgb > 0.5)
+        return float4(packDepth24(depth), 1.0);
     return float4(depth, depth, depth, 1.0);
 }
\ No newline at end of file
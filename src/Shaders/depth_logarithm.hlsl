@@ -5,6 +5,7 @@
 sampler depth_tex : register(s0);
 const float4x4 inv_projection : register(c0);
 const float4 depth_params : register(c4); // depth_near, depth_far, spherical_correction [0,1], near_precision [1, inf)
+const float pack_rgb : register(c5); // [0,1]
 
 float4 main(float4 uv : COLOR0) : COLOR {
     float depth_near = depth_params[0];
@@ -19,5 +20,7 @@ float4 main(float4 uv : COLOR0) : COLOR {
     depth -= depth_near;
     depth = max(0, depth);
     depth = log(1 + depth * near_precision) / log(1 + (depth_far - depth_near) * near_precision);
+    if (pack_rgb > 0.5)
+        return float4(packDepth24(depth), 1.0);
     return float4(depth, depth, depth, 1.0);
 }
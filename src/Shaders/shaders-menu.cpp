@@ -11,13 +11,19 @@ void DepthLinear::OnMenu()
     ImGui::InputFloat("Near Z", &m_near, 100, 1000);
     ImGui::InputFloat("Far Z", &m_far, 100, 1000);
     ImGui::Checkbox("Spherical correction", &m_spherical_correction);
+    ImGui::Checkbox("Pack into RGB", &m_pack_rgb); ImGui::SameLine();
+    Helper::ImGuiHelpMarker(
+        "Store 24 bits of depth across the color channels, instead of 8 bits of grayscale.\n"
+        "Record the stream with the \"depth\" encoder to write 16-bit PNGs or float EXRs."
+    );
 }
 nlohmann::json DepthLinear::SubclassToJson() const
 {
     return {
         {"m_near", m_near},
         {"m_far", m_far},
-        {"m_spherical_correction", m_spherical_correction}
+        {"m_spherical_correction", m_spherical_correction},
+        {"m_pack_rgb", m_pack_rgb}
     };
 }
 void DepthLinear::FromJson(const nlohmann::json* json)
@@ -25,6 +31,7 @@ void DepthLinear::FromJson(const nlohmann::json* json)
     Helper::FromJson(json, "m_near", m_near);
     Helper::FromJson(json, "m_far", m_far);
     Helper::FromJson(json, "m_spherical_correction", m_spherical_correction);
+    Helper::FromJson(json, "m_pack_rgb", m_pack_rgb);
 }
 
 void DepthLogarithm::OnMenu()
@@ -36,6 +43,11 @@ void DepthLogarithm::OnMenu()
     Helper::ImGuiHelpMarker(
         "Increasing values (above 1) gives more precision in closer geometry, and less precision in farther geometry.\n"
     );
+    ImGui::Checkbox("Pack into RGB", &m_pack_rgb); ImGui::SameLine();
+    Helper::ImGuiHelpMarker(
+        "Store 24 bits of depth across the color channels, instead of 8 bits of grayscale.\n"
+        "Record the stream with the \"depth\" encoder to write 16-bit PNGs or float EXRs."
+    );
 }
 nlohmann::json DepthLogarithm::SubclassToJson() const
 {
@@ -43,7 +55,8 @@ nlohmann::json DepthLogarithm::SubclassToJson() const
         {"m_near", m_near},
         {"m_far", m_far},
         {"m_spherical_correction", m_spherical_correction},
-        {"m_near_precision", m_near_precision}
+        {"m_near_precision", m_near_precision},
+        {"m_pack_rgb", m_pack_rgb}
     };
 }
 void DepthLogarithm::FromJson(const nlohmann::json* json)
@@ -52,6 +65,7 @@ void DepthLogarithm::FromJson(const nlohmann::json* json)
     Helper::FromJson(json, "m_far", m_far);
     Helper::FromJson(json, "m_spherical_correction", m_spherical_correction);
     Helper::FromJson(json, "m_near_precision", m_near_precision);
+    Helper::FromJson(json, "m_pack_rgb", m_pack_rgb);
 }
 
 void DepthToRgb::OnMenu() {}
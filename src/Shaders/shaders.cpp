@@ -138,7 +138,7 @@ IDirect3DDevice9* PixelShader::GetDevice()
 
 void DepthLinear::ApplyConstants(const float* inv_projection, IDirect3DTexture9* depth)
 {
-    const float consts[4] = {m_near, m_far, (float)m_spherical_correction, 0};
+    const float consts[4] = {m_near, m_far, (float)m_spherical_correction, (float)m_pack_rgb};
     GetDevice()->SetTexture(0, depth);
     GetDevice()->SetPixelShaderConstantF(0, inv_projection, 4);
     GetDevice()->SetPixelShaderConstantF(4, consts, 1);
@@ -146,10 +146,13 @@ void DepthLinear::ApplyConstants(const float* inv_projection, IDirect3DTexture9*
 
 void DepthLogarithm::ApplyConstants(const float* inv_projection, IDirect3DTexture9* depth)
 {
-    const float consts[4] = {m_near, m_far, (float)m_spherical_correction, m_near_precision};
+    const float consts[8] = {
+        m_near, m_far, (float)m_spherical_correction, m_near_precision,
+        (float)m_pack_rgb, 0, 0, 0
+    };
     GetDevice()->SetTexture(0, depth);
     GetDevice()->SetPixelShaderConstantF(0, inv_projection, 4);
-    GetDevice()->SetPixelShaderConstantF(4, consts, 1);
+    GetDevice()->SetPixelShaderConstantF(4, consts, 2);
 }
 
 void DepthToRgb::ApplyConstants(const float* inv_projection, IDirect3DTexture9* depth)
@@ -116,6 +116,8 @@ private:
     float m_near = 0;
     float m_far = 1000;
     bool m_spherical_correction = false;
+    /// @brief Output 24-bit depth as 0xRRGGBB, for the "depth" encoder
+    bool m_pack_rgb = false;
 };
 
 class DepthLogarithm final : public PixelShader
@@ -140,6 +142,8 @@ private:
     float m_far = 1000;
     float m_near_precision = 1;
     bool m_spherical_correction = false;
+    /// @brief Output 24-bit depth as 0xRRGGBB, for the "depth" encoder
+    bool m_pack_rgb = false;
 };
 
 class DepthToRgb final : public PixelShader
@@ -148,7 +152,7 @@ public:
     DepthToRgb() : PixelShader(
         "depth_to_rgb.cso",
         "Depth (RGB)",
-        "Converts depth to 24-bit RGB in the form of 0xRRGGBB"
+        "Converts raw depth to 24-bit RGB in the form of 0xRRGGBB"
     ) {}
 
     std::shared_ptr<PixelShader> NewInstance() const override {
@@ -13,4 +13,14 @@ float3 reconstructPositionWithZ(in float2 uv, in float z, in float4x4 InvVP) {
   float4 position_v = mul(InvVP, position_s);
   position_v.z = 1.0;
   return position_v.xyz / position_v.w;
+}
+
+// Pack depth from [0,1] into 24 bits, as 0xRRGGBB.
+// Each channel holds a whole byte, so the recorder's depth encoder can decode it exactly.
+float3 packDepth24(in float depth) {
+  float d = floor(saturate(depth) * 16777215.0 + 0.5);
+  float r = floor(d / 65536.0);
+  float g = floor((d - r * 65536.0) / 256.0);
+  float b = d - r * 65536.0 - g * 256.0;
+  return float3(r, g, b) / 255.0;
 }
\ No newline at end of file
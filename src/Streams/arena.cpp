@@ -0,0 +1,125 @@
+#include "arena.h"
+#include <cassert>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static constexpr size_t SMALL_PAGE_SIZE = 4096;
+
+#ifdef _WIN32
+/// @brief Large pages need SeLockMemoryPrivilege, which is granted to the user but not enabled by default
+static bool EnableLockMemoryPrivilege()
+{
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+        return false;
+
+    TOKEN_PRIVILEGES privileges{};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool result = LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+        && AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+        && GetLastError() == ERROR_SUCCESS; // Also set when the privilege wasn't granted
+    CloseHandle(token);
+    return result;
+}
+
+static uint8_t* AllocatePages(size_t* size, bool* large_pages)
+{
+    if (*large_pages)
+    {
+        size_t large_page_size = GetLargePageMinimum();
+        if (large_page_size > 0 && EnableLockMemoryPrivilege())
+        {
+            size_t large_size = (*size + large_page_size - 1) / large_page_size * large_page_size;
+            void* ptr = VirtualAlloc(nullptr, large_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (ptr)
+            {
+                *size = large_size;
+                return (uint8_t*)ptr;
+            }
+        }
+        *large_pages = false;
+    }
+    return (uint8_t*)VirtualAlloc(nullptr, *size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+static void FreePages(uint8_t* ptr, size_t) {
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+#else
+static uint8_t* AllocatePages(size_t* size, bool* large_pages)
+{
+    constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+    if (*large_pages)
+    {
+        size_t huge_size = (*size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        void* ptr = mmap(nullptr, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED)
+        {
+            *size = huge_size;
+            return (uint8_t*)ptr;
+        }
+        *large_pages = false;
+    }
+
+    void* ptr = mmap(nullptr, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+        return nullptr;
+    return (uint8_t*)ptr;
+}
+
+static void FreePages(uint8_t* ptr, size_t size) {
+    munmap(ptr, size);
+}
+#endif
+
+FrameArena::FrameArena(size_t slot_size, size_t num_slots, bool large_pages)
+    : m_slot_size(slot_size), m_num_slots(num_slots), m_large_pages(large_pages)
+{
+    assert(slot_size > 0 && num_slots > 0 && "Frame arena must have at least 1 non-empty slot");
+
+    m_slot_stride = (slot_size + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+    m_alloc_size = m_slot_stride * num_slots;
+    m_base = AllocatePages(&m_alloc_size, &m_large_pages);
+    if (!m_base)
+        return;
+
+    // Commit every page now, instead of faulting them in while recording.
+    // Large pages are already resident.
+    if (!m_large_pages)
+    {
+        for (size_t offset = 0; offset < m_alloc_size; offset += SMALL_PAGE_SIZE)
+            m_base[offset] = 0;
+    }
+
+    // Reversed, so the first slots are allocated first
+    m_free.reserve(num_slots);
+    for (size_t i = num_slots; i > 0; --i)
+        m_free.push_back(i - 1);
+}
+
+FrameArena::~FrameArena()
+{
+    if (m_base)
+        FreePages(m_base, m_alloc_size);
+}
+
+size_t FrameArena::Allocate()
+{
+    if (m_free.empty())
+        return NO_SLOT;
+    size_t slot = m_free.back();
+    m_free.pop_back();
+    return slot;
+}
+
+void FrameArena::Free(size_t slot)
+{
+    assert(slot < m_num_slots && "Slot is not in the arena");
+    assert(m_free.size() < m_num_slots && "More slots are being freed than were allocated");
+    m_free.push_back(slot);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief A large block of memory, split into equally-sized slots for raw frames.
+ *
+ * The whole block is allocated and touched up front, so copying a frame into a slot
+ * never waits on the heap or on page faults. Large pages can be requested to reduce TLB misses,
+ * which falls back to normal pages if the OS refuses.
+ *
+ * This class has no D3D or game dependencies, so it can be built and exercised on its own.
+ * Slots are allocated and freed without synchronization, but each slot may be filled by any one thread.
+ */
+class FrameArena
+{
+public:
+    static constexpr size_t NO_SLOT = ~(size_t)0;
+
+    /// @param large_pages Try to allocate the block with large pages
+    FrameArena(size_t slot_size, size_t num_slots, bool large_pages);
+    ~FrameArena();
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    /// @brief `false` if the block couldn't be allocated
+    bool IsValid() const { return m_base != nullptr; }
+    /// @return A free slot, or @ref NO_SLOT if the arena is full
+    size_t Allocate();
+    void Free(size_t slot);
+    uint8_t* GetSlot(size_t slot) const { return m_base + slot * m_slot_stride; }
+
+    size_t GetSlotSize() const { return m_slot_size; }
+    size_t GetNumSlots() const { return m_num_slots; }
+    size_t GetNumFree() const { return m_free.size(); }
+    /// @brief The block was allocated with large pages
+    bool HasLargePages() const { return m_large_pages; }
+
+private:
+    /// @brief Slots start on cache lines, so threads filling neighboring slots don't share any
+    static constexpr size_t SLOT_ALIGNMENT = 64;
+
+    uint8_t* m_base = nullptr;
+    size_t m_alloc_size = 0;
+    size_t m_slot_size;
+    size_t m_slot_stride;
+    size_t m_num_slots;
+    bool m_large_pages = false;
+    /// @brief Used as a stack, so recently freed slots are reused while they're still in the TLB
+    std::vector<size_t> m_free;
+};
@@ -0,0 +1,313 @@
+#include "backlog.h"
+#include "framebuffer.h"
+#include "videolog.h"
+#include <Helper/lz4.h>
+#include <Helper/defer.h>
+#include <cstring>
+#include <cassert>
+
+bool FrameBacklog::Compress(const FrameBufferBase& buffer, Entry* entry)
+{
+    size_t pitch;
+    const uint8_t* pixels = buffer.LockRead(&pitch);
+    if (!pixels)
+    {
+        VideoLog::AppendError("Failed to lock frame %zu for compression\n", entry->index);
+        return false;
+    }
+    defer { buffer.UnlockRead(); };
+
+    size_t row_size = buffer.GetRowSize();
+    size_t raw_size = row_size * buffer.GetHeight();
+
+    // LZ4 needs contiguous input, so padded rows are packed first
+    thread_local std::vector<uint8_t> packed;
+    if (pitch != row_size)
+    {
+        packed.resize(raw_size);
+        for (uint32_t y = 0; y < buffer.GetHeight(); ++y)
+            memcpy(packed.data() + y * row_size, pixels + y * pitch, row_size);
+        pixels = packed.data();
+    }
+
+    // Compress into a reused buffer, so each entry only holds what it needs
+    thread_local std::vector<uint8_t> scratch;
+    scratch.resize(Helper::LZ4CompressBound(raw_size));
+    size_t compressed_size = Helper::LZ4Compress(pixels, raw_size, scratch.data(), scratch.size());
+    if (compressed_size == 0)
+    {
+        VideoLog::AppendError("Failed to compress frame %zu\n", entry->index);
+        return false;
+    }
+
+    entry->data.assign(scratch.begin(), scratch.begin() + compressed_size);
+    entry->width = buffer.GetWidth();
+    entry->height = buffer.GetHeight();
+    entry->format = buffer.GetFormat();
+    return true;
+}
+
+bool FrameBacklog::Decompress(const Entry& entry, FrameBufferMem* buffer)
+{
+    assert(buffer->GetWidth() == entry.width && buffer->GetHeight() == entry.height && "Buffer size must match the entry");
+    assert(buffer->GetFormat() == entry.format && "Buffer format must match the entry");
+
+    if (!Helper::LZ4Decompress(entry.data.data(), entry.data.size(), buffer->GetData(), buffer->GetDataLength()))
+    {
+        VideoLog::AppendError("Failed to decompress frame %zu from the backlog\n", entry.index);
+        return false;
+    }
+    return true;
+}
+
+FrameBacklog::~FrameBacklog()
+{
+    if (m_spill_path.empty())
+        return;
+    m_spill_file.close();
+    std::error_code err;
+    std::filesystem::remove(m_spill_path, err);
+}
+
+bool FrameBacklog::SetSpillFile(std::filesystem::path path, uint64_t budget)
+{
+    assert(m_spill_path.empty() && "The spill file can only be set once");
+    m_spill_file.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    if (!m_spill_file)
+    {
+        VideoLog::AppendError("Failed to create the backlog's spill file: '%s'\n", path.u8string().c_str());
+        return false;
+    }
+    m_spill_path = std::move(path);
+    m_spill_budget = budget;
+    return true;
+}
+
+bool FrameBacklog::SetArena(size_t slot_size, size_t num_slots, bool large_pages)
+{
+    assert(!m_arena && "The arena can only be set once");
+    m_arena = std::make_unique<FrameArena>(slot_size, num_slots, large_pages);
+    if (!m_arena->IsValid())
+    {
+        VideoLog::AppendError("Failed to allocate the burst arena (%zu frames, %.1f MB)\n",
+            num_slots, (double)slot_size * num_slots / (1024.0 * 1024.0)
+        );
+        m_arena = nullptr;
+        return false;
+    }
+    if (large_pages && !m_arena->HasLargePages())
+        VideoLog::Append("Large pages are unavailable. The burst arena uses normal pages instead.\n");
+    return true;
+}
+
+bool FrameBacklog::Store(const FrameBufferBase& buffer, Entry* entry)
+{
+    if (entry->tier != Tier::ARENA)
+        return Compress(buffer, entry) && (entry->tier != Tier::DISK || Spill(entry));
+
+    size_t pitch;
+    const uint8_t* pixels = buffer.LockRead(&pitch);
+    if (!pixels)
+    {
+        VideoLog::AppendError("Failed to lock frame %zu for the burst arena\n", entry->index);
+        return false;
+    }
+    defer { buffer.UnlockRead(); };
+
+    size_t row_size = buffer.GetRowSize();
+    assert(row_size * buffer.GetHeight() <= m_arena->GetSlotSize() && "Frame is larger than the arena's slots");
+    uint8_t* slot = m_arena->GetSlot(entry->slot);
+    if (pitch == row_size)
+        memcpy(slot, pixels, row_size * buffer.GetHeight());
+    else
+    {
+        for (uint32_t y = 0; y < buffer.GetHeight(); ++y)
+            memcpy(slot + y * row_size, pixels + y * pitch, row_size);
+    }
+
+    entry->width = buffer.GetWidth();
+    entry->height = buffer.GetHeight();
+    entry->format = buffer.GetFormat();
+    return true;
+}
+
+bool FrameBacklog::Restore(Entry* entry, FrameBufferMem* buffer)
+{
+    if (entry->tier != Tier::ARENA)
+        return Load(entry) && Decompress(*entry, buffer);
+
+    assert(buffer->GetWidth() == entry->width && buffer->GetHeight() == entry->height && "Buffer size must match the entry");
+    assert(buffer->GetFormat() == entry->format && "Buffer format must match the entry");
+    memcpy(buffer->GetData(), m_arena->GetSlot(entry->slot), buffer->GetDataLength());
+    return true;
+}
+
+bool FrameBacklog::Spill(Entry* entry)
+{
+    assert(entry->tier == Tier::DISK && "Only entries reserved on disk can be spilled");
+    {
+        std::scoped_lock lock{m_spill_mutex};
+        m_spill_file.seekp(m_spill_end);
+        m_spill_file.write((const char*)entry->data.data(), entry->data.size());
+        if (!m_spill_file)
+        {
+            VideoLog::AppendError("Failed to write frame %zu to the backlog's spill file\n", entry->index);
+            return false;
+        }
+        entry->spill_offset = m_spill_end;
+        entry->spill_size = entry->data.size();
+        m_spill_end += entry->data.size();
+    }
+    entry->data = {};
+    return true;
+}
+
+bool FrameBacklog::Load(Entry* entry)
+{
+    if (entry->tier != Tier::DISK)
+        return true;
+
+    entry->data.resize(entry->spill_size);
+    std::scoped_lock lock{m_spill_mutex};
+    m_spill_file.seekg(entry->spill_offset);
+    m_spill_file.read((char*)entry->data.data(), entry->data.size());
+    if (!m_spill_file)
+    {
+        VideoLog::AppendError("Failed to read frame %zu from the backlog's spill file\n", entry->index);
+        return false;
+    }
+    return true;
+}
+
+bool FrameBacklog::TryReserve(size_t raw_size, Entry* entry)
+{
+    if (m_arena && raw_size <= m_arena->GetSlotSize())
+    {
+        entry->slot = m_arena->Allocate();
+        if (entry->slot != FrameArena::NO_SLOT)
+        {
+            entry->tier = Tier::ARENA;
+            return true;
+        }
+    }
+    if (m_used + m_reserved + raw_size <= m_budget)
+    {
+        m_reserved += raw_size;
+        entry->tier = Tier::RAM;
+        return true;
+    }
+    if (!m_spill_path.empty() && m_spill_used + raw_size <= m_spill_budget)
+    {
+        m_spill_used += raw_size;
+        entry->tier = Tier::DISK;
+        return true;
+    }
+    entry->tier = Tier::NONE;
+    return false;
+}
+
+void FrameBacklog::Push(Entry&& entry, size_t reserved)
+{
+    if (entry.tier == Tier::ARENA)
+    {
+        // The arena isn't compressed, so it's kept out of the compression ratio
+        m_num_arena_entries += 1;
+        size_t num_used_slots = m_arena->GetNumSlots() - m_arena->GetNumFree();
+        m_peak_arena_slots = num_used_slots > m_peak_arena_slots ? num_used_slots : m_peak_arena_slots;
+        m_entries.push_back(std::move(entry));
+        m_peak_entries = m_entries.size() > m_peak_entries ? m_entries.size() : m_peak_entries;
+        return;
+    }
+
+    if (entry.tier == Tier::DISK)
+    {
+        // The reservation is replaced with the space that was actually written
+        m_spill_used = m_spill_used - reserved + entry.spill_size;
+        m_total_compressed += entry.spill_size;
+        m_total_spilled += entry.spill_size;
+        m_num_spilled += 1;
+    }
+    else
+    {
+        m_reserved -= reserved;
+        m_used += entry.data.size();
+        m_total_compressed += entry.data.size();
+        m_peak_used = m_used > m_peak_used ? m_used : m_peak_used;
+    }
+    m_total_raw += reserved;
+    m_total_entries += 1;
+    m_entries.push_back(std::move(entry));
+    m_peak_entries = m_entries.size() > m_peak_entries ? m_entries.size() : m_peak_entries;
+}
+
+void FrameBacklog::Unreserve(const Entry& entry, size_t reserved)
+{
+    if (entry.tier == Tier::DISK)
+        m_spill_used -= reserved;
+    else if (entry.tier == Tier::RAM)
+        m_reserved -= reserved;
+    else if (entry.tier == Tier::ARENA)
+        m_arena->Free(entry.slot);
+}
+
+FrameBacklog::Entry FrameBacklog::Take(size_t i)
+{
+    Entry entry = std::move(m_entries[i]);
+    m_entries.erase(m_entries.begin() + i);
+    if (entry.tier == Tier::RAM)
+        m_used -= entry.data.size();
+    return entry;
+}
+
+void FrameBacklog::Release(const Entry& entry)
+{
+    if (entry.tier == Tier::ARENA)
+        m_arena->Free(entry.slot);
+    else if (entry.tier == Tier::DISK)
+    {
+        m_spill_used -= entry.spill_size;
+        if (m_spill_used == 0)
+            ResetSpillFile();
+    }
+}
+
+void FrameBacklog::ResetSpillFile()
+{
+    // Nothing can be spilling or loading, since that needs reserved or unreleased space
+    std::scoped_lock lock{m_spill_mutex};
+    m_spill_file.close();
+    m_spill_file.open(m_spill_path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    m_spill_end = 0;
+    if (!m_spill_file)
+    {
+        VideoLog::AppendError("Failed to reset the backlog's spill file. Frames won't be spilled anymore.\n");
+        m_spill_budget = 0;
+    }
+}
+
+std::string FrameBacklog::GetStats() const
+{
+    std::string stats;
+    if (m_arena)
+    {
+        stats += Helper::sprintf(
+            "Burst arena held %zu frames, using up to %zu of %zu slots%s\n", m_num_arena_entries,
+            m_peak_arena_slots, m_arena->GetNumSlots(), m_arena->HasLargePages() ? " (large pages)" : ""
+        );
+    }
+    if (m_total_entries == 0)
+        return m_arena ? stats : "The backlog was not used\n";
+
+    double ratio = (double)m_total_raw / m_total_compressed;
+    stats += Helper::sprintf(
+        "Backlog compressed %zu frames at %.2fx, and held up to %zu frames in %.1f MB\n",
+        m_total_entries, ratio, m_peak_entries, m_peak_used / (1024.0 * 1024.0)
+    );
+    if (m_num_spilled > 0)
+    {
+        stats += Helper::sprintf(
+            "Backlog spilled %zu frames to disk (%.1f MB)\n", m_num_spilled, m_total_spilled / (1024.0 * 1024.0)
+        );
+    }
+    return stats;
+}
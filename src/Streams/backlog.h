@@ -0,0 +1,156 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <string>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <cstdint>
+#include <Helper/d3dformat.h>
+#include "arena.h"
+
+class VideoWriter;
+class FrameBufferBase;
+class FrameBufferMem;
+
+/**
+ * @brief LZ4-compressed frames held in RAM, for when the encoders fall behind.
+ *
+ * Compressing a frame takes a fraction of the time needed to encode it,
+ * so @ref FramePool can return frame buffers to the game sooner by moving their pixels here.
+ * Frames are decompressed right before they're encoded.
+ *
+ * When the RAM budget is full, entries can spill into a scratch file with @ref SetSpillFile.
+ * The file is only appended to, so it stays sequential on disk. Once every spilled entry is released,
+ * it's truncated and written from the start again. It's deleted with the backlog.
+ *
+ * For burst capture, @ref SetArena adds a preallocated arena of uncompressed frames,
+ * which is preferred over both compressed tiers since copying is faster than compressing.
+ *
+ * This class is not thread-safe, except for @ref Store and @ref Restore.
+ * @ref FramePool guards it with its own mutex, and calls the thread-safe functions outside of it.
+ */
+class FrameBacklog
+{
+public:
+    /// @brief Where an entry is kept
+    enum class Tier
+    {
+        NONE,
+        /// @brief Uncompressed, in a slot of the arena
+        ARENA,
+        RAM,
+        DISK,
+    };
+
+    struct Entry
+    {
+        /// @brief An LZ4 block of the frame's tightly packed rows. Empty while spilled, or in the arena.
+        std::vector<uint8_t> data;
+        Tier tier = Tier::NONE;
+        /// @brief The arena slot holding the frame's tightly packed rows
+        size_t slot = FrameArena::NO_SLOT;
+        /// @brief Position of the LZ4 block in the spill file
+        uint64_t spill_offset = 0;
+        /// @brief Size of the LZ4 block in the spill file
+        size_t spill_size = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        D3DFORMAT format = D3DFMT_UNKNOWN;
+        size_t index = 0;
+        /// @brief Order of the frame within its writer, for keeping synchronous writers in order
+        size_t sequence = 0;
+        std::shared_ptr<VideoWriter> writer;
+    };
+
+    /// @param budget The most bytes of compressed frames to hold in RAM at once
+    explicit FrameBacklog(size_t budget) : m_budget(budget) {}
+    ~FrameBacklog();
+
+    /// @brief Compress the buffer's pixels into `entry->data`, and fill in its size and format
+    static bool Compress(const FrameBufferBase& buffer, Entry* entry);
+    /// @brief Decompress the entry's pixels. `buffer` must have the entry's size and format.
+    static bool Decompress(const Entry& entry, FrameBufferMem* buffer);
+
+    /**
+     * @brief Create a scratch file to spill entries into, when the RAM budget is full.
+     * @param budget The most bytes to hold in the file at once. Space is reclaimed when the spilled entries drain.
+     * @return `false` if the file couldn't be created
+     */
+    bool SetSpillFile(std::filesystem::path path, uint64_t budget);
+    /**
+     * @brief Preallocate an arena of uncompressed frames, used before any other tier.
+     * @param slot_size The uncompressed size of each frame
+     * @param large_pages Try to allocate the arena with large pages
+     * @return `false` if the arena couldn't be allocated
+     */
+    bool SetArena(size_t slot_size, size_t num_slots, bool large_pages);
+
+    /// @brief Fill a reserved entry with the buffer's pixels, in the entry's tier. Thread-safe.
+    bool Store(const FrameBufferBase& buffer, Entry* entry);
+    /// @brief Read a taken entry's pixels into `buffer`, which must have the entry's size and format. Thread-safe.
+    bool Restore(Entry* entry, FrameBufferMem* buffer);
+
+    /**
+     * @brief Reserve room for a frame before storing it.
+     * @details The uncompressed size is reserved, since the compressed size isn't known yet.
+     * The arena is preferred, then RAM, then the spill file.
+     * @param entry Assigned the tier and arena slot of the reservation
+     * @return `false` if the frame might not fit in any tier
+     */
+    bool TryReserve(size_t raw_size, Entry* entry);
+    /// @brief Add a stored entry to the tier it was reserved in, and release the room reserved for it
+    void Push(Entry&& entry, size_t reserved);
+    /// @brief Release the room reserved for a frame that won't be pushed
+    void Unreserve(const Entry& entry, size_t reserved);
+    /// @brief Remove and return an entry from @ref GetEntries. Call @ref Release after restoring it.
+    Entry Take(size_t i);
+    /// @brief Free the arena slot or spill file space of a taken entry, after restoring it. RAM is released by @ref Take.
+    void Release(const Entry& entry);
+
+    /// @brief Entries from oldest to newest
+    const std::deque<Entry>& GetEntries() const { return m_entries; }
+    bool IsEmpty() const { return m_entries.empty(); }
+    /// @brief A summary of the compression ratio and peak memory use. Includes a newline.
+    std::string GetStats() const;
+
+private:
+    /// @brief Move a compressed entry's data to the end of the spill file. Thread-safe.
+    bool Spill(Entry* entry);
+    /// @brief Read a spilled entry's data back into RAM. Thread-safe.
+    bool Load(Entry* entry);
+    /// @brief Truncate the spill file, once nothing in it is reserved or waiting to be loaded
+    void ResetSpillFile();
+
+    const size_t m_budget;
+    /// @brief Optional. Set by @ref SetArena.
+    std::unique_ptr<FrameArena> m_arena;
+    size_t m_num_arena_entries = 0;
+    size_t m_peak_arena_slots = 0;
+    std::deque<Entry> m_entries;
+    /// @brief Empty if spilling is disabled
+    std::filesystem::path m_spill_path;
+    uint64_t m_spill_budget = 0;
+    /// @brief Bytes reserved, or held by entries that aren't released yet, in the spill file
+    uint64_t m_spill_used = 0;
+    size_t m_num_spilled = 0;
+    /// @brief Bytes of every spilled entry, for the stats
+    uint64_t m_total_spilled = 0;
+    /// @brief Protects @ref m_spill_file and @ref m_spill_end
+    std::mutex m_spill_mutex;
+    std::fstream m_spill_file;
+    /// @brief The end of the data written to @ref m_spill_file
+    uint64_t m_spill_end = 0;
+    /// @brief Bytes of compressed data in RAM
+    size_t m_used = 0;
+    /// @brief Bytes of RAM reserved for frames that are being compressed
+    size_t m_reserved = 0;
+    size_t m_peak_used = 0;
+    size_t m_peak_entries = 0;
+    /// @brief Uncompressed bytes of every pushed frame, for the compression ratio
+    size_t m_total_raw = 0;
+    /// @brief Compressed bytes of every pushed frame, for the compression ratio
+    size_t m_total_compressed = 0;
+    size_t m_total_entries = 0;
+};
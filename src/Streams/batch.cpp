@@ -0,0 +1,139 @@
+#include "batch.h"
+#include <Helper/json.h>
+#include <Helper/str.h>
+#include <cstdlib>
+
+std::optional<BatchJob> BatchJob::Parse(std::istream& input, std::string* error)
+{
+    nlohmann::json root;
+    try {
+        root = nlohmann::json::parse(input);
+    }
+    catch (const std::exception& e)
+    {
+        *error = Helper::sprintf("Failed to parse JSON: '%s'", e.what());
+        return std::nullopt;
+    }
+
+    BatchJob job;
+    const nlohmann::json* clips = &root;
+    if (root.is_object())
+    {
+        Helper::FromJson(root, "output", job.output);
+        clips = Helper::FromJson(root, "clips");
+    }
+    if (!clips || !clips->is_array())
+    {
+        *error = "Expected a list of clips";
+        return std::nullopt;
+    }
+
+    for (size_t i = 0; i < clips->size(); ++i)
+    {
+        const nlohmann::json& j = (*clips)[i];
+        BatchClip& clip = job.clips.emplace_back();
+        if (!j.is_object() || !Helper::FromJson(j, "demo", clip.demo) || clip.demo.empty())
+        {
+            *error = Helper::sprintf("Clip %zu has no demo", i);
+            return std::nullopt;
+        }
+        if (!Helper::FromJson(j, "start_tick", clip.start_tick) || !Helper::FromJson(j, "end_tick", clip.end_tick))
+        {
+            *error = Helper::sprintf("Clip %zu needs a start_tick and an end_tick", i);
+            return std::nullopt;
+        }
+        if (clip.start_tick < 0 || clip.end_tick <= clip.start_tick)
+        {
+            *error = Helper::sprintf("Clip %zu must end after it starts", i);
+            return std::nullopt;
+        }
+        if (j.contains("streams") && !Helper::FromJson(j, "streams", clip.streams))
+        {
+            *error = Helper::sprintf("Clip %zu has streams that aren't a list of names", i);
+            return std::nullopt;
+        }
+        if (!Helper::FromJson(j, "name", clip.name) || clip.name.empty())
+            clip.name = Helper::sprintf("clip%02zu", i);
+    }
+
+    if (job.clips.empty())
+    {
+        *error = "The job has no clips";
+        return std::nullopt;
+    }
+    return job;
+}
+
+BatchScheduler::Action BatchScheduler::Update(const Observation& observation)
+{
+    switch (m_state)
+    {
+    case State::LOAD:
+    {
+        const BatchClip* clip = GetClip();
+        if (!clip)
+        {
+            m_state = State::FINISHED;
+            return Action::FINISHED;
+        }
+
+        m_num_waits = 0;
+        if (observation.playing_demo && m_loaded_demo == clip->demo)
+        {
+            m_state = State::WAIT_SEEK;
+            return Action::SEEK;
+        }
+        m_loaded_demo = clip->demo;
+        m_state = State::WAIT_LOAD;
+        return Action::PLAY_DEMO;
+    }
+    case State::WAIT_LOAD:
+        if (!observation.playing_demo || observation.loading)
+        {
+            if (++m_num_waits < LOAD_TIMEOUT_UPDATES)
+                return Action::NONE;
+            // The demo is missing or broken, so don't assume it's playing for the next clip
+            m_loaded_demo.clear();
+            ++m_index;
+            m_state = State::LOAD;
+            return Action::SKIP;
+        }
+        m_num_waits = 0;
+        m_state = State::WAIT_SEEK;
+        return Action::SEEK;
+    case State::WAIT_SEEK:
+        if (!observation.playing_demo)
+        {
+            // The demo was stopped from elsewhere, so load it again
+            m_loaded_demo.clear();
+            m_state = State::LOAD;
+            return Action::NONE;
+        }
+        if (!observation.loading && std::abs(observation.tick - GetClip()->start_tick) <= SEEK_TOLERANCE)
+        {
+            m_state = State::RECORDING;
+            return Action::START;
+        }
+        if (++m_num_waits < SEEK_RETRY_UPDATES)
+            return Action::NONE;
+        m_num_waits = 0;
+        return Action::SEEK;
+    case State::RECORDING:
+        if (!m_aborted && observation.playing_demo && !observation.loading && observation.tick < GetClip()->end_tick)
+            return Action::NONE;
+        ++m_index;
+        m_state = m_aborted ? State::FINISHED : State::LOAD;
+        return Action::STOP;
+    case State::FINISHED:
+        break;
+    }
+    return Action::FINISHED;
+}
+
+void BatchScheduler::Abort()
+{
+    if (m_state == State::RECORDING)
+        m_aborted = true;
+    else
+        m_state = State::FINISHED;
+}
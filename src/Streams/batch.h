@@ -0,0 +1,115 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <optional>
+#include <istream>
+#include <cstdint>
+
+/// @brief One clip of a batch job: a tick range of a demo, recorded with a set of streams
+struct BatchClip
+{
+    /// @brief The name of the clip's folder
+    std::string name;
+    /// @brief The demo to play, as passed to `playdemo`
+    std::string demo;
+    int start_tick = 0;
+    /// @brief Recording stops when this tick is reached
+    int end_tick = 0;
+    /// @brief Names of the streams to record. If empty, every stream is recorded.
+    std::vector<std::string> streams;
+};
+
+struct BatchJob
+{
+    /// @brief The folder to contain every clip. If empty, the recorder's output folder is used.
+    std::filesystem::path output;
+    std::vector<BatchClip> clips;
+
+    /**
+     * @brief Parse a job file. This is either a list of clips, or an object with `output` and `clips`.
+     *
+     * Each clip has a `demo`, `start_tick`, `end_tick`, and optionally a `name` and a list of `streams`.
+     * @param error Assigned a description of the first problem, if parsing fails
+     * @return `std::nullopt` if the file is malformed
+     */
+    static std::optional<BatchJob> Parse(std::istream& input, std::string* error);
+};
+
+/**
+ * @brief Decides when to load, seek, start and stop each clip of a batch job.
+ *
+ * The scheduler has no game dependencies. Each frame, the caller passes what the game is doing to
+ * @ref Update, and carries out the returned action. Demos that are already playing aren't reloaded,
+ * so clips from the same demo only pay for a seek.
+ */
+class BatchScheduler
+{
+public:
+    enum class Action
+    {
+        /// @brief Nothing to do this frame
+        NONE,
+        /// @brief Play the current clip's demo
+        PLAY_DEMO,
+        /// @brief Seek to the current clip's start tick, and pause
+        SEEK,
+        /// @brief Start recording the current clip, and resume the demo
+        START,
+        /// @brief Stop recording the current clip. The next clip becomes current.
+        STOP,
+        /// @brief The current clip's demo didn't load in time, so the clip is skipped. The next clip becomes current.
+        SKIP,
+        /// @brief Every clip is recorded
+        FINISHED,
+    };
+
+    /// @brief What the game is doing this frame
+    struct Observation
+    {
+        bool playing_demo = false;
+        /// @brief The demo is still loading, or the game isn't connected yet
+        bool loading = false;
+        int tick = 0;
+    };
+
+    /// @brief Seeking is done when the demo is within this many ticks of the start tick
+    static constexpr int SEEK_TOLERANCE = 2;
+    /// @brief Seek again if it isn't done after this many updates
+    static constexpr size_t SEEK_RETRY_UPDATES = 300;
+    /// @brief Skip the clip if its demo hasn't loaded after this many updates
+    static constexpr size_t LOAD_TIMEOUT_UPDATES = 3000;
+
+    explicit BatchScheduler(std::vector<BatchClip> clips) : m_clips(std::move(clips)) {}
+
+    Action Update(const Observation& observation);
+    /// @brief Skip the remaining clips. A clip that is recording is stopped at the next update.
+    void Abort();
+
+    /// @return `nullptr` if every clip is done
+    const BatchClip* GetClip() const { return m_index < m_clips.size() ? &m_clips[m_index] : nullptr; }
+    size_t GetClipIndex() const { return m_index; }
+    size_t GetNumClips() const { return m_clips.size(); }
+    bool IsRecording() const { return m_state == State::RECORDING; }
+    bool IsFinished() const { return m_state == State::FINISHED; }
+
+private:
+    enum class State
+    {
+        LOAD,
+        WAIT_LOAD,
+        SEEK,
+        WAIT_SEEK,
+        RECORDING,
+        FINISHED,
+    };
+
+    std::vector<BatchClip> m_clips;
+    size_t m_index = 0;
+    State m_state = State::LOAD;
+    /// @brief The demo that was last played by this scheduler
+    std::string m_loaded_demo;
+    /// @brief Updates spent in the current wait state
+    size_t m_num_waits = 0;
+    bool m_aborted = false;
+};
@@ -0,0 +1,191 @@
+#include "calibration.h"
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+void EncoderCalibration::AddCandidate(std::string name, EncodeFn encode) {
+    m_candidates.push_back({std::move(name), std::move(encode)});
+}
+
+EncoderCalibration::Measurement EncoderCalibration::Measure(size_t candidate, size_t num_threads) const
+{
+    const size_t num_encodes = num_threads * ENCODES_PER_THREAD > m_num_frames ? num_threads * ENCODES_PER_THREAD : m_num_frames;
+    const EncodeFn& encode = m_candidates[candidate].encode;
+    std::atomic<size_t> next = 0;
+    std::atomic<size_t> total_bytes = 0;
+    std::atomic<bool> failed = false;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        threads.emplace_back([&] {
+            for (size_t index = next++; index < num_encodes; index = next++)
+            {
+                size_t bytes = encode(index % m_num_frames);
+                if (bytes == 0)
+                    failed = true;
+                total_bytes += bytes;
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+    Measurement measurement;
+    measurement.candidate = candidate;
+    measurement.num_threads = num_threads;
+    if (failed)
+        return measurement; // An fps of 0 is never recommended
+    measurement.fps = num_encodes / seconds.count();
+    measurement.bytes_per_frame = (double)total_bytes / num_encodes;
+    return measurement;
+}
+
+EncoderCalibration::Report EncoderCalibration::Run(double target_fps, size_t max_threads, const std::filesystem::path& output_dir) const
+{
+    Report report;
+    if (!output_dir.empty())
+        report.disk_bytes_per_sec = MeasureDiskSpeed(output_dir, DISK_TEST_BYTES);
+    if (m_num_frames == 0)
+        return report;
+    if (max_threads == 0)
+        max_threads = 1;
+
+    for (size_t candidate = 0; candidate < m_candidates.size(); ++candidate)
+    {
+        for (size_t num_threads = 1;; num_threads *= 2)
+        {
+            if (num_threads > max_threads)
+                num_threads = max_threads;
+
+            Measurement measurement = Measure(candidate, num_threads);
+            measurement.sustained_fps = measurement.fps;
+            if (report.disk_bytes_per_sec > 0 && measurement.bytes_per_frame > 0)
+            {
+                double disk_fps = report.disk_bytes_per_sec / measurement.bytes_per_frame;
+                if (disk_fps < measurement.sustained_fps)
+                    measurement.sustained_fps = disk_fps;
+            }
+            report.measurements.push_back(measurement);
+
+            if (measurement.fps == 0 || measurement.sustained_fps >= target_fps || num_threads >= max_threads)
+                break;
+        }
+    }
+
+    // Prefer the smallest output that keeps up, then the fewest threads. Otherwise, the fastest.
+    for (size_t i = 0; i < report.measurements.size(); ++i)
+    {
+        const Measurement& measurement = report.measurements[i];
+        if (measurement.fps == 0)
+            continue;
+        const bool sustains = measurement.sustained_fps >= target_fps;
+        bool better;
+        if (report.best < 0)
+            better = true;
+        else
+        {
+            const Measurement& best = report.measurements[report.best];
+            if (sustains != report.sustains_target)
+                better = sustains;
+            else if (sustains && measurement.bytes_per_frame != best.bytes_per_frame)
+                better = measurement.bytes_per_frame < best.bytes_per_frame;
+            else if (sustains)
+                better = measurement.num_threads < best.num_threads;
+            else
+                better = measurement.sustained_fps > best.sustained_fps;
+        }
+        if (better)
+        {
+            report.best = (int)i;
+            report.sustains_target = sustains;
+        }
+    }
+    return report;
+}
+
+std::string EncoderCalibration::FormatReport(const Report& report) const
+{
+    std::string text;
+    char line[256];
+    snprintf(line, sizeof(line), "Disk write speed: %.0f MB/s\n", report.disk_bytes_per_sec / (1024 * 1024));
+    text += line;
+    for (size_t i = 0; i < report.measurements.size(); ++i)
+    {
+        const Measurement& measurement = report.measurements[i];
+        snprintf(
+            line, sizeof(line), "%s %-24s %3zu threads: %7.1f fps (%7.1f sustained), %8.1f KB/frame\n",
+            (int)i == report.best ? "*" : " ", GetCandidateName(measurement.candidate).c_str(), measurement.num_threads,
+            measurement.fps, measurement.sustained_fps, measurement.bytes_per_frame / 1024
+        );
+        text += line;
+    }
+    return text;
+}
+
+/**
+ * @brief Write `num_bytes` of repeated blocks to a new file, and return once they're on the drive.
+ * @details Without waiting for the drive, this would only measure the OS's write cache.
+ */
+static bool WriteThrough(const std::filesystem::path& path, const std::vector<char>& block, size_t num_bytes)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileW(
+        path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_WRITE_THROUGH, nullptr
+    );
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    bool ok = true;
+    for (size_t written = 0; ok && written < num_bytes; written += block.size())
+    {
+        DWORD size = (DWORD)(num_bytes - written < block.size() ? num_bytes - written : block.size());
+        DWORD num_written;
+        ok = WriteFile(file, block.data(), size, &num_written, nullptr) && num_written == size;
+    }
+    ok = ok && FlushFileBuffers(file);
+    CloseHandle(file);
+    return ok;
+#else
+    int file = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file < 0)
+        return false;
+    bool ok = true;
+    for (size_t written = 0; ok && written < num_bytes; written += block.size())
+    {
+        size_t size = num_bytes - written < block.size() ? num_bytes - written : block.size();
+        ok = write(file, block.data(), size) == (ssize_t)size;
+    }
+    ok = ok && fsync(file) == 0;
+    close(file);
+    return ok;
+#endif
+}
+
+double EncoderCalibration::MeasureDiskSpeed(const std::filesystem::path& dir, size_t num_bytes)
+{
+    constexpr size_t BLOCK_SIZE = 4 << 20;
+    const std::filesystem::path path = dir / "calibration.tmp";
+    std::vector<char> block(BLOCK_SIZE);
+    for (size_t i = 0; i < block.size(); ++i)
+        block[i] = (char)(i * 31 + 7); // Not all zeros, in case the drive compresses
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = WriteThrough(path, block, num_bytes);
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+    std::error_code err;
+    std::filesystem::remove(path, err);
+    if (!ok || seconds.count() <= 0)
+        return 0;
+    return num_bytes / seconds.count();
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Benchmark encoder settings across thread counts, to find the one that keeps up with a target framerate
+ * with the smallest output.
+ *
+ * Encoders are given as callbacks, so this has no D3D or game dependencies, and can be run on its own.
+ */
+class EncoderCalibration
+{
+public:
+    /**
+     * @brief Encode one of the sample frames. Must be thread-safe.
+     * @return The size of the encoded frame in bytes, or 0 on failure
+     */
+    using EncodeFn = std::function<size_t(size_t frame)>;
+
+    struct Measurement
+    {
+        size_t candidate = 0;
+        size_t num_threads = 0;
+        /// @brief Frames encoded per second, across all threads
+        double fps = 0;
+        double bytes_per_frame = 0;
+        /// @brief @ref fps, or less if the disk can't keep up
+        double sustained_fps = 0;
+    };
+
+    struct Report
+    {
+        std::vector<Measurement> measurements;
+        /// @brief Bytes per second written to the output folder. 0 if it couldn't be measured.
+        double disk_bytes_per_sec = 0;
+        /// @brief Index into `measurements` of the recommended setup, or -1 if nothing could be measured
+        int best = -1;
+        /// @brief The recommended setup sustains the target framerate. Otherwise, it's just the fastest setup.
+        bool sustains_target = false;
+    };
+
+    /// @param num_frames The number of sample frames that the encoders choose from
+    explicit EncoderCalibration(size_t num_frames) : m_num_frames(num_frames) {}
+
+    void AddCandidate(std::string name, EncodeFn encode);
+    size_t GetNumCandidates() const { return m_candidates.size(); }
+    const std::string& GetCandidateName(size_t candidate) const { return m_candidates[candidate].name; }
+
+    /**
+     * @brief Measure every candidate with 1, 2, 4 and more threads, and the write speed of the output folder.
+     * @details A candidate's larger thread counts are skipped once it sustains the target,
+     * so the recommendation uses the fewest threads that keep up.
+     * @param max_threads The most threads to measure with
+     * @param output_dir A file is written to it and deleted, to measure the disk. Skipped if empty.
+     */
+    Report Run(double target_fps, size_t max_threads, const std::filesystem::path& output_dir) const;
+    /// @brief A table of the measurements, one line each, with the recommendation marked
+    std::string FormatReport(const Report& report) const;
+
+    /**
+     * @brief Write a scratch file of `num_bytes` in large blocks and delete it.
+     * @details The clock stops once the data is flushed to the drive, so the OS's write cache doesn't count.
+     * @return Bytes per second, or 0 if the file couldn't be written
+     */
+    static double MeasureDiskSpeed(const std::filesystem::path& dir, size_t num_bytes);
+
+private:
+    struct Candidate
+    {
+        std::string name;
+        EncodeFn encode;
+    };
+
+    /// @brief Frames encoded by each thread for one measurement
+    static constexpr size_t ENCODES_PER_THREAD = 3;
+    /// @brief Size of the scratch file for @ref MeasureDiskSpeed
+    static constexpr size_t DISK_TEST_BYTES = 256 << 20;
+
+    Measurement Measure(size_t candidate, size_t num_threads) const;
+
+    size_t m_num_frames;
+    std::vector<Candidate> m_candidates;
+};
@@ -0,0 +1,133 @@
+#include "crop.h"
+#include <cstring>
+#include <Helper/simd.h>
+
+namespace Crop
+{
+
+/// @brief Number of pixels compared at once. 16 pixels are exactly three vectors.
+static constexpr size_t BLOCK_PIXELS = 16;
+
+/// @brief The background color, repeated to compare whole blocks of pixels
+struct Background
+{
+    explicit Background(const uint8_t* pixel)
+    {
+        for (size_t p = 0; p < BLOCK_PIXELS; ++p)
+            memcpy(pattern + p * 3, pixel, 3);
+#ifdef SF_USE_SSE2
+        for (size_t r = 0; r < 3; ++r)
+            xpattern[r] = _mm_load_si128((const __m128i*)pattern + r);
+#endif
+    }
+
+    bool Matches(const uint8_t* pixel) const {
+        return memcmp(pixel, pattern, 3) == 0;
+    }
+
+    bool MatchesBlock(const uint8_t* pixels) const
+    {
+#ifdef SF_USE_SSE2
+        const __m128i* block = (const __m128i*)pixels;
+        __m128i eq = _mm_and_si128(
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128(block + 0), xpattern[0]),
+                _mm_cmpeq_epi8(_mm_loadu_si128(block + 1), xpattern[1])
+            ),
+            _mm_cmpeq_epi8(_mm_loadu_si128(block + 2), xpattern[2])
+        );
+        return _mm_movemask_epi8(eq) == 0xFFFF;
+#else
+        return memcmp(pixels, pattern, sizeof(pattern)) == 0;
+#endif
+    }
+
+    alignas(16) uint8_t pattern[BLOCK_PIXELS * 3];
+#ifdef SF_USE_SSE2
+    __m128i xpattern[3];
+#endif
+};
+
+/// @return The first pixel within [begin, end) that isn't the background, or `end` if there is none
+static size_t FindFirst(const uint8_t* row, size_t begin, size_t end, const Background& bg)
+{
+    size_t x = begin;
+    while (x + BLOCK_PIXELS <= end && bg.MatchesBlock(row + x * 3))
+        x += BLOCK_PIXELS;
+    for (; x < end; ++x)
+    {
+        if (!bg.Matches(row + x * 3))
+            return x;
+    }
+    return end;
+}
+
+/// @return One past the last pixel within [begin, end) that isn't the background, or `begin` if there is none
+static size_t FindLast(const uint8_t* row, size_t begin, size_t end, const Background& bg)
+{
+    size_t x = end;
+    while (x >= begin + BLOCK_PIXELS && bg.MatchesBlock(row + (x - BLOCK_PIXELS) * 3))
+        x -= BLOCK_PIXELS;
+    for (; x > begin; --x)
+    {
+        if (!bg.Matches(row + (x - 1) * 3))
+            return x;
+    }
+    return begin;
+}
+
+bool FindBounds(const uint8_t* rgb, uint32_t width, uint32_t height, Rect* bounds)
+{
+    if (width == 0 || height == 0)
+        return false;
+
+    const Background bg(rgb);
+    const size_t row_size = (size_t)width * 3;
+
+    // The first row with a subject pixel also gives the first guess at the left and right edges
+    uint32_t top = 0;
+    size_t left = width;
+    for (; top < height; ++top)
+    {
+        left = FindFirst(rgb + top * row_size, 0, width, bg);
+        if (left < width)
+            break;
+    }
+    if (top == height)
+        return false;
+    size_t right = FindLast(rgb + top * row_size, left, width, bg);
+
+    uint32_t bottom = height;
+    while (bottom - 1 > top && FindFirst(rgb + (bottom - 1) * row_size, 0, width, bg) == width)
+        --bottom;
+
+    // Each remaining row only has to be searched outside of the edges found so far
+    for (uint32_t y = top + 1; y < bottom; ++y)
+    {
+        const uint8_t* row = rgb + y * row_size;
+        if (left > 0)
+            left = FindFirst(row, 0, left, bg);
+        if (right < width)
+        {
+            size_t row_right = FindLast(row, right, width, bg);
+            if (row_right > right)
+                right = row_right;
+        }
+    }
+
+    bounds->x = (uint32_t)left;
+    bounds->y = top;
+    bounds->width = (uint32_t)(right - left);
+    bounds->height = bottom - top;
+    return true;
+}
+
+void CopyRect(const uint8_t* rgb, uint32_t width, const Rect& rect, uint8_t* out)
+{
+    const size_t row_size = (size_t)width * 3;
+    const size_t rect_row_size = (size_t)rect.width * 3;
+    for (uint32_t y = 0; y < rect.height; ++y)
+        memcpy(out + y * rect_row_size, rgb + (rect.y + y) * row_size + (size_t)rect.x * 3, rect_row_size);
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Helpers to crop frames to the pixels that differ from their background.
+ *
+ * Mattes and wireframe passes are mostly one flat color around a small subject.
+ * Encoding only the subject's bounding box is faster and makes smaller files,
+ * and padding it with the background color restores the original frame exactly.
+ *
+ * These have no D3D or game dependencies, so they can be built and exercised on their own.
+ */
+namespace Crop
+{
+    struct Rect
+    {
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    /**
+     * @brief Find the smallest rectangle holding every pixel that differs from the background.
+     * @details The background is the color of the top-left pixel.
+     * @param rgb Tightly packed rows of 3-byte pixels
+     * @return `false` if every pixel is the background color
+     */
+    bool FindBounds(const uint8_t* rgb, uint32_t width, uint32_t height, Rect* bounds);
+
+    /**
+     * @brief Copy a rectangle of pixels out of a frame
+     * @param out Receives tightly packed rows of the rectangle
+     */
+    void CopyRect(const uint8_t* rgb, uint32_t width, const Rect& rect, uint8_t* out);
+}
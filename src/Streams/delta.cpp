@@ -0,0 +1,257 @@
+#include "delta.h"
+#include <cstring>
+#include <Helper/simd.h>
+
+namespace Delta
+{
+
+// The ops of QOI, without alpha
+static constexpr uint8_t OP_INDEX = 0x00;
+static constexpr uint8_t OP_DIFF = 0x40;
+static constexpr uint8_t OP_LUMA = 0x80;
+static constexpr uint8_t OP_RUN = 0xC0;
+static constexpr uint8_t OP_RGB = 0xFE;
+static constexpr uint8_t OP_MASK = 0xC0;
+static constexpr int MAX_RUN = 62;
+static constexpr size_t INDEX_SIZE = 64;
+
+/// @brief State shared by the ops of one frame
+struct OpState
+{
+    OpState() { memset(index, 0, sizeof(index)); }
+
+    uint32_t index[INDEX_SIZE];
+    uint32_t prev = 0;
+};
+
+static inline uint32_t ReadPixel(const uint8_t* pixel) {
+    return pixel[0] | (pixel[1] << 8) | (pixel[2] << 16);
+}
+
+static inline void WritePixel(uint8_t* pixel, uint32_t color)
+{
+    pixel[0] = (uint8_t)color;
+    pixel[1] = (uint8_t)(color >> 8);
+    pixel[2] = (uint8_t)(color >> 16);
+}
+
+/// @brief The hash of QOI, with an alpha of 255
+static inline size_t HashPixel(uint32_t color)
+{
+    uint32_t r = color & 0xFF, g = (color >> 8) & 0xFF, b = (color >> 16) & 0xFF;
+    return (r * 3 + g * 5 + b * 7 + 255 * 11) % INDEX_SIZE;
+}
+
+static inline uint32_t DivideUp(uint32_t a, uint32_t b) {
+    return (a + b - 1) / b;
+}
+
+static bool BytesEqual(const uint8_t* a, const uint8_t* b, size_t size)
+{
+    size_t i = 0;
+#ifdef SF_USE_SSE2
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+        if (_mm_movemask_epi8(eq) != 0xFFFF)
+            return false;
+    }
+#endif
+    return memcmp(a + i, b + i, size - i) == 0;
+}
+
+Encoder::Encoder(uint32_t width, uint32_t height)
+    : m_width(width), m_height(height),
+    m_tiles_x(DivideUp(width, TILE_SIZE)), m_tiles_y(DivideUp(height, TILE_SIZE)),
+    m_prev((size_t)width * height * 3)
+{}
+
+size_t Encoder::Encode(const uint8_t* rgb, bool keyframe, std::vector<uint8_t>* out)
+{
+    keyframe = keyframe || !m_has_prev;
+    const size_t row_size = (size_t)m_width * 3;
+    const size_t bitmap_size = keyframe ? 0 : (GetNumTiles() + 7) / 8;
+
+    out->clear();
+    out->push_back(keyframe ? FLAG_KEYFRAME : 0);
+    out->resize(1 + bitmap_size, 0);
+
+    OpState state;
+    size_t num_stored = 0;
+    for (uint32_t ty = 0; ty < m_tiles_y; ++ty)
+    {
+        const uint32_t y0 = ty * TILE_SIZE;
+        const uint32_t tile_height = m_height - y0 < TILE_SIZE ? m_height - y0 : TILE_SIZE;
+        for (uint32_t tx = 0; tx < m_tiles_x; ++tx)
+        {
+            const uint32_t x0 = tx * TILE_SIZE;
+            const uint32_t tile_width = m_width - x0 < TILE_SIZE ? m_width - x0 : TILE_SIZE;
+            const size_t tile_row_size = (size_t)tile_width * 3;
+            const size_t tile_offset = y0 * row_size + (size_t)x0 * 3;
+
+            if (!keyframe)
+            {
+                bool changed = false;
+                for (uint32_t y = 0; y < tile_height && !changed; ++y)
+                {
+                    size_t offset = tile_offset + y * row_size;
+                    changed = !BytesEqual(rgb + offset, m_prev.data() + offset, tile_row_size);
+                }
+                if (!changed)
+                    continue;
+                size_t tile = (size_t)ty * m_tiles_x + tx;
+                (*out)[1 + tile / 8] |= (uint8_t)(1 << (tile % 8));
+            }
+            ++num_stored;
+
+            int run = 0;
+            for (uint32_t y = 0; y < tile_height; ++y)
+            {
+                const size_t offset = tile_offset + y * row_size;
+                const uint8_t* src = rgb + offset;
+                memcpy(m_prev.data() + offset, src, tile_row_size);
+
+                for (uint32_t x = 0; x < tile_width; ++x)
+                {
+                    uint32_t color = ReadPixel(src + x * 3);
+                    if (color == state.prev)
+                    {
+                        if (++run == MAX_RUN)
+                        {
+                            out->push_back((uint8_t)(OP_RUN | (run - 1)));
+                            run = 0;
+                        }
+                        continue;
+                    }
+                    if (run > 0)
+                    {
+                        out->push_back((uint8_t)(OP_RUN | (run - 1)));
+                        run = 0;
+                    }
+
+                    size_t hash = HashPixel(color);
+                    if (state.index[hash] == color)
+                        out->push_back((uint8_t)(OP_INDEX | hash));
+                    else
+                    {
+                        state.index[hash] = color;
+                        int dr = (int8_t)((color & 0xFF) - (state.prev & 0xFF));
+                        int dg = (int8_t)(((color >> 8) & 0xFF) - ((state.prev >> 8) & 0xFF));
+                        int db = (int8_t)(((color >> 16) & 0xFF) - ((state.prev >> 16) & 0xFF));
+                        int dr_dg = dr - dg, db_dg = db - dg;
+                        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                            out->push_back((uint8_t)(OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                        else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7)
+                        {
+                            out->push_back((uint8_t)(OP_LUMA | (dg + 32)));
+                            out->push_back((uint8_t)((dr_dg + 8) << 4 | (db_dg + 8)));
+                        }
+                        else
+                        {
+                            const uint8_t rgb_op[4] = {OP_RGB, (uint8_t)color, (uint8_t)(color >> 8), (uint8_t)(color >> 16)};
+                            out->insert(out->end(), rgb_op, rgb_op + 4);
+                        }
+                    }
+                    state.prev = color;
+                }
+            }
+            if (run > 0)
+                out->push_back((uint8_t)(OP_RUN | (run - 1)));
+        }
+    }
+
+    m_has_prev = true;
+    return num_stored;
+}
+
+Decoder::Decoder(uint32_t width, uint32_t height)
+    : m_width(width), m_height(height),
+    m_tiles_x(DivideUp(width, TILE_SIZE)), m_tiles_y(DivideUp(height, TILE_SIZE)),
+    m_frame((size_t)width * height * 3)
+{}
+
+bool Decoder::Decode(const uint8_t* data, size_t size)
+{
+    if (size < 1)
+        return false;
+    const bool keyframe = data[0] & FLAG_KEYFRAME;
+    if (!keyframe && !m_has_frame)
+        return false;
+
+    const size_t num_tiles = (size_t)m_tiles_x * m_tiles_y;
+    const uint8_t* bitmap = data + 1;
+    size_t pos = 1 + (keyframe ? 0 : (num_tiles + 7) / 8);
+    if (pos > size)
+        return false;
+
+    const size_t row_size = (size_t)m_width * 3;
+    OpState state;
+    for (size_t tile = 0; tile < num_tiles; ++tile)
+    {
+        if (!keyframe && !(bitmap[tile / 8] & (1 << (tile % 8))))
+            continue;
+
+        const uint32_t x0 = (uint32_t)(tile % m_tiles_x) * TILE_SIZE;
+        const uint32_t y0 = (uint32_t)(tile / m_tiles_x) * TILE_SIZE;
+        const uint32_t tile_width = m_width - x0 < TILE_SIZE ? m_width - x0 : TILE_SIZE;
+        const uint32_t tile_height = m_height - y0 < TILE_SIZE ? m_height - y0 : TILE_SIZE;
+
+        int run = 0;
+        for (uint32_t y = 0; y < tile_height; ++y)
+        {
+            uint8_t* dst = m_frame.data() + (y0 + y) * row_size + (size_t)x0 * 3;
+            for (uint32_t x = 0; x < tile_width; ++x)
+            {
+                if (run > 0)
+                    --run;
+                else
+                {
+                    if (pos >= size)
+                        return false;
+                    const uint8_t op = data[pos++];
+                    if (op == OP_RGB + 1) // RGBA, which is never written
+                        return false;
+                    if (op == OP_RGB)
+                    {
+                        if (pos + 3 > size)
+                            return false;
+                        state.prev = ReadPixel(data + pos);
+                        pos += 3;
+                    }
+                    else if ((op & OP_MASK) == OP_INDEX)
+                        state.prev = state.index[op];
+                    else if ((op & OP_MASK) == OP_DIFF)
+                    {
+                        uint8_t r = (uint8_t)((state.prev & 0xFF) + ((op >> 4) & 3) - 2);
+                        uint8_t g = (uint8_t)(((state.prev >> 8) & 0xFF) + ((op >> 2) & 3) - 2);
+                        uint8_t b = (uint8_t)(((state.prev >> 16) & 0xFF) + (op & 3) - 2);
+                        state.prev = r | (g << 8) | (b << 16);
+                    }
+                    else if ((op & OP_MASK) == OP_LUMA)
+                    {
+                        if (pos >= size)
+                            return false;
+                        const uint8_t op2 = data[pos++];
+                        int dg = (op & 0x3F) - 32;
+                        uint8_t r = (uint8_t)((state.prev & 0xFF) + dg + ((op2 >> 4) & 0xF) - 8);
+                        uint8_t g = (uint8_t)(((state.prev >> 8) & 0xFF) + dg);
+                        uint8_t b = (uint8_t)(((state.prev >> 16) & 0xFF) + dg + (op2 & 0xF) - 8);
+                        state.prev = r | (g << 8) | (b << 16);
+                    }
+                    else // Run, including this pixel
+                        run = op & 0x3F;
+
+                    state.index[HashPixel(state.prev)] = state.prev;
+                }
+                WritePixel(dst + x * 3, state.prev);
+            }
+        }
+        if (run > 0) // Runs end with their tile
+            return false;
+    }
+
+    m_has_frame = true;
+    return true;
+}
+
+}
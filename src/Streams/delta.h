@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief A lossless codec for frames that change little from one frame to the next.
+ *
+ * Frames are split into tiles of @ref TILE_SIZE pixels. Each frame only stores the tiles that changed
+ * since the previous frame, encoded with QOI's ops. Keyframes store every tile, so they can be decoded
+ * without the frames before them.
+ *
+ * An encoded frame starts with a flags byte. Unless it's a keyframe, a bitmap of changed tiles follows,
+ * one bit per tile in row order, low bits first. The changed tiles follow, with their pixels in row order.
+ * The ops' state carries over from one tile to the next, but runs end with each tile.
+ *
+ * These have no D3D or game dependencies, so they can be built and exercised on their own.
+ */
+namespace Delta
+{
+    static constexpr uint32_t TILE_SIZE = 16;
+    static constexpr uint8_t FLAG_KEYFRAME = 1;
+
+    class Encoder
+    {
+    public:
+        Encoder(uint32_t width, uint32_t height);
+
+        /**
+         * @brief Encode a frame against the previous frame
+         * @param rgb Tightly packed rows of 3-byte pixels
+         * @param keyframe Store every tile. The first frame is always a keyframe.
+         * @param out Receives the encoded frame
+         * @return The number of tiles that were stored
+         */
+        size_t Encode(const uint8_t* rgb, bool keyframe, std::vector<uint8_t>* out);
+        size_t GetNumTiles() const { return (size_t)m_tiles_x * m_tiles_y; }
+
+    private:
+        const uint32_t m_width;
+        const uint32_t m_height;
+        const uint32_t m_tiles_x;
+        const uint32_t m_tiles_y;
+        /// @brief The last encoded frame
+        std::vector<uint8_t> m_prev;
+        bool m_has_prev = false;
+    };
+
+    class Decoder
+    {
+    public:
+        Decoder(uint32_t width, uint32_t height);
+
+        /**
+         * @brief Apply an encoded frame to the last decoded frame
+         * @return `false` if the data is malformed, or isn't a keyframe and no keyframe was decoded yet
+         */
+        bool Decode(const uint8_t* data, size_t size);
+        /// @brief Tightly packed rows of the last decoded frame
+        const uint8_t* GetFrame() const { return m_frame.data(); }
+
+    private:
+        const uint32_t m_width;
+        const uint32_t m_height;
+        const uint32_t m_tiles_x;
+        const uint32_t m_tiles_y;
+        std::vector<uint8_t> m_frame;
+        bool m_has_frame = false;
+    };
+}
@@ -0,0 +1,73 @@
+#include "depth.h"
+#include "exr.h"
+#include <Helper/simd.h>
+
+namespace Depth
+{
+
+static inline uint32_t ReadDepth(const uint8_t* pixel, const PixelLayout& layout) {
+    return (pixel[layout.offsets[0]] << 16) | (pixel[layout.offsets[1]] << 8) | pixel[layout.offsets[2]];
+}
+
+/// @brief Blue, green and red are the low 3 bytes of each little-endian pixel, so depth is just the pixel without alpha
+static inline bool IsBgrx(const PixelLayout& layout) {
+    return layout.stride == 4 && layout.offsets[0] == 2 && layout.offsets[1] == 1 && layout.offsets[2] == 0;
+}
+
+void UnpackFloat(const uint8_t* pixels, size_t num_pixels, const PixelLayout& layout, float* out)
+{
+    size_t i = 0;
+#ifdef SF_USE_SSE2
+    if (IsBgrx(layout))
+    {
+        const __m128i rgb_mask = _mm_set1_epi32(MAX_VALUE);
+        // Divide instead of multiplying by the reciprocal, so every 24-bit value round-trips exactly
+        const __m128 scale = _mm_set1_ps((float)MAX_VALUE);
+        for (; i + 4 <= num_pixels; i += 4)
+        {
+            __m128i depth = _mm_and_si128(_mm_loadu_si128((const __m128i*)(pixels + i * 4)), rgb_mask);
+            _mm_storeu_ps(out + i, _mm_div_ps(_mm_cvtepi32_ps(depth), scale));
+        }
+    }
+#endif
+    for (; i < num_pixels; ++i)
+        out[i] = (float)ReadDepth(pixels + i * layout.stride, layout) / (float)MAX_VALUE;
+}
+
+void UnpackU16BE(const uint8_t* pixels, size_t num_pixels, const PixelLayout& layout, uint16_t* out)
+{
+    size_t i = 0;
+#ifdef SF_USE_SSE2
+    if (IsBgrx(layout))
+    {
+        const __m128i rgb_mask = _mm_set1_epi32(MAX_VALUE);
+        const __m128i bias32 = _mm_set1_epi32(0x8000);
+        const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+        for (; i + 8 <= num_pixels; i += 8)
+        {
+            const __m128i* src = (const __m128i*)(pixels + i * 4);
+            __m128i lo = _mm_srli_epi32(_mm_and_si128(_mm_loadu_si128(src + 0), rgb_mask), 8);
+            __m128i hi = _mm_srli_epi32(_mm_and_si128(_mm_loadu_si128(src + 1), rgb_mask), 8);
+            // SSE2 can only narrow with signed saturation, so shift the range down and back up
+            __m128i packed = _mm_xor_si128(
+                _mm_packs_epi32(_mm_sub_epi32(lo, bias32), _mm_sub_epi32(hi, bias32)), bias16
+            );
+            packed = _mm_or_si128(_mm_slli_epi16(packed, 8), _mm_srli_epi16(packed, 8));
+            _mm_storeu_si128((__m128i*)(out + i), packed);
+        }
+    }
+#endif
+    for (; i < num_pixels; ++i)
+    {
+        uint16_t value = (uint16_t)(ReadDepth(pixels + i * layout.stride, layout) >> 8);
+        out[i] = (uint16_t)((value << 8) | (value >> 8));
+    }
+}
+
+bool WriteExr(std::ostream& output, uint32_t width, uint32_t height, const float* pixels, bool half, int compression)
+{
+    const Exr::Channel channel = {"Z", 0};
+    return Exr::Write(output, width, height, pixels, 1, &channel, 1, half, compression);
+}
+
+}
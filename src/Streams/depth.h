@@ -0,0 +1,40 @@
+#pragma once
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Helpers to decode 24-bit depth from color frames, and write it with full precision.
+ *
+ * The depth shaders can pack depth into the color channels as 0xRRGGBB, with one whole byte each.
+ * This decodes it back to 24 bits, for 16-bit grayscale PNGs and single-channel OpenEXR files.
+ *
+ * These have no D3D or game dependencies, so they can be built and exercised on their own.
+ */
+namespace Depth
+{
+    static constexpr uint32_t MAX_VALUE = 0xFFFFFF;
+
+    /// @brief Where the packed channels are within each pixel
+    struct PixelLayout
+    {
+        /// @brief Bytes per pixel. Layouts of 4 bytes with blue first (like `D3DFMT_A8R8G8B8`) are vectorized.
+        size_t stride;
+        /// @brief Byte offsets of red, green and blue
+        size_t offsets[3];
+    };
+
+    /// @brief Decode packed pixels to depth from 0 to 1
+    void UnpackFloat(const uint8_t* pixels, size_t num_pixels, const PixelLayout& layout, float* out);
+    /// @brief Decode packed pixels to the top 16 bits of depth, in big-endian like PNG expects
+    void UnpackU16BE(const uint8_t* pixels, size_t num_pixels, const PixelLayout& layout, uint16_t* out);
+
+    /**
+     * @brief Write a single-channel OpenEXR image, with a `Z` channel and ZIP compression. See @ref Exr::Write.
+     * @param pixels Tightly packed rows of depth
+     * @param half Store each value as a half-precision float, instead of a full float
+     * @param compression A zlib level between 0 and 9
+     * @return `false` if the output couldn't be written
+     */
+    bool WriteExr(std::ostream& output, uint32_t width, uint32_t height, const float* pixels, bool half, int compression = 6);
+}
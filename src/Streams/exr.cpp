@@ -0,0 +1,171 @@
+#include "exr.h"
+#include "hdr.h"
+#include <vector>
+#include <cstring>
+#include <miniz.h>
+
+namespace Exr
+{
+
+/// @brief Scanlines in each block of a ZIP-compressed EXR
+static constexpr uint32_t EXR_ZIP_LINES = 16;
+
+static void WriteU8(std::vector<uint8_t>* out, uint8_t value) {
+    out->push_back(value);
+}
+static void WriteU32(std::vector<uint8_t>* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i)
+        out->push_back((uint8_t)(value >> (i * 8)));
+}
+static void WriteU64(std::vector<uint8_t>* out, uint64_t value) {
+    for (int i = 0; i < 8; ++i)
+        out->push_back((uint8_t)(value >> (i * 8)));
+}
+static void WriteF32(std::vector<uint8_t>* out, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    WriteU32(out, bits);
+}
+static void WriteString(std::vector<uint8_t>* out, const char* str) {
+    out->insert(out->end(), str, str + strlen(str) + 1);
+}
+static void WriteAttribute(std::vector<uint8_t>* out, const char* name, const char* type, uint32_t size)
+{
+    WriteString(out, name);
+    WriteString(out, type);
+    WriteU32(out, size);
+}
+
+/// @brief Interleave and delta-encode bytes, as EXR's ZIP compression expects before deflating
+static void PredictExrBlock(const uint8_t* raw, size_t size, uint8_t* out)
+{
+    // Split the even and odd bytes, so the high and low bytes of each value are compressed together
+    uint8_t* first = out;
+    uint8_t* second = out + (size + 1) / 2;
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (i % 2 == 0)
+            *first++ = raw[i];
+        else
+            *second++ = raw[i];
+    }
+
+    uint8_t prev = out[0];
+    for (size_t i = 1; i < size; ++i)
+    {
+        uint8_t current = out[i];
+        out[i] = (uint8_t)(current - prev + 128);
+        prev = current;
+    }
+}
+
+bool Write(
+    std::ostream& output, uint32_t width, uint32_t height, const float* pixels, size_t pixel_stride,
+    const Channel* channels, size_t num_channels, bool half, int compression)
+{
+    constexpr uint32_t EXR_MAGIC = 20000630;
+    constexpr uint32_t EXR_VERSION = 2; // Single-part scanline image
+    constexpr uint32_t PIXEL_HALF = 1, PIXEL_FLOAT = 2;
+    constexpr uint8_t COMPRESSION_ZIP = 3;
+
+    std::vector<uint8_t> header;
+    WriteU32(&header, EXR_MAGIC);
+    WriteU32(&header, EXR_VERSION);
+
+    uint32_t chlist_size = 1;
+    for (size_t c = 0; c < num_channels; ++c)
+        chlist_size += (uint32_t)strlen(channels[c].name) + 1 + 16;
+    WriteAttribute(&header, "channels", "chlist", chlist_size);
+    for (size_t c = 0; c < num_channels; ++c)
+    {
+        WriteString(&header, channels[c].name);
+        WriteU32(&header, half ? PIXEL_HALF : PIXEL_FLOAT);
+        WriteU32(&header, 0); // pLinear and reserved bytes
+        WriteU32(&header, 1); // x sampling
+        WriteU32(&header, 1); // y sampling
+    }
+    WriteU8(&header, 0);
+    WriteAttribute(&header, "compression", "compression", 1);
+    WriteU8(&header, COMPRESSION_ZIP);
+    for (const char* window : {"dataWindow", "displayWindow"})
+    {
+        WriteAttribute(&header, window, "box2i", 16);
+        WriteU32(&header, 0);
+        WriteU32(&header, 0);
+        WriteU32(&header, width - 1);
+        WriteU32(&header, height - 1);
+    }
+    WriteAttribute(&header, "lineOrder", "lineOrder", 1);
+    WriteU8(&header, 0); // Increasing Y
+    WriteAttribute(&header, "pixelAspectRatio", "float", 4);
+    WriteF32(&header, 1);
+    WriteAttribute(&header, "screenWindowCenter", "v2f", 8);
+    WriteF32(&header, 0);
+    WriteF32(&header, 0);
+    WriteAttribute(&header, "screenWindowWidth", "float", 4);
+    WriteF32(&header, 1);
+    WriteU8(&header, 0); // End of header
+
+    const uint32_t num_blocks = (height + EXR_ZIP_LINES - 1) / EXR_ZIP_LINES;
+    const size_t value_size = half ? 2 : 4;
+    const size_t max_raw_size = (size_t)width * EXR_ZIP_LINES * num_channels * value_size;
+    std::vector<uint8_t> raw(max_raw_size);
+    // One channel of one scanline, gathered from the pixels
+    std::vector<float> line(width);
+    std::vector<uint8_t> predicted(max_raw_size);
+    std::vector<uint8_t> blocks;
+    std::vector<uint64_t> offsets(num_blocks);
+    uint64_t blocks_start = header.size() + num_blocks * sizeof(uint64_t);
+
+    for (uint32_t block = 0; block < num_blocks; ++block)
+    {
+        uint32_t y = block * EXR_ZIP_LINES;
+        uint32_t num_lines = height - y < EXR_ZIP_LINES ? height - y : EXR_ZIP_LINES;
+        size_t raw_size = (size_t)width * num_lines * num_channels * value_size;
+
+        // Each scanline holds every value of the first channel, then the next channel, and so on
+        uint8_t* dst = raw.data();
+        for (uint32_t line_y = y; line_y < y + num_lines; ++line_y)
+        {
+            const float* row = pixels + (size_t)line_y * width * pixel_stride;
+            for (size_t c = 0; c < num_channels; ++c)
+            {
+                for (uint32_t x = 0; x < width; ++x)
+                    line[x] = row[x * pixel_stride + channels[c].offset];
+                if (half)
+                    Hdr::FloatToHalf(line.data(), width, (uint16_t*)dst);
+                else
+                    memcpy(dst, line.data(), width * sizeof(float));
+                dst += width * value_size;
+            }
+        }
+
+        PredictExrBlock(raw.data(), raw_size, predicted.data());
+
+        mz_ulong compressed_size = mz_compressBound((mz_ulong)raw_size);
+        size_t block_start = blocks.size();
+        blocks.resize(block_start + 8 + compressed_size);
+        uint8_t* data = blocks.data() + block_start + 8;
+        if (mz_compress2(data, &compressed_size, predicted.data(), (mz_ulong)raw_size, compression) != MZ_OK)
+            return false;
+        if (compressed_size >= raw_size) // Readers take blocks that aren't smaller as uncompressed
+        {
+            memcpy(data, raw.data(), raw_size);
+            compressed_size = (mz_ulong)raw_size;
+        }
+        blocks.resize(block_start + 8 + compressed_size);
+
+        uint32_t block_header[2] = {y, (uint32_t)compressed_size};
+        memcpy(blocks.data() + block_start, block_header, sizeof(block_header));
+        offsets[block] = blocks_start + block_start;
+    }
+
+    for (uint64_t offset : offsets)
+        WriteU64(&header, offset);
+    output.write((const char*)header.data(), header.size());
+    output.write((const char*)blocks.data(), blocks.size());
+    return (bool)output;
+}
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief A minimal OpenEXR writer for scanline images with ZIP compression.
+ *
+ * These have no D3D or game dependencies, so they can be built and exercised on their own.
+ */
+namespace Exr
+{
+    struct Channel
+    {
+        /// @brief The channel's name, like `R` or `Z`
+        const char* name;
+        /// @brief Index of the channel's value within each pixel
+        size_t offset;
+    };
+
+    /**
+     * @brief Write an OpenEXR image.
+     * @param pixels Tightly packed rows of pixels, with `pixel_stride` floats in each
+     * @param channels The channels to write, sorted by name as OpenEXR requires (`A`, `B`, `G`, `R`)
+     * @param half Store each value as a half-precision float, instead of a full float
+     * @param compression A zlib level between 0 and 9
+     * @return `false` if the output couldn't be written
+     */
+    bool Write(
+        std::ostream& output, uint32_t width, uint32_t height, const float* pixels, size_t pixel_stride,
+        const Channel* channels, size_t num_channels, bool half, int compression = 6
+    );
+}
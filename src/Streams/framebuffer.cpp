@@ -0,0 +1,176 @@
+#include "framebuffer.h"
+#include <Helper/defer.h>
+#include <Helper/hash.h>
+#include "pixels.h"
+#include <cstring>
+#include <cassert>
+
+const Helper::D3DFORMAT_info& FrameBufferRgb::GetFormatInfo() const
+{
+    static constexpr Helper::D3DFORMAT_info info = {
+        3,          // stride
+        {8,8,8},    // bitdepth
+        3,          // num_channels
+        true,       // is_uniform_bitdepth
+        false,      // is_float
+        false,      // is_depth
+    };
+    return info;
+}
+
+const Helper::D3DFORMAT_info& FrameBufferRgba::GetFormatInfo() const
+{
+    static constexpr Helper::D3DFORMAT_info info = {
+        4,          // stride
+        {8,8,8,8},  // bitdepth
+        4,          // num_channels
+        true,       // is_uniform_bitdepth
+        false,      // is_float
+        false,      // is_depth
+    };
+    return info;
+}
+
+FrameBufferMem::FrameBufferMem(uint32_t width, uint32_t height, D3DFORMAT d3dformat)
+    : m_width(width), m_height(height), m_d3dformat(d3dformat)
+{
+    if (!Helper::GetD3DFormatInfo(m_d3dformat, &m_d3dformat_info))
+        assert(0 && "Invalid or unsupported D3DFORMAT");
+    m_data.resize(GetRowSize() * m_height);
+}
+
+uint64_t FrameBufferBase::Hash() const
+{
+    size_t pitch;
+    const uint8_t* pixels = LockRead(&pitch);
+    if (!pixels)
+        assert(0 && "Failed to lock frame buffer");
+    defer { UnlockRead(); };
+
+    uint64_t hash = 0;
+    size_t row_size = GetRowSize();
+    for (uint32_t y = 0; y < GetHeight(); ++y)
+        hash = Helper::HashBytes(pixels + y * pitch, row_size, hash);
+    return hash;
+}
+
+/**
+ * @brief Tonemap a row of float pixels to 8-bit RGBA
+ * @return `false` if the format isn't a supported float format
+ */
+static bool FloatRowToRgba8(D3DFORMAT format, const uint8_t* src, uint32_t width, Hdr::Tonemap tonemap, uint8_t* dst)
+{
+    switch (format)
+    {
+    case D3DFMT_A16B16G16R16F:
+    {
+        thread_local std::vector<float> linear;
+        linear.resize((size_t)width * 4);
+        Hdr::HalfToFloat((const uint16_t*)src, linear.size(), linear.data());
+        Hdr::LinearToRgba8(linear.data(), width, tonemap, dst);
+        return true;
+    }
+    case D3DFMT_A32B32G32R32F:
+        Hdr::LinearToRgba8((const float*)src, width, tonemap, dst);
+        return true;
+    default:
+        break;
+    }
+    return false;
+}
+
+FrameBufferRgb FrameBufferBase::ToRgb(Hdr::Tonemap tonemap) const
+{
+    FrameBufferRgb frame{GetWidth(), GetHeight()};
+    size_t pitch;
+    const uint8_t* pixels = LockRead(&pitch);
+    if (!pixels)
+        assert(0 && "Failed to lock frame buffer");
+    defer { UnlockRead(); };
+    
+    switch (GetFormat())
+    {
+    case Helper::D3DFMT_B8G8R8: BlitRgb(&frame, pixels, pitch); break;
+    case D3DFMT_R8G8B8: BlitBgr(&frame, pixels, pitch); break;
+    case D3DFMT_A8B8G8R8: BlitRgba(&frame, pixels, pitch); break;
+    case D3DFMT_A8R8G8B8: BlitBgra(&frame, pixels, pitch); break;
+    case D3DFMT_A16B16G16R16F:
+    case D3DFMT_A32B32G32R32F:
+    {
+        const uint32_t width = GetWidth();
+        thread_local std::vector<uint8_t> rgba;
+        rgba.resize((size_t)width * 4);
+        for (uint32_t y = 0; y < GetHeight(); ++y)
+        {
+            FloatRowToRgba8(GetFormat(), pixels + y * pitch, width, tonemap, rgba.data());
+            Pixels::RgbaToRgb(rgba.data(), width, frame.GetData() + (size_t)y * width * frame.GetPixelStride());
+        }
+        break;
+    }
+    default:
+        assert(0 && "Blitting is not implemented for this D3DFORMAT");
+    }
+
+    return frame;
+}
+
+FrameBufferRgba FrameBufferBase::ToRgba(Hdr::Tonemap tonemap) const
+{
+    FrameBufferRgba frame{GetWidth(), GetHeight()};
+    size_t pitch;
+    const uint8_t* pixels = LockRead(&pitch);
+    if (!pixels)
+        assert(0 && "Failed to lock frame buffer");
+    defer { UnlockRead(); };
+
+    const uint32_t width = GetWidth();
+    const size_t dst_row_size = frame.GetPixelStride() * width;
+    for (uint32_t y = 0; y < GetHeight(); ++y)
+    {
+        const uint8_t* src_row = pixels + y * pitch;
+        uint8_t* dst_row = frame.GetData() + y * dst_row_size;
+        switch (GetFormat())
+        {
+        case Helper::D3DFMT_B8G8R8: Pixels::RgbToRgba(src_row, width, dst_row); break;
+        case D3DFMT_R8G8B8: Pixels::BgrToRgba(src_row, width, dst_row); break;
+        case D3DFMT_A8B8G8R8: memcpy(dst_row, src_row, dst_row_size); break;
+        case D3DFMT_A8R8G8B8: Pixels::BgraToRgba(src_row, width, dst_row); break;
+        case D3DFMT_A16B16G16R16F:
+        case D3DFMT_A32B32G32R32F: FloatRowToRgba8(GetFormat(), src_row, width, tonemap, dst_row); break;
+        default:
+            assert(0 && "Blitting is not implemented for this D3DFORMAT");
+            return frame;
+        }
+    }
+    return frame;
+}
+
+void FrameBufferBase::BlitRgb(FrameBufferRgb* dst, const uint8_t* src, size_t pitch)
+{
+    uint32_t height = dst->GetHeight();
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        size_t row_size = dst->GetPixelStride() * dst->GetWidth();
+        uint8_t* dst_row = dst->GetData() + y * row_size;
+        const uint8_t* src_row = src + y * pitch;
+        memcpy(dst_row, src_row, row_size);
+    }
+}
+void FrameBufferBase::BlitBgr(FrameBufferRgb* dst, const uint8_t* src, size_t pitch)
+{
+    uint32_t width = dst->GetWidth(), height = dst->GetHeight();
+    for (uint32_t y = 0; y < height; ++y)
+        Pixels::BgrToRgb(src + y * pitch, width, dst->GetData() + (size_t)y * width * dst->GetPixelStride());
+}
+void FrameBufferBase::BlitRgba(FrameBufferRgb* dst, const uint8_t* src, size_t pitch)
+{
+    uint32_t width = dst->GetWidth(), height = dst->GetHeight();
+    for (uint32_t y = 0; y < height; ++y)
+        Pixels::RgbaToRgb(src + y * pitch, width, dst->GetData() + (size_t)y * width * dst->GetPixelStride());
+}
+void FrameBufferBase::BlitBgra(FrameBufferRgb* dst, const uint8_t* src, size_t pitch)
+{
+    uint32_t width = dst->GetWidth(), height = dst->GetHeight();
+    for (uint32_t y = 0; y < height; ++y)
+        Pixels::BgraToRgb(src + y * pitch, width, dst->GetData() + (size_t)y * width * dst->GetPixelStride());
+}
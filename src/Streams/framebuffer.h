@@ -0,0 +1,149 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <Helper/d3dformat.h>
+#include "hdr.h"
+
+class FrameBufferRgb;
+class FrameBufferRgba;
+
+/**
+ * @brief Pixels of a captured frame, to be read by a @ref VideoWriter.
+ * @details The buffers here have no D3D or game dependencies. @ref FrameBufferDx9 wraps a D3D surface.
+ */
+class FrameBufferBase
+{
+public:
+    virtual ~FrameBufferBase() {}
+    virtual uint32_t GetWidth() const = 0;
+    virtual uint32_t GetHeight() const = 0;
+    virtual D3DFORMAT GetFormat() const = 0;
+    virtual const Helper::D3DFORMAT_info& GetFormatInfo() const = 0;
+    /**
+     * @brief Map the pixels for reading. Call @ref UnlockRead when finished.
+     * @param pitch Receives the number of bytes from the start of one row to the next
+     * @return The first row of pixels, or `nullptr` on failure
+     */
+    virtual const uint8_t* LockRead(size_t* pitch) const = 0;
+    virtual void UnlockRead() const = 0;
+
+    /// @brief The number of bytes between each pixel
+    uint8_t GetPixelStride() const { return GetFormatInfo().stride; }
+    /// @brief The number of bytes in a row of visible pixels, not including padding
+    size_t GetRowSize() const { return (size_t)GetPixelStride() * GetWidth(); }
+    /**
+     * @brief Convert to a 24-bit RGB buffer
+     * @param tonemap How float formats are brought into 8-bit sRGB
+     */
+    FrameBufferRgb ToRgb(Hdr::Tonemap tonemap = Hdr::Tonemap::CLAMP) const;
+    /**
+     * @brief Convert to a 32-bit RGBA buffer. Formats without alpha become opaque.
+     * @param tonemap How float formats are brought into 8-bit sRGB
+     */
+    FrameBufferRgba ToRgba(Hdr::Tonemap tonemap = Hdr::Tonemap::CLAMP) const;
+    /// @brief Hash the visible pixels, ignoring any padding between rows
+    uint64_t Hash() const;
+
+private:
+    static void BlitRgb(FrameBufferRgb* dst, const uint8_t* src, size_t pitch);
+    static void BlitBgr(FrameBufferRgb* dst, const uint8_t* src, size_t pitch);
+    static void BlitRgba(FrameBufferRgb* dst, const uint8_t* src, size_t pitch);
+    static void BlitBgra(FrameBufferRgb* dst, const uint8_t* src, size_t pitch);
+};
+
+/**
+ * @brief Wrap a read/writeable 24-bit RGB buffer
+ */
+class FrameBufferRgb : public FrameBufferBase
+{
+public:
+    FrameBufferRgb(uint32_t width, uint32_t height)
+        : m_width(width), m_height(height), m_data((uint8_t*)malloc(width * height * 3)) {}
+    ~FrameBufferRgb() { free(m_data); }
+    FrameBufferRgb(FrameBufferRgb&& other) : m_width(other.m_width), m_height(other.m_height), m_data(other.m_data) {
+        other.m_data = nullptr;
+    }
+
+    uint32_t GetWidth() const override { return m_width; }
+    uint32_t GetHeight() const override { return m_height; }
+    D3DFORMAT GetFormat() const override { return Helper::D3DFMT_B8G8R8; }
+    const Helper::D3DFORMAT_info& GetFormatInfo() const;
+    uint8_t* GetData() { return m_data; }
+    const uint8_t* GetData() const { return m_data; }
+    size_t GetDataLength() const { return m_width * m_height * GetPixelStride(); }
+    size_t GetPixelStride() const { return 3; }
+    const uint8_t* LockRead(size_t* pitch) const override {
+        *pitch = m_width * GetPixelStride();
+        return m_data;
+    }
+    void UnlockRead() const override {}
+
+private:
+    uint32_t m_width;
+    uint32_t m_height;
+    uint8_t* m_data;
+};
+
+/**
+ * @brief Wrap a read/writeable 32-bit RGBA buffer
+ */
+class FrameBufferRgba : public FrameBufferBase
+{
+public:
+    FrameBufferRgba(uint32_t width, uint32_t height)
+        : m_width(width), m_height(height), m_data((uint8_t*)malloc((size_t)width * height * 4)) {}
+    ~FrameBufferRgba() { free(m_data); }
+    FrameBufferRgba(FrameBufferRgba&& other) : m_width(other.m_width), m_height(other.m_height), m_data(other.m_data) {
+        other.m_data = nullptr;
+    }
+
+    uint32_t GetWidth() const override { return m_width; }
+    uint32_t GetHeight() const override { return m_height; }
+    /// @brief Red is first in memory
+    D3DFORMAT GetFormat() const override { return D3DFMT_A8B8G8R8; }
+    const Helper::D3DFORMAT_info& GetFormatInfo() const;
+    uint8_t* GetData() { return m_data; }
+    const uint8_t* GetData() const { return m_data; }
+    size_t GetDataLength() const { return (size_t)m_width * m_height * GetPixelStride(); }
+    size_t GetPixelStride() const { return 4; }
+    const uint8_t* LockRead(size_t* pitch) const override {
+        *pitch = m_width * GetPixelStride();
+        return m_data;
+    }
+    void UnlockRead() const override {}
+
+private:
+    uint32_t m_width;
+    uint32_t m_height;
+    uint8_t* m_data;
+};
+
+/**
+ * @brief Wrap a read/writeable buffer in system memory, with tightly packed rows of any format
+ */
+class FrameBufferMem : public FrameBufferBase
+{
+public:
+    FrameBufferMem(uint32_t width, uint32_t height, D3DFORMAT d3dformat);
+
+    uint32_t GetWidth() const override { return m_width; }
+    uint32_t GetHeight() const override { return m_height; }
+    D3DFORMAT GetFormat() const override { return m_d3dformat; }
+    const Helper::D3DFORMAT_info& GetFormatInfo() const override { return m_d3dformat_info; }
+    uint8_t* GetData() { return m_data.data(); }
+    const uint8_t* GetData() const { return m_data.data(); }
+    size_t GetDataLength() const { return m_data.size(); }
+    const uint8_t* LockRead(size_t* pitch) const override {
+        *pitch = GetRowSize();
+        return m_data.data();
+    }
+    void UnlockRead() const override {}
+
+private:
+    uint32_t m_width;
+    uint32_t m_height;
+    D3DFORMAT m_d3dformat;
+    Helper::D3DFORMAT_info m_d3dformat_info = {0};
+    std::vector<uint8_t> m_data;
+};
@@ -0,0 +1,658 @@
+#include "framepool.h"
+#include "videolog.h"
+#include <Helper/str.h>
+#include <algorithm>
+#include <optional>
+#include <cassert>
+
+FramePool::FramePool(
+    ReadbackDevice::Ptr device, size_t num_threads, size_t num_frames,
+    uint32_t frame_width, uint32_t frame_height, D3DFORMAT frame_format
+) : m_device(std::move(device)), m_frame_width(frame_width), m_frame_height(frame_height), m_frame_format(frame_format) {
+    assert(num_frames > 0 && "Frame pool must contain at least 1 frame");
+
+    m_threads.reserve(num_threads);
+    m_all.reserve(num_frames);
+    m_full.reserve(num_frames);
+    m_empty.reserve(num_frames);
+
+    // Fill the empty-frame pool with empty frames
+    for (size_t i = 0; i < num_frames; ++i)
+    {
+        m_all.push_back(CreateFrame());
+        m_empty.push_back(m_all.back());
+    }
+
+    // Create worker threads (without running them yet)
+    for (size_t i = 0; i < num_threads; ++i)
+        m_threads.emplace_back(&WorkerLoop, this);
+}
+
+FramePool::FramePtr FramePool::CreateFrame() const
+{
+    return std::make_shared<Frame>(
+        m_device->CreateBuffer(m_frame_width, m_frame_height, m_frame_format),
+        m_device->CreateFence()
+    );
+}
+
+void FramePool::Close()
+{
+    std::scoped_lock closing_lock{m_close_mutex};
+    if (IsClosed())
+        return;
+    
+    {
+        std::scoped_lock lock{m_mutex};
+        m_all.clear();
+        m_empty.clear();
+        m_sync_writers.clear();
+        m_writer_pending.clear();
+    }
+    m_cv_empty.notify_all();
+    m_cv_full.notify_all();
+    m_cv_idle.notify_all();
+    
+    for (auto& thread : m_threads)
+        thread.join();
+    m_threads.clear();
+    {
+        // The game thread may still be storing a borrowed frame in the backlog
+        std::unique_lock lock{m_mutex};
+        m_cv_idle.wait(lock, [this] { return m_num_jobs == 0; });
+        m_writer_timings.clear();
+    }
+    m_full.clear();
+    m_backlog = nullptr;
+}
+
+void FramePool::Finish()
+{
+    EndCapture();
+    {
+        std::unique_lock lock{m_mutex};
+        size_t num_remaining = m_full.size() + (m_backlog ? m_backlog->GetEntries().size() : 0);
+        if (num_remaining > 0)
+            VideoLog::Append(Helper::sprintf("Writing %zu remaining frames...\n", num_remaining));
+
+        m_cv_idle.wait(lock, [this] { return IsClosed() || GetNumPendingLocked() == 0; });
+        if (m_backlog)
+            VideoLog::Append(m_backlog->GetStats());
+        if (m_num_burst_overflows > 0)
+            VideoLog::Append(Helper::sprintf("Burst arena was full, so %zu frames were encoded while recording\n", m_num_burst_overflows));
+        if (m_stall_stats.num_stalls > 0)
+        {
+            VideoLog::Append(Helper::sprintf(
+                "The game stalled over budget %zu times (borrowed %zu frames, degraded %zu writers, dropped %zu frames)\n",
+                m_stall_stats.num_stalls, m_stall_stats.num_borrowed, m_stall_stats.num_degraded, m_stall_stats.num_dropped
+            ));
+        }
+    }
+    Close();
+}
+
+size_t FramePool::GetNumFrames()
+{
+    std::scoped_lock lock{m_mutex};
+    return m_all.size();
+}
+
+size_t FramePool::GetNumPending()
+{
+    std::scoped_lock lock{m_mutex};
+    return IsClosed() ? 0 : GetNumPendingLocked();
+}
+
+size_t FramePool::GetNumPending(const VideoWriter* writer)
+{
+    std::scoped_lock lock{m_mutex};
+    if (IsClosed())
+        return 0;
+    auto it = m_writer_pending.find(writer);
+    return it != m_writer_pending.end() ? it->second : 0;
+}
+
+size_t FramePool::GetNumPendingLocked() const
+{
+    size_t num_backlogged = m_backlog ? m_backlog->GetEntries().size() : 0;
+    return m_full.size() + num_backlogged + m_num_jobs;
+}
+
+void FramePool::SetBacklog(size_t budget)
+{
+    std::scoped_lock lock{m_mutex};
+    m_backlog = std::make_unique<FrameBacklog>(budget);
+}
+
+bool FramePool::SetBacklogSpill(std::filesystem::path path, uint64_t budget)
+{
+    std::scoped_lock lock{m_mutex};
+    assert(m_backlog && "Call SetBacklog first");
+    return m_backlog->SetSpillFile(std::move(path), budget);
+}
+
+bool FramePool::SetBurst(size_t budget, bool large_pages)
+{
+    std::scoped_lock lock{m_mutex};
+    if (!m_backlog) // Without a RAM budget, only the arena is used
+        m_backlog = std::make_unique<FrameBacklog>(0);
+
+    size_t slot_size = m_all.front()->buffer->GetRowSize() * m_frame_height;
+    size_t num_slots = budget / slot_size;
+    if (num_slots == 0)
+    {
+        VideoLog::AppendError("The burst budget is too small for a single frame\n");
+        return false;
+    }
+    if (!m_backlog->SetArena(slot_size, num_slots, large_pages))
+        return false;
+    m_burst = true;
+    return true;
+}
+
+void FramePool::EndCapture()
+{
+    {
+        std::scoped_lock lock{m_mutex};
+        RestoreWriters();
+        if (!m_burst)
+            return;
+        m_burst = false;
+    }
+    m_cv_full.notify_all();
+}
+
+void FramePool::SetStallPolicy(StallPolicy policy, std::chrono::microseconds budget)
+{
+    std::scoped_lock lock{m_mutex};
+    m_stall_policy = policy;
+    m_stall_budget = budget;
+}
+
+FramePool::StallStats FramePool::GetStallStats()
+{
+    std::scoped_lock lock{m_mutex};
+    return m_stall_stats;
+}
+
+void FramePool::PushFullFrame(const FramePtr& frame, size_t index, const std::shared_ptr<VideoWriter>& writer)
+{
+    if (IsClosed())
+        return;
+
+    assert(writer != nullptr && "A writer must be provided to write the frame");
+    assert(frame->buffer->GetWidth() * frame->buffer->GetHeight() != 0 && "Frame buffer must have non-zero size. Resize the buffer before use.");
+
+    frame->writer = writer;
+    frame->index = index;
+    frame->sequence = 0;
+    frame->fence->Issue();
+
+    {
+        std::scoped_lock lock{m_mutex};
+        assert(m_full.size() < m_all.size() && "More frames are being pushed than exists in the pool");
+        if (!writer->IsAsync())
+            frame->sequence = m_sync_writers[writer.get()].next_push++;
+        m_writer_pending[writer.get()] += 1;
+        m_full.push_back(frame);
+    }
+    m_cv_full.notify_one();
+}
+
+bool FramePool::PopJob(Job* job)
+{
+    {
+        std::unique_lock lock{m_mutex};
+        bool found = false;
+        m_cv_full.wait(lock, [this, job, &found]
+        {
+            if (IsClosed())
+                return true; // The pool was closed. Stop waiting.
+            found = FindJob(job);
+            return found;
+        });
+        if (!found)
+            return false;
+        m_num_jobs += 1;
+    }
+    m_cv_full.notify_one();
+    return true;
+}
+
+bool FramePool::FindJob(Job* job)
+{
+    size_t ready_index = ~(size_t)0;
+    for (size_t i = 0; i < m_full.size(); ++i)
+    {
+        if (IsWriterReady(m_full[i]->writer.get(), m_full[i]->sequence))
+        {
+            ready_index = i;
+            break;
+        }
+    }
+
+    // Storing is much faster than encoding, so it returns frames to the game sooner.
+    // Store when the game has no empty frames left, when no full frame can be encoded yet, or during burst capture.
+    // The newest frame is stored, since it would wait the longest for an encoder.
+    if (m_backlog && !m_full.empty() && (m_burst || m_empty.empty() || ready_index == ~(size_t)0))
+    {
+        const FramePtr& newest = m_full.back();
+        size_t raw_size = newest->buffer->GetRowSize() * newest->buffer->GetHeight();
+        job->entry = {};
+        if (m_backlog->TryReserve(raw_size, &job->entry))
+        {
+            job->type = Job::STORE;
+            job->frame = std::move(m_full.back());
+            job->entry.index = job->frame->index;
+            job->entry.sequence = job->frame->sequence;
+            job->entry.writer = job->frame->writer;
+            job->reserved = raw_size;
+            m_full.pop_back();
+            return true;
+        }
+    }
+
+    // During burst capture, frames are only encoded if the game is waiting on frames that couldn't be stored
+    if (m_burst && m_full.empty())
+        return false;
+
+    if (ready_index != ~(size_t)0)
+    {
+        job->type = Job::ENCODE;
+        job->frame = std::move(m_full[ready_index]);
+        m_num_burst_overflows += m_burst;
+        m_full.erase(m_full.begin() + ready_index);
+        if (!job->frame->writer->IsAsync()) // List the writer as currently in use
+            m_sync_writers[job->frame->writer.get()].in_use = true;
+        return true;
+    }
+
+    if (!m_backlog)
+        return false;
+
+    const auto& entries = m_backlog->GetEntries();
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (IsWriterReady(entries[i].writer.get(), entries[i].sequence))
+        {
+            job->type = Job::RESTORE;
+            job->frame = nullptr;
+            job->entry = m_backlog->Take(i);
+            m_num_burst_overflows += m_burst;
+            if (!job->entry.writer->IsAsync())
+                m_sync_writers[job->entry.writer.get()].in_use = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void FramePool::ReleasePending(const VideoWriter* writer)
+{
+    auto pending = m_writer_pending.find(writer);
+    if (pending == m_writer_pending.end() || --pending->second != 0)
+        return;
+
+    // Both sequence counters are equal now, so a new writer at the same address starts fresh
+    m_writer_pending.erase(pending);
+    m_sync_writers.erase(writer);
+    auto timing = m_writer_timings.find(writer);
+    if (timing != m_writer_timings.end())
+    {
+        if (timing->second.degraded)
+            timing->second.writer->SetDegraded(false);
+        m_writer_timings.erase(timing);
+    }
+}
+
+bool FramePool::IsWriterReady(const VideoWriter* writer, size_t sequence) const
+{
+    if (writer->IsAsync())
+        return true;
+    auto it = m_sync_writers.find(writer);
+    return it != m_sync_writers.end() && !it->second.in_use && it->second.next_write == sequence;
+}
+
+void FramePool::AdvanceWriter(WriterState& state)
+{
+    state.next_write += 1;
+    for (auto lost = state.lost.begin(); lost != state.lost.end();)
+    {
+        if (*lost == state.next_write)
+        {
+            state.next_write += 1;
+            state.lost.erase(lost);
+            lost = state.lost.begin(); // The lost sequences aren't sorted
+        }
+        else
+            ++lost;
+    }
+}
+
+void FramePool::FinishJob(Job&& job, bool result)
+{
+    {
+        std::scoped_lock lock{m_mutex};
+        m_num_jobs -= 1;
+        if (IsClosed())
+            return;
+
+        if (job.type == Job::STORE)
+        {
+            if (result)
+                m_backlog->Push(std::move(job.entry), job.reserved);
+            else
+            {
+                // The frame is lost, so it's no longer pending, and its writer must not wait for it
+                m_backlog->Unreserve(job.entry, job.reserved);
+                auto it = m_sync_writers.find(job.frame->writer.get());
+                if (it != m_sync_writers.end())
+                {
+                    if (it->second.next_write == job.frame->sequence)
+                        AdvanceWriter(it->second);
+                    else
+                        it->second.lost.push_back(job.frame->sequence);
+                }
+                ReleasePending(job.frame->writer.get());
+            }
+        }
+        else
+        {
+            if (job.type == Job::RESTORE)
+                m_backlog->Release(job.entry);
+            const auto& writer = job.frame ? job.frame->writer : job.entry.writer;
+            if (m_stall_policy == StallPolicy::DEGRADE && result)
+            {
+                WriterTiming& timing = m_writer_timings[writer.get()];
+                float write_ms = std::chrono::duration<float, std::milli>(job.write_time).count();
+                timing.avg_ms = timing.writer ? timing.avg_ms * 0.9f + write_ms * 0.1f : write_ms;
+                timing.writer = writer;
+            }
+            auto it = m_sync_writers.find(writer.get());
+            if (it != m_sync_writers.end())
+            {
+                it->second.in_use = false;
+                AdvanceWriter(it->second);
+            }
+
+            ReleasePending(writer.get());
+        }
+
+        if (job.frame)
+        {
+            assert(m_empty.size() < m_all.size() && "More frames are being pushed than exists in the pool");
+            job.frame->writer = nullptr;
+            m_empty.emplace_back(std::move(job.frame));
+        }
+    }
+    m_cv_empty.notify_one();
+    m_cv_full.notify_one();
+    m_cv_idle.notify_all();
+}
+
+FramePool::FramePtr FramePool::PopEmptyFrame()
+{
+    FramePtr back;
+    {
+        auto wait_start = std::chrono::steady_clock::now();
+        std::unique_lock lock{m_mutex};
+        auto is_ready = [this]{ return IsClosed() || !m_empty.empty(); };
+        bool stalled = m_stall_policy != StallPolicy::BLOCK && !m_cv_empty.wait_for(lock, m_stall_budget, is_ready);
+        if (stalled)
+        {
+            m_stall_stats.num_stalls += 1;
+            m_pops_since_stall = 0;
+            if (!HandleStall(lock, &back))
+            {
+                m_wait_time += std::chrono::steady_clock::now() - wait_start;
+                m_num_pops += 1;
+                return nullptr;
+            }
+        }
+
+        if (!back)
+        {
+            m_cv_empty.wait(lock, is_ready);
+            if (IsClosed())
+                return nullptr;
+            back = std::move(m_empty.front());
+            m_empty.erase(m_empty.begin());
+        }
+
+        m_wait_time += std::chrono::steady_clock::now() - wait_start;
+        m_num_pops += 1;
+        m_min_empty = m_empty.size() < m_min_empty ? m_empty.size() : m_min_empty;
+        if (!stalled && ++m_pops_since_stall == DEGRADE_RESTORE_POPS)
+            RestoreWriters();
+    }
+    m_cv_empty.notify_one();
+    return back;
+}
+
+bool FramePool::HandleStall(std::unique_lock<std::mutex>& lock, FramePtr* frame)
+{
+    switch (m_stall_policy)
+    {
+    case StallPolicy::BLOCK:
+        break;
+    case StallPolicy::BORROW:
+        *frame = BorrowFrame(lock);
+        break;
+    case StallPolicy::DEGRADE:
+        DegradeSlowestWriter();
+        break;
+    case StallPolicy::DROP:
+        m_stall_stats.num_dropped += 1;
+        return false;
+    }
+    return true;
+}
+
+FramePool::FramePtr FramePool::BorrowFrame(std::unique_lock<std::mutex>& lock)
+{
+    if (!m_backlog || m_full.empty())
+        return nullptr;
+
+    // The oldest frame is the most likely to be finished on the GPU
+    const FramePtr& oldest = m_full.front();
+    size_t raw_size = oldest->buffer->GetRowSize() * oldest->buffer->GetHeight();
+    FrameBacklog::Entry entry;
+    if (!m_backlog->TryReserve(raw_size, &entry))
+        return nullptr;
+
+    FramePtr frame = std::move(m_full.front());
+    m_full.erase(m_full.begin());
+    entry.index = frame->index;
+    entry.sequence = frame->sequence;
+    entry.writer = frame->writer;
+    m_num_jobs += 1;
+
+    lock.unlock();
+    frame->fence->Wait();
+    bool result = m_backlog->Store(*frame->buffer, &entry);
+    lock.lock();
+
+    m_num_jobs -= 1;
+    m_cv_idle.notify_all();
+    if (IsClosed())
+        return nullptr;
+
+    if (!result)
+    {
+        // Leave the frame for the encoders instead
+        m_backlog->Unreserve(entry, raw_size);
+        m_full.insert(m_full.begin(), std::move(frame));
+        return nullptr;
+    }
+
+    m_backlog->Push(std::move(entry), raw_size);
+    m_stall_stats.num_borrowed += 1;
+    frame->writer = nullptr;
+    m_cv_full.notify_one(); // A worker may be able to restore the entry
+    return frame;
+}
+
+void FramePool::DegradeSlowestWriter()
+{
+    WriterTiming* slowest = nullptr;
+    for (auto& [ptr, timing] : m_writer_timings)
+    {
+        if (!timing.degraded && (!slowest || timing.avg_ms > slowest->avg_ms))
+            slowest = &timing;
+    }
+    if (!slowest)
+        return;
+
+    slowest->degraded = true;
+    if (slowest->writer->SetDegraded(true))
+    {
+        m_stall_stats.num_degraded += 1;
+        VideoLog::Append(Helper::sprintf("Degraded a writer that took %.1f ms per frame\n", slowest->avg_ms));
+    }
+}
+
+void FramePool::RestoreWriters()
+{
+    for (auto& [ptr, timing] : m_writer_timings)
+    {
+        if (timing.degraded)
+        {
+            timing.writer->SetDegraded(false);
+            timing.degraded = false;
+        }
+    }
+}
+
+void FramePool::SetAdaptiveLimits(size_t min_frames, size_t max_frames)
+{
+    assert(min_frames > 0 && min_frames <= max_frames && "Invalid frame pool limits");
+    m_min_frames = min_frames;
+    m_max_frames = max_frames;
+}
+
+void FramePool::Adapt()
+{
+    if (m_max_frames == 0 || IsClosed())
+        return;
+    if (++m_adapt_calls < ADAPT_INTERVAL)
+        return;
+    m_adapt_calls = 0;
+
+    std::chrono::nanoseconds wait_time;
+    size_t num_pops, min_empty, num_frames;
+    {
+        std::scoped_lock lock{m_mutex};
+        wait_time = m_wait_time;
+        num_pops = m_num_pops;
+        min_empty = m_min_empty;
+        num_frames = m_all.size();
+        m_wait_time = {};
+        m_num_pops = 0;
+        m_min_empty = ~(size_t)0;
+    }
+    if (num_pops == 0)
+        return;
+
+    auto avg_wait = wait_time / num_pops;
+    float avg_wait_ms = std::chrono::duration<float, std::milli>(avg_wait).count();
+
+    if (avg_wait > ADAPT_MAX_WAIT && num_frames < m_max_frames)
+    {
+        // The encoders are behind. Grow by a quarter, so large pools catch up quickly.
+        size_t num_new = num_frames / 4 > 1 ? num_frames / 4 : 1;
+        num_new = num_new < m_max_frames - num_frames ? num_new : m_max_frames - num_frames;
+        std::vector<FramePtr> new_frames;
+        for (size_t i = 0; i < num_new; ++i)
+            new_frames.push_back(CreateFrame());
+        
+        {
+            std::scoped_lock lock{m_mutex};
+            if (IsClosed())
+                return;
+            for (FramePtr& frame : new_frames)
+            {
+                m_all.push_back(frame);
+                m_empty.push_back(std::move(frame));
+            }
+        }
+        m_cv_empty.notify_all();
+        VideoLog::Append(Helper::sprintf(
+            "Frame pool grew from %zu to %zu frames (waited %.2f ms per frame)\n", num_frames, num_frames + num_new, avg_wait_ms
+        ));
+    }
+    else if (avg_wait <= ADAPT_MAX_WAIT && min_empty >= 2 && num_frames > m_min_frames)
+    {
+        // At least one frame was never used. Free one at a time, in case the load is bursty.
+        std::scoped_lock lock{m_mutex};
+        if (IsClosed() || m_empty.empty())
+            return;
+        FramePtr unused = std::move(m_empty.back());
+        m_empty.pop_back();
+        m_all.erase(std::find(m_all.begin(), m_all.end(), unused));
+        VideoLog::Append(Helper::sprintf(
+            "Frame pool shrank from %zu to %zu frames (%zu frames were unused)\n", num_frames, num_frames - 1, min_empty
+        ));
+    }
+}
+
+void FramePool::WorkerLoop(FramePool* pool)
+{
+    Job job;
+    // Reused by every backlog entry this thread restores
+    std::optional<FrameBufferMem> mem_buffer;
+    while (pool->PopJob(&job))
+    {
+        bool result = false;
+        // Logged with the frame's index if the job fails
+        const char* error = nullptr;
+        size_t index = job.frame ? job.frame->index : job.entry.index;
+        switch (job.type)
+        {
+        case Job::ENCODE:
+        {
+            // Wait for the GPU without holding the device's lock, which would stall the game thread
+            job.frame->fence->Wait();
+            auto write_start = std::chrono::steady_clock::now();
+            result = job.frame->writer->WriteFrame(*job.frame->buffer, job.frame->index);
+            job.write_time = std::chrono::steady_clock::now() - write_start;
+            error = "Failed to write frame %zu. The FramePool will close.\n";
+            break;
+        }
+        case Job::STORE:
+            job.frame->fence->Wait();
+            // The backlog isn't destroyed until the threads are joined, so it can be used without the lock
+            result = pool->m_backlog->Store(*job.frame->buffer, &job.entry);
+            error = "Failed to store frame %zu in the backlog. The FramePool will close.\n";
+            break;
+        case Job::RESTORE:
+        {
+            const FrameBacklog::Entry& entry = job.entry;
+            if (!mem_buffer || mem_buffer->GetWidth() != entry.width || mem_buffer->GetHeight() != entry.height
+                || mem_buffer->GetFormat() != entry.format)
+            {
+                mem_buffer.emplace(entry.width, entry.height, entry.format);
+            }
+            auto write_start = std::chrono::steady_clock::now();
+            if (!pool->m_backlog->Restore(&job.entry, &*mem_buffer))
+            {
+                error = "Failed to restore frame %zu from the backlog. The FramePool will close.\n";
+                break;
+            }
+            result = entry.writer->WriteFrame(*mem_buffer, entry.index);
+            job.write_time = std::chrono::steady_clock::now() - write_start;
+            error = "Failed to write frame %zu. The FramePool will close.\n";
+            break;
+        }
+        }
+
+        pool->FinishJob(std::move(job), result);
+        if (!result)
+        {
+            VideoLog::AppendError(error, index);
+            // We can't call Close from within a worker thread, or it would have to wait on itself.
+            // A new thread is spanwed to do this.
+            std::thread([](FramePool* pool) { pool->Close(); }, pool).detach();
+            return;
+        }
+    }
+}
@@ -0,0 +1,345 @@
+#pragma once
+#include <filesystem>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include "framebuffer.h"
+#include "readback.h"
+#include "backlog.h"
+
+/**
+ * @brief Implements a video encoder for @ref FramePool to write frames (as video or image sequence).
+ * 
+ * Each instance corresponds to one video file or one image sequence.
+ */
+class VideoWriter
+{
+public:
+    virtual ~VideoWriter() {}
+    /**
+     * @brief Write the frame buffer. Blocking.
+     * @param frame_index Index of the frame being written.
+     * @return `false` on failure
+     */
+    virtual bool WriteFrame(const FrameBufferBase& buffer, size_t frame_index) = 0;
+    /**
+     * @brief Whether this instance supports async and unordered writes.
+     * @details When false, the FramePool will ensure that writes are ordered and synchronous.
+     */
+    virtual bool IsAsync() const = 0;
+    /**
+     * @brief Trade file size for speed, while the game is waiting on this writer. Thread-safe.
+     * @return `false` if the writer has no faster mode
+     */
+    virtual bool SetDegraded(bool degraded) { return false; }
+};
+
+/**
+ * @brief A worker pool that writes video frames.
+ * 
+ * Call @ref PopEmptyFrame to get an empty frame buffer.
+ * Fill the buffer with data and call @ref PushFullFrame to have a worker encode it.
+ * 
+ * With @ref SetBacklog, workers may compress full frames into a @ref FrameBacklog instead of encoding them,
+ * which returns the frame buffers to the game sooner when the encoders fall behind.
+ * 
+ * Frame buffers and fences come from a @ref ReadbackDevice, so the pool itself doesn't depend on D3D.
+ * 
+ * Threads are spawned in the constructor and do not stop until either the destructor or the @ref Close function is called.
+ */
+class FramePool
+{
+public:
+    /**
+     * @brief A frame from the pool.
+     * 
+     * The user must fill `buffer` with the desired contents and send it back to the pool using @ref PushFullFrame.
+     * 
+     * The worker threads must wait on `fence`, then encode or store `buffer` in the backlog,
+     * and send it back to the pool using @ref FinishJob.
+     */
+    struct Frame
+    {
+        Frame(std::unique_ptr<FrameBufferBase> buffer, ReadbackFence::Ptr fence)
+            : buffer(std::move(buffer)), fence(std::move(fence)) {}
+        /// @brief Created by the pool's @ref ReadbackDevice
+        std::unique_ptr<FrameBufferBase> buffer;
+        /// @brief Completes when the GPU has finished filling `buffer`
+        ReadbackFence::Ptr fence;
+        size_t index;
+        /// @brief Order of the frame within its writer, assigned by @ref PushFullFrame
+        size_t sequence;
+        std::shared_ptr<VideoWriter> writer;
+    };
+    using FramePtr = std::shared_ptr<Frame>;
+
+    /// @brief What @ref PopEmptyFrame does when no empty frame arrives within the stall budget
+    enum class StallPolicy
+    {
+        /// @brief Keep waiting, however long it takes
+        BLOCK,
+        /// @brief Store the oldest full frame in the backlog on the calling thread, and reuse it
+        BORROW,
+        /// @brief Degrade the slowest writer until the stalls stop, and keep waiting
+        DEGRADE,
+        /// @brief Give up, so the caller drops the frame
+        DROP,
+    };
+
+    /// @brief How often each stall policy acted, since the pool was created
+    struct StallStats
+    {
+        /// @brief Pops that waited longer than the stall budget
+        size_t num_stalls = 0;
+        size_t num_borrowed = 0;
+        size_t num_degraded = 0;
+        size_t num_dropped = 0;
+    };
+
+    /**
+     * @brief Initialize the frame pool and spawn threads.
+     * @param device Creates the frame buffers and their fences
+     * @param num_threads Number of worker threads to spawn.
+     * @param num_frames Number of frame buffers in the pool.
+     * @param frame_format Format of the frame buffers. Float formats capture HDR render targets.
+     */
+    FramePool(
+        ReadbackDevice::Ptr device, size_t num_threads, size_t num_frames,
+        uint32_t frame_width, uint32_t frame_height, D3DFORMAT frame_format = D3DFMT_A8R8G8B8
+    );
+    ~FramePool() { Close(); }
+
+    /// @brief Stop accepting new work, wait for all threads to end, and drain the pool.
+    /// @details Do not call this from within the pool's own worker thread(s).
+    void Close();
+    /**
+     * @brief Wait for every pushed frame to be written, including the backlog, then @ref Close.
+     * @details Only call this from the game thread, after the last @ref PushFullFrame.
+     * This ends burst capture, if it hasn't ended yet.
+     */
+    void Finish();
+    /// @brief The number of pushed frames that aren't written yet, including the backlog. 0 if the pool is closed.
+    size_t GetNumPending();
+    /// @brief The number of pushed frames that aren't written yet, for one writer. 0 if the pool is closed.
+    size_t GetNumPending(const VideoWriter* writer);
+    bool IsClosed() const { return m_all.empty(); }
+    /// @brief The number of frame buffers in the pool, which @ref Adapt may change. 0 if the pool is closed.
+    size_t GetNumFrames();
+    uint32_t GetFrameWidth() const { return m_frame_width; }
+    uint32_t GetFrameHeight() const { return m_frame_height; }
+    D3DFORMAT GetFrameFormat() const { return m_frame_format; }
+    /**
+     * @brief Block until an empty frame can be popped, or work has finished.
+     * @details Fill this frame and pass it to @ref PushFullFrame.
+     * The wait may be cut short by the stall policy. See @ref SetStallPolicy.
+     * @return `nullptr` if the pool is closed, no longer accepting work,
+     * or if the stall policy dropped the frame. Use @ref IsClosed to tell them apart.
+     */
+    FramePtr PopEmptyFrame();
+    /**
+     * @brief Push a frame for a worker thread to pop and use.
+     * 
+     * The frame's fence is issued here, so call this right after issuing the commands that fill the buffer.
+     * Only call this from the thread that issued those commands.
+     * @param index Index of the frame being written. `frame->index` will be assigned this.
+     * @param writer Method of writing the frame to video. `frame->writer` will be assigned this.
+     */
+    void PushFullFrame(const FramePtr& frame, size_t index, const std::shared_ptr<VideoWriter>& writer);
+    /// @brief Allow @ref Adapt to resize the pool between these limits. The pool is fixed by default.
+    void SetAdaptiveLimits(size_t min_frames, size_t max_frames);
+    /**
+     * @brief Grow or shrink the pool, based on measurements since the last decision.
+     * 
+     * The pool grows when @ref PopEmptyFrame spent too long waiting for a frame,
+     * and shrinks when some frames were never used. Decisions are logged to @ref VideoLog.
+     * Only call this from the game thread, once per recorded frame.
+     */
+    void Adapt();
+    /**
+     * @brief Let workers compress frames into a backlog while the encoders are behind.
+     * @details Call this before pushing any frames.
+     * @param budget The most bytes of compressed frames to hold at once
+     */
+    void SetBacklog(size_t budget);
+    /**
+     * @brief Let the backlog spill into a scratch file when its RAM budget is full.
+     * @details Call this after @ref SetBacklog, before pushing any frames.
+     * @param path The scratch file to create. It's deleted when the pool closes.
+     * @param budget The most bytes to write to the file
+     * @return `false` if the file couldn't be created
+     */
+    bool SetBacklogSpill(std::filesystem::path path, uint64_t budget);
+    /**
+     * @brief Start burst capture: workers only copy frames into a preallocated arena, until @ref EndBurst.
+     * 
+     * Frames are only encoded during burst capture when the arena and backlog are full.
+     * Call this after @ref SetBacklog (if it's used), before pushing any frames.
+     * @param budget The most bytes of uncompressed frames to hold in the arena
+     * @param large_pages Try to allocate the arena with large pages
+     * @return `false` if the arena couldn't be allocated
+     */
+    bool SetBurst(size_t budget, bool large_pages);
+    /**
+     * @brief Call when no more frames will be pushed.
+     * @details Workers start encoding the frames held by burst capture,
+     * and degraded writers are restored since the game no longer waits on them.
+     */
+    void EndCapture();
+    /**
+     * @brief Choose what @ref PopEmptyFrame does when it waits longer than `budget`. The default is to block.
+     * @details @ref StallPolicy::BORROW needs a backlog, and blocks without one.
+     */
+    void SetStallPolicy(StallPolicy policy, std::chrono::microseconds budget);
+    StallStats GetStallStats();
+
+private:
+    /// @brief Work for a worker thread, popped by @ref PopJob
+    struct Job
+    {
+        enum Type
+        {
+            /// @brief Encode `frame`
+            ENCODE,
+            /// @brief Store `frame` into `entry`, and push it to the backlog
+            STORE,
+            /// @brief Restore `entry` and encode it
+            RESTORE,
+        };
+
+        Type type;
+        /// @brief Unused when restoring
+        FramePtr frame;
+        FrameBacklog::Entry entry;
+        /// @brief Bytes reserved in the backlog for storing `frame`
+        size_t reserved = 0;
+        /// @brief Time spent writing, for finding the slowest writer
+        std::chrono::nanoseconds write_time{0};
+    };
+
+    /// @brief Ordering state of a synchronous writer
+    struct WriterState
+    {
+        /// @brief Sequence of the next pushed frame
+        size_t next_push = 0;
+        /// @brief Sequence of the next frame to write
+        size_t next_write = 0;
+        /// @brief A worker is currently writing with it
+        bool in_use = false;
+        /// @brief Sequences after `next_write` whose frames were lost, which are skipped
+        std::vector<size_t> lost;
+    };
+
+    /// @brief Write times of a writer, for @ref StallPolicy::DEGRADE
+    struct WriterTiming
+    {
+        std::shared_ptr<VideoWriter> writer;
+        /// @brief Moving average of the time to write a frame
+        float avg_ms = 0.f;
+        /// @brief @ref VideoWriter::SetDegraded was called, whether or not it succeeded
+        bool degraded = false;
+    };
+
+    /// @brief Number of @ref Adapt calls between each decision
+    static constexpr size_t ADAPT_INTERVAL = 30;
+    /// @brief Grow the pool if @ref PopEmptyFrame waits longer than this on average
+    static constexpr std::chrono::microseconds ADAPT_MAX_WAIT{500};
+    /// @brief Restore degraded writers after this many pops without a stall
+    static constexpr size_t DEGRADE_RESTORE_POPS = 120;
+
+    /**
+     * @brief Block indefinitely until a job can be popped, or work has finished.
+     * @details Do the job and then pass it to @ref FinishJob.
+     * @return `false` if all work is finished.
+     */
+    bool PopJob(Job* job);
+    /// @brief Find the best job to pop. Lock @ref m_mutex beforehand.
+    bool FindJob(Job* job);
+    /**
+     * @brief Return the job's frame to the pool, and make its writer useable for a new thread again.
+     * @param result `false` if the job failed. The frame is still returned, but nothing is backlogged.
+     */
+    void FinishJob(Job&& job, bool result);
+    /// @brief Count one of the writer's pushed frames as done, and forget the writer after its last one. Lock @ref m_mutex beforehand.
+    void ReleasePending(const VideoWriter* writer);
+    /// @brief Check if a frame can be written now. Lock @ref m_mutex beforehand.
+    bool IsWriterReady(const VideoWriter* writer, size_t sequence) const;
+    /// @brief Move a synchronous writer past its written frame, and past any lost frames after it
+    static void AdvanceWriter(WriterState& state);
+    /// @brief Same as @ref GetNumPending. Lock @ref m_mutex beforehand.
+    size_t GetNumPendingLocked() const;
+    /**
+     * @brief Act on a stall with @ref m_stall_policy. `lock` must hold @ref m_mutex, and may be released meanwhile.
+     * @param frame Assigned a borrowed frame, if one was borrowed
+     * @return `false` if the frame must be dropped
+     */
+    bool HandleStall(std::unique_lock<std::mutex>& lock, FramePtr* frame);
+    /// @brief Store the oldest full frame in the backlog on this thread. See @ref HandleStall.
+    /// @return The emptied frame, or `nullptr` if none could be borrowed
+    FramePtr BorrowFrame(std::unique_lock<std::mutex>& lock);
+    /// @brief Degrade the slowest writer that isn't degraded yet. Lock @ref m_mutex beforehand.
+    void DegradeSlowestWriter();
+    /// @brief Undo @ref DegradeSlowestWriter for every writer. Lock @ref m_mutex beforehand.
+    void RestoreWriters();
+    /// @brief Create a frame buffer and its fence. Only call this from the game thread.
+    FramePtr CreateFrame() const;
+    static void WorkerLoop(FramePool* pool);
+
+    ReadbackDevice::Ptr m_device;
+    std::vector<std::thread> m_threads;
+    /// @brief All frames in the pool.
+    /// This vector is cleared to indicate that no further work shall be added.
+    std::vector<FramePtr> m_all;
+    /// @brief Frames that are ready to be filled with pixels.
+    /// The oldest frame is popped first, giving the GPU the most time to finish reading it.
+    std::vector<FramePtr> m_empty;
+    /// @brief Frames that are filled with pixels
+    std::vector<FramePtr> m_full;
+    /// @brief Synchronous writers, which must write one frame at a time, in order
+    std::unordered_map<const VideoWriter*, WriterState> m_sync_writers;
+    /// @brief Pushed frames of each writer that aren't written yet.
+    /// Writers are forgotten when this reaches 0, so they can be destroyed while the pool is reused.
+    std::unordered_map<const VideoWriter*, size_t> m_writer_pending;
+    /// @brief Optional. Set by @ref SetBacklog or @ref SetBurst.
+    std::unique_ptr<FrameBacklog> m_backlog;
+    /// @brief Burst capture is ongoing, so frames are stored instead of encoded
+    bool m_burst = false;
+    /// @brief Frames encoded during burst capture, because the arena was full
+    size_t m_num_burst_overflows = 0;
+    StallPolicy m_stall_policy = StallPolicy::BLOCK;
+    std::chrono::microseconds m_stall_budget{0};
+    StallStats m_stall_stats;
+    /// @brief Only filled for @ref StallPolicy::DEGRADE
+    std::unordered_map<const VideoWriter*, WriterTiming> m_writer_timings;
+    /// @brief Pops since the last stall, for restoring degraded writers
+    size_t m_pops_since_stall = 0;
+    /// @brief Number of jobs that are popped but not finished
+    size_t m_num_jobs = 0;
+    /// @brief The list of threads waiting on @ref m_empty
+    std::condition_variable m_cv_empty;
+    /// @brief The list of threads waiting on @ref m_full
+    std::condition_variable m_cv_full;
+    /// @brief Notified when a job finishes, for @ref Finish
+    std::condition_variable m_cv_idle;
+    std::mutex m_mutex;
+    /// @brief Locked during @ref Close to prevent repeated closing.
+    std::mutex m_close_mutex;
+
+    uint32_t m_frame_width;
+    uint32_t m_frame_height;
+    D3DFORMAT m_frame_format;
+    /// @brief The limits used by @ref Adapt. Both are 0 when the pool has a fixed size.
+    size_t m_min_frames = 0;
+    size_t m_max_frames = 0;
+    size_t m_adapt_calls = 0;
+    /// @brief Time spent waiting in @ref PopEmptyFrame since the last decision. Locked by @ref m_mutex.
+    std::chrono::nanoseconds m_wait_time{0};
+    /// @brief Number of @ref PopEmptyFrame calls since the last decision. Locked by @ref m_mutex.
+    size_t m_num_pops = 0;
+    /// @brief The fewest empty frames left after a pop, since the last decision. Locked by @ref m_mutex.
+    size_t m_min_empty = ~(size_t)0;
+};
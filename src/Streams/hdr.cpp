@@ -0,0 +1,237 @@
+#include "hdr.h"
+#include <cmath>
+#include <cstring>
+#include <Helper/simd.h>
+
+namespace Hdr
+{
+
+static inline float BitsToFloat(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline uint32_t FloatToBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+#ifdef SF_USE_F16C
+SF_TARGET("f16c") static void FloatToHalfF16C(const float* src, size_t count, uint16_t* dst, size_t* num_done)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i halves = _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storel_epi64((__m128i*)(dst + i), halves);
+    }
+    *num_done = i;
+}
+
+SF_TARGET("f16c") static void HalfToFloatF16C(const uint16_t* src, size_t count, float* dst, size_t* num_done)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dst + i, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(src + i))));
+    *num_done = i;
+}
+#endif
+
+bool HasF16C()
+{
+#ifdef SF_USE_F16C
+    return Simd::HasF16C();
+#else
+    return false;
+#endif
+}
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits = FloatToBits(value);
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t float_exp = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    int exp = (int)float_exp - 127 + 15;
+
+    if (float_exp == 0xFF) // Infinity or NaN. NaNs are quieted and keep the top of their payload, like F16C.
+        return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 | (mantissa >> 13) : 0));
+    if (exp >= 31) // Too large, so round to infinity
+        return (uint16_t)(sign | 0x7C00);
+    if (exp <= 0) // Subnormal, or too small
+    {
+        if (exp < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exp);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            ++half;
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = sign | ((uint32_t)exp << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        ++half; // May carry into the exponent, which is still correct
+    return (uint16_t)half;
+}
+
+float HalfToFloat(uint16_t value)
+{
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exp = (value >> 10) & 0x1F;
+    uint32_t mantissa = value & 0x3FF;
+
+    if (exp == 0) // Zero or subnormal, which is exact as a float
+    {
+        float magnitude = (float)mantissa * (1.f / 16777216.f);
+        return sign ? -magnitude : magnitude;
+    }
+    if (exp == 31) // Infinity or NaN. NaNs are quieted, like F16C.
+        return BitsToFloat(sign | 0x7F800000 | (mantissa ? 0x400000 | (mantissa << 13) : 0));
+    return BitsToFloat(sign | ((exp + 127 - 15) << 23) | (mantissa << 13));
+}
+
+void FloatToHalf(const float* src, size_t count, uint16_t* dst)
+{
+    size_t i = 0;
+#ifdef SF_USE_F16C
+    if (HasF16C())
+        FloatToHalfF16C(src, count, dst, &i);
+#endif
+    for (; i < count; ++i)
+        dst[i] = FloatToHalf(src[i]);
+}
+
+void HalfToFloat(const uint16_t* src, size_t count, float* dst)
+{
+    size_t i = 0;
+#ifdef SF_USE_F16C
+    if (HasF16C())
+        HalfToFloatF16C(src, count, dst, &i);
+#endif
+    for (; i < count; ++i)
+        dst[i] = HalfToFloat(src[i]);
+}
+
+/// @brief Steps in the linear-to-sRGB table. sRGB's steepest slope is 12.92, so this is finer than 8 bits.
+static constexpr size_t SRGB_STEPS = 4096;
+
+static const uint8_t* GetSrgbEncodeTable()
+{
+    static const auto table = [] {
+        struct { uint8_t values[SRGB_STEPS]; } table;
+        for (size_t i = 0; i < SRGB_STEPS; ++i)
+        {
+            double linear = (double)i / (SRGB_STEPS - 1);
+            double srgb = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1 / 2.4) - 0.055;
+            table.values[i] = (uint8_t)(srgb * 255 + 0.5);
+        }
+        return table;
+    }();
+    return table.values;
+}
+
+static const float* GetSrgbDecodeTable()
+{
+    static const auto table = [] {
+        struct { float values[256]; } table;
+        for (size_t i = 0; i < 256; ++i)
+        {
+            double srgb = i / 255.0;
+            table.values[i] = (float)(srgb <= 0.04045 ? srgb / 12.92 : std::pow((srgb + 0.055) / 1.055, 2.4));
+        }
+        return table;
+    }();
+    return table.values;
+}
+
+/// @brief Tonemap one channel, after negatives and NaNs are removed
+static inline float TonemapChannel(float x, Tonemap tonemap)
+{
+    switch (tonemap)
+    {
+    case Tonemap::REINHARD: return x / (1.f + x);
+    case Tonemap::ACES: return (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+    default: return x;
+    }
+}
+
+void LinearToRgba8(const float* src, size_t num_pixels, Tonemap tonemap, uint8_t* dst)
+{
+    const uint8_t* encode = GetSrgbEncodeTable();
+    size_t i = 0;
+#ifdef SF_USE_SSE2
+    // Each pixel is one vector. Color becomes an index into the sRGB table, and alpha becomes its 8-bit value.
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 scale = _mm_setr_ps(SRGB_STEPS - 1, SRGB_STEPS - 1, SRGB_STEPS - 1, 255.f);
+    const __m128 rounding = _mm_set1_ps(0.5f);
+    const __m128 color_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    alignas(16) int32_t values[4];
+    for (; i < num_pixels; ++i)
+    {
+        // Max returns its second operand for NaN, so NaN becomes 0
+        __m128 pixel = _mm_max_ps(_mm_loadu_ps(src + i * 4), zero);
+        __m128 mapped = pixel;
+        if (tonemap == Tonemap::REINHARD)
+            mapped = _mm_div_ps(pixel, _mm_add_ps(one, pixel));
+        else if (tonemap == Tonemap::ACES)
+        {
+            __m128 numerator = _mm_mul_ps(pixel, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.51f), pixel), _mm_set1_ps(0.03f)));
+            __m128 denominator = _mm_add_ps(
+                _mm_mul_ps(pixel, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.43f), pixel), _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f)
+            );
+            mapped = _mm_div_ps(numerator, denominator);
+        }
+        pixel = _mm_or_ps(_mm_and_ps(color_mask, mapped), _mm_andnot_ps(color_mask, pixel));
+        pixel = _mm_min_ps(pixel, one);
+        _mm_store_si128((__m128i*)values, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(pixel, scale), rounding)));
+
+        uint8_t* out = dst + i * 4;
+        out[0] = encode[values[0]];
+        out[1] = encode[values[1]];
+        out[2] = encode[values[2]];
+        out[3] = (uint8_t)values[3];
+    }
+#endif
+    for (; i < num_pixels; ++i)
+    {
+        const float* pixel = src + i * 4;
+        uint8_t* out = dst + i * 4;
+        for (int c = 0; c < 4; ++c)
+        {
+            float x = pixel[c] > 0.f ? pixel[c] : 0.f;
+            if (c < 3)
+                x = TonemapChannel(x, tonemap);
+            x = x < 1.f ? x : 1.f;
+            if (c < 3)
+                out[c] = encode[(int32_t)(x * (SRGB_STEPS - 1) + 0.5f)];
+            else
+                out[c] = (uint8_t)(int32_t)(x * 255.f + 0.5f);
+        }
+    }
+}
+
+void Rgb8ToLinear(const uint8_t* src, size_t num_pixels, size_t stride, const size_t offsets[3], bool has_alpha, float* dst)
+{
+    const float* decode = GetSrgbDecodeTable();
+    for (size_t i = 0; i < num_pixels; ++i)
+    {
+        const uint8_t* pixel = src + i * stride;
+        float* out = dst + i * 4;
+        out[0] = decode[pixel[offsets[0]]];
+        out[1] = decode[pixel[offsets[1]]];
+        out[2] = decode[pixel[offsets[2]]];
+        out[3] = has_alpha ? pixel[3] / 255.f : 1.f;
+    }
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Converters between half floats, linear floats and 8-bit color, for frames captured in a float format.
+ *
+ * Half floats are converted with F16C when the CPU has it, and bit by bit otherwise.
+ * Both paths round to nearest even, so they give identical results.
+ *
+ * These have no D3D or game dependencies, so they can be built and exercised on their own.
+ */
+namespace Hdr
+{
+    /// @brief How linear values above 1 are brought into the 8-bit range
+    enum class Tonemap
+    {
+        /// @brief Clip values to 1
+        CLAMP,
+        /// @brief `x / (1 + x)`, which keeps detail in highlights but dims the whole image
+        REINHARD,
+        /// @brief Krzysztof Narkowicz's fit of the ACES filmic curve
+        ACES,
+        _COUNT,
+    };
+
+    /// @brief True if the CPU supports F16C, and the half float conversions use it
+    bool HasF16C();
+
+    /// @brief Convert to a half float, rounding to nearest even
+    uint16_t FloatToHalf(float value);
+    float HalfToFloat(uint16_t value);
+    void FloatToHalf(const float* src, size_t count, uint16_t* dst);
+    void HalfToFloat(const uint16_t* src, size_t count, float* dst);
+
+    /**
+     * @brief Tonemap linear RGBA floats and encode them as 8-bit sRGB.
+     * @details Alpha isn't tonemapped or encoded, only clamped between 0 and 1.
+     */
+    void LinearToRgba8(const float* src, size_t num_pixels, Tonemap tonemap, uint8_t* dst);
+    /**
+     * @brief Decode 8-bit sRGB pixels to linear RGBA floats
+     * @param stride Bytes between each source pixel, 3 or 4
+     * @param offsets Offsets of the red, green and blue bytes within each pixel
+     * @param has_alpha The fourth byte of each pixel is alpha. Otherwise, alpha is 1.
+     */
+    void Rgb8ToLinear(const uint8_t* src, size_t num_pixels, size_t stride, const size_t offsets[3], bool has_alpha, float* dst);
+}
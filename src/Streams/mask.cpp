@@ -0,0 +1,94 @@
+#include "mask.h"
+#include <Helper/simd.h>
+
+namespace Mask
+{
+
+/// @brief Movemask puts the first pixel in the lowest bit, but PNG wants it in the highest
+static inline uint8_t ReverseBits(uint8_t b)
+{
+    b = (uint8_t)((b & 0xF0) >> 4 | (b & 0x0F) << 4);
+    b = (uint8_t)((b & 0xCC) >> 2 | (b & 0x33) << 2);
+    return (uint8_t)((b & 0xAA) >> 1 | (b & 0x55) << 1);
+}
+
+void Extract(const uint8_t* pixels, size_t num_pixels, size_t stride, size_t offset, int threshold, uint8_t* out)
+{
+    if (threshold > 255)
+        threshold = 255;
+    size_t i = 0;
+#ifdef SF_USE_SSE2
+    if (stride == 4)
+    {
+        const __m128i low_byte = _mm_set1_epi32(0xFF);
+        const __m128i xthreshold = _mm_set1_epi8((char)(uint8_t)threshold);
+        const int shift = (int)offset * 8;
+        for (; i + 16 <= num_pixels; i += 16)
+        {
+            // Move the channel to the low byte of each 32-bit pixel, then narrow 16 pixels to 16 bytes
+            const __m128i* src = (const __m128i*)(pixels + i * 4);
+            __m128i p0 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(src + 0), _mm_cvtsi32_si128(shift)), low_byte);
+            __m128i p1 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(src + 1), _mm_cvtsi32_si128(shift)), low_byte);
+            __m128i p2 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(src + 2), _mm_cvtsi32_si128(shift)), low_byte);
+            __m128i p3 = _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(src + 3), _mm_cvtsi32_si128(shift)), low_byte);
+            __m128i values = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+
+            if (threshold > 0) // Unsigned `values >= threshold`
+                values = _mm_cmpeq_epi8(_mm_max_epu8(values, xthreshold), values);
+            _mm_storeu_si128((__m128i*)(out + i), values);
+        }
+    }
+#endif
+    for (; i < num_pixels; ++i)
+    {
+        uint8_t value = pixels[i * stride + offset];
+        if (threshold > 0)
+            value = value >= threshold ? 255 : 0;
+        out[i] = value;
+    }
+}
+
+void AddPlane(const uint8_t* mask, size_t num_pixels, int plane, uint8_t* planes)
+{
+    const uint8_t bit = (uint8_t)(1 << plane);
+    size_t i = 0;
+#ifdef SF_USE_SSE2
+    const __m128i xbit = _mm_set1_epi8((char)bit);
+    for (; i + 16 <= num_pixels; i += 16)
+    {
+        __m128i dst = _mm_loadu_si128((const __m128i*)(planes + i));
+        __m128i src = _mm_and_si128(_mm_loadu_si128((const __m128i*)(mask + i)), xbit);
+        _mm_storeu_si128((__m128i*)(planes + i), _mm_or_si128(dst, src));
+    }
+#endif
+    for (; i < num_pixels; ++i)
+        planes[i] |= mask[i] & bit;
+}
+
+void PackBits(const uint8_t* mask, uint32_t width, uint32_t height, std::vector<uint8_t>* out)
+{
+    const size_t row_size = ((size_t)width + 7) / 8;
+    out->assign(row_size * height, 0);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* src = mask + (size_t)y * width;
+        uint8_t* dst = out->data() + y * row_size;
+        uint32_t x = 0;
+#ifdef SF_USE_SSE2
+        // The top bit of each byte is set in a binary mask, so 16 pixels become 2 bytes at once
+        for (; x + 16 <= width; x += 16)
+        {
+            int bits = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(src + x)));
+            dst[x / 8] = ReverseBits((uint8_t)bits);
+            dst[x / 8 + 1] = ReverseBits((uint8_t)(bits >> 8));
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            if (src[x])
+                dst[x / 8] |= 0x80 >> (x % 8);
+        }
+    }
+}
+
+}
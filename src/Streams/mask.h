@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Helpers to reduce matte frames to single-channel coverage masks.
+ *
+ * A mask is one byte per pixel. Binary masks are 0 or 255, so they can be combined as bit planes,
+ * or packed to 1 bit per pixel.
+ *
+ * These have no D3D or game dependencies, so they can be built and exercised on their own.
+ */
+namespace Mask
+{
+    /**
+     * @brief Copy one channel of each pixel into a mask.
+     * @param pixels Tightly packed pixels
+     * @param stride Bytes per pixel. Strides of 4 are vectorized.
+     * @param offset Byte offset of the channel within each pixel
+     * @param threshold If above 0, values at or above it become 255, and all others become 0
+     * @param out Receives `num_pixels` bytes
+     */
+    void Extract(const uint8_t* pixels, size_t num_pixels, size_t stride, size_t offset, int threshold, uint8_t* out);
+
+    /**
+     * @brief Copy a binary mask into one bit of each byte of `planes`
+     * @param plane The bit to set, from 0 to 7
+     */
+    void AddPlane(const uint8_t* mask, size_t num_pixels, int plane, uint8_t* planes);
+
+    /**
+     * @brief Pack a binary mask to 1 bit per pixel, high bits first, like PNG expects.
+     * @details Each row starts on a new byte.
+     */
+    void PackBits(const uint8_t* mask, uint32_t width, uint32_t height, std::vector<uint8_t>* out);
+}
@@ -0,0 +1,133 @@
+#include "materialindex.h"
+#include <Base/Interfaces.h>
+#include <SDK/imaterialsystem.h>
+#include <SDK/imaterial.h>
+
+bool MaterialIndex::IsOutdated() const
+{
+    if (Interfaces::mat_system->GetNumMaterials() != m_num_materials)
+        return true;
+    for (const Group& group : m_groups)
+    {
+        if (group.is_stored && IsStale(group))
+            return true;
+    }
+    return false;
+}
+
+bool MaterialIndex::IsStale(const Group& group)
+{
+    for (size_t i = 0; i < group.materials.size(); ++i)
+    {
+        if (Interfaces::mat_system->GetMaterial(group.handles[i]) != group.materials[i])
+            return true;
+    }
+    return false;
+}
+
+bool MaterialIndex::Refresh()
+{
+    // Unmodified groups are written to after a refresh, so all of them are checked here
+    bool is_outdated = Interfaces::mat_system->GetNumMaterials() != m_num_materials;
+    for (size_t i = 0; i < m_groups.size() && !is_outdated; ++i)
+        is_outdated = IsStale(m_groups[i]);
+    if (!is_outdated)
+        return false;
+
+    // Remember the original colors of modified materials, in case they're still loaded.
+    // Pointers may have been freed and re-occupied, so they're only trusted if the handle and name pointer also match.
+    struct StoredColor
+    {
+        MaterialHandle_t handle;
+        const char* name;
+        Color color;
+    };
+    std::unordered_map<IMaterial*, StoredColor> stored_colors;
+    for (Group& group : m_groups)
+    {
+        if (group.is_stored)
+        {
+            for (size_t i = 0; i < group.materials.size(); ++i)
+                stored_colors.emplace(group.materials[i], StoredColor{group.handles[i], group.names[i], group.original_colors[i]});
+        }
+        group.materials.clear();
+        group.handles.clear();
+        group.names.clear();
+        group.original_colors.clear();
+    }
+    
+    m_num_materials = Interfaces::mat_system->GetNumMaterials();
+    for (   MaterialHandle_t handle = Interfaces::mat_system->FirstMaterial();
+            handle != Interfaces::mat_system->InvalidMaterial();
+            handle = Interfaces::mat_system->NextMaterial(handle)
+        )
+    {
+        IMaterial* mat = Interfaces::mat_system->GetMaterial(handle);
+        const char* name = mat->GetName();
+        Group& group = m_groups[GetGroupIndex(mat->GetTextureGroupName())];
+        group.materials.push_back(mat);
+        group.handles.push_back(handle);
+        group.names.push_back(name);
+
+        if (group.is_stored)
+        {
+            auto stored = stored_colors.find(mat);
+            if (stored != stored_colors.end() && stored->second.handle == handle && stored->second.name == name)
+                group.original_colors.push_back(stored->second.color);
+            else // It's a new material, so its color is untouched
+                group.original_colors.push_back(GetColor(mat));
+        }
+    }
+
+    ++m_generation;
+    return true;
+}
+
+void MaterialIndex::SetGroupColor(size_t group_index, const std::array<float, 4>& color)
+{
+    Group& group = m_groups[group_index];
+    if (!group.is_stored)
+    {
+        group.original_colors.resize(group.materials.size());
+        for (size_t i = 0; i < group.materials.size(); ++i)
+            group.original_colors[i] = GetColor(group.materials[i]);
+        group.is_stored = true;
+    }
+
+    for (IMaterial* mat : group.materials)
+        SetColor(mat, color);
+}
+
+void MaterialIndex::RestoreGroup(size_t group_index)
+{
+    Group& group = m_groups[group_index];
+    if (!group.is_stored)
+        return;
+
+    for (size_t i = 0; i < group.materials.size(); ++i)
+        SetColor(group.materials[i], group.original_colors[i]);
+    group.original_colors.clear();
+    group.is_stored = false;
+}
+
+size_t MaterialIndex::GetGroupIndex(const char* group_name)
+{
+    auto insertion = m_group_ids.try_emplace(group_name);
+    if (insertion.second)
+        insertion.first->second = (uint8_t)MaterialTweak::GetTextureGroupIndex(group_name);
+    return insertion.first->second;
+}
+
+MaterialIndex::Color MaterialIndex::GetColor(IMaterial* mat)
+{
+    Color color;
+    mat->GetColorModulation(&color[0], &color[1], &color[2]);
+    color[3] = mat->GetAlphaModulation();
+    return color;
+}
+
+void MaterialIndex::SetColor(IMaterial* mat, const Color& color)
+{
+    mat->ColorModulate(color[0], color[1], color[2]);
+    mat->AlphaModulate(color[3]);
+}
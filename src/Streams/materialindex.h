@@ -0,0 +1,76 @@
+#pragma once
+#include "rendertweak.h"
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+class IMaterial;
+
+/**
+ * @brief Every loaded material, grouped by texture group.
+ * 
+ * This lets @ref MaterialTweak effects be applied to a few texture groups
+ * without iterating the whole material system and comparing group names.
+ * The original colors of modified groups are stored in flat arrays, so they can be restored later.
+ * 
+ * Only use this from the game thread.
+ */
+class MaterialIndex
+{
+public:
+    /// @brief Number of groups, including a group for texture groups that aren't in @ref MaterialTweak::TEXTURE_GROUPS
+    static constexpr size_t NUM_GROUPS = MaterialTweak::TEXTURE_GROUPS.size() + 1;
+
+    /**
+     * @brief Check if any materials were loaded or unloaded since the last @ref Refresh.
+     * 
+     * A map change or material reload can keep the same number of materials,
+     * so the materials of modified groups are also checked against their handles.
+     * Those are the only ones written to without a @ref Refresh first.
+     */
+    bool IsOutdated() const;
+    /**
+     * @brief Rescan every material, if outdated.
+     * 
+     * Original colors are kept for materials that remain loaded.
+     * Newly loaded materials will have the default color, even if their group was modified.
+     * @return True if the index was rescanned, and the generation was incremented.
+     */
+    bool Refresh();
+    /// @brief Incremented each time the materials are rescanned
+    uint32_t GetGeneration() const { return m_generation; }
+    /// @param group An index from @ref MaterialTweak::GetTextureGroupIndex
+    const std::vector<IMaterial*>& GetGroup(size_t group) const { return m_groups[group].materials; }
+    /// @brief Override the color of a group, storing the original colors if they aren't already stored.
+    void SetGroupColor(size_t group, const std::array<float, 4>& color);
+    /// @brief Restore the original colors of a group, if they were stored.
+    void RestoreGroup(size_t group);
+
+private:
+    using Color = std::array<float, 4>;
+
+    struct Group
+    {
+        std::vector<IMaterial*> materials;
+        /// @brief Handles of @ref materials, used to validate pointers when rescanning
+        std::vector<uint16_t> handles;
+        /// @brief Name pointers of @ref materials, to tell a material from a new one at the same address and handle
+        std::vector<const char*> names;
+        /// @brief Original colors of @ref materials. Only valid if @ref is_stored.
+        std::vector<Color> original_colors;
+        bool is_stored = false;
+    };
+
+    /// @brief Check if any material of a group no longer matches its handle
+    static bool IsStale(const Group& group);
+    size_t GetGroupIndex(const char* group_name);
+    static Color GetColor(IMaterial* mat);
+    static void SetColor(IMaterial* mat, const Color& color);
+
+    std::array<Group, NUM_GROUPS> m_groups;
+    /// @brief Group names are interned by the material system, so their pointers are mapped to indexes.
+    std::unordered_map<const char*, uint8_t> m_group_ids;
+    int m_num_materials = -1;
+    uint32_t m_generation = 0;
+};
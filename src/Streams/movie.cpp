@@ -3,13 +3,16 @@
 #include <chrono>
 #include <type_traits>
 #include <cassert>
+#include <unordered_map>
 #include "videowriter.h"
 #include "stream.h"
+#include <Hooks/OverlayHook.h>
 
 Movie::Movie(
     uint32_t width, uint32_t height,
     std::filesystem::path root_path, const std::vector<std::shared_ptr<Stream>>& streams,
-    size_t framepool_size, const EncoderConfig& default_videoconfig
+    size_t framepool_size, size_t num_threads, const EncoderConfig& default_videoconfig,
+    std::shared_ptr<FramePool> shared_framepool, D3DFORMAT frame_format
 )   : m_root_path(std::move(root_path)), m_temp_audio_name(CreateTempAudioName(".wav"))
 {
     // Create the movie directory structure
@@ -45,10 +48,41 @@ Movie::Movie(
         return;
     }
 
+    std::vector<EncoderConfig> configs;
+    configs.reserve(streams.size());
+    // Grouped mask streams share a sequence, with one bit plane each
+    struct MaskGroup
+    {
+        std::shared_ptr<MaskSequence> sequence;
+        size_t num_planes = 0;
+        size_t next_plane = 0;
+    };
+    std::unordered_map<std::string, MaskGroup> mask_groups;
     for (const auto& stream : streams)
     {
-        const EncoderConfig& config = default_videoconfig;
-        std::filesystem::path stream_path = m_root_path / stream->GetName();
+        EncoderConfig& config = configs.emplace_back(
+            stream->GetVideoConfig() ? *stream->GetVideoConfig() : default_videoconfig
+        );
+        config.framerate = default_videoconfig.framerate; // Every stream is recorded at the same rate
+        if (config.type == EncoderConfig::TYPE_MASK && !config.mask_group.empty())
+        {
+            if (++mask_groups[config.mask_group].num_planes > MaskSequence::MAX_PLANES)
+            {
+                VideoLog::AppendError("Mask group '%s' has more than %zu streams\n", config.mask_group.c_str(), MaskSequence::MAX_PLANES);
+                m_failed = true;
+                return;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < streams.size(); ++i)
+    {
+        const std::shared_ptr<Stream>& stream = streams[i];
+        const EncoderConfig& config = configs[i];
+        MaskGroup* mask_group = nullptr;
+        if (config.type == EncoderConfig::TYPE_MASK && !config.mask_group.empty())
+            mask_group = &mask_groups[config.mask_group];
+        std::filesystem::path stream_path = m_root_path / (mask_group ? config.mask_group : stream->GetName());
 
         if (config.type == EncoderConfig::TYPE_FFMPEG)
         {
@@ -65,6 +99,10 @@ Movie::Movie(
                 temp += ch;
             stream_path = temp;
         }
+        else if (config.type == EncoderConfig::TYPE_DELTA)
+            stream_path += ".sfdelta";
+        else if (config.type == EncoderConfig::TYPE_RAW)
+            stream_path += ".sfraw";
         else // For image sequences, create an additional folder to contain it
         {
             std::error_code err;
@@ -82,15 +120,61 @@ Movie::Movie(
 
         std::shared_ptr<VideoWriter> writer;
         if (config.type == EncoderConfig::TYPE_QOI)
-            writer = std::make_shared<ImageWriter>(width, height, ImageWriter::Format::QOI, std::move(stream_path));
+        {
+            auto qoi_writer = std::make_shared<ImageWriter>(width, height, ImageWriter::Format::QOI, std::move(stream_path));
+            qoi_writer->SetLinkDuplicates(config.link_duplicates);
+            qoi_writer->SetCropToContent(config.crop_to_content && !config.alpha);
+            qoi_writer->SetAlpha(config.alpha);
+            qoi_writer->SetTonemap((Hdr::Tonemap)config.tonemap);
+            writer = std::move(qoi_writer);
+        }
         else if (config.type == EncoderConfig::TYPE_PNG)
         {
             auto png_writer = std::make_shared<ImageWriter>(width, height, ImageWriter::Format::PNG, std::move(stream_path));
             png_writer->SetPngCompression(config.png_compression);
+            png_writer->SetLinkDuplicates(config.link_duplicates);
+            png_writer->SetPngPalette(config.png_palette);
+            png_writer->SetCropToContent(config.crop_to_content && !config.alpha);
+            png_writer->SetAlpha(config.alpha);
+            png_writer->SetTonemap((Hdr::Tonemap)config.tonemap);
             writer = std::move(png_writer);
         }
         else if (config.type == EncoderConfig::TYPE_FFMPEG)
-            writer = std::make_shared<FFmpegWriter>(width, height, config.framerate, config.ffmpeg_output_args, std::move(stream_path));
+            writer = std::make_shared<FFmpegWriter>(
+                width, height, config.framerate, config.ffmpeg_output_args, std::move(stream_path),
+                frame_format, config.alpha, (Hdr::Tonemap)config.tonemap
+            );
+        else if (config.type == EncoderConfig::TYPE_MASK)
+        {
+            size_t plane = 0;
+            std::shared_ptr<MaskSequence> sequence;
+            int threshold = config.mask_threshold;
+            if (mask_group)
+            {
+                // The group is configured by its first stream. Bit planes are always binary.
+                if (!mask_group->sequence)
+                {
+                    mask_group->sequence = std::make_shared<MaskSequence>(
+                        width, height, mask_group->num_planes, true, config.png_compression, std::move(stream_path)
+                    );
+                }
+                plane = mask_group->next_plane++;
+                sequence = mask_group->sequence;
+                if (threshold <= 0)
+                    threshold = 128;
+            }
+            else
+                sequence = std::make_shared<MaskSequence>(width, height, 1, threshold > 0, config.png_compression, std::move(stream_path));
+            writer = std::make_shared<MaskWriter>(std::move(sequence), plane, config.mask_channel, threshold);
+        }
+        else if (config.type == EncoderConfig::TYPE_DELTA)
+            writer = std::make_shared<DeltaWriter>(width, height, config.delta_keyframe_interval, stream_path);
+        else if (config.type == EncoderConfig::TYPE_RAW)
+            writer = std::make_shared<RawWriter>(config.framerate, stream->GetName(), config.raw_lz4, stream_path);
+        else if (config.type == EncoderConfig::TYPE_DEPTH)
+            writer = std::make_shared<DepthWriter>((DepthWriter::Format)config.depth_format, config.png_compression, std::move(stream_path));
+        else if (config.type == EncoderConfig::TYPE_EXR)
+            writer = std::make_shared<ExrWriter>(config.alpha, config.exr_half, config.png_compression, std::move(stream_path));
         else
         {
             VideoLog::AppendError("Invalid or unsupported EncoderConfig type: %s\n", config.type ? config.type->name : "(null)");
@@ -104,10 +188,21 @@ Movie::Movie(
     VideoLog::Append("Recording will begin after the console is closed\n");
     VideoLog::Append(Helper::sprintf("Recording to '%s'\n", m_root_path.string().c_str()));
     
-    auto num_threads = std::thread::hardware_concurrency();
-    if (num_threads <= 0)
+    if (shared_framepool && !shared_framepool->IsClosed()
+        && shared_framepool->GetFrameWidth() == width && shared_framepool->GetFrameHeight() == height
+        && shared_framepool->GetFrameFormat() == frame_format)
+    {
+        m_framepool = std::move(shared_framepool);
+        return;
+    }
+
+    if (num_threads == 0)
+        num_threads = std::thread::hardware_concurrency();
+    if (num_threads == 0)
         num_threads = 1;
-    m_framepool.emplace(num_threads, framepool_size, width, height);
+    m_framepool = std::make_shared<FramePool>(
+        ReadbackDevice::Create(g_hk_overlay.Device()), num_threads, framepool_size, width, height, frame_format
+    );
 }
 
 FramePool& Movie::GetFramePool()
@@ -117,6 +212,17 @@ FramePool& Movie::GetFramePool()
     return *m_framepool;
 }
 
+size_t Movie::GetNumPending()
+{
+    if (!IsFramePoolShared())
+        return GetFramePool().GetNumPending();
+
+    size_t num_pending = 0;
+    for (const StreamPair& pair : m_streams)
+        num_pending += GetFramePool().GetNumPending(pair.writer.get());
+    return num_pending;
+}
+
 std::string Movie::CreateTempAudioName(const char* suffix)
 {
     auto time = std::chrono::duration_cast<std::chrono::milliseconds>(
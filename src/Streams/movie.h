@@ -34,12 +34,17 @@ public:
      * @param root_path The directory to containt all movie files.
      * This directory is created automatically.
      * @param framepool_size Number of frame buffers to reserve
+     * @param num_threads Number of threads that write frames. 0 uses one per CPU core.
      * @param default_videoconfig The video config to use for all streams without an override
+     * @param shared_framepool Optional. Write frames with this pool instead of creating one,
+     * so consecutive movies can reuse its buffers and threads. Ignored if its frames are the wrong size or format.
+     * @param frame_format Format that frames are captured in. Float formats keep HDR render targets.
      */
     Movie(
         uint32_t width, uint32_t height,
         std::filesystem::path root_path, const std::vector<std::shared_ptr<Stream>>& streams,
-        size_t framepool_size, const EncoderConfig& default_videoconfig
+        size_t framepool_size, size_t num_threads, const EncoderConfig& default_videoconfig,
+        std::shared_ptr<FramePool> shared_framepool = nullptr, D3DFORMAT frame_format = D3DFMT_A8R8G8B8
     );
 
     const std::string& GetTempAudioName() const { return m_temp_audio_name; }
@@ -52,6 +57,12 @@ public:
     /// @brief Get the frame pool.
     /// @details Do not call this if @ref Failed is true immediately after construction.
     FramePool& GetFramePool();
+    /// @brief Get the frame pool, for sharing it with another movie
+    const std::shared_ptr<FramePool>& GetSharedFramePool() const { return m_framepool; }
+    /// @brief Another movie uses the frame pool too, so this movie must not close it
+    bool IsFramePoolShared() const { return m_framepool.use_count() > 1; }
+    /// @brief The number of this movie's frames that aren't written yet
+    size_t GetNumPending();
     /// @brief Return the frame index (starting at 0) and increment it.
     size_t NextFrameIndex() { return m_frame_index++; }
 
@@ -64,8 +75,8 @@ private:
     /// @brief Name of the temp audio file
     const std::string m_temp_audio_name;
     std::vector<StreamPair> m_streams;
-    /// @brief This is wrapped so we don't unnecessarily construct it.
-    std::optional<FramePool> m_framepool;
+    /// @brief This is wrapped so we don't unnecessarily construct it, and so it can be shared.
+    std::shared_ptr<FramePool> m_framepool;
     size_t m_frame_index = 0;
     bool m_failed = false;
 };
\ No newline at end of file
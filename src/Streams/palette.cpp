@@ -0,0 +1,138 @@
+#include "palette.h"
+#include <cstring>
+#include <Helper/simd.h>
+
+/// @brief Number of pixels compared at once when skipping runs of one color
+static constexpr size_t BLOCK_PIXELS = 16;
+
+static inline uint32_t ReadColor(const uint8_t* pixel) {
+    return pixel[0] | (pixel[1] << 8) | (pixel[2] << 16);
+}
+
+static inline size_t HashColor(uint32_t color) {
+    return (color * 0x9E3779B1u) >> 23; // Top 9 bits, to index the table
+}
+
+bool IndexedImage::Build(const uint8_t* rgb, uint32_t width, uint32_t height)
+{
+    static_assert(TABLE_SIZE == 512, "HashColor must return an index into the table");
+
+    m_width = width;
+    m_height = height;
+    m_palette.clear();
+    m_table_keys.fill(EMPTY_KEY);
+
+    const size_t num_pixels = (size_t)width * height;
+    m_indices.resize(num_pixels);
+
+    uint32_t last_color = EMPTY_KEY;
+    uint8_t last_index = 0;
+#ifdef SF_USE_SSE2
+    // The last color, repeated over 16 pixels
+    alignas(16) uint8_t pattern[BLOCK_PIXELS * 3];
+    __m128i xpattern[3];
+#endif
+
+    size_t i = 0;
+    while (i < num_pixels)
+    {
+#ifdef SF_USE_SSE2
+        // Mattes are mostly long runs of one color, so skip them a block at a time
+        if (last_color != EMPTY_KEY)
+        {
+            for (; i + BLOCK_PIXELS <= num_pixels; i += BLOCK_PIXELS)
+            {
+                const __m128i* block = (const __m128i*)(rgb + i * 3);
+                __m128i eq = _mm_and_si128(
+                    _mm_and_si128(
+                        _mm_cmpeq_epi8(_mm_loadu_si128(block + 0), xpattern[0]),
+                        _mm_cmpeq_epi8(_mm_loadu_si128(block + 1), xpattern[1])
+                    ),
+                    _mm_cmpeq_epi8(_mm_loadu_si128(block + 2), xpattern[2])
+                );
+                if (_mm_movemask_epi8(eq) != 0xFFFF)
+                    break;
+                memset(&m_indices[i], last_index, BLOCK_PIXELS);
+            }
+        }
+#endif
+        // The next block has a different color, so go through it pixel by pixel
+        size_t block_end = i + BLOCK_PIXELS < num_pixels ? i + BLOCK_PIXELS : num_pixels;
+        for (; i < block_end; ++i)
+        {
+            uint32_t color = ReadColor(rgb + i * 3);
+            if (color != last_color)
+            {
+                int index = FindOrAddColor(color);
+                if (index < 0)
+                    return false;
+                last_color = color;
+                last_index = (uint8_t)index;
+#ifdef SF_USE_SSE2
+                for (size_t p = 0; p < BLOCK_PIXELS; ++p)
+                    memcpy(pattern + p * 3, rgb + i * 3, 3);
+                for (size_t r = 0; r < 3; ++r)
+                    xpattern[r] = _mm_load_si128((const __m128i*)pattern + r);
+#endif
+            }
+            m_indices[i] = last_index;
+        }
+    }
+
+    size_t num_colors = m_palette.size();
+    m_bit_depth = num_colors <= 2 ? 1 : num_colors <= 4 ? 2 : num_colors <= 16 ? 4 : 8;
+    Pack();
+    return true;
+}
+
+int IndexedImage::FindOrAddColor(uint32_t color)
+{
+    for (size_t slot = HashColor(color);; slot = (slot + 1) % TABLE_SIZE)
+    {
+        if (m_table_keys[slot] == color)
+            return m_table_values[slot];
+        if (m_table_keys[slot] != EMPTY_KEY)
+            continue;
+
+        if (m_palette.size() >= MAX_COLORS)
+            return -1;
+        m_table_keys[slot] = color;
+        m_table_values[slot] = (uint8_t)m_palette.size();
+        m_palette.push_back({(uint8_t)color, (uint8_t)(color >> 8), (uint8_t)(color >> 16)});
+        return m_table_values[slot];
+    }
+}
+
+void IndexedImage::Pack()
+{
+    if (m_bit_depth == 8)
+    {
+        m_data.swap(m_indices);
+        return;
+    }
+
+    const size_t row_size = GetRowSize();
+    const uint32_t pixels_per_byte = 8 / m_bit_depth;
+    m_data.resize(row_size * m_height);
+    for (uint32_t y = 0; y < m_height; ++y)
+    {
+        const uint8_t* indices = m_indices.data() + (size_t)y * m_width;
+        uint8_t* out = m_data.data() + y * row_size;
+        uint32_t x = 0;
+        for (; x + pixels_per_byte <= m_width; x += pixels_per_byte)
+        {
+            uint8_t byte = 0;
+            for (uint32_t i = 0; i < pixels_per_byte; ++i)
+                byte = (uint8_t)(byte << m_bit_depth | indices[x + i]);
+            *out++ = byte;
+        }
+        if (x < m_width) // Fill the last byte of the row with zeros
+        {
+            uint8_t byte = 0;
+            uint32_t num_left = m_width - x;
+            for (uint32_t i = 0; i < num_left; ++i)
+                byte = (uint8_t)(byte << m_bit_depth | indices[x + i]);
+            *out = (uint8_t)(byte << (m_bit_depth * (pixels_per_byte - num_left)));
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief A frame of 24-bit pixels, reduced to a palette of at most 256 colors.
+ *
+ * Mattes and other flat streams only have a handful of colors,
+ * so they can be written as indexed PNGs with 1, 2, 4 or 8 bits per pixel instead of 24.
+ * That's far less data for zlib to compress, and the files are several times smaller.
+ *
+ * This class has no D3D or game dependencies, so it can be built and exercised on its own.
+ */
+class IndexedImage
+{
+public:
+    static constexpr size_t MAX_COLORS = 256;
+
+    /**
+     * @brief Build the palette and indices of tightly packed RGB pixels.
+     * @details This gives up as soon as a color doesn't fit, so frames with many colors are rejected quickly.
+     * @return `false` if the pixels have more than @ref MAX_COLORS colors
+     */
+    bool Build(const uint8_t* rgb, uint32_t width, uint32_t height);
+
+    /// @brief Colors in order of their first appearance
+    const std::vector<std::array<uint8_t, 3>>& GetPalette() const { return m_palette; }
+    /// @brief 1, 2, 4 or 8. The fewest bits that can index every color of the palette.
+    int GetBitDepth() const { return m_bit_depth; }
+    /// @brief Rows of indices packed into @ref GetBitDepth bits each, high bits first, like PNG expects.
+    /// Each row starts on a new byte.
+    const std::vector<uint8_t>& GetData() const { return m_data; }
+    size_t GetRowSize() const { return ((size_t)m_width * m_bit_depth + 7) / 8; }
+
+private:
+    /// @return The color's index, or -1 if the palette is full
+    int FindOrAddColor(uint32_t color);
+    /// @brief Pack @ref m_indices into @ref m_data with @ref m_bit_depth bits each
+    void Pack();
+
+    /// @brief Open-addressed, with one more bit than @ref MAX_COLORS so it never gets crowded
+    static constexpr size_t TABLE_SIZE = MAX_COLORS * 2;
+    static constexpr uint32_t EMPTY_KEY = ~(uint32_t)0;
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    int m_bit_depth = 8;
+    std::vector<std::array<uint8_t, 3>> m_palette;
+    std::array<uint32_t, TABLE_SIZE> m_table_keys;
+    std::array<uint8_t, TABLE_SIZE> m_table_values;
+    /// @brief One byte per pixel, before packing
+    std::vector<uint8_t> m_indices;
+    std::vector<uint8_t> m_data;
+};
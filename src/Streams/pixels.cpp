@@ -0,0 +1,149 @@
+#include "pixels.h"
+#include <cstring>
+#include <Helper/simd.h>
+
+namespace Pixels
+{
+
+static inline uint32_t Load32(const uint8_t* src)
+{
+    uint32_t value;
+    memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+static inline void Store32(uint8_t* dst, uint32_t value) {
+    memcpy(dst, &value, sizeof(value));
+}
+
+static inline uint32_t SwapRedBlue(uint32_t pixel) {
+    return ((pixel & 0xFF) << 16) | (pixel & 0xFF00) | ((pixel >> 16) & 0xFF);
+}
+
+#ifdef SF_USE_SSSE3
+/// @brief The SSSE3 part of @ref Convert4To3
+/// @return The number of pixels converted
+template <bool swap>
+SF_TARGET("ssse3") static size_t Convert4To3Ssse3(const uint8_t* src, size_t num_pixels, uint8_t* dst)
+{
+    const __m128i shuffle = swap
+        ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+        : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    size_t i = 0;
+    // Each store writes 16 bytes for 12 bytes of pixels, so stop while the overlap still lands in `dst`
+    for (; i + 6 <= num_pixels; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        _mm_storeu_si128((__m128i*)(dst + i * 3), _mm_shuffle_epi8(pixels, shuffle));
+    }
+    return i;
+}
+#endif
+
+/**
+ * @brief Drop the 4th byte of each pixel, optionally swapping red and blue.
+ * @details Four 24-bit pixels are packed into three 32-bit words, instead of being written byte by byte.
+ * CPUs with SSSE3 shuffle four pixels at once instead.
+ */
+template <bool swap>
+static void Convert4To3(const uint8_t* src, size_t num_pixels, uint8_t* dst)
+{
+    size_t i = 0;
+#ifdef SF_USE_SSSE3
+    if (Simd::HasSsse3())
+        i = Convert4To3Ssse3<swap>(src, num_pixels, dst);
+#endif
+    for (; i + 4 <= num_pixels; i += 4)
+    {
+        uint32_t p0 = Load32(src + i * 4 + 0) & 0xFFFFFF;
+        uint32_t p1 = Load32(src + i * 4 + 4) & 0xFFFFFF;
+        uint32_t p2 = Load32(src + i * 4 + 8) & 0xFFFFFF;
+        uint32_t p3 = Load32(src + i * 4 + 12) & 0xFFFFFF;
+        if (swap)
+        {
+            p0 = SwapRedBlue(p0);
+            p1 = SwapRedBlue(p1);
+            p2 = SwapRedBlue(p2);
+            p3 = SwapRedBlue(p3);
+        }
+        Store32(dst + i * 3 + 0, p0 | (p1 << 24));
+        Store32(dst + i * 3 + 4, (p1 >> 8) | (p2 << 16));
+        Store32(dst + i * 3 + 8, (p2 >> 16) | (p3 << 8));
+    }
+    for (; i < num_pixels; ++i)
+    {
+        const uint8_t* src_pixel = src + i * 4;
+        uint8_t* dst_pixel = dst + i * 3;
+        dst_pixel[0] = src_pixel[swap ? 2 : 0];
+        dst_pixel[1] = src_pixel[1];
+        dst_pixel[2] = src_pixel[swap ? 0 : 2];
+    }
+}
+
+void BgraToRgb(const uint8_t* src, size_t num_pixels, uint8_t* dst) {
+    Convert4To3<true>(src, num_pixels, dst);
+}
+
+void RgbaToRgb(const uint8_t* src, size_t num_pixels, uint8_t* dst) {
+    Convert4To3<false>(src, num_pixels, dst);
+}
+
+void BgrToRgb(const uint8_t* src, size_t num_pixels, uint8_t* dst)
+{
+    for (size_t i = 0; i < num_pixels; ++i)
+    {
+        const uint8_t* src_pixel = src + i * 3;
+        uint8_t* dst_pixel = dst + i * 3;
+        dst_pixel[0] = src_pixel[2];
+        dst_pixel[1] = src_pixel[1];
+        dst_pixel[2] = src_pixel[0];
+    }
+}
+
+void BgraToRgba(const uint8_t* src, size_t num_pixels, uint8_t* dst)
+{
+    size_t i = 0;
+#ifdef SF_USE_SSE2
+    // Green and alpha stay in place, and red and blue trade places within each 32-bit pixel
+    const __m128i green_alpha = _mm_set1_epi32((int)0xFF00FF00);
+    const __m128i low_byte = _mm_set1_epi32(0xFF);
+    for (; i + 4 <= num_pixels; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        __m128i red_blue = _mm_or_si128(
+            _mm_slli_epi32(_mm_and_si128(pixels, low_byte), 16),
+            _mm_and_si128(_mm_srli_epi32(pixels, 16), low_byte)
+        );
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_and_si128(pixels, green_alpha), red_blue));
+    }
+#endif
+    for (; i < num_pixels; ++i)
+    {
+        uint32_t pixel = Load32(src + i * 4);
+        Store32(dst + i * 4, (pixel & 0xFF00FF00) | SwapRedBlue(pixel & 0xFFFFFF));
+    }
+}
+
+void RgbToRgba(const uint8_t* src, size_t num_pixels, uint8_t* dst)
+{
+    for (size_t i = 0; i < num_pixels; ++i)
+    {
+        memcpy(dst + i * 4, src + i * 3, 3);
+        dst[i * 4 + 3] = 0xFF;
+    }
+}
+
+void BgrToRgba(const uint8_t* src, size_t num_pixels, uint8_t* dst)
+{
+    for (size_t i = 0; i < num_pixels; ++i)
+    {
+        const uint8_t* src_pixel = src + i * 3;
+        uint8_t* dst_pixel = dst + i * 4;
+        dst_pixel[0] = src_pixel[2];
+        dst_pixel[1] = src_pixel[1];
+        dst_pixel[2] = src_pixel[0];
+        dst_pixel[3] = 0xFF;
+    }
+}
+
+}
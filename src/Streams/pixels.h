@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Converters from the game's pixel layouts to tightly packed RGB or RGBA, as PNG and QOI expect.
+ *
+ * These have no D3D or game dependencies, so they can be built and exercised on their own.
+ * They're shared by the in-game writers and the offline transcoder.
+ */
+namespace Pixels
+{
+    /// @brief Convert 4-byte pixels with blue first in memory, like `D3DFMT_A8R8G8B8`
+    void BgraToRgb(const uint8_t* src, size_t num_pixels, uint8_t* dst);
+    /// @brief Convert 4-byte pixels with red first in memory, like `D3DFMT_A8B8G8R8`
+    void RgbaToRgb(const uint8_t* src, size_t num_pixels, uint8_t* dst);
+    /// @brief Convert 3-byte pixels with blue first in memory, like `D3DFMT_R8G8B8`
+    void BgrToRgb(const uint8_t* src, size_t num_pixels, uint8_t* dst);
+
+    /// @brief Convert 4-byte pixels with blue first in memory, like `D3DFMT_A8R8G8B8`, keeping alpha
+    void BgraToRgba(const uint8_t* src, size_t num_pixels, uint8_t* dst);
+    /// @brief Add opaque alpha to 3-byte pixels with red first in memory
+    void RgbToRgba(const uint8_t* src, size_t num_pixels, uint8_t* dst);
+    /// @brief Add opaque alpha to 3-byte pixels with blue first in memory, like `D3DFMT_R8G8B8`
+    void BgrToRgba(const uint8_t* src, size_t num_pixels, uint8_t* dst);
+}
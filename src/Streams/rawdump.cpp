@@ -0,0 +1,76 @@
+#include "rawdump.h"
+#include <Helper/lz4.h>
+#include <cstring>
+
+namespace RawDump
+{
+
+/// @brief Names longer than this are rejected while reading, as a sign of a corrupt header
+static constexpr uint32_t MAX_NAME_LENGTH = 4096;
+
+template <class T>
+static void WriteValue(std::ostream& output, T value) {
+    output.write((const char*)&value, sizeof(value));
+}
+
+template <class T>
+static bool ReadValue(std::istream& input, T* value) {
+    return (bool)input.read((char*)value, sizeof(*value));
+}
+
+bool WriteHeader(std::ostream& output, const Header& header)
+{
+    output.write(MAGIC, sizeof(MAGIC));
+    WriteValue<uint32_t>(output, VERSION);
+    WriteValue<uint32_t>(output, (uint32_t)header.format);
+    WriteValue<uint32_t>(output, header.width);
+    WriteValue<uint32_t>(output, header.height);
+    WriteValue<uint32_t>(output, header.framerate);
+    WriteValue<uint32_t>(output, (uint32_t)header.stream_name.size());
+    output.write(header.stream_name.data(), header.stream_name.size());
+    return (bool)output;
+}
+
+bool ReadHeader(std::istream& input, Header* header)
+{
+    char magic[sizeof(MAGIC)];
+    uint32_t version, format, name_length;
+    if (!input.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+    if (!ReadValue(input, &version) || version != VERSION)
+        return false;
+    if (!ReadValue(input, &format) || format > (uint32_t)PixelFormat::RGB)
+        return false;
+    header->format = (PixelFormat)format;
+    if (!ReadValue(input, &header->width) || !ReadValue(input, &header->height) || !ReadValue(input, &header->framerate))
+        return false;
+    if (!ReadValue(input, &name_length) || name_length > MAX_NAME_LENGTH)
+        return false;
+    header->stream_name.resize(name_length);
+    return (bool)input.read(header->stream_name.data(), name_length);
+}
+
+bool WriteFrameHeader(std::ostream& output, const FrameHeader& frame)
+{
+    WriteValue(output, frame.frame_index);
+    WriteValue(output, frame.flags);
+    WriteValue(output, frame.size);
+    return (bool)output;
+}
+
+bool ReadFrameHeader(std::istream& input, FrameHeader* frame) {
+    return ReadValue(input, &frame->frame_index) && ReadValue(input, &frame->flags) && ReadValue(input, &frame->size);
+}
+
+bool DecodeFrame(const Header& header, const FrameHeader& frame, const uint8_t* data, uint8_t* out)
+{
+    const size_t frame_size = header.GetFrameSize();
+    if (frame.flags & FRAME_LZ4)
+        return Helper::LZ4Decompress(data, frame.size, out, frame_size);
+    if (frame.size != frame_size)
+        return false;
+    memcpy(out, data, frame_size);
+    return true;
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <istream>
+#include <ostream>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief The file format of the "raw" encoder: uncompressed frames, to encode later with `sf-transcode`.
+ *
+ * A dump starts with a @ref Header, written by @ref WriteHeader. Each frame follows as a @ref FrameHeader,
+ * then `size` bytes of tightly packed rows. When @ref FRAME_LZ4 is set, those bytes are a raw LZ4 block.
+ * Integers are little-endian.
+ *
+ * These have no D3D or game dependencies, so they can be built and exercised on their own.
+ */
+namespace RawDump
+{
+    static constexpr char MAGIC[8] = "SFRAW";
+    static constexpr uint32_t VERSION = 1;
+    /// @brief The frame's pixels are compressed into an LZ4 block
+    static constexpr uint32_t FRAME_LZ4 = 1;
+
+    /// @brief Order of the channels in memory
+    enum class PixelFormat : uint32_t
+    {
+        BGRA,
+        RGBA,
+        BGR,
+        RGB,
+    };
+
+    struct Header
+    {
+        PixelFormat format = PixelFormat::BGRA;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t framerate = 0;
+        std::string stream_name;
+
+        size_t GetPixelStride() const { return format == PixelFormat::BGRA || format == PixelFormat::RGBA ? 4 : 3; }
+        size_t GetFrameSize() const { return (size_t)width * height * GetPixelStride(); }
+    };
+
+    struct FrameHeader
+    {
+        uint32_t frame_index = 0;
+        /// @brief Any of the `FRAME_` flags
+        uint32_t flags = 0;
+        /// @brief Bytes of pixel data that follow
+        uint32_t size = 0;
+    };
+
+    bool WriteHeader(std::ostream& output, const Header& header);
+    /// @return `false` if the input isn't a dump of a known version
+    bool ReadHeader(std::istream& input, Header* header);
+    bool WriteFrameHeader(std::ostream& output, const FrameHeader& frame);
+    /// @return `false` at the end of the dump
+    bool ReadFrameHeader(std::istream& input, FrameHeader* frame);
+    /**
+     * @brief Get the pixels of a frame, decompressing them if needed
+     * @param data The `frame.size` bytes that followed the frame header
+     * @param out Receives @ref Header::GetFrameSize bytes
+     * @return `false` if the data is malformed
+     */
+    bool DecodeFrame(const Header& header, const FrameHeader& frame, const uint8_t* data, uint8_t* out);
+}
@@ -0,0 +1,68 @@
+#include "readback.h"
+#include "videowriter.h"
+#include <d3d9.h>
+
+/// @brief Uses a D3D9 event query
+class ReadbackFenceDx9 : public ReadbackFence
+{
+public:
+    /// @details The query is taken without incrementing its ref count.
+    ReadbackFenceDx9(IDirect3DQuery9* query) : m_query(query) {}
+    ~ReadbackFenceDx9() { m_query->Release(); }
+
+    void Issue() override
+    {
+        m_query->Issue(D3DISSUE_END);
+        m_is_issued = true;
+    }
+
+    bool IsComplete() override
+    {
+        if (!m_is_issued)
+            return true;
+        // Flushing is required, or the query may never complete.
+        // Any failure (like a lost device) is treated as completion, so nothing waits forever.
+        return m_query->GetData(nullptr, 0, D3DGETDATA_FLUSH) != S_FALSE;
+    }
+
+private:
+    IDirect3DQuery9* m_query;
+    bool m_is_issued = false;
+};
+
+/// @brief Used when event queries aren't supported. Locking the surface will synchronize instead.
+class ReadbackFenceNone : public ReadbackFence
+{
+public:
+    void Issue() override {}
+    bool IsComplete() override { return true; }
+};
+
+ReadbackFence::Ptr ReadbackFence::Create(IDirect3DDevice9* device)
+{
+    IDirect3DQuery9* query;
+    if (FAILED(device->CreateQuery(D3DQUERYTYPE_EVENT, &query)))
+        return std::make_unique<ReadbackFenceNone>();
+    return std::make_unique<ReadbackFenceDx9>(query);
+}
+
+/// @brief Reads back into lockable render targets
+class ReadbackDeviceDx9 : public ReadbackDevice
+{
+public:
+    /// @details The device is taken without incrementing its ref count.
+    ReadbackDeviceDx9(IDirect3DDevice9* device) : m_device(device) {}
+
+    std::unique_ptr<FrameBufferBase> CreateBuffer(uint32_t width, uint32_t height, D3DFORMAT format) override {
+        return std::make_unique<FrameBufferDx9>(width, height, format);
+    }
+    ReadbackFence::Ptr CreateFence() override { return ReadbackFence::Create(m_device); }
+
+private:
+    IDirect3DDevice9* m_device;
+};
+
+ReadbackDevice::Ptr ReadbackDevice::Create(IDirect3DDevice9* device)
+{
+    return std::make_shared<ReadbackDeviceDx9>(device);
+}
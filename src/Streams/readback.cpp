@@ -0,0 +1,8 @@
+#include "readback.h"
+#include <thread>
+
+void ReadbackFence::Wait()
+{
+    while (!IsComplete())
+        std::this_thread::yield();
+}
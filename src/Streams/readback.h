@@ -0,0 +1,53 @@
+#pragma once
+#include <memory>
+#include <cstdint>
+#include <Helper/d3dformat.h>
+
+struct IDirect3DDevice9;
+class FrameBufferBase;
+
+/**
+ * @brief Signals when the GPU has finished the commands issued before it.
+ *
+ * Frames are copied to lockable surfaces on the game thread, but read by worker threads.
+ * Locking a surface before its copy is complete would stall inside the driver while holding the device's lock,
+ * so workers wait on a fence before locking.
+ */
+class ReadbackFence
+{
+public:
+    using Ptr = std::unique_ptr<ReadbackFence>;
+
+    virtual ~ReadbackFence() = default;
+    /// @brief Mark the end of the commands to wait for. Call this from the thread that issued the commands.
+    virtual void Issue() = 0;
+    /// @brief Check if the commands are complete, without blocking
+    virtual bool IsComplete() = 0;
+    /// @brief Block until the commands are complete
+    void Wait();
+
+    /**
+     * @brief Create a fence from an event query.
+     * @return A fence that's always complete, if the device doesn't support event queries.
+     */
+    static Ptr Create(IDirect3DDevice9* device);
+};
+
+/**
+ * @brief Creates the frame buffers that @ref FramePool reads back, and the fences that guard them.
+ * @details The pool only uses this interface, so it can be tested with a device that isn't a GPU.
+ */
+class ReadbackDevice
+{
+public:
+    using Ptr = std::shared_ptr<ReadbackDevice>;
+
+    virtual ~ReadbackDevice() = default;
+    /// @brief Create a buffer for the game thread to copy frames into. Only call this from the game thread.
+    virtual std::unique_ptr<FrameBufferBase> CreateBuffer(uint32_t width, uint32_t height, D3DFORMAT format) = 0;
+    /// @brief Create a fence for one buffer. Only call this from the game thread.
+    virtual ReadbackFence::Ptr CreateFence() = 0;
+
+    /// @brief Create lockable render targets and event query fences on a D3D9 device
+    static Ptr Create(IDirect3DDevice9* device);
+};
@@ -0,0 +1,121 @@
+#include "renderplan.h"
+#include "stream.h"
+#include "materials.h"
+#include <Base/Entity.h>
+#include <SDK/client_class.h>
+#include <SDK/const.h>
+#include <SDK/studio.h>
+#include <algorithm>
+
+RenderPlan::ConstPtr RenderPlan::Compile(const Stream& stream)
+{
+    auto plan = std::make_shared<RenderPlan>();
+
+    for (auto tweak = stream.begin<ModelTweak>(); tweak != stream.end<ModelTweak>(); ++tweak)
+    {
+        ModelEntry& entry = plan->models.emplace_back();
+        entry.tweak = std::make_shared<const ModelTweak>(*tweak);
+        entry.color = tweak->color_multiply;
+        entry.override_material = tweak->custom_material != nullptr;
+        entry.material = tweak->custom_material ? tweak->custom_material->GetMaterial() : nullptr;
+        entry.is_invisible = tweak->IsEffectInvisible();
+    }
+
+    // Only the first command tweak is used
+    auto cmd_tweak = stream.begin<CommandTweak>();
+    if (cmd_tweak != stream.end<CommandTweak>())
+        cmd_tweak->Compile(&plan->commands);
+
+    for (auto tweak = stream.begin<MaterialTweak>(); tweak != stream.end<MaterialTweak>(); ++tweak)
+    {
+        for (size_t i = 0; i < plan->material_groups.size(); ++i)
+        {
+            if (tweak->IsGroupAffected(i))
+                plan->material_groups[i] = { true, tweak->color_multiply };
+        }
+    }
+
+    // Only the first material tweak affects props
+    auto mat_tweak = stream.begin<MaterialTweak>();
+    if (mat_tweak != stream.end<MaterialTweak>())
+    {
+        plan->affect_props = mat_tweak->props;
+        plan->prop_color = mat_tweak->color_multiply;
+    }
+
+    for (auto tweak = stream.begin<CameraTweak>(); tweak != stream.end<CameraTweak>(); ++tweak)
+    {
+        if (tweak->fov_override)
+        {
+            plan->fov_override = true;
+            plan->fov = tweak->fov;
+        }
+        plan->hide_fade |= tweak->hide_fade;
+        if (!plan->pixel_shader)
+            plan->pixel_shader = tweak->pixel_shader;
+    }
+
+    // Only the first camera tweak chooses the HUD visibility
+    auto cam_tweak = stream.begin<CameraTweak>();
+    if (cam_tweak != stream.end<CameraTweak>())
+        plan->hud = cam_tweak->hud;
+
+    return plan;
+}
+
+uint64_t RenderPlan::GetAffectedModels(int entity_index, CBaseEntity* entity) const
+{
+    // Client-side entities don't have a networked index
+    if (entity_index < 0 || entity_index >= MAX_EDICTS)
+        return ClassifyEntity(entity);
+
+    if (m_entity_cache.size() <= (size_t)entity_index)
+        m_entity_cache.resize(entity_index + 1);
+
+    ClientClass* client_class = entity->GetClientClass();
+    EntityCacheEntry& cached = m_entity_cache[entity_index];
+    if (cached.client_class != client_class)
+    {
+        cached.client_class = client_class;
+        cached.affected = ClassifyEntity(entity);
+    }
+    return cached.affected;
+}
+
+uint64_t RenderPlan::ClassifyEntity(CBaseEntity* entity) const
+{
+    uint64_t affected = 0;
+    size_t count = std::min<size_t>(models.size(), MAX_CACHED_MODELS);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (models[i].tweak->IsEntityAffected(entity))
+            affected |= 1ull << i;
+    }
+    return affected;
+}
+
+uint64_t RenderPlan::GetAffectedModels(const studiohdr_t* hdr) const
+{
+    auto insertion = m_model_cache.try_emplace(hdr);
+    ModelCacheEntry& cached = insertion.first->second;
+    if (insertion.second || cached.checksum != hdr->checksum)
+    {
+        cached.checksum = hdr->checksum;
+        cached.affected = ClassifyModel(hdr);
+    }
+    return cached.affected;
+}
+
+uint64_t RenderPlan::ClassifyModel(const studiohdr_t* hdr) const
+{
+    // NOTE: DO NOT use `pszName()`. This crashes in 64-bit TF2.
+    std::string_view name = hdr->name;
+    uint64_t affected = 0;
+    size_t count = std::min<size_t>(models.size(), MAX_CACHED_MODELS);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (models[i].tweak->IsModelAffected(name))
+            affected |= 1ull << i;
+    }
+    return affected;
+}
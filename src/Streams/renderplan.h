@@ -0,0 +1,113 @@
+#pragma once
+#include "rendertweak.h"
+#include "materialindex.h"
+#include <memory>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+
+class Stream;
+class IMaterial;
+class CBaseEntity;
+class ClientClass;
+struct studiohdr_t;
+
+/**
+ * @brief An immutable, pre-resolved snapshot of a stream, for use in render hooks.
+ *
+ * Render hooks run for every model draw, so they read a plan instead of iterating the stream's tweaks.
+ * Plans are compiled by @ref ActiveStream when a stream is set or signalled for an update.
+ * Modifying the stream afterwards has no effect on an existing plan.
+ */
+class RenderPlan
+{
+public:
+    using ConstPtr = std::shared_ptr<const RenderPlan>;
+
+    struct ModelEntry
+    {
+        /// @brief A private copy of the tweak, used for its filters
+        std::shared_ptr<const ModelTweak> tweak;
+        std::array<float, 4> color;
+        /// @brief The custom material. Only used when @ref override_material is true.
+        IMaterial* material;
+        bool override_material;
+        bool is_invisible;
+    };
+
+    struct MaterialGroup
+    {
+        bool affected = false;
+        std::array<float, 4> color = { 1,1,1,1 };
+        bool operator==(const MaterialGroup& other) const = default;
+    };
+    using MaterialGroups = std::array<MaterialGroup, MaterialIndex::NUM_GROUPS>;
+
+    /// @brief Number of @ref models whose filters are cached. Further entries must be checked directly.
+    static constexpr size_t MAX_CACHED_MODELS = 64;
+    /// @brief Dev option, for comparing hook times with and without the filter caches
+    static inline std::atomic<bool> filter_cache_enabled = true;
+
+    /// @brief Compile a plan from the stream. Lock the stream for reading beforehand.
+    static ConstPtr Compile(const Stream& stream);
+
+    /**
+     * @brief Check which @ref models are affected by an entity.
+     * 
+     * Entity filters only depend on the entity's class, so results are cached by entity index
+     * and recomputed when an index is reused by an entity of another class.
+     * Only call this from the thread that draws models.
+     * 
+     * @return A bit for each of the first @ref MAX_CACHED_MODELS entries in @ref models
+     */
+    uint64_t GetAffectedModels(int entity_index, CBaseEntity* entity) const;
+    /// @brief Same as @ref GetAffectedModels, without the cache
+    uint64_t ClassifyEntity(CBaseEntity* entity) const;
+    /**
+     * @brief Check which @ref models are affected by a model's path.
+     * 
+     * Results are memoized per model header. The header's checksum is also compared,
+     * in case a header's memory is reused for another model after a level change.
+     * Only call this from the thread that draws models.
+     * 
+     * @return A bit for each of the first @ref MAX_CACHED_MODELS entries in @ref models
+     */
+    uint64_t GetAffectedModels(const studiohdr_t* hdr) const;
+    /// @brief Same as @ref GetAffectedModels, without the cache
+    uint64_t ClassifyModel(const studiohdr_t* hdr) const;
+
+    /// @brief Every @ref ModelTweak, in order
+    std::vector<ModelEntry> models;
+    /// @brief Commands from the first @ref CommandTweak
+    CommandTweak::Compiled commands;
+    /// @brief The color of each @ref MaterialIndex group, from the last @ref MaterialTweak that affects it
+    MaterialGroups material_groups;
+    /// @brief True if static props are affected by the first @ref MaterialTweak
+    bool affect_props = false;
+    std::array<float, 4> prop_color = { 1,1,1,1 };
+    bool fov_override = false;
+    float fov = 90;
+    bool hide_fade = false;
+    CameraTweak::HudChoice hud = CameraTweak::HUD_DEFAULT;
+    /// @brief The first pixel shader, or `nullptr`
+    std::shared_ptr<Shader::PixelShader> pixel_shader = nullptr;
+
+private:
+    struct EntityCacheEntry
+    {
+        ClientClass* client_class = nullptr;
+        uint64_t affected = 0;
+    };
+
+    struct ModelCacheEntry
+    {
+        int checksum;
+        uint64_t affected;
+    };
+
+    /// @brief Indexed by entity index. Grows as needed.
+    mutable std::vector<EntityCacheEntry> m_entity_cache;
+    mutable std::unordered_map<const studiohdr_t*, ModelCacheEntry> m_model_cache;
+};
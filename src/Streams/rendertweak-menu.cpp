@@ -137,6 +137,24 @@ void CommandTweak::OnMenu()
     );
     if (ImGui::Button("Presets"))
         ImGui::OpenPopup(POPUP_PRESETS);
+
+    if (commands != m_menu_commands)
+    {
+        Compiled compiled;
+        Compile(&compiled);
+        m_menu_commands = commands;
+        m_menu_num_commands = compiled.commands.size();
+    }
+    if (m_menu_num_commands > 0)
+    {
+        ImGui::SameLine();
+        ImGui::TextColored(ImVec4(1,1,0,1), "[!] %zu non-ConVar command(s)", m_menu_num_commands);
+        ImGui::SameLine(); Helper::ImGuiHelpMarker(
+            "Commands that aren't ConVars (like \"r_cleardecals\") can't be compared or restored.\n"
+            "They are executed every time this stream is rendered, which is slow when recording many streams."
+        );
+    }
+
     ImGui::PushItemWidth(-1);
     should_update |= ImGui::InputTextMultiline("##commands", &commands, ImVec2(0, -1));
     ImGui::SameLine(); Helper::ImGuiHelpMarker("In Team Fortress 2, this affects the glow outlines that appear on objectives");
@@ -173,7 +191,7 @@ void CommandTweak::OnMenu()
     }
 
     if (should_update)
-        g_active_stream.SignalUpdate(nullptr, ActiveStream::UPDATE_CONVARS);
+        g_active_stream.SignalUpdate(nullptr, ActiveStream::UPDATE_CONVARS | ActiveStream::UPDATE_RENDER_PLAN);
 }
 
 nlohmann::json CommandTweak::SubclassToJson() const
@@ -223,6 +241,7 @@ void ModelTweak::OnMenu()
 {
     const char* const ENTITY_POPUP = "##popup_add_class";
     const char* const MODEL_POPUP = "##popup_add_model";
+    bool should_update = false;
 
     if (ImGui::BeginCombo("Material", custom_material ? custom_material->GetName().c_str() : MATERIAL_CHOICE_NAME[(int)render_effect]))
     {
@@ -233,6 +252,7 @@ void ModelTweak::OnMenu()
             {
                 render_effect = (MaterialChoice)i;
                 custom_material = nullptr;
+                should_update = true;
             }
         }
 
@@ -244,6 +264,7 @@ void ModelTweak::OnMenu()
             {
                 render_effect = MaterialChoice::CUSTOM;
                 custom_material = mat;
+                should_update = true;
             }
             ImGui::PopID();
             ++i;
@@ -252,14 +273,14 @@ void ModelTweak::OnMenu()
     }
     ImGui::SameLine(); Helper::ImGuiHelpMarker("Change how the models/textures are rendered");
 
-    ImGui::ColorEdit4("Color multiply", color_multiply.data());
+    should_update |= ImGui::ColorEdit4("Color multiply", color_multiply.data());
     ImGui::SameLine(); Helper::ImGuiHelpMarker("Use this with the matte material to get a solid color.");
 
     ImGui::TextUnformatted("Affected models:");
     
-    ImGui::RadioButton("All models", (int*)&filter_choice, (int)FilterChoice::ALL);
-    ImGui::RadioButton("Models in the list", (int*)&filter_choice, (int)FilterChoice::WHITELIST);
-    ImGui::RadioButton("Models not in the list", (int*)&filter_choice, (int)FilterChoice::BLACKLIST);
+    should_update |= ImGui::RadioButton("All models", (int*)&filter_choice, (int)FilterChoice::ALL);
+    should_update |= ImGui::RadioButton("Models in the list", (int*)&filter_choice, (int)FilterChoice::WHITELIST);
+    should_update |= ImGui::RadioButton("Models not in the list", (int*)&filter_choice, (int)FilterChoice::BLACKLIST);
 
     // === Include entities === //
     static ClientClass* selected_class = nullptr;
@@ -269,15 +290,15 @@ void ModelTweak::OnMenu()
 
     ImGui::BeginGroup();
 
-    ImGui::Checkbox("Players", &filter_player);
-    ImGui::Checkbox("Weapons", &filter_weapon);
+    should_update |= ImGui::Checkbox("Players", &filter_player);
+    should_update |= ImGui::Checkbox("Weapons", &filter_weapon);
 
     ImGui::EndGroup();
     ImGui::SameLine();
     ImGui::BeginGroup();
 
-    ImGui::Checkbox("Wearables", &filter_wearable);
-    ImGui::Checkbox("Projectiles", &filter_projectile);
+    should_update |= ImGui::Checkbox("Wearables", &filter_wearable);
+    should_update |= ImGui::Checkbox("Projectiles", &filter_projectile);
 
     ImGui::EndGroup();
     
@@ -290,12 +311,14 @@ void ModelTweak::OnMenu()
     {
         auto lock = g_active_stream.WriteLock();
         classes.erase(selected_class);
+        should_update = true;
     }
     ImGui::SameLine();
     if (ImGui::Button("Remove all##class"))
     {
         auto lock = g_active_stream.WriteLock();
         classes.clear();
+        should_update = true;
     }
 
     if (ImGui::BeginListBox("##class_list", Helper::CalcListBoxSize(classes.size())))
@@ -326,6 +349,7 @@ void ModelTweak::OnMenu()
             {
                 auto lock = g_active_stream.WriteLock();
                 model_paths.erase(it);
+                should_update = true;
                 break;
             }
         }
@@ -335,6 +359,7 @@ void ModelTweak::OnMenu()
     {
         auto lock = g_active_stream.WriteLock();
         model_paths.clear();
+        should_update = true;
     }
 
     if (ImGui::BeginListBox("##model_list", Helper::CalcListBoxSize(model_paths.size())))
@@ -369,6 +394,7 @@ void ModelTweak::OnMenu()
                     {
                         auto lock = g_active_stream.WriteLock();
                         classes.emplace(next_class);
+                        should_update = true;
                     }
                 }
             }
@@ -388,7 +414,8 @@ void ModelTweak::OnMenu()
         if (ImGui::Button("Add"))
         {
             auto lock = g_active_stream.WriteLock();
-            model_paths.emplace(search_input.data());
+            model_paths.emplace(Helper::NormalizePath(search_input.data()));
+            should_update = true;
         }
 
         ImGui::SetNextItemWidth(-1);
@@ -402,7 +429,8 @@ void ModelTweak::OnMenu()
                     if (ImGui::Selectable(name.c_str(), false, ImGuiSelectableFlags_DontClosePopups))
                     {
                         auto lock = g_active_stream.WriteLock();
-                        model_paths.emplace(name);
+                        model_paths.emplace(Helper::NormalizePath(name));
+                        should_update = true;
                     }
                     if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNone))
                         ImGui::SetTooltip("%s", name.c_str());
@@ -423,6 +451,9 @@ void ModelTweak::OnMenu()
         
         ImGui::EndPopup();
     }
+
+    if (should_update)
+        g_active_stream.SignalUpdate(nullptr, ActiveStream::UPDATE_RENDER_PLAN);
 }
 
 nlohmann::json ModelTweak::SubclassToJson() const
@@ -508,7 +539,7 @@ void ModelTweak::SubclassFromJson(const nlohmann::json* json)
     if (j_model_paths && j_model_paths->is_array())
     {
         for (auto& j_path : *j_model_paths)
-            model_paths.emplace(j_path.get<std::string>());
+            model_paths.emplace(Helper::NormalizePath(j_path.get_ref<const nlohmann::json::string_t&>()));
     }
 }
 
@@ -550,7 +581,7 @@ void MaterialTweak::OnMenu()
         ImGui::EndDisabled();
 
     if (should_update)
-        g_active_stream.SignalUpdate(nullptr, ActiveStream::UPDATE_MATERIALS);
+        g_active_stream.SignalUpdate(nullptr, ActiveStream::UPDATE_MATERIALS | ActiveStream::UPDATE_RENDER_PLAN);
 }
 
 nlohmann::json MaterialTweak::SubclassToJson() const
@@ -600,17 +631,18 @@ void MaterialTweak::SubclassFromJson(const nlohmann::json* json)
 
 void CameraTweak::OnMenu()
 {
-    ImGui::Checkbox("FOV override", &fov_override);
+    bool should_update = false;
+    should_update |= ImGui::Checkbox("FOV override", &fov_override);
 
     if (!fov_override)
         ImGui::BeginDisabled();
 
-    ImGui::SliderFloat("FOV", &fov, 0, 180);
+    should_update |= ImGui::SliderFloat("FOV", &fov, 0, 180);
 
     if (!fov_override)
         ImGui::EndDisabled();
 
-    ImGui::Checkbox("Hide fade effects", &hide_fade); ImGui::SameLine();
+    should_update |= ImGui::Checkbox("Hide fade effects", &hide_fade); ImGui::SameLine();
     Helper::ImGuiHelpMarker("This hides the effects of flashbangs, teleporters, and other mechanics that normally cover the screen.");
 
     if (ImGui::BeginCombo("HUD visiblity", HUD_CHOICE_NAME[hud]))
@@ -618,7 +650,10 @@ void CameraTweak::OnMenu()
         for (int i = 0; i < HUD_CHOICE_NAME.size(); ++i)
         {
             if (ImGui::Selectable(HUD_CHOICE_NAME[i], i == hud))
+            {
                 hud = (HudChoice)i;
+                should_update = true;
+            }
         }
         ImGui::EndCombo();
     }
@@ -626,11 +661,17 @@ void CameraTweak::OnMenu()
     if (ImGui::BeginCombo("Pixel shader", pixel_shader ? pixel_shader->GetDisplayName() : "None"))
     {
         if (ImGui::Selectable("None", false))
+        {
             pixel_shader = nullptr;
+            should_update = true;
+        }
         for (const Shader::PixelShader::ConstPtr& shader : *Shader::PixelShader::GetLoadedShaders())
         {
             if (ImGui::Selectable(shader->GetDisplayName(), false))
+            {
                 pixel_shader = shader->NewInstance();
+                should_update = true;
+            }
             if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNone))
                 ImGui::SetTooltip("%s", shader->GetDesc());
         }
@@ -643,6 +684,9 @@ void CameraTweak::OnMenu()
         pixel_shader->OnMenu();
         ImGui::PopID();
     }
+
+    if (should_update)
+        g_active_stream.SignalUpdate(nullptr, ActiveStream::UPDATE_RENDER_PLAN);
 }
 
 nlohmann::json CameraTweak::SubclassToJson() const
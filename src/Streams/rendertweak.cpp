@@ -2,8 +2,12 @@
 #include <SDK/texture_group_names.h>
 #include <SDK/imaterial.h>
 #include <Base/Entity.h>
+#include <Base/Interfaces.h>
+#include <SDK/icvar.h>
+#include <SDK/convar.h>
 #include <Helper/engine.h>
 #include <Helper/str.h>
+#include <algorithm>
 
 const std::array<const char*, 27> MaterialTweak::TEXTURE_GROUPS = {
     TEXTURE_GROUP_LIGHTMAP,
@@ -46,6 +50,34 @@ void CommandTweak::GetCommandList(std::vector<Helper::ParsedCommand>* output) co
     }
 }
 
+void CommandTweak::Compile(Compiled* output) const
+{
+    std::vector<Helper::ParsedCommand> parsed_cmds;
+    GetCommandList(&parsed_cmds);
+
+    for (auto& cmd : parsed_cmds)
+    {
+        std::string cmd_name = std::string(cmd.name);
+        ConVar* cvar = Interfaces::cvar->FindVar(cmd_name.c_str());
+        if (!cvar)
+        {
+            // It's probably a command
+            cmd_name += ' ';
+            cmd_name += cmd.args;
+            output->commands.push_back(std::move(cmd_name));
+            continue;
+        }
+
+        auto existing = std::find_if(output->convars.begin(), output->convars.end(),
+            [cvar](const ConVarValue& value) { return value.convar == cvar; }
+        );
+        if (existing != output->convars.end())
+            existing->value = cmd.args;
+        else
+            output->convars.push_back(ConVarValue{cvar, std::string(cmd.args)});
+    }
+}
+
 bool ModelTweak::IsEntityAffected(CBaseEntity* entity) const
 {
     if (filter_choice == FilterChoice::ALL)
@@ -70,17 +102,13 @@ bool ModelTweak::HasEntityFilters() const
     return !classes.empty();
 }
 
-bool ModelTweak::IsModelAffected(const std::string& path) const
+bool ModelTweak::IsModelAffected(std::string_view path) const
 {
     if (filter_choice == FilterChoice::ALL)
         return true;
 
-    for (auto& model_path : model_paths)
-    {
-		if (Helper::CaseInsensitivePathCompare(path.c_str(), model_path.c_str()) == 0)
-			return filter_choice == FilterChoice::WHITELIST;
-	}
-
+    if (model_paths.find(path) != model_paths.end())
+        return filter_choice == FilterChoice::WHITELIST;
     return filter_choice == FilterChoice::BLACKLIST;
 }
 
@@ -89,23 +117,25 @@ bool ModelTweak::IsEffectInvisible() const {
 }
 
 bool MaterialTweak::IsMaterialAffected(class IMaterial* material) const
+{
+    return IsGroupAffected(GetTextureGroupIndex(material->GetTextureGroupName()));
+}
+
+bool MaterialTweak::IsGroupAffected(size_t group_index) const
 {
     if (filter_choice == FilterChoice::ALL)
         return true;
     
-    bool is_match = false;
-    
-    // TODO: Make this a hash set
-    for (size_t i = 0; i < groups.size(); ++i)
+    bool is_match = group_index < groups.size() && groups[group_index];
+    return filter_choice == FilterChoice::WHITELIST ? is_match : !is_match;
+}
+
+size_t MaterialTweak::GetTextureGroupIndex(const char* group_name)
+{
+    for (size_t i = 0; i < TEXTURE_GROUPS.size(); ++i)
     {
-        if (!groups[i])
-            continue;
-        if (!strcmp(material->GetTextureGroupName(), MaterialTweak::TEXTURE_GROUPS[i]))
-        {
-            is_match = true;
-            break;
-        }
+        if (!strcmp(group_name, TEXTURE_GROUPS[i]))
+            return i;
     }
-
-    return filter_choice == FilterChoice::WHITELIST ? is_match : !is_match;
+    return TEXTURE_GROUPS.size();
 }
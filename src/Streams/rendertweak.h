@@ -5,12 +5,16 @@
 #include <array>
 #include <string>
 #include <Helper/json.h>
+#include <Helper/str.h>
 
 namespace Helper { class ParsedCommand; }
 namespace Shader { class PixelShader; }
 class CBaseEntity;
+class ConVar;
 class ClientClass;
 enum class FilterChoice : int { ALL, WHITELIST, BLACKLIST, _COUNT };
+/// @brief A compile-time ID for each @ref RenderTweak subclass
+enum class TweakType : size_t { COMMAND, MODEL, MATERIAL, CAMERA, FOG, _COUNT };
 
 /// @brief Configurable variables for one part of the rendering process.
 /// @details Each subclass will typically provide settings for a specific, hooked render function.
@@ -24,6 +28,7 @@ public:
     
     /// @return A class-specific display name. Must be unique.
     virtual const char* GetName() const = 0;
+    virtual TweakType GetType() const = 0;
     virtual std::shared_ptr<RenderTweak> Clone() const = 0;
     /// @brief Display the controls to edit the tweak
     virtual void OnMenu() = 0;
@@ -47,13 +52,31 @@ protected:
 class CommandTweak : public RenderTweak
 {
 public:
+    static constexpr TweakType TYPE = TweakType::COMMAND;
     const char* GetName() const override { return "Commands"; }
+    TweakType GetType() const override { return TYPE; }
     std::shared_ptr<RenderTweak> Clone() const override {
         return std::make_shared<CommandTweak>(*this);
     }
+    /// @brief A ConVar and the value it should be set to
+    struct ConVarValue
+    {
+        ConVar* convar;
+        std::string value;
+    };
+    /// @brief The commands, resolved ahead of time
+    struct Compiled
+    {
+        std::vector<ConVarValue> convars;
+        /// @brief Commands that aren't ConVars. They must be executed every time the stream is applied.
+        std::vector<std::string> commands;
+    };
+
     void OnMenu() override;
     /// @brief Split @ref commands into individual commands and add them to a vector
     void GetCommandList(std::vector<Helper::ParsedCommand>* output) const;
+    /// @brief Resolve each command into a ConVar and value. Later values of the same ConVar take priority.
+    void Compile(Compiled* output) const;
 
     /// @brief Console commands separated by newlines or semicolons
     std::string commands;
@@ -61,6 +84,12 @@ public:
 protected:
     nlohmann::json SubclassToJson() const override;
     void SubclassFromJson(const nlohmann::json* json) override;
+
+private:
+    /// @brief The @ref commands that the menu last compiled, so it only compiles them again after they change
+    std::string m_menu_commands;
+    /// @brief Number of non-ConVar commands in @ref m_menu_commands
+    size_t m_menu_num_commands = 0;
 };
 
 class ModelTweak : public RenderTweak
@@ -71,7 +100,9 @@ public:
         "Normal", "Invisible", "Custom"
     };
 
+    static constexpr TweakType TYPE = TweakType::MODEL;
     const char* GetName() const override { return "Models"; }
+    TweakType GetType() const override { return TYPE; }
     std::shared_ptr<RenderTweak> Clone() const override {
         return std::make_shared<ModelTweak>(*this);
     }
@@ -82,7 +113,7 @@ public:
 
     /// @return `true` if an entity should be rendered differently than normal
     bool IsEntityAffected(CBaseEntity* entity) const;
-    bool IsModelAffected(const std::string& path) const;
+    bool IsModelAffected(std::string_view path) const;
     /// @return `true` if the effect will make an entity invisible
     bool IsEffectInvisible() const;
 
@@ -96,8 +127,8 @@ public:
 
     /// @brief A list of entity classes to filter
     std::unordered_set<ClientClass*> classes;
-    /// @brief A list of model paths to filter. Paths must be lowercase with forward-slashes.
-    std::unordered_set<std::string> model_paths;
+    /// @brief A list of model paths to filter. Paths must be normalized with @ref Helper::NormalizePath.
+    Helper::PathSet model_paths;
     bool filter_player = false;
     bool filter_weapon = false;
     bool filter_wearable = false;
@@ -113,13 +144,19 @@ class MaterialTweak : public RenderTweak
 public:
     static const std::array<const char*, 27> TEXTURE_GROUPS;
 
+    static constexpr TweakType TYPE = TweakType::MATERIAL;
     const char* GetName() const override { return "Materials"; }
+    TweakType GetType() const override { return TYPE; }
     std::shared_ptr<RenderTweak> Clone() const override {
         return std::make_shared<MaterialTweak>(*this);
     }
     void OnMenu() override;
 
     bool IsMaterialAffected(class IMaterial* material) const;
+    /// @param group_index An index from @ref GetTextureGroupIndex
+    bool IsGroupAffected(size_t group_index) const;
+    /// @return The index of a group in @ref TEXTURE_GROUPS, or `TEXTURE_GROUPS.size()` if it isn't listed.
+    static size_t GetTextureGroupIndex(const char* group_name);
 
     /// @brief A color multiply given to each material
     std::array<float, 4> color_multiply = { 1,1,1,1 };
@@ -144,7 +181,9 @@ public:
         "Default", "Disabled", "Enabled"
     };
 
+    static constexpr TweakType TYPE = TweakType::CAMERA;
     const char* GetName() const override { return "Camera"; }
+    TweakType GetType() const override { return TYPE; }
     std::shared_ptr<RenderTweak> Clone() const override {
         return std::make_shared<CameraTweak>(*this);
     }
@@ -164,7 +203,9 @@ protected:
 class FogTweak : public RenderTweak
 {
 public:
+    static constexpr TweakType TYPE = TweakType::FOG;
     const char* GetName() const override { return "Fog"; }
+    TweakType GetType() const override { return TYPE; }
     std::shared_ptr<RenderTweak> Clone() const override {
         return std::make_shared<FogTweak>(*this);
     }
@@ -1,6 +1,7 @@
 #include "stream.h"
 #include <nlohmann/json.hpp>
 #include "materials.h"
+#include "videowriter.h"
 #include <Shaders/shaders.h>
 #include <Base/Interfaces.h>
 #include <SDK/texture_group_names.h>
@@ -9,10 +10,34 @@ Stream::Ptr Stream::Clone(const std::string& new_name) const
 {
     Stream::Ptr clone = std::make_shared<Stream>(new_name);
     for (auto& tweak : m_tweaks)
-        clone->m_tweaks.emplace_back(std::move(tweak->Clone()));
+        clone->AddTweak(tweak->Clone());
+    if (m_videoconfig)
+        clone->m_videoconfig = std::make_shared<EncoderConfig>(*m_videoconfig);
     return clone;
 }
 
+void Stream::AddTweak(ElementType tweak)
+{
+    m_buckets[(size_t)tweak->GetType()].push_back(tweak.get());
+    m_tweaks.emplace_back(std::move(tweak));
+}
+
+void Stream::RemoveTweak(size_t index)
+{
+    if (index >= m_tweaks.size())
+        return;
+    m_tweaks.erase(m_tweaks.begin() + index);
+    UpdateBuckets();
+}
+
+void Stream::UpdateBuckets()
+{
+    for (auto& bucket : m_buckets)
+        bucket.clear();
+    for (auto& tweak : m_tweaks)
+        m_buckets[(size_t)tweak->GetType()].push_back(tweak.get());
+}
+
 nlohmann::json Stream::ToJson() const
 {
     nlohmann::json j = {
@@ -23,6 +48,8 @@ nlohmann::json Stream::ToJson() const
     for (RenderTweak::ConstPtr tweak : m_tweaks)
         j_tweak_arr.emplace_back(tweak->ToJson());
     j.emplace("tweaks", std::move(j_tweak_arr));
+    if (m_videoconfig)
+        j.emplace("videoconfig", m_videoconfig->ToJson());
     return j;
 }
 void Stream::FromJson(const nlohmann::json* j)
@@ -56,9 +83,16 @@ void Stream::FromJson(const nlohmann::json* j)
         {
             RenderTweak::Ptr tweak = RenderTweak::CreateFromJson(&j_tweak);
             if (tweak)
-                m_tweaks.emplace_back(std::move(tweak));
+                AddTweak(std::move(tweak));
         }
     }
+
+    const nlohmann::json* j_videoconfig = Helper::FromJson(j, "videoconfig");
+    if (j_videoconfig && j_videoconfig->is_object())
+    {
+        m_videoconfig = std::make_shared<EncoderConfig>();
+        m_videoconfig->FromJson(j_videoconfig);
+    }
 }
 Stream::Ptr Stream::CreateFromJson(const nlohmann::json* json)
 {
@@ -93,15 +127,15 @@ std::vector<Stream::ConstPtr> Stream::MakePresets()
         entities->filter_player = true;
         entities->filter_weapon = true;
         entities->filter_wearable = true;
-        matte->m_tweaks.emplace_back(std::move(entities));
+        matte->AddTweak(std::move(entities));
 
         auto fog = std::make_shared<FogTweak>();
         fog->fog_enabled = true;
-        matte->m_tweaks.emplace_back(std::move(fog));
+        matte->AddTweak(std::move(fog));
 
         auto cam = std::make_shared<CameraTweak>();
         cam->hud = CameraTweak::HUD_DISABLED;
-        matte->m_tweaks.emplace_back(std::move(cam));
+        matte->AddTweak(std::move(cam));
 
         auto misc = std::make_shared<CommandTweak>();
         misc->commands =
@@ -110,7 +144,7 @@ std::vector<Stream::ConstPtr> Stream::MakePresets()
             "glow_outline_effect_enable 0\n"
             "r_screenoverlay off";
         // Particles are intentionally left enabled, so they may obscure the player matte
-        matte->m_tweaks.emplace_back(std::move(misc));
+        matte->AddTweak(std::move(misc));
 
         // Get rid of the "client effects" materials by making them black
         auto materials = std::make_shared<MaterialTweak>();
@@ -122,7 +156,7 @@ std::vector<Stream::ConstPtr> Stream::MakePresets()
             const char* group = MaterialTweak::TEXTURE_GROUPS[i];
             materials->groups[i] = !strcmp(group, TEXTURE_GROUP_CLIENT_EFFECTS);
         }
-        matte->m_tweaks.push_back(std::move(materials));
+        matte->AddTweak(std::move(materials));
 
         vec.emplace_back(std::move(matte));
     }
@@ -132,11 +166,11 @@ std::vector<Stream::ConstPtr> Stream::MakePresets()
 
         auto cam = std::make_shared<CameraTweak>();
         cam->pixel_shader = Shader::PixelShader::GetLoadedShader<Shader::DepthLinear>();
-        depth->m_tweaks.emplace_back(std::move(cam));
+        depth->AddTweak(std::move(cam));
 
         auto misc = std::make_shared<CommandTweak>();
         misc->commands = "r_drawvgui 0";
-        depth->m_tweaks.push_back(std::move(misc));
+        depth->AddTweak(std::move(misc));
         
         vec.emplace_back(std::move(depth));
     }
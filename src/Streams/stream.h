@@ -3,6 +3,11 @@
 #include "rendertweak.h"
 #include <string>
 #include <memory>
+#include <vector>
+#include <array>
+#include <type_traits>
+
+class EncoderConfig;
 
 /**
  * @brief A combination of render tweaks to be used while rendering a frame.
@@ -21,7 +26,12 @@ public:
     Ptr Clone(const std::string& new_name) const;
     std::string& GetName() { return m_name; }
     const std::string& GetName() const { return m_name; }
-    std::vector<ElementType>& GetRenderTweaks() { return m_tweaks; }
+    const std::vector<ElementType>& GetRenderTweaks() const { return m_tweaks; }
+    void AddTweak(ElementType tweak);
+    void RemoveTweak(size_t index);
+    /// @brief Encoder options that override the recorder's, or `nullptr` to use the recorder's
+    const std::shared_ptr<EncoderConfig>& GetVideoConfig() const { return m_videoconfig; }
+    void SetVideoConfig(std::shared_ptr<EncoderConfig> config) { m_videoconfig = std::move(config); }
     nlohmann::json ToJson() const override;
     void FromJson(const nlohmann::json* json) override;
     /// @brief Create a new instance from JSON
@@ -30,26 +40,27 @@ public:
 
     static const std::vector<ConstPtr>& GetPresets();
     
+    /// @brief Iterates the tweaks of type `T`, in order
     template <class T>
     class const_type_iterator
     {
     public:
         static const_type_iterator begin(const Stream& r) {
-            return const_type_iterator::const_type_iterator(get_begin_ptr(r), get_end_ptr(r));
+            auto& bucket = r.GetBucket<T>();
+            return const_type_iterator(bucket.data());
         }
         static const_type_iterator end(const Stream& r) {
-            return const_type_iterator::const_type_iterator(get_end_ptr(r), get_end_ptr(r));
+            auto& bucket = r.GetBucket<T>();
+            return const_type_iterator(bucket.data() + bucket.size());
         }
         
         const_type_iterator& operator++() {
-            do {
-                ++ptr;
-            } while (ptr < ptr_end && std::dynamic_pointer_cast<T>(*ptr) == nullptr);
+            ++ptr;
             return *this;
         }
 
-        std::shared_ptr<T> operator*() const { return std::dynamic_pointer_cast<T>(*ptr); }
-        std::shared_ptr<T> operator->() const { return std::dynamic_pointer_cast<T>(*ptr); }
+        T& operator*() const { return *static_cast<T*>(*ptr); }
+        T* operator->() const { return static_cast<T*>(*ptr); }
         bool operator==(const const_type_iterator<T>& other) const {
             return this->ptr == other.ptr;
         }
@@ -58,27 +69,9 @@ public:
         }
 
     private:
-        const_type_iterator(const ElementType* next, const ElementType* end)
-            : ptr(next), ptr_end(end) {}
-        
-        static const ElementType* get_begin_ptr(const Stream& r)
-        {
-            auto& tweaks = r.GetRenderTweaks();
-            for (auto& tweak : tweaks)
-            {
-                if (std::dynamic_pointer_cast<T>(tweak) != nullptr)
-                    return &tweak;
-            }
-            return get_end_ptr(r);
-        }
-        
-        static const ElementType* get_end_ptr(const Stream& r) {
-            auto& tweaks = r.GetRenderTweaks();
-            return tweaks.empty() ? nullptr : (&tweaks.back() + 1);
-        }
+        const_type_iterator(RenderTweak* const* next) : ptr(next) {}
 
-        const ElementType* ptr;
-        const ElementType* ptr_end;
+        RenderTweak* const* ptr;
     };
 
     template <class T>
@@ -92,10 +85,21 @@ public:
     const const_type_iterator<T> end() { return const_type_iterator<T>::end(*this); }
 
 protected:
-    const std::vector<ElementType>& GetRenderTweaks() const { return m_tweaks; }
+    /// @brief Get the tweaks of type `T`, in order
+    template <class T>
+    const std::vector<RenderTweak*>& GetBucket() const {
+        return m_buckets[(size_t)std::remove_const_t<T>::TYPE];
+    }
+    /// @brief Rebuild @ref m_buckets from @ref m_tweaks
+    void UpdateBuckets();
     
     std::string m_name;
+    /// @brief All tweaks, in order. Modify this with @ref AddTweak and @ref RemoveTweak.
     std::vector<ElementType> m_tweaks;
+    /// @brief Non-owning pointers to the tweaks in @ref m_tweaks, grouped by @ref RenderTweak::GetType
+    std::array<std::vector<RenderTweak*>, (size_t)TweakType::_COUNT> m_buckets;
+    /// @brief Optional. Lets cheap streams, like mattes, use a faster encoder than the rest.
+    std::shared_ptr<EncoderConfig> m_videoconfig;
 
 private:
     static std::vector<ConstPtr> MakePresets();
@@ -0,0 +1,19 @@
+#include "videolog.h"
+
+void VideoLog::Append(const std::string& text) {
+    std::string txt = text;
+    if (!txt.empty() && txt.back() == '\n')
+        txt.pop_back();
+    *GetLog() += text;
+    GetConsoleQueue().Append(std::move(txt));
+}
+
+void VideoLog::AppendError(const std::string& text) {
+    Append(text);
+    has_errors = true;
+}
+
+void VideoLog::Clear() {
+    GetLog()->clear();
+    GetConsoleQueue().Clear();
+}
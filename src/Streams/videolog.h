@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <Helper/threading.h>
+#include <Helper/str.h>
+
+/**
+ * @brief A global, thread-safe video log
+ */
+class VideoLog
+{
+public:
+    struct ConsoleQueue
+    {
+        void Append(std::string text)
+        {
+            std::scoped_lock lock(m_mutex);
+            m_queue.push_back(std::move(text));
+        }
+
+        void ExecuteAndClear();
+
+        void Clear()
+        {
+            std::scoped_lock lock(m_mutex);
+            m_queue.clear();
+        }
+    private:
+        friend VideoLog;
+        ConsoleQueue() = default;
+
+        std::vector<std::string> m_queue;
+        std::mutex m_mutex;
+    };
+
+    static void Append(const std::string& text);
+
+    /// @brief Append text to the error log. Newlines should be added.
+    static void AppendError(const std::string& text);
+    /// @brief Append text to the error log. Newlines should be added.
+    static void AppendError(const std::string_view text) {
+        return AppendError(std::string(text));
+    }
+    /// @brief Append text to the error log. Newlines should be added.
+    template <class... TArgs>
+    static void AppendError(const char* fmt, TArgs&&... args) {
+        AppendError(Helper::sprintf(fmt, std::forward<TArgs>(args)...));
+    }
+    static void Clear();
+    static Helper::LockedRef<std::string> GetLog() { return Helper::LockedRef<std::string>(log, mutex); }
+    /// @brief Lines are appended here to be removed and printed by the recorder in the game thread
+    static ConsoleQueue& GetConsoleQueue() {
+        return console_queue;
+    }
+    static bool HasErrors() {
+        std::scoped_lock lock{mutex};
+        return has_errors;
+    }
+
+private:
+    static inline std::string log;
+    static inline ConsoleQueue console_queue;
+    static inline std::mutex mutex;
+    static inline bool has_errors = false;
+};
@@ -4,9 +4,15 @@
 #include <Helper/defer.h>
 #include <Helper/imgui.h>
 #include <Helper/ffmpeg.h>
+#include <Helper/lz4.h>
+#include "mask.h"
+#include "depth.h"
+#include "exr.h"
 #include <ffmpipe/ffmpipe.h>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <optional>
 #include <cassert>
 #include <cstdio>
 #include <spng.h>
@@ -22,11 +28,54 @@ static EncoderConfig::TypeDesc type_descs[] =
     {"qoi",     "Image sequence with fast, lossless compression"},
     {"png",     "Image sequence with slower, lossless compression"},
     {"ffmpeg",  "Any video format, fast or slow, lossless or lossy"},
+    {"mask",    "Image sequence of grayscale masks, for mattes. Several mattes can share one file."},
+    {"depth",   "Image sequence of 16-bit or floating-point depth. Use a depth shader with \"Pack into RGB\"."},
+    {"delta",   "Lossless file that only stores what changed between frames. Made for static shots and mattes."},
+    {"raw",     "Unencoded frames in one file, to encode later with sf-transcode. Fastest to record, but very large."},
+    {"exr",     "Image sequence of linear, floating-point color. Keeps HDR with a float capture format."},
 };
 
 const EncoderConfig::TypeDesc* EncoderConfig::TYPE_QOI = &type_descs[0];
 const EncoderConfig::TypeDesc* EncoderConfig::TYPE_PNG = &type_descs[1];
 const EncoderConfig::TypeDesc* EncoderConfig::TYPE_FFMPEG = &type_descs[2];
+const EncoderConfig::TypeDesc* EncoderConfig::TYPE_MASK = &type_descs[3];
+const EncoderConfig::TypeDesc* EncoderConfig::TYPE_DEPTH = &type_descs[4];
+const EncoderConfig::TypeDesc* EncoderConfig::TYPE_DELTA = &type_descs[5];
+const EncoderConfig::TypeDesc* EncoderConfig::TYPE_RAW = &type_descs[6];
+const EncoderConfig::TypeDesc* EncoderConfig::TYPE_EXR = &type_descs[7];
+
+static const char* MASK_CHANNEL_NAMES[] = {"Red", "Green", "Blue"};
+static const char* DEPTH_FORMAT_NAMES[] = {"16-bit PNG", "EXR (float)", "EXR (half)"};
+static_assert(std::size(DEPTH_FORMAT_NAMES) == (size_t)DepthWriter::Format::_COUNT);
+static const char* TONEMAP_NAMES[] = {"Clamp", "Reinhard", "ACES filmic"};
+static_assert(std::size(TONEMAP_NAMES) == (size_t)Hdr::Tonemap::_COUNT);
+
+/**
+ * @brief Find the red, green and blue bytes within each pixel of a format
+ * @return `false` if the format isn't 8-bit RGB
+ */
+static bool GetRgbOffsets(D3DFORMAT format, size_t offsets[3])
+{
+    switch (format)
+    {
+    case D3DFMT_A8R8G8B8:
+    case D3DFMT_X8R8G8B8:
+    case D3DFMT_R8G8B8: // Blue is first in memory
+        offsets[0] = 2;
+        offsets[1] = 1;
+        offsets[2] = 0;
+        return true;
+    case D3DFMT_A8B8G8R8:
+    case Helper::D3DFMT_B8G8R8:
+        offsets[0] = 0;
+        offsets[1] = 1;
+        offsets[2] = 2;
+        return true;
+    default:
+        break;
+    }
+    return false;
+}
 
 void VideoLog::ConsoleQueue::ExecuteAndClear()
 {
@@ -36,24 +85,6 @@ void VideoLog::ConsoleQueue::ExecuteAndClear()
     m_queue.clear();
 }
 
-void VideoLog::Append(const std::string& text) {
-    std::string txt = text;
-    if (!txt.empty() && txt.back() == '\n')
-        txt.pop_back();
-    *GetLog() += text;
-    GetConsoleQueue().Append(std::move(txt));
-}
-
-void VideoLog::AppendError(const std::string& text) {
-    Append(text);
-    has_errors = true;
-}
-
-void VideoLog::Clear() {
-    GetLog()->clear();
-    GetConsoleQueue().Clear();
-}
-
 static std::vector<EncoderConfig::FFmpegPreset> MakeFFmpegPresets()
 {
     std::vector<EncoderConfig::FFmpegPreset> presets;
@@ -72,6 +103,21 @@ static std::vector<EncoderConfig::FFmpegPreset> MakeFFmpegPresets()
         
         "-c:v utvideo", "avi"
     );
+    presets.emplace_back(
+        "UTVideo (RGBA)",
+        "Lossless RGBA encoded with UTVideo.\n"
+        "Enable \"Keep alpha\" to store the stream's alpha channel.",
+
+        "-c:v utvideo -pix_fmt gbrap", "avi"
+    );
+    presets.emplace_back(
+        "ProRes 4444 (YUVA)",
+        "Almost-lossless YUV with alpha, encoded with ProRes 4444.\n"
+        "Enable \"Keep alpha\" to store the stream's alpha channel.\n"
+        "Most editing software can read it, but it's slower and larger than UTVideo.",
+
+        "-c:v prores_ks -profile:v 4444 -pix_fmt yuva444p10le", "mov"
+    );
 
     std::string h264 = "-c:v libx264";
     std::string hevc = "-c:v libx265";
@@ -120,9 +166,10 @@ size_t EncoderConfig::NumTypes() {
     return std::size(type_descs);
 }
 
-void EncoderConfig::ShowImguiControls()
+void EncoderConfig::ShowImguiControls(bool show_framerate)
 {
-    ImGui::InputInt("Framerate", &framerate);
+    if (show_framerate)
+        ImGui::InputInt("Framerate", &framerate);
 
     if (ImGui::BeginCombo("Video encoder", type->name))
     {
@@ -141,12 +188,124 @@ void EncoderConfig::ShowImguiControls()
 
     ImGui::SeparatorText("Encoder settings");
 
-    if (type == EncoderConfig::TYPE_PNG)
+    if (type == EncoderConfig::TYPE_PNG || type == EncoderConfig::TYPE_MASK || type == EncoderConfig::TYPE_DEPTH
+        || type == EncoderConfig::TYPE_EXR)
     {
         ImGui::SliderInt("Compression", &png_compression, 0, 9, "%d", ImGuiSliderFlags_AlwaysClamp);
         ImGui::SameLine();
         Helper::ImGuiHelpMarker("Higher compression is slower to render, but creates a smaller file");
     }
+    if (type == EncoderConfig::TYPE_PNG || type == EncoderConfig::TYPE_QOI)
+    {
+        ImGui::Checkbox("Link duplicate frames", &link_duplicates);
+        ImGui::SameLine();
+        Helper::ImGuiHelpMarker(
+            "Frames that are identical to the previous frame are hard-linked instead of encoded.\n"
+            "This makes paused demos and empty mattes nearly free to record.\n"
+            "The output folder must be on a drive that supports hard links (like NTFS)."
+        );
+    }
+    if (type == EncoderConfig::TYPE_PNG)
+    {
+        ImGui::Checkbox("Indexed colors", &png_palette);
+        ImGui::SameLine();
+        Helper::ImGuiHelpMarker(
+            "Frames with 256 colors or less are written as indexed PNGs.\n"
+            "Mattes become several times smaller, and faster to compress.\n"
+            "Frames with more colors are written normally."
+        );
+    }
+    if (type == EncoderConfig::TYPE_PNG || type == EncoderConfig::TYPE_QOI || type == EncoderConfig::TYPE_FFMPEG
+        || type == EncoderConfig::TYPE_EXR)
+    {
+        ImGui::Checkbox("Keep alpha", &alpha);
+        ImGui::SameLine();
+        Helper::ImGuiHelpMarker(
+            "Write the stream's alpha channel with its colors, as RGBA images or video.\n"
+            "A stream whose materials write coverage to alpha then holds its own matte, without rendering one.\n"
+            "Indexed colors and cropping only apply to RGB. FFmpeg needs a codec with alpha, like the RGBA presets."
+        );
+    }
+    if (type == EncoderConfig::TYPE_PNG || type == EncoderConfig::TYPE_QOI || type == EncoderConfig::TYPE_FFMPEG)
+    {
+        ImGui::Combo("Tonemap", &tonemap, TONEMAP_NAMES, std::size(TONEMAP_NAMES));
+        ImGui::SameLine();
+        Helper::ImGuiHelpMarker(
+            "How frames with a float capture format are brought into 8-bit color.\n"
+            "Clamp clips everything brighter than white. Reinhard and ACES roll highlights off smoothly.\n"
+            "This does nothing with the default 8-bit capture format."
+        );
+    }
+    if (type == EncoderConfig::TYPE_PNG || type == EncoderConfig::TYPE_QOI)
+    {
+        ImGui::Checkbox("Crop to content", &crop_to_content);
+        ImGui::SameLine();
+        Helper::ImGuiHelpMarker(
+            "Only the bounding box of pixels that differ from the top-left pixel is encoded.\n"
+            "Mattes and wireframes with a small subject become much faster and smaller.\n"
+            "Each frame's box and background color are listed in crop.csv, to pad frames back to full size."
+        );
+    }
+    else if (type == EncoderConfig::TYPE_MASK)
+    {
+        ImGui::Combo("Channel", &mask_channel, MASK_CHANNEL_NAMES, std::size(MASK_CHANNEL_NAMES));
+        ImGui::SameLine();
+        Helper::ImGuiHelpMarker("The color channel that the mask is taken from");
+
+        ImGui::SliderInt("Threshold", &mask_threshold, 0, 255, "%d", ImGuiSliderFlags_AlwaysClamp);
+        ImGui::SameLine();
+        Helper::ImGuiHelpMarker(
+            "Pixels where the channel is at least this value are in the mask, and the mask is written with 1 bit per pixel.\n"
+            "At 0, the channel's 8-bit coverage is written instead."
+        );
+
+        ImGui::InputText("Group", &mask_group);
+        ImGui::SameLine();
+        Helper::ImGuiHelpMarker(
+            "Mask streams in the same group are written to one file, named after the group.\n"
+            "Each stream is stored in its own bit, in the order of the stream list, so up to 8 streams fit in a group.\n"
+            "Grouped masks always use a threshold."
+        );
+    }
+    else if (type == EncoderConfig::TYPE_DEPTH)
+    {
+        ImGui::Combo("Depth format", &depth_format, DEPTH_FORMAT_NAMES, std::size(DEPTH_FORMAT_NAMES));
+        ImGui::SameLine();
+        Helper::ImGuiHelpMarker(
+            "16-bit PNGs keep the top 16 bits of depth.\n"
+            "Float EXRs keep all 24 bits, and half EXRs keep 11 bits of precision at any distance.\n"
+            "The stream must use a depth shader with \"Pack into RGB\" enabled."
+        );
+    }
+    else if (type == EncoderConfig::TYPE_DELTA)
+    {
+        ImGui::SliderInt("Keyframe interval", &delta_keyframe_interval, 1, 600, "%d", ImGuiSliderFlags_AlwaysClamp);
+        ImGui::SameLine();
+        Helper::ImGuiHelpMarker(
+            "Every this many frames, the whole frame is stored instead of what changed.\n"
+            "Lower values make the file faster to seek, but larger."
+        );
+    }
+    else if (type == EncoderConfig::TYPE_EXR)
+    {
+        ImGui::Checkbox("Half floats", &exr_half);
+        ImGui::SameLine();
+        Helper::ImGuiHelpMarker(
+            "Store 16-bit floats instead of 32-bit floats. They keep 11 bits of precision at any brightness,\n"
+            "which is plenty for color, and halve the file size.\n"
+            "Use a float capture format to keep HDR. 8-bit frames are converted to linear color."
+        );
+    }
+    else if (type == EncoderConfig::TYPE_RAW)
+    {
+        ImGui::Checkbox("LZ4 compression", &raw_lz4);
+        ImGui::SameLine();
+        Helper::ImGuiHelpMarker(
+            "Compress each frame with LZ4. Mattes and flat streams become much smaller,\n"
+            "at the cost of some CPU time while recording.\n"
+            "Dumps are converted to images or video with the sf-transcode tool."
+        );
+    }
     else if (type == EncoderConfig::TYPE_FFMPEG)
     {
         static const std::vector<FFmpegPreset> ffmpeg_presets = MakeFFmpegPresets();
@@ -252,6 +411,18 @@ void EncoderConfig::FromJson(const nlohmann::json* j)
     Helper::FromJson(j, "ffmpeg_output_ext", ffmpeg_output_ext);
     Helper::FromJson(j, "ffmpeg_path", ffmpeg_path);
     Helper::FromJson(j, "png_compression", safe_png_compression);
+    Helper::FromJson(j, "link_duplicates", link_duplicates);
+    Helper::FromJson(j, "png_palette", png_palette);
+    Helper::FromJson(j, "crop_to_content", crop_to_content);
+    Helper::FromJson(j, "mask_channel", mask_channel);
+    Helper::FromJson(j, "mask_threshold", mask_threshold);
+    Helper::FromJson(j, "mask_group", mask_group);
+    Helper::FromJson(j, "depth_format", depth_format);
+    Helper::FromJson(j, "delta_keyframe_interval", delta_keyframe_interval);
+    Helper::FromJson(j, "raw_lz4", raw_lz4);
+    Helper::FromJson(j, "alpha", alpha);
+    Helper::FromJson(j, "tonemap", tonemap);
+    Helper::FromJson(j, "exr_half", exr_half);
 
     if (ffmpeg_path.empty())
         ffmpeg_path = Helper::FFmpeg::GetDefaultPath();
@@ -259,6 +430,11 @@ void EncoderConfig::FromJson(const nlohmann::json* j)
     safe_png_compression = max(safe_png_compression, 0);
     safe_png_compression = min(safe_png_compression, 7);
     png_compression = safe_png_compression;
+    mask_channel = max(0, min(mask_channel, (int)std::size(MASK_CHANNEL_NAMES) - 1));
+    mask_threshold = max(0, min(mask_threshold, 255));
+    depth_format = max(0, min(depth_format, (int)DepthWriter::Format::_COUNT - 1));
+    delta_keyframe_interval = max(1, delta_keyframe_interval);
+    tonemap = max(0, min(tonemap, (int)Hdr::Tonemap::_COUNT - 1));
 
     for (size_t i = 0; i < NumTypes(); ++i)
     {
@@ -279,23 +455,38 @@ nlohmann::json EncoderConfig::ToJson() const
         {"ffmpeg_output_ext", ffmpeg_output_ext},
         {"ffmpeg_path", ffmpeg_path},
         {"png_compression", png_compression},
+        {"link_duplicates", link_duplicates},
+        {"png_palette", png_palette},
+        {"crop_to_content", crop_to_content},
+        {"mask_channel", mask_channel},
+        {"mask_threshold", mask_threshold},
+        {"mask_group", mask_group},
+        {"depth_format", depth_format},
+        {"delta_keyframe_interval", delta_keyframe_interval},
+        {"raw_lz4", raw_lz4},
+        {"alpha", alpha},
+        {"tonemap", tonemap},
+        {"exr_half", exr_half},
     };
 }
 
-bool ImageWriter::WriteFrame(const FrameBufferDx9& buffer, size_t frame_index)
+bool ImageWriter::WriteFrame(const FrameBufferBase& buffer, size_t frame_index)
 {
-    const wchar_t* file_extension = L"";
-    switch (m_file_format)
+    std::filesystem::path path = GetFramePath(frame_index);
+
+    uint64_t hash = 0;
+    CropEntry crop;
+    if (m_link_duplicates)
     {
-    case Format::PNG: file_extension = L"png"; break;
-    case Format::QOI: file_extension = L"qoi"; break;
-    default:
-        assert(0 && "Unknown format. A switch case may be missing.");
+        hash = buffer.Hash();
+        if (LinkDuplicate(hash, path, &crop))
+        {
+            if (m_crop_to_content)
+                AppendCropIndex(frame_index, crop);
+            return true;
+        }
     }
 
-    auto suffix = std::to_wstring(frame_index) + L'.' + file_extension;
-
-    std::filesystem::path path = m_base_path.wstring() + suffix;
     std::ofstream file(path, std::ios::binary);
     if (!file)
     {
@@ -304,68 +495,256 @@ bool ImageWriter::WriteFrame(const FrameBufferDx9& buffer, size_t frame_index)
     }
     
     bool result = false;
-    switch (m_file_format)
+    if (m_alpha)
     {
-    case Format::PNG: result = WritePNG(buffer.ToRgb(), file, m_png_compression); break;
-    case Format::QOI: result = WriteQOI(buffer.ToRgb(), file); break;
+        FrameBufferRgba rgba = buffer.ToRgba(m_tonemap);
+        switch (m_file_format)
+        {
+        case Format::PNG: result = WritePNG(rgba, file, m_degraded ? 0 : m_png_compression); break;
+        case Format::QOI: result = WriteQOI(rgba, file); break;
+        }
     }
+    else
+        result = WriteRgb(buffer, frame_index, file, &crop);
 
     if (!file)
     {
         VideoLog::AppendError("Failed to write to existing file '%s'\n", path.u8string().c_str());
         return false;
     }
+    // The encoder logged why. The broken file must not become the target of later links.
+    if (!result)
+        return false;
+
+    if (m_link_duplicates)
+    {
+        file.close();
+        std::scoped_lock lock{m_last_mutex};
+        m_last_hash = hash;
+        m_last_path = std::move(path);
+        m_last_crop = crop;
+    }
 
     return true;
 }
 
-bool ImageWriter::WritePNG(const FrameBufferRgb& buffer, std::ostream& output, int compression)
+bool ImageWriter::WriteRgb(const FrameBufferBase& buffer, size_t frame_index, std::ostream& output, CropEntry* crop)
 {
-    auto write_fn = [](spng_ctx *ctx, void *user, void *data, size_t n)
+    FrameBufferRgb rgb = buffer.ToRgb(m_tonemap);
+    std::optional<FrameBufferRgb> cropped;
+    if (m_crop_to_content)
     {
-        std::ostream& output = *(std::ostream*)user;
-        output.write((const char*)data, n);
-        return output ? 0 : SPNG_IO_ERROR;
-    };
+        if (!Crop::FindBounds(rgb.GetData(), rgb.GetWidth(), rgb.GetHeight(), &crop->rect))
+            crop->rect = {0, 0, 1, 1}; // Every pixel is background, but images can't be empty
+        memcpy(crop->background, rgb.GetData(), sizeof(crop->background));
+        if (crop->rect.width != rgb.GetWidth() || crop->rect.height != rgb.GetHeight())
+        {
+            cropped.emplace(crop->rect.width, crop->rect.height);
+            Crop::CopyRect(rgb.GetData(), rgb.GetWidth(), crop->rect, cropped->GetData());
+        }
+        AppendCropIndex(frame_index, *crop);
+    }
+    const FrameBufferRgb& image = cropped ? *cropped : rgb;
+    const Crop::Rect* crop_rect = m_crop_to_content ? &crop->rect : nullptr;
+
+    switch (m_file_format)
+    {
+    case Format::PNG:
+    {
+        int compression = m_degraded ? 0 : m_png_compression;
+        // Reused by each thread, to avoid reallocating it for every frame
+        thread_local IndexedImage indexed;
+        if (m_png_palette && indexed.Build(image.GetData(), image.GetWidth(), image.GetHeight()))
+            return WritePNG(indexed, image.GetWidth(), image.GetHeight(), output, compression, crop_rect);
+        return WritePNG(image, output, compression, crop_rect);
+    }
+    case Format::QOI: return WriteQOI(image, output);
+    }
+    return false;
+}
+
+bool ImageWriter::SetDegraded(bool degraded)
+{
+    if (m_file_format != Format::PNG || m_png_compression == 0)
+        return false;
+    m_degraded = degraded;
+    return true;
+}
+
+std::filesystem::path ImageWriter::GetFramePath(size_t frame_index) const
+{
+    const wchar_t* file_extension = L"";
+    switch (m_file_format)
+    {
+    case Format::PNG: file_extension = L"png"; break;
+    case Format::QOI: file_extension = L"qoi"; break;
+    default:
+        assert(0 && "Unknown format. A switch case may be missing.");
+    }
+
+    auto suffix = std::to_wstring(frame_index) + L'.' + file_extension;
+    return m_base_path.wstring() + suffix;
+}
 
-    int err = 0;
+bool ImageWriter::LinkDuplicate(uint64_t hash, const std::filesystem::path& path, CropEntry* last_crop)
+{
+    std::filesystem::path last_path;
+    {
+        std::scoped_lock lock{m_last_mutex};
+        if (m_last_path.empty() || m_last_hash != hash)
+            return false;
+        last_path = m_last_path;
+        *last_crop = m_last_crop;
+    }
+
+    // Frames are written out-of-order, so the last file may belong to a later frame.
+    // That's fine, because the pixels are identical either way.
+    std::error_code err;
+    std::filesystem::create_hard_link(last_path, path, err);
+    if (err) // The drive may not support hard links. Copying is still faster than encoding.
+        std::filesystem::copy_file(last_path, path, std::filesystem::copy_options::overwrite_existing, err);
+    return !err;
+}
+
+void ImageWriter::AppendCropIndex(size_t frame_index, const CropEntry& crop)
+{
+    std::scoped_lock lock{m_crop_mutex};
+    if (!m_crop_index.is_open())
+    {
+        std::filesystem::path path = m_base_path.parent_path() / "crop.csv";
+        m_crop_index.open(path);
+        if (!m_crop_index)
+        {
+            VideoLog::AppendError("Failed to open crop index for writing: '%s'\n", path.u8string().c_str());
+            return;
+        }
+        m_crop_index << "frame,x,y,width,height,frame_width,frame_height,background\n";
+    }
+
+    m_crop_index << Helper::sprintf(
+        "%zu,%u,%u,%u,%u,%u,%u,%02x%02x%02x\n", frame_index,
+        crop.rect.x, crop.rect.y, crop.rect.width, crop.rect.height, m_width, m_height,
+        crop.background[0], crop.background[1], crop.background[2]
+    );
+}
+
+static int WritePngStream(spng_ctx *ctx, void *user, void *data, size_t n)
+{
+    std::ostream& output = *(std::ostream*)user;
+    output.write((const char*)data, n);
+    return output ? 0 : SPNG_IO_ERROR;
+}
+
+/// @brief Store where a cropped image belongs, so viewers that support `oFFs` can place it
+static void SetPngOffset(spng_ctx* ctx, const Crop::Rect* crop)
+{
+    if (!crop)
+        return;
+    spng_offs offs = {0};
+    offs.x = (int32_t)crop->x;
+    offs.y = (int32_t)crop->y;
+    offs.unit_specifier = 0; // Pixels
+    spng_set_offs(ctx, &offs);
+}
+
+/// @param color_type `SPNG_COLOR_TYPE_TRUECOLOR` or `SPNG_COLOR_TYPE_TRUECOLOR_ALPHA`, with 8 bits per channel
+static bool WriteTruecolorPNG(
+    const uint8_t* pixels, size_t length, uint32_t width, uint32_t height, uint8_t color_type,
+    std::ostream& output, int compression, const Crop::Rect* crop)
+{
     spng_ihdr ihdr = {0};
-    ihdr.width = buffer.GetWidth();
-    ihdr.height = buffer.GetHeight();
-    ihdr.bit_depth = buffer.GetFormatInfo().bitdepth[0];
-    ihdr.color_type = SPNG_COLOR_TYPE_TRUECOLOR;
+    ihdr.width = width;
+    ihdr.height = height;
+    ihdr.bit_depth = 8;
+    ihdr.color_type = color_type;
 
     spng_ctx* ctx = spng_ctx_new(SPNG_CTX_ENCODER);
     defer { spng_ctx_free(ctx); };
 
     spng_set_ihdr(ctx, &ihdr);
-    spng_set_png_stream(ctx, write_fn, (void*)&output);
+    SetPngOffset(ctx, crop);
+    spng_set_png_stream(ctx, WritePngStream, (void*)&output);
     spng_set_option(ctx, SPNG_IMG_COMPRESSION_LEVEL, compression > 9 ? 9 : compression);
 
-    err = spng_encode_image(ctx, buffer.GetData(), buffer.GetDataLength(), SPNG_FMT_PNG, SPNG_ENCODE_FINALIZE);
-
+    int err = spng_encode_image(ctx, pixels, length, SPNG_FMT_PNG, SPNG_ENCODE_FINALIZE);
     if (err != 0)
     {
         VideoLog::AppendError("Failed to encode PNG. SPNG error code: %d\n", err);
         return false;
     }
-    
     return true;
 }
 
-bool ImageWriter::WriteQOI(const FrameBufferRgb& buffer, std::ostream& output)
+bool ImageWriter::WritePNG(const FrameBufferRgb& buffer, std::ostream& output, int compression, const Crop::Rect* crop)
+{
+    return WriteTruecolorPNG(
+        buffer.GetData(), buffer.GetDataLength(), buffer.GetWidth(), buffer.GetHeight(),
+        SPNG_COLOR_TYPE_TRUECOLOR, output, compression, crop
+    );
+}
+
+bool ImageWriter::WritePNG(const FrameBufferRgba& buffer, std::ostream& output, int compression)
+{
+    return WriteTruecolorPNG(
+        buffer.GetData(), buffer.GetDataLength(), buffer.GetWidth(), buffer.GetHeight(),
+        SPNG_COLOR_TYPE_TRUECOLOR_ALPHA, output, compression, nullptr
+    );
+}
+
+bool ImageWriter::WritePNG(
+    const IndexedImage& image, uint32_t width, uint32_t height, std::ostream& output,
+    int compression, const Crop::Rect* crop)
+{
+    spng_ihdr ihdr = {0};
+    ihdr.width = width;
+    ihdr.height = height;
+    ihdr.bit_depth = image.GetBitDepth();
+    ihdr.color_type = SPNG_COLOR_TYPE_INDEXED;
+
+    spng_plte plte = {0};
+    plte.n_entries = image.GetPalette().size();
+    for (size_t i = 0; i < plte.n_entries; ++i)
+    {
+        plte.entries[i].red = image.GetPalette()[i][0];
+        plte.entries[i].green = image.GetPalette()[i][1];
+        plte.entries[i].blue = image.GetPalette()[i][2];
+    }
+
+    spng_ctx* ctx = spng_ctx_new(SPNG_CTX_ENCODER);
+    defer { spng_ctx_free(ctx); };
+
+    spng_set_ihdr(ctx, &ihdr);
+    spng_set_plte(ctx, &plte);
+    SetPngOffset(ctx, crop);
+    spng_set_png_stream(ctx, WritePngStream, (void*)&output);
+    spng_set_option(ctx, SPNG_IMG_COMPRESSION_LEVEL, compression > 9 ? 9 : compression);
+    // Filtering rarely helps indexed images, and costs a pass over every row
+    spng_set_option(ctx, SPNG_FILTER_CHOICE, SPNG_DISABLE_FILTERING);
+
+    const std::vector<uint8_t>& data = image.GetData();
+    int err = spng_encode_image(ctx, data.data(), data.size(), SPNG_FMT_PNG, SPNG_ENCODE_FINALIZE);
+    if (err != 0)
+    {
+        VideoLog::AppendError("Failed to encode indexed PNG. SPNG error code: %d\n", err);
+        return false;
+    }
+    return true;
+}
+
+/// @param channels 3 for RGB, or 4 for RGBA
+static bool WriteQOIPixels(const uint8_t* pixels, uint32_t width, uint32_t height, uint8_t channels, std::ostream& output)
 {
     qoi_desc desc;
-    desc.channels = buffer.GetFormatInfo().num_channels;
+    desc.channels = channels;
     desc.colorspace = QOI_SRGB;
-    desc.width = buffer.GetWidth();
-    desc.height = buffer.GetHeight();
+    desc.width = width;
+    desc.height = height;
 
     // TODO: Redefine QOI_MALLOC to allocate from a reuseable vector.
     //  It will have to be thread-safe.
 
     int encoded_len;
-    void* encoded = qoi_encode(buffer.GetData(), &desc, &encoded_len);
+    void* encoded = qoi_encode(pixels, &desc, &encoded_len);
     if (!encoded)
     {
         VideoLog::AppendError("Failed to encode QOI\n");
@@ -377,17 +756,247 @@ bool ImageWriter::WriteQOI(const FrameBufferRgb& buffer, std::ostream& output)
     return true;
 }
 
-const Helper::D3DFORMAT_info& FrameBufferRgb::GetFormatInfo() const
+bool ImageWriter::WriteQOI(const FrameBufferRgb& buffer, std::ostream& output) {
+    return WriteQOIPixels(buffer.GetData(), buffer.GetWidth(), buffer.GetHeight(), buffer.GetFormatInfo().num_channels, output);
+}
+
+bool ImageWriter::WriteQOI(const FrameBufferRgba& buffer, std::ostream& output) {
+    return WriteQOIPixels(buffer.GetData(), buffer.GetWidth(), buffer.GetHeight(), buffer.GetFormatInfo().num_channels, output);
+}
+
+MaskSequence::MaskSequence(uint32_t width, uint32_t height, size_t num_planes, bool binary, int compression, std::filesystem::path&& base_path)
+    : m_width(width), m_height(height), m_num_planes(num_planes), m_binary(binary),
+    m_compression(compression), m_base_path(std::move(base_path))
 {
-    static constexpr Helper::D3DFORMAT_info info = {
-        3,          // stride
-        {8,8,8},    // bitdepth
-        3,          // num_channels
-        true,       // is_uniform_bitdepth
-        false,      // is_float
-        false,      // is_depth
-    };
-    return info;
+    assert(num_planes > 0 && num_planes <= MAX_PLANES && "A mask sequence must have 1 to 8 planes");
+    assert((num_planes == 1 || binary) && "Bit planes must be binary");
+}
+
+MaskSequence::~MaskSequence()
+{
+    for (auto& [frame_index, frame] : m_pending)
+        WriteFile(frame_index, frame.planes.data());
+}
+
+bool MaskSequence::AddPlane(size_t frame_index, size_t plane, const uint8_t* mask)
+{
+    if (m_num_planes == 1)
+        return WriteFile(frame_index, mask);
+
+    const size_t num_pixels = (size_t)m_width * m_height;
+    PendingFrame finished;
+    {
+        std::scoped_lock lock{m_mutex};
+        PendingFrame& frame = m_pending[frame_index];
+        if (frame.planes.empty())
+            frame.planes.assign(num_pixels, 0);
+        Mask::AddPlane(mask, num_pixels, (int)plane, frame.planes.data());
+        if (++frame.num_added < m_num_planes)
+            return true;
+        finished = std::move(frame);
+        m_pending.erase(frame_index);
+    }
+    return WriteFile(frame_index, finished.planes.data());
+}
+
+bool MaskSequence::WriteFile(size_t frame_index, const uint8_t* pixels)
+{
+    std::filesystem::path path = m_base_path.wstring() + std::to_wstring(frame_index) + L".png";
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        VideoLog::AppendError("Failed to open file for writing: '%s'\n", path.u8string().c_str());
+        return false;
+    }
+
+    spng_ihdr ihdr = {0};
+    ihdr.width = m_width;
+    ihdr.height = m_height;
+    ihdr.color_type = SPNG_COLOR_TYPE_GRAYSCALE;
+    ihdr.bit_depth = 8;
+
+    // A single binary mask is packed to 1 bit per pixel. Bit planes need every bit of the byte.
+    thread_local std::vector<uint8_t> packed;
+    const uint8_t* data = pixels;
+    size_t data_size = (size_t)m_width * m_height;
+    if (m_num_planes == 1 && m_binary)
+    {
+        Mask::PackBits(pixels, m_width, m_height, &packed);
+        ihdr.bit_depth = 1;
+        data = packed.data();
+        data_size = packed.size();
+    }
+
+    spng_ctx* ctx = spng_ctx_new(SPNG_CTX_ENCODER);
+    defer { spng_ctx_free(ctx); };
+
+    spng_set_ihdr(ctx, &ihdr);
+    spng_set_png_stream(ctx, WritePngStream, (void*)&file);
+    spng_set_option(ctx, SPNG_IMG_COMPRESSION_LEVEL, m_compression > 9 ? 9 : m_compression);
+
+    int err = spng_encode_image(ctx, data, data_size, SPNG_FMT_PNG, SPNG_ENCODE_FINALIZE);
+    if (err != 0)
+    {
+        VideoLog::AppendError("Failed to encode mask PNG. SPNG error code: %d\n", err);
+        return false;
+    }
+    return true;
+}
+
+bool MaskWriter::WriteFrame(const FrameBufferBase& buffer, size_t frame_index)
+{
+    size_t offsets[3];
+    if (!GetRgbOffsets(buffer.GetFormat(), offsets))
+    {
+        VideoLog::AppendError("Masks are not implemented for D3DFORMAT %d\n", (int)buffer.GetFormat());
+        return false;
+    }
+
+    const uint32_t width = buffer.GetWidth(), height = buffer.GetHeight();
+    thread_local std::vector<uint8_t> mask;
+    mask.resize((size_t)width * height);
+
+    size_t pitch;
+    const uint8_t* pixels = buffer.LockRead(&pitch);
+    if (!pixels)
+    {
+        VideoLog::AppendError("Failed to lock frame buffer for a mask\n");
+        return false;
+    }
+    for (uint32_t y = 0; y < height; ++y)
+        Mask::Extract(pixels + y * pitch, width, buffer.GetPixelStride(), offsets[m_channel], m_threshold, mask.data() + (size_t)y * width);
+    buffer.UnlockRead();
+
+    return m_sequence->AddPlane(frame_index, m_plane, mask.data());
+}
+
+bool DepthWriter::WriteFrame(const FrameBufferBase& buffer, size_t frame_index)
+{
+    Depth::PixelLayout layout;
+    layout.stride = buffer.GetPixelStride();
+    if (!GetRgbOffsets(buffer.GetFormat(), layout.offsets))
+    {
+        VideoLog::AppendError("Depth is not implemented for D3DFORMAT %d\n", (int)buffer.GetFormat());
+        return false;
+    }
+
+    const wchar_t* file_extension = m_format == Format::PNG16 ? L".png" : L".exr";
+    std::filesystem::path path = m_base_path.wstring() + std::to_wstring(frame_index) + file_extension;
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        VideoLog::AppendError("Failed to open file for writing: '%s'\n", path.u8string().c_str());
+        return false;
+    }
+
+    const uint32_t width = buffer.GetWidth(), height = buffer.GetHeight();
+    size_t pitch;
+    const uint8_t* pixels = buffer.LockRead(&pitch);
+    if (!pixels)
+    {
+        VideoLog::AppendError("Failed to lock frame buffer for depth\n");
+        return false;
+    }
+    defer { buffer.UnlockRead(); };
+
+    if (m_format == Format::PNG16)
+    {
+        thread_local std::vector<uint16_t> depth;
+        depth.resize((size_t)width * height);
+        for (uint32_t y = 0; y < height; ++y)
+            Depth::UnpackU16BE(pixels + y * pitch, width, layout, depth.data() + (size_t)y * width);
+
+        spng_ihdr ihdr = {0};
+        ihdr.width = width;
+        ihdr.height = height;
+        ihdr.bit_depth = 16;
+        ihdr.color_type = SPNG_COLOR_TYPE_GRAYSCALE;
+
+        spng_ctx* ctx = spng_ctx_new(SPNG_CTX_ENCODER);
+        defer { spng_ctx_free(ctx); };
+        spng_set_ihdr(ctx, &ihdr);
+        spng_set_png_stream(ctx, WritePngStream, (void*)&file);
+        spng_set_option(ctx, SPNG_IMG_COMPRESSION_LEVEL, m_compression > 9 ? 9 : m_compression);
+
+        // The samples are already big-endian, as stored in the file
+        int err = spng_encode_image(ctx, depth.data(), depth.size() * sizeof(depth[0]), SPNG_FMT_RAW, SPNG_ENCODE_FINALIZE);
+        if (err != 0)
+        {
+            VideoLog::AppendError("Failed to encode depth PNG. SPNG error code: %d\n", err);
+            return false;
+        }
+        return true;
+    }
+
+    thread_local std::vector<float> depth;
+    depth.resize((size_t)width * height);
+    for (uint32_t y = 0; y < height; ++y)
+        Depth::UnpackFloat(pixels + y * pitch, width, layout, depth.data() + (size_t)y * width);
+    if (!Depth::WriteExr(file, width, height, depth.data(), m_format == Format::EXR_HALF, m_compression))
+    {
+        VideoLog::AppendError("Failed to write EXR '%s'\n", path.u8string().c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ExrWriter::WriteFrame(const FrameBufferBase& buffer, size_t frame_index)
+{
+    const D3DFORMAT format = buffer.GetFormat();
+    const bool is_float = format == D3DFMT_A16B16G16R16F || format == D3DFMT_A32B32G32R32F;
+    size_t offsets[3] = {};
+    Helper::D3DFORMAT_info info = {};
+    if (!is_float && (!GetRgbOffsets(format, offsets) || !Helper::GetD3DFormatInfo(format, &info)))
+    {
+        VideoLog::AppendError("EXR is not implemented for D3DFORMAT %d\n", (int)format);
+        return false;
+    }
+    // The fourth byte of X8 formats is undefined, so their alpha is 1
+    const bool has_alpha = format == D3DFMT_A8R8G8B8 || format == D3DFMT_A8B8G8R8;
+
+    std::filesystem::path path = m_base_path.wstring() + std::to_wstring(frame_index) + L".exr";
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        VideoLog::AppendError("Failed to open file for writing: '%s'\n", path.u8string().c_str());
+        return false;
+    }
+
+    const uint32_t width = buffer.GetWidth(), height = buffer.GetHeight();
+    size_t pitch;
+    const uint8_t* pixels = buffer.LockRead(&pitch);
+    if (!pixels)
+    {
+        VideoLog::AppendError("Failed to lock frame buffer for EXR\n");
+        return false;
+    }
+    defer { buffer.UnlockRead(); };
+
+    // Reused by each thread, to avoid reallocating it for every frame
+    thread_local std::vector<float> linear;
+    linear.resize((size_t)width * height * 4);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* src = pixels + y * pitch;
+        float* dst = linear.data() + (size_t)y * width * 4;
+        switch (format)
+        {
+        case D3DFMT_A16B16G16R16F: Hdr::HalfToFloat((const uint16_t*)src, (size_t)width * 4, dst); break;
+        case D3DFMT_A32B32G32R32F: memcpy(dst, src, (size_t)width * 4 * sizeof(float)); break;
+        default: Hdr::Rgb8ToLinear(src, width, info.stride, offsets, has_alpha, dst); break;
+        }
+    }
+
+    // Sorted by name, as EXR requires
+    const Exr::Channel rgba_channels[] = {{"A", 3}, {"B", 2}, {"G", 1}, {"R", 0}};
+    const Exr::Channel* channels = m_alpha ? rgba_channels : rgba_channels + 1;
+    size_t num_channels = m_alpha ? 4 : 3;
+    if (!Exr::Write(file, width, height, linear.data(), 4, channels, num_channels, m_half, m_compression))
+    {
+        VideoLog::AppendError("Failed to write EXR '%s'\n", path.u8string().c_str());
+        return false;
+    }
+    return true;
 }
 
 FrameBufferDx9::FrameBufferDx9(IDirect3DSurface9* surface)
@@ -426,106 +1035,184 @@ FrameBufferDx9::FrameBufferDx9(uint32_t width, uint32_t height, D3DFORMAT d3dfor
         assert(0 && "Failed to create render target with desired D3DFORMAT");
 }
 
-FrameBufferRgb FrameBufferDx9::ToRgb() const
+const uint8_t* FrameBufferDx9::LockRead(size_t* pitch) const
 {
     assert(m_d3dsurface && "Missing a valid surface pointer");
-    FrameBufferRgb frame{GetWidth(), GetHeight()};
     D3DLOCKED_RECT locked_rect;
     if (FAILED(m_d3dsurface->LockRect(&locked_rect, nullptr, D3DLOCK_READONLY)))
-        assert(0 && "Failed to lock D3D surface rect");
-    defer { m_d3dsurface->UnlockRect(); };
-    
-    switch (m_d3dformat)
-    {
-    case Helper::D3DFMT_B8G8R8: BlitRgb(&frame, locked_rect); break;
-    case D3DFMT_R8G8B8: BlitBgr(&frame, locked_rect); break;
-    case D3DFMT_A8B8G8R8: BlitRgba(&frame, locked_rect); break;
-    case D3DFMT_A8R8G8B8: BlitBgra(&frame, locked_rect); break;
-    default:
-        assert(0 && "Blitting is not implemented for this D3DFORMAT");
-    }
+        return nullptr;
+    *pitch = locked_rect.Pitch;
+    return (const uint8_t*)locked_rect.pBits;
+}
+
+void FrameBufferDx9::UnlockRead() const {
+    m_d3dsurface->UnlockRect();
+}
 
-    return frame;
+template <class T>
+static void WriteValue(std::ostream& output, T value) {
+    output.write((const char*)&value, sizeof(value)); // Little-endian on every platform we run on
 }
 
-void FrameBufferDx9::BlitRgb(FrameBufferRgb* dst, D3DLOCKED_RECT src)
+DeltaWriter::DeltaWriter(uint32_t width, uint32_t height, int keyframe_interval, const std::filesystem::path& output_path)
+    : m_encoder(width, height), m_keyframe_interval(keyframe_interval), m_path(output_path),
+    m_file(output_path, std::ios::binary)
 {
-    uint32_t width = dst->GetWidth(), height = dst->GetHeight();
-    size_t dst_stride = dst->GetPixelStride();
-    const size_t src_stride = 3;
+    if (!m_file)
+        return;
+    m_file.write(MAGIC, sizeof(MAGIC));
+    WriteValue<uint32_t>(m_file, VERSION);
+    WriteValue<uint32_t>(m_file, width);
+    WriteValue<uint32_t>(m_file, height);
+    WriteValue<uint32_t>(m_file, Delta::TILE_SIZE);
+    m_offset = sizeof(MAGIC) + 4 * sizeof(uint32_t);
+}
 
-    for (uint32_t y = 0; y < height; ++y)
+DeltaWriter::~DeltaWriter()
+{
+    if (!m_file)
+        return;
+    for (const Keyframe& keyframe : m_keyframes)
     {
-        size_t row_size = dst->GetPixelStride() * dst->GetWidth();
-        uint8_t* dst_row = dst->GetData() + y * row_size;
-        const uint8_t* src_row = (const uint8_t*)src.pBits + y * src.Pitch;
-        memcpy(dst_row, src_row, row_size);
+        WriteValue<uint32_t>(m_file, keyframe.frame_index);
+        WriteValue<uint64_t>(m_file, keyframe.offset);
     }
+    WriteValue<uint32_t>(m_file, (uint32_t)m_keyframes.size());
+    WriteValue<uint64_t>(m_file, m_offset);
+    m_file.write(MAGIC, sizeof(MAGIC));
+    if (!m_file)
+        VideoLog::AppendError("Failed to write the index of '%s'\n", m_path.u8string().c_str());
 }
-void FrameBufferDx9::BlitBgr(FrameBufferRgb* dst, D3DLOCKED_RECT src)
+
+bool DeltaWriter::WriteFrame(const FrameBufferBase& buffer, size_t frame_index)
 {
-    uint32_t width = dst->GetWidth(), height = dst->GetHeight();
-    size_t dst_stride = dst->GetPixelStride();
-    const size_t src_stride = 3;
+    if (!m_file)
+    {
+        VideoLog::AppendError("Failed to open file for writing: '%s'\n", m_path.u8string().c_str());
+        return false;
+    }
 
-    for (uint32_t y = 0; y < height; ++y)
+    const bool keyframe = m_num_frames++ % m_keyframe_interval == 0;
+    FrameBufferRgb rgb = buffer.ToRgb();
+    m_encoder.Encode(rgb.GetData(), keyframe, &m_encoded);
+    if (keyframe)
+        m_keyframes.push_back({(uint32_t)frame_index, m_offset});
+
+    WriteValue<uint32_t>(m_file, (uint32_t)frame_index);
+    WriteValue<uint32_t>(m_file, (uint32_t)m_encoded.size());
+    m_file.write((const char*)m_encoded.data(), m_encoded.size());
+    m_offset += 2 * sizeof(uint32_t) + m_encoded.size();
+    if (!m_file)
     {
-        for (uint32_t x = 0; x < width; ++x)
-        {
-            uint8_t* dst_pixel = dst->GetData() + (y * width + x) * dst->GetPixelStride();
-            const uint8_t* src_pixel = (const uint8_t*)src.pBits + y * src.Pitch + x * src_stride;
-            dst_pixel[0] = src_pixel[2];
-            dst_pixel[1] = src_pixel[1];
-            dst_pixel[2] = src_pixel[0];
-        }
+        VideoLog::AppendError("Failed to write to existing file '%s'\n", m_path.u8string().c_str());
+        return false;
     }
+    return true;
 }
-void FrameBufferDx9::BlitRgba(FrameBufferRgb* dst, D3DLOCKED_RECT src)
+
+RawWriter::RawWriter(uint32_t framerate, std::string stream_name, bool lz4, const std::filesystem::path& output_path)
+    : m_framerate(framerate), m_stream_name(std::move(stream_name)), m_lz4(lz4), m_path(output_path),
+    m_file(output_path, std::ios::binary)
+{}
+
+bool RawWriter::WriteFrame(const FrameBufferBase& buffer, size_t frame_index)
 {
-    uint32_t width = dst->GetWidth(), height = dst->GetHeight();
-    size_t dst_stride = dst->GetPixelStride();
-    const size_t src_stride = 4;
+    if (!m_file)
+    {
+        VideoLog::AppendError("Failed to open file for writing: '%s'\n", m_path.u8string().c_str());
+        return false;
+    }
 
-    for (uint32_t y = 0; y < height; ++y)
+    if (!m_wrote_header)
     {
-        for (uint32_t x = 0; x < width; ++x)
+        switch (buffer.GetFormat())
         {
-            uint8_t* dst_pixel = dst->GetData() + (y * width + x) * dst->GetPixelStride();
-            const uint8_t* src_pixel = (const uint8_t*)src.pBits + y * src.Pitch + x * src_stride;
-            dst_pixel[0] = src_pixel[0];
-            dst_pixel[1] = src_pixel[1];
-            dst_pixel[2] = src_pixel[2];
+        case D3DFMT_A8R8G8B8:
+        case D3DFMT_X8R8G8B8: m_header.format = RawDump::PixelFormat::BGRA; break;
+        case D3DFMT_A8B8G8R8: m_header.format = RawDump::PixelFormat::RGBA; break;
+        case D3DFMT_R8G8B8: m_header.format = RawDump::PixelFormat::BGR; break;
+        case Helper::D3DFMT_B8G8R8: m_header.format = RawDump::PixelFormat::RGB; break;
+        default:
+            VideoLog::AppendError("Raw dumps are not implemented for D3DFORMAT %d\n", (int)buffer.GetFormat());
+            return false;
         }
+        m_header.width = buffer.GetWidth();
+        m_header.height = buffer.GetHeight();
+        m_header.framerate = m_framerate;
+        m_header.stream_name = m_stream_name;
+        RawDump::WriteHeader(m_file, m_header);
+        m_wrote_header = true;
     }
-}
-void FrameBufferDx9::BlitBgra(FrameBufferRgb* dst, D3DLOCKED_RECT src)
-{
-    uint32_t width = dst->GetWidth(), height = dst->GetHeight();
-    size_t dst_stride = dst->GetPixelStride();
-    const size_t src_stride = 4;
 
-    for (uint32_t y = 0; y < height; ++y)
+    size_t pitch;
+    const uint8_t* pixels = buffer.LockRead(&pitch);
+    if (!pixels)
     {
-        for (uint32_t x = 0; x < width; ++x)
+        VideoLog::AppendError("Failed to lock frame buffer\n");
+        return false;
+    }
+    defer { buffer.UnlockRead(); };
+
+    const size_t row_size = (size_t)m_header.width * m_header.GetPixelStride();
+    const size_t frame_size = m_header.GetFrameSize();
+    RawDump::FrameHeader frame;
+    frame.frame_index = (uint32_t)frame_index;
+    frame.size = (uint32_t)frame_size;
+
+    if (!m_lz4)
+    {
+        RawDump::WriteFrameHeader(m_file, frame);
+        if (pitch == row_size)
+            m_file.write((const char*)pixels, frame_size);
+        else
         {
-            uint8_t* dst_pixel = dst->GetData() + (y * width + x) * dst->GetPixelStride();
-            const uint8_t* src_pixel = (const uint8_t*)src.pBits + y * src.Pitch + x * src_stride;
-            dst_pixel[0] = src_pixel[2];
-            dst_pixel[1] = src_pixel[1];
-            dst_pixel[2] = src_pixel[0];
+            for (uint32_t y = 0; y < m_header.height; ++y)
+                m_file.write((const char*)pixels + y * pitch, row_size);
         }
     }
+    else
+    {
+        const uint8_t* data = pixels;
+        if (pitch != row_size)
+        {
+            m_packed.resize(frame_size);
+            for (uint32_t y = 0; y < m_header.height; ++y)
+                memcpy(m_packed.data() + y * row_size, pixels + y * pitch, row_size);
+            data = m_packed.data();
+        }
+
+        m_compressed.resize(Helper::LZ4CompressBound(frame_size));
+        size_t compressed_size = Helper::LZ4Compress(data, frame_size, m_compressed.data(), m_compressed.size());
+        if (compressed_size > 0 && compressed_size < frame_size)
+        {
+            frame.flags |= RawDump::FRAME_LZ4;
+            frame.size = (uint32_t)compressed_size;
+            data = m_compressed.data();
+        }
+        RawDump::WriteFrameHeader(m_file, frame);
+        m_file.write((const char*)data, frame.size);
+    }
+
+    if (!m_file)
+    {
+        VideoLog::AppendError("Failed to write to existing file '%s'\n", m_path.u8string().c_str());
+        return false;
+    }
+    return true;
 }
 
-FFmpegWriter::FFmpegWriter(uint32_t width, uint32_t height, uint32_t framerate, const std::string& output_args, const std::filesystem::path& output_path)
+FFmpegWriter::FFmpegWriter(
+    uint32_t width, uint32_t height, uint32_t framerate, const std::string& output_args,
+    const std::filesystem::path& output_path, D3DFORMAT frame_format, bool alpha, Hdr::Tonemap tonemap)
+    : m_alpha(alpha), m_tonemap(tonemap)
 {
-    IDirect3DSurface9* render_target;
-    D3DSURFACE_DESC desc;
-    g_hk_overlay.Device()->GetRenderTarget(0, &render_target);
-    render_target->GetDesc(&desc);
-    render_target->Release();
-
-    const char* pix_fmt = Helper::GetD3DFormatAsFFmpegPixFmt(desc.Format, true);
+    Helper::D3DFORMAT_info format_info;
+    m_convert = Helper::GetD3DFormatInfo(frame_format, &format_info) && format_info.is_float;
+    const char* pix_fmt;
+    if (m_convert) // Most codecs can't take float pixels, so they're tonemapped to 8-bit first
+        pix_fmt = alpha ? "rgba" : "rgb24";
+    else
+        pix_fmt = Helper::GetD3DFormatAsFFmpegPixFmt(frame_format, !alpha);
     assert(pix_fmt && "No equivalent FFmpeg pix_fmt for given D3DFORMAT");
 
     std::wstringstream ffmpeg_args;
@@ -559,7 +1246,7 @@ FFmpegWriter::~FFmpegWriter()
     }
 }
 
-bool FFmpegWriter::WriteFrame(const FrameBufferDx9& buffer, size_t frame_index)
+bool FFmpegWriter::WriteFrame(const FrameBufferBase& buffer, size_t frame_index)
 {
     if (!m_pipe)
     {
@@ -567,192 +1254,51 @@ bool FFmpegWriter::WriteFrame(const FrameBufferDx9& buffer, size_t frame_index)
         return false;
     }
 
-    IDirect3DSurface9* d3dsurface = buffer.GetSurface();
-    D3DLOCKED_RECT locked_rect;
-    if (FAILED(d3dsurface->LockRect(&locked_rect, nullptr, D3DLOCK_READONLY)))
+    if (m_convert)
     {
-        VideoLog::AppendError("Failed to lock d3d surface\n");
-        return false;
-    }
-
-    defer { d3dsurface->UnlockRect(); };
-    for (uint32_t row = 0; row < buffer.GetHeight(); ++row)
-    {
-        const uint8_t* data = (const uint8_t*)locked_rect.pBits + row * locked_rect.Pitch;
-        ffmpipe::PipeStatus status = m_pipe->Write(data, buffer.GetPixelStride() * buffer.GetWidth());
+        std::optional<FrameBufferRgba> rgba;
+        std::optional<FrameBufferRgb> rgb;
+        const uint8_t* data;
+        size_t size;
+        if (m_alpha)
+        {
+            rgba.emplace(buffer.ToRgba(m_tonemap));
+            data = rgba->GetData(), size = rgba->GetDataLength();
+        }
+        else
+        {
+            rgb.emplace(buffer.ToRgb(m_tonemap));
+            data = rgb->GetData(), size = rgb->GetDataLength();
+        }
+        ffmpipe::PipeStatus status = m_pipe->Write(data, size);
         if (!status.IsOk())
         {
             std::string message = status.ToString();
             VideoLog::AppendError("Failed to write pixels to FFmpeg: %s\n", message.c_str());
             return false;
         }
+        return true;
     }
-    return true;
-}
-
-FramePool::FramePool(
-    size_t num_threads, size_t num_frames,
-    uint32_t frame_width, uint32_t frame_height
-) {
-    assert(num_frames > 0 && "Frame pool must contain at least 1 frame");
-
-    m_threads.reserve(num_threads);
-    m_all.reserve(num_frames);
-    m_full.reserve(num_frames);
-    m_empty.reserve(num_frames);
-
-    IDirect3DSurface9* render_target;
-    D3DSURFACE_DESC surface_desc;
-    if (FAILED(g_hk_overlay.Device()->GetRenderTarget(0, &render_target)))
-        assert(0 && "Failed to get render target");
-    defer { render_target->Release(); };
-    if (FAILED(render_target->GetDesc(&surface_desc)))
-        assert(0 && "Failed to get the render target's surface desc");
-
-    // Fill the empty-frame pool with empty frames
-    for (size_t i = 0; i < num_frames; ++i)
-    {
-        m_all.push_back(std::make_shared<Frame>(FrameBufferDx9(frame_width, frame_height, D3DFMT_A8R8G8B8)));
-        m_empty.push_back(m_all.back());
-    }
-
-    // Create worker threads (without running them yet)
-    for (size_t i = 0; i < num_threads; ++i)
-        m_threads.emplace_back(&WorkerLoop, this);
-}
 
-void FramePool::Close()
-{
-    std::scoped_lock closing_lock{m_close_mutex};
-    if (IsClosed())
-        return;
-    
+    size_t pitch;
+    const uint8_t* pixels = buffer.LockRead(&pitch);
+    if (!pixels)
     {
-        std::scoped_lock lock{m_mutex};
-        m_all.clear();
-        m_empty.clear();
-        m_sync_writers.clear();
-    }
-    m_cv_empty.notify_all();
-    m_cv_full.notify_all();
-    
-    for (auto& thread : m_threads)
-        thread.join();
-    m_threads.clear();
-    m_full.clear();
-}
-
-void FramePool::PushFullFrame(const FramePtr& frame, size_t index, const std::shared_ptr<VideoWriter>& writer)
-{
-    if (IsClosed())
-        return;
-
-    assert(writer != nullptr && "A writer must be provided to write the frame");
-    assert(frame->buffer.GetWidth() * frame->buffer.GetHeight() != 0 && "Frame buffer must have non-zero size. Resize the buffer before use.");
-
-    frame->writer = writer;
-    frame->index = index;
-
-    {
-        std::scoped_lock lock{m_mutex};
-        assert(m_full.size() < m_all.size() && "More frames are being pushed than exists in the pool");
-        m_full.push_back(frame);
+        VideoLog::AppendError("Failed to lock frame buffer\n");
+        return false;
     }
-    m_cv_full.notify_one();
-}
 
-FramePool::FramePtr FramePool::PopFullFrame()
-{
-    FramePtr popped;
+    defer { buffer.UnlockRead(); };
+    for (uint32_t row = 0; row < buffer.GetHeight(); ++row)
     {
-        std::unique_lock lock{m_mutex};
-        // Index of the best frame to pop
-        size_t frame_index = ~(size_t)0;
-        // Wait for a good frame to pop
-        m_cv_full.wait(lock, [this, &frame_index]
+        const uint8_t* data = pixels + row * pitch;
+        ffmpipe::PipeStatus status = m_pipe->Write(data, buffer.GetRowSize());
+        if (!status.IsOk())
         {
-            if (IsClosed())
-                return true; // The pool was closed. Stop waiting.
-            
-            // Only pop a frame whose writer isn't currently in use
-            for (size_t i = 0; i < m_full.size(); ++i)
-            {
-                if (m_sync_writers.find(m_full[i]->writer.get()) == m_sync_writers.end())
-                {
-                    frame_index = i;
-                    return true;
-                }
-            }
+            std::string message = status.ToString();
+            VideoLog::AppendError("Failed to write pixels to FFmpeg: %s\n", message.c_str());
             return false;
-        });
-        if (frame_index == ~(size_t)0)
-            return nullptr;
-
-        popped = std::move(m_full[frame_index]);
-        if (!popped->writer->IsAsync()) // List the writer as currently in use
-            m_sync_writers.emplace(popped->writer.get());
-        m_full.erase(m_full.begin() + frame_index);
-    }
-    m_cv_full.notify_one();
-    return popped;
-}
-
-void FramePool::PushEmptyFrame(FramePtr frame)
-{
-    if (IsClosed())
-        return;
-    
-    bool is_sync_writer_useable = false;
-    assert(frame->writer && "frame->writer must be a valid pointer");
-
-    {
-        std::scoped_lock lock{m_mutex};
-        assert(m_empty.size() < m_all.size() && "More frames are being pushed than exists in the pool");
-        if (frame->writer)
-        {
-            if (m_sync_writers.erase(frame->writer.get()) && !m_full.empty())
-                is_sync_writer_useable = true;
         }
-        frame->writer = nullptr;
-        m_empty.emplace_back(std::move(frame));
-    }
-    m_cv_empty.notify_one();
-    if (is_sync_writer_useable)
-        m_cv_full.notify_one();
-}
-
-FramePool::FramePtr FramePool::PopEmptyFrame()
-{
-    FramePtr back;
-    {
-        std::unique_lock lock{m_mutex};
-        m_cv_empty.wait(lock, [this]{ return IsClosed() || !m_empty.empty(); });
-        if (IsClosed())
-            return nullptr;
-
-        back = m_empty.back();
-        m_empty.pop_back();
     }
-    m_cv_empty.notify_one();
-    return back;
+    return true;
 }
-
-void FramePool::WorkerLoop(FramePool* pool)
-{
-    while (FramePtr frame = pool->PopFullFrame())
-    {
-        std::shared_ptr<VideoWriter> writer = frame->writer;
-        assert(writer != nullptr && "frame->writer must be assigned before calling PushFullFrame");
-
-        bool result = writer->WriteFrame(frame->buffer, frame->index);
-        pool->PushEmptyFrame(frame);
-        if (!result)
-        {
-            VideoLog::AppendError("`writer->WriteFrame` failed. The FramePool will close.\n");
-            // We can't call Close from within a worker thread, or it would have to wait on itself.
-            // A new thread is spanwed to do this.
-            std::thread([](FramePool* pool) { pool->Close(); }, pool).detach();
-            return;
-        }
-    }
-}
\ No newline at end of file
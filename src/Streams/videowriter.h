@@ -4,78 +4,27 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
+#include <atomic>
 #include <string_view>
 #include <vector>
-#include <unordered_set>
+#include <fstream>
+#include <unordered_map>
 #include <Helper/d3d9.h>
 #include <Helper/threading.h>
 #include <Helper/str.h>
 #include <Helper/json.h>
+#include "videolog.h"
+#include "framebuffer.h"
+#include "framepool.h"
+#include "palette.h"
+#include "crop.h"
+#include "delta.h"
+#include "rawdump.h"
+#include "hdr.h"
 
-class FrameBufferDx9;
-class FrameBufferRgb;
 namespace ffmpipe { class Pipe; }
 
-/**
- * @brief A global, thread-safe video log
- */
-class VideoLog
-{
-public:
-    struct ConsoleQueue
-    {
-        void Append(std::string text)
-        {
-            std::scoped_lock lock(m_mutex);
-            m_queue.push_back(std::move(text));
-        }
-
-        void ExecuteAndClear();
-
-        void Clear()
-        {
-            std::scoped_lock lock(m_mutex);
-            m_queue.clear();
-        }
-    private:
-        friend VideoLog;
-        explicit ConsoleQueue() = default;
-
-        std::vector<std::string> m_queue;
-        std::mutex m_mutex;
-    };
-
-    static void Append(const std::string& text);
-
-    /// @brief Append text to the error log. Newlines should be added.
-    static void AppendError(const std::string& text);
-    /// @brief Append text to the error log. Newlines should be added.
-    static void AppendError(const std::string_view text) {
-        return AppendError(std::string(text));
-    }
-    /// @brief Append text to the error log. Newlines should be added.
-    template <class... TArgs>
-    static void AppendError(const char* fmt, TArgs&&... args) {
-        AppendError(Helper::sprintf(fmt, std::forward<TArgs>(args)...));
-    }
-    static void Clear();
-    static Helper::LockedRef<std::string> GetLog() { return Helper::LockedRef<std::string>(log, mutex); }
-    /// @brief Lines are appended here to be removed and printed by the recorder in the game thread
-    static ConsoleQueue& GetConsoleQueue() {
-        return console_queue;
-    }
-    static bool HasErrors() {
-        std::scoped_lock lock{mutex};
-        return has_errors;
-    }
-
-private:
-    static inline std::string log;
-    static inline ConsoleQueue console_queue;
-    static inline std::mutex mutex;
-    static inline bool has_errors = false;
-};
-
 /**
  * @brief Video encoding options.
  * @details Mainly for use with the GUI and config system.
@@ -104,6 +53,11 @@ public:
     static const TypeDesc* TYPE_QOI;
     static const TypeDesc* TYPE_PNG;
     static const TypeDesc* TYPE_FFMPEG;
+    static const TypeDesc* TYPE_MASK;
+    static const TypeDesc* TYPE_DEPTH;
+    static const TypeDesc* TYPE_DELTA;
+    static const TypeDesc* TYPE_RAW;
+    static const TypeDesc* TYPE_EXR;
 
     /// @brief One of the `TYPE_` constants
     const TypeDesc* type = TYPE_PNG;
@@ -115,9 +69,34 @@ public:
     std::filesystem::path ffmpeg_path;
     /// @brief A value between 0 and 9
     int png_compression = 1;
+    /// @brief Image sequences will hard-link frames that are identical to the previous one, instead of encoding them
+    bool link_duplicates = false;
+    /// @brief PNGs with few colors, like mattes, are written with a palette instead of 24-bit pixels
+    bool png_palette = true;
+    /// @brief Image sequences only encode the bounding box of pixels that differ from the background
+    bool crop_to_content = false;
+    /// @brief The channel that masks are taken from. 0 = red, 1 = green, 2 = blue.
+    int mask_channel = 1;
+    /// @brief Above 0, masks are 1-bit and set where the channel is at least this value. Otherwise, masks are 8-bit.
+    int mask_threshold = 128;
+    /// @brief Mask streams with the same non-empty group are written to one file, each as a bit plane
+    std::string mask_group;
+    /// @brief A @ref DepthWriter::Format
+    int depth_format = 0;
+    /// @brief Frames between each keyframe of a delta file
+    int delta_keyframe_interval = 60;
+    /// @brief Compress each frame of a raw dump with LZ4
+    bool raw_lz4 = false;
+    /// @brief PNG, QOI and FFmpeg keep the frames' alpha channel, instead of writing RGB
+    bool alpha = false;
+    /// @brief A @ref Hdr::Tonemap, for converting float frames to 8-bit
+    int tonemap = 0;
+    /// @brief EXRs store half floats instead of full floats
+    bool exr_half = true;
 
     /// @brief Render the ImGui controls. It's best to push a unique ID before calling.
-    void ShowImguiControls();
+    /// @param show_framerate Hide this for configs whose framerate is decided elsewhere
+    void ShowImguiControls(bool show_framerate = true);
     void FromJson(const nlohmann::json* json) override;
     nlohmann::json ToJson() const override;
 
@@ -126,28 +105,6 @@ public:
     static const std::vector<FFmpegPreset>& GetFFmpegPresets();
 };
 
-/**
- * @brief Implements a video encoder for @ref FramePool to write frames (as video or image sequence).
- * 
- * Each instance corresponds to one video file or one image sequence.
- */
-class VideoWriter
-{
-public:
-    virtual ~VideoWriter() {}
-    /**
-     * @brief Write the frame buffer. Blocking.
-     * @param frame_index Index of the frame being written.
-     * @return `false` on failure
-     */
-    virtual bool WriteFrame(const FrameBufferDx9& buffer, size_t frame_index) = 0;
-    /**
-     * @brief Whether this instance supports async and unordered writes.
-     * @details When false, the FramePool will ensure that writes are ordered and synchronous.
-     */
-    virtual bool IsAsync() const = 0;
-};
-
 /**
  * @brief Write a sequence of images suffixed with a number and file extension
  */
@@ -163,76 +120,332 @@ public:
             : m_width(width), m_height(height), m_file_format(file_format), m_base_path(std::move(base_path)) {}
 
     /// @brief Write the frame to file
-    bool WriteFrame(const FrameBufferDx9& buffer, size_t frame_index) override;
+    bool WriteFrame(const FrameBufferBase& buffer, size_t frame_index) override;
     bool IsAsync() const override { return true; }
+    /// @brief Write PNGs without compression, while degraded
+    bool SetDegraded(bool degraded) override;
     /// @param compression A value between 0 and 9
     void SetPngCompression(int compression) { m_png_compression = compression; }
+    /// @brief Hard-link a frame to the last written file when their pixels are identical
+    void SetLinkDuplicates(bool link) { m_link_duplicates = link; }
+    /// @brief Write PNGs with up to 256 colors as indexed PNGs
+    void SetPngPalette(bool palette) { m_png_palette = palette; }
+    /**
+     * @brief Only encode the bounding box of pixels that differ from the top-left pixel.
+     * @details Each frame's box and background color are listed in `crop.csv`, next to the frames,
+     * so they can be padded back to full size. PNGs also store the box's position in an `oFFs` chunk.
+     */
+    void SetCropToContent(bool crop) { m_crop_to_content = crop; }
+    /**
+     * @brief Write RGBA images that keep the frames' alpha channel.
+     * @details Indexed colors and cropping only apply to RGB, so they're skipped.
+     */
+    void SetAlpha(bool alpha) { m_alpha = alpha; }
+    /// @brief How float frames are converted to 8-bit
+    void SetTonemap(Hdr::Tonemap tonemap) { m_tonemap = tonemap; }
 
     /// @param compression A value between 0 and 9
-    static bool WritePNG(const FrameBufferRgb& buffer, std::ostream& output, int compression = 7);
+    /// @param crop If set, the image is this part of a larger frame
+    static bool WritePNG(const FrameBufferRgb& buffer, std::ostream& output, int compression = 7, const Crop::Rect* crop = nullptr);
+    /// @param compression A value between 0 and 9
+    /// @param crop If set, the image is this part of a larger frame
+    static bool WritePNG(
+        const IndexedImage& image, uint32_t width, uint32_t height, std::ostream& output,
+        int compression = 7, const Crop::Rect* crop = nullptr
+    );
+    /// @param compression A value between 0 and 9
+    static bool WritePNG(const FrameBufferRgba& buffer, std::ostream& output, int compression = 7);
     static bool WriteQOI(const FrameBufferRgb& buffer, std::ostream& output);
+    static bool WriteQOI(const FrameBufferRgba& buffer, std::ostream& output);
 
 private:
+    /// @brief Where a cropped frame is within the full frame
+    struct CropEntry
+    {
+        Crop::Rect rect;
+        /// @brief The color of every pixel outside of the rect
+        uint8_t background[3] = {0};
+    };
+
+    std::filesystem::path GetFramePath(size_t frame_index) const;
+    /**
+     * @brief Encode the frame as RGB, cropping it and indexing its colors if enabled.
+     * @param crop Receives the frame's crop
+     */
+    bool WriteRgb(const FrameBufferBase& buffer, size_t frame_index, std::ostream& output, CropEntry* crop);
+    /**
+     * @brief Link the frame's file to the last written file, if their hashes match.
+     * @param last_crop Receives the crop of the last written file
+     * @return `true` if the frame was linked and needs no encoding
+     */
+    bool LinkDuplicate(uint64_t hash, const std::filesystem::path& path, CropEntry* last_crop);
+    /// @brief Add a line to the crop index. Frames are written out-of-order, so lines are too.
+    void AppendCropIndex(size_t frame_index, const CropEntry& crop);
+
     const uint32_t m_width;
     const uint32_t m_height;
     const Format m_file_format;
     int m_png_compression = 6;
+    std::atomic<bool> m_degraded = false;
+    bool m_link_duplicates = false;
+    bool m_png_palette = false;
+    bool m_crop_to_content = false;
+    bool m_alpha = false;
+    Hdr::Tonemap m_tonemap = Hdr::Tonemap::CLAMP;
     std::filesystem::path m_base_path;
+
+    /// @brief Protects the last-written frame's info
+    std::mutex m_last_mutex;
+    /// @brief Hash of the last fully-written frame
+    uint64_t m_last_hash = 0;
+    /// @brief Path of the last fully-written frame. Empty if nothing was written.
+    std::filesystem::path m_last_path;
+    /// @brief Crop of the last fully-written frame
+    CropEntry m_last_crop;
+
+    /// @brief Protects the crop index
+    std::mutex m_crop_mutex;
+    /// @brief Opened with the first cropped frame
+    std::ofstream m_crop_index;
 };
 
-class FFmpegWriter : public VideoWriter
+/**
+ * @brief A sequence of grayscale PNGs, holding the masks of one or more streams.
+ *
+ * With one stream, each PNG is the stream's 1-bit or 8-bit mask.
+ * With more streams, each stream's binary mask is stored in its own bit of an 8-bit PNG,
+ * so several mattes are encoded into one file per frame.
+ */
+class MaskSequence
 {
 public:
+    static constexpr size_t MAX_PLANES = 8;
+
     /**
-     * @param output_args FFmpeg output args to append after the `-i` flag, not including the output file name.
-     * @param output_path Path of the output file
+     * @param num_planes Number of streams that are written to the sequence. Above 1, masks must be binary.
+     * @param binary The masks are binary
+     * @param base_path File path including the name but not the extension
      */
-    FFmpegWriter(uint32_t width, uint32_t height, uint32_t framerate, const std::string& output_args, const std::filesystem::path& output_path);
-    ~FFmpegWriter();
-    
-    bool WriteFrame(const FrameBufferDx9& buffer, size_t frame_index) override;
-    bool IsAsync() const override { return false; }
+    MaskSequence(uint32_t width, uint32_t height, size_t num_planes, bool binary, int compression, std::filesystem::path&& base_path);
+    /// @brief Write the frames that are missing planes, such as frames that were dropped for some streams
+    ~MaskSequence();
+
+    /// @brief Add a stream's mask to a frame, and write the frame once every plane is added. Thread-safe.
+    bool AddPlane(size_t frame_index, size_t plane, const uint8_t* mask);
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
 
 private:
-    std::shared_ptr<ffmpipe::Pipe> m_pipe;
+    bool WriteFile(size_t frame_index, const uint8_t* pixels);
+
+    struct PendingFrame
+    {
+        std::vector<uint8_t> planes;
+        size_t num_added = 0;
+    };
+
+    const uint32_t m_width;
+    const uint32_t m_height;
+    const size_t m_num_planes;
+    const bool m_binary;
+    const int m_compression;
+    const std::filesystem::path m_base_path;
+    /// @brief Protects @ref m_pending
+    std::mutex m_mutex;
+    /// @brief Frames that some planes were added to
+    std::unordered_map<size_t, PendingFrame> m_pending;
 };
 
-class FrameBufferBase
+/**
+ * @brief Extract one channel of a stream as a mask, and add it to a @ref MaskSequence
+ */
+class MaskWriter : public VideoWriter
 {
 public:
-    virtual ~FrameBufferBase() {}
-    virtual uint32_t GetWidth() const = 0;
-    virtual uint32_t GetHeight() const = 0;
-    virtual D3DFORMAT GetFormat() const = 0;
-    virtual const Helper::D3DFORMAT_info& GetFormatInfo() const = 0;
+    /**
+     * @param plane This stream's bit plane in the sequence
+     * @param channel 0 = red, 1 = green, 2 = blue
+     * @param threshold Above 0, the mask is binary and set where the channel is at least this value
+     */
+    MaskWriter(std::shared_ptr<MaskSequence> sequence, size_t plane, int channel, int threshold)
+        : m_sequence(std::move(sequence)), m_plane(plane), m_channel(channel), m_threshold(threshold) {}
+
+    bool WriteFrame(const FrameBufferBase& buffer, size_t frame_index) override;
+    bool IsAsync() const override { return true; }
+
+private:
+    std::shared_ptr<MaskSequence> m_sequence;
+    const size_t m_plane;
+    const int m_channel;
+    const int m_threshold;
 };
 
 /**
- * @brief Wrap a read/writeable 24-bit RGB buffer
+ * @brief Write a sequence of high-precision depth images.
+ *
+ * Frames must hold 24-bit depth packed as 0xRRGGBB, by a depth shader with "Pack into RGB".
  */
-class FrameBufferRgb : public FrameBufferBase
+class DepthWriter : public VideoWriter
 {
 public:
-    FrameBufferRgb(uint32_t width, uint32_t height)
-        : m_width(width), m_height(height), m_data((uint8_t*)malloc(width * height * 3)) {}
-    ~FrameBufferRgb() { free(m_data); }
-    FrameBufferRgb(FrameBufferRgb&& other) : m_data(other.m_data), m_width(other.m_width), m_height(other.m_height) {
-        other.m_data = nullptr;
-    }
+    enum class Format
+    {
+        /// @brief 16-bit grayscale PNG
+        PNG16,
+        /// @brief OpenEXR with a 32-bit float `Z` channel
+        EXR_FLOAT,
+        /// @brief OpenEXR with a 16-bit float `Z` channel
+        EXR_HALF,
+        _COUNT,
+    };
 
-    uint32_t GetWidth() const override { return m_width; }
-    uint32_t GetHeight() const override { return m_height; }
-    D3DFORMAT GetFormat() const override { return Helper::D3DFMT_B8G8R8; }
-    const Helper::D3DFORMAT_info& GetFormatInfo() const;
-    uint8_t* GetData() { return m_data; }
-    const uint8_t* GetData() const { return m_data; }
-    size_t GetDataLength() const { return m_width * m_height * GetPixelStride(); }
-    size_t GetPixelStride() const { return 3; }
+    /**
+     * @param compression A value between 0 and 9
+     * @param base_path File path including the name but not the extension
+     */
+    DepthWriter(Format format, int compression, std::filesystem::path&& base_path)
+        : m_format(format), m_compression(compression), m_base_path(std::move(base_path)) {}
+
+    bool WriteFrame(const FrameBufferBase& buffer, size_t frame_index) override;
+    bool IsAsync() const override { return true; }
 
 private:
-    uint32_t m_width;
-    uint32_t m_height;
-    uint8_t* m_data;
+    const Format m_format;
+    const int m_compression;
+    const std::filesystem::path m_base_path;
+};
+
+/**
+ * @brief Write a sequence of OpenEXR images with linear color.
+ *
+ * Float frames are written as they are, since the game renders HDR in linear space.
+ * 8-bit frames are decoded from sRGB.
+ */
+class ExrWriter : public VideoWriter
+{
+public:
+    /**
+     * @param alpha Add an `A` channel
+     * @param half Store half floats instead of full floats
+     * @param compression A value between 0 and 9
+     * @param base_path File path including the name but not the extension
+     */
+    ExrWriter(bool alpha, bool half, int compression, std::filesystem::path&& base_path)
+        : m_alpha(alpha), m_half(half), m_compression(compression), m_base_path(std::move(base_path)) {}
+
+    bool WriteFrame(const FrameBufferBase& buffer, size_t frame_index) override;
+    bool IsAsync() const override { return true; }
+
+private:
+    const bool m_alpha;
+    const bool m_half;
+    const int m_compression;
+    const std::filesystem::path m_base_path;
+};
+
+/**
+ * @brief Write a stream to one file, only storing the tiles that changed since the previous frame.
+ *
+ * The file starts with @ref MAGIC, then the version, width, height and tile size as 32-bit integers.
+ * Each frame follows as its index and size as 32-bit integers, then a frame from @ref Delta::Encoder.
+ * The file ends with an index for seeking: each keyframe's index as a 32-bit integer and file offset
+ * as a 64-bit integer, the number of keyframes as a 32-bit integer, the offset of the index
+ * as a 64-bit integer, and @ref MAGIC again. Integers are little-endian.
+ */
+class DeltaWriter : public VideoWriter
+{
+public:
+    static constexpr char MAGIC[8] = "SFDELTA";
+    static constexpr uint32_t VERSION = 1;
+
+    /**
+     * @param keyframe_interval Frames between each keyframe
+     * @param output_path Path of the output file
+     */
+    DeltaWriter(uint32_t width, uint32_t height, int keyframe_interval, const std::filesystem::path& output_path);
+    /// @brief Write the keyframe index
+    ~DeltaWriter();
+
+    bool WriteFrame(const FrameBufferBase& buffer, size_t frame_index) override;
+    /// @brief Each frame is encoded against the one before it
+    bool IsAsync() const override { return false; }
+
+private:
+    struct Keyframe
+    {
+        uint32_t frame_index;
+        uint64_t offset;
+    };
+
+    Delta::Encoder m_encoder;
+    const int m_keyframe_interval;
+    const std::filesystem::path m_path;
+    std::ofstream m_file;
+    /// @brief File offset of the next frame
+    uint64_t m_offset = 0;
+    size_t m_num_frames = 0;
+    std::vector<Keyframe> m_keyframes;
+    std::vector<uint8_t> m_encoded;
+};
+
+/**
+ * @brief Write a stream's frames to one file with almost no processing, to encode later with `sf-transcode`.
+ * @details See @ref RawDump for the format.
+ */
+class RawWriter : public VideoWriter
+{
+public:
+    /**
+     * @param stream_name Stored in the header, for the transcoder
+     * @param lz4 Compress each frame with LZ4
+     * @param output_path Path of the output file
+     */
+    RawWriter(uint32_t framerate, std::string stream_name, bool lz4, const std::filesystem::path& output_path);
+
+    bool WriteFrame(const FrameBufferBase& buffer, size_t frame_index) override;
+    /// @brief Frames are appended to one sequential file
+    bool IsAsync() const override { return false; }
+
+private:
+    const uint32_t m_framerate;
+    const std::string m_stream_name;
+    const bool m_lz4;
+    const std::filesystem::path m_path;
+    std::ofstream m_file;
+    /// @brief The header is written with the first frame, once the pixel format is known
+    bool m_wrote_header = false;
+    RawDump::Header m_header;
+    /// @brief Rows of the frame without padding, when the buffer's pitch has some
+    std::vector<uint8_t> m_packed;
+    std::vector<uint8_t> m_compressed;
+};
+
+class FFmpegWriter : public VideoWriter
+{
+public:
+    /**
+     * @param output_args FFmpeg output args to append after the `-i` flag, not including the output file name.
+     * @param output_path Path of the output file
+     * @param frame_format Format of the frames that will be written. Float frames are converted to 8-bit.
+     * @param alpha Send the frames' alpha channel to FFmpeg. The codec must support it, or it's dropped.
+     * @param tonemap How float frames are converted to 8-bit
+     */
+    FFmpegWriter(
+        uint32_t width, uint32_t height, uint32_t framerate, const std::string& output_args,
+        const std::filesystem::path& output_path, D3DFORMAT frame_format, bool alpha = false,
+        Hdr::Tonemap tonemap = Hdr::Tonemap::CLAMP
+    );
+    ~FFmpegWriter();
+    
+    bool WriteFrame(const FrameBufferBase& buffer, size_t frame_index) override;
+    bool IsAsync() const override { return false; }
+
+private:
+    std::shared_ptr<ffmpipe::Pipe> m_pipe;
+    /// @brief Frames are float, so they're converted to 8-bit before they're piped
+    bool m_convert = false;
+    bool m_alpha = false;
+    Hdr::Tonemap m_tonemap = Hdr::Tonemap::CLAMP;
 };
 
 /**
@@ -253,116 +466,19 @@ public:
         other.m_d3dsurface = nullptr;
     }
 
-    /// @brief Convert to a 24-bit RGB surface
-    FrameBufferRgb ToRgb() const;
     uint32_t GetWidth() const override { return m_width; }
     uint32_t GetHeight() const override { return m_height; }
     D3DFORMAT GetFormat() const override { return m_d3dformat; }
     const Helper::D3DFORMAT_info& GetFormatInfo() const override { return m_d3dformat_info; }
     IDirect3DSurface9* GetSurface() const { return m_d3dsurface; }
     uint8_t GetNumChannels() const { return GetFormatInfo().num_channels; }
-    /// @brief The number of bytes between each pixel
-    uint8_t GetPixelStride() const { return GetFormatInfo().stride; }
+    const uint8_t* LockRead(size_t* pitch) const override;
+    void UnlockRead() const override;
 
 private:
-
-    static void BlitRgb(FrameBufferRgb* dst, D3DLOCKED_RECT src);
-    static void BlitBgr(FrameBufferRgb* dst, D3DLOCKED_RECT src);
-    static void BlitRgba(FrameBufferRgb* dst, D3DLOCKED_RECT src);
-    static void BlitBgra(FrameBufferRgb* dst, D3DLOCKED_RECT src);
-
     uint32_t m_width = 0;
     uint32_t m_height = 0;
     IDirect3DSurface9* m_d3dsurface = nullptr;
     D3DFORMAT m_d3dformat = D3DFMT_UNKNOWN;
     Helper::D3DFORMAT_info m_d3dformat_info = {0};
 };
-
-/**
- * @brief A worker pool that writes video frames.
- * 
- * Call @ref PopEmptyFrame to get an empty frame buffer.
- * Fill the buffer with data and call @ref PushFullFrame to have a worker encode it.
- * 
- * Threads are spawned in the constructor and do not stop until either the destructor or the @ref Close function is called.
- */
-class FramePool
-{
-public:
-    /**
-     * @brief A frame from the pool.
-     * 
-     * The user must fill `buffer` with the desired contents and send it back to the pool using @ref PushFullFrame.
-     * 
-     * The worker threads must encode `buffer` using the provided `writer` and send it back to the pool using @ref PushEmptyFrame.
-     */
-    struct Frame
-    {
-        Frame(FrameBufferDx9&& buffer) : buffer(std::move(buffer)) {}
-        FrameBufferDx9 buffer;
-        size_t index;
-        std::shared_ptr<VideoWriter> writer;
-    };
-    using FramePtr = std::shared_ptr<Frame>;
-
-    /**
-     * @brief Initialize the frame pool and spawn threads.
-     * @param num_threads Number of worker threads to spawn.
-     * @param num_frames Number of frame buffers in the pool.
-     */
-    FramePool(
-        size_t num_threads, size_t num_frames,
-        uint32_t frame_width, uint32_t frame_height
-    );
-    ~FramePool() { Close(); }
-
-    /// @brief Stop accepting new work, wait for all threads to end, and drain the pool.
-    /// @details Do not call this from within the pool's own worker thread(s).
-    void Close();
-    bool IsClosed() const { return m_all.empty(); }
-    /**
-     * @brief Block indefinitely until an empty frame can be popped, or work has finished.
-     * @details Fill this frame and pass it to @ref PushFullFrame.
-     * @return `nullptr` if the pool is closed, no longer accepting work.
-     */
-    FramePtr PopEmptyFrame();
-    /// @brief Push a frame for a worker thread to pop and use
-    /// @param index Index of the frame being written. `frame->index` will be assigned this.
-    /// @param writer Method of writing the frame to video. `frame->writer` will be assigned this.
-    void PushFullFrame(const FramePtr& frame, size_t index, const std::shared_ptr<VideoWriter>& writer);
-
-private:
-    /**
-     * @brief Block indefinitely until a full frame can be popped, or work has finished.
-     * @details Work on this frame and then pass it to @ref PushEmptyFrame.
-     * @return `nullptr` if all work is finished.
-     */
-    FramePtr PopFullFrame();
-    /**
-     * @brief Free a frame after it's been written, returning it to the pool.
-     * 
-     * The `frame->writer` pointer must be valid.
-     * If the writer is synchronous, it will become useable for a new thread again.
-     * @param frame A valid pointer with a valid buffer and writer.
-     */
-    void PushEmptyFrame(FramePtr frame);
-    static void WorkerLoop(FramePool* pool);
-
-    std::vector<std::thread> m_threads;
-    /// @brief All frames in the pool.
-    /// This vector is cleared to indicate that no further work shall be added.
-    std::vector<FramePtr> m_all;
-    /// @brief Frames that are ready to be filled with pixels
-    std::vector<FramePtr> m_empty;
-    /// @brief Frames that are filled with pixels
-    std::vector<FramePtr> m_full;
-    /// @brief Synchronous writers that are currently in use
-    std::unordered_set<const VideoWriter*> m_sync_writers;
-    /// @brief The list of threads waiting on @ref m_empty
-    std::condition_variable m_cv_empty;
-    /// @brief The list of threads waiting on @ref m_full
-    std::condition_variable m_cv_full;
-    std::mutex m_mutex;
-    /// @brief Locked during @ref Close to prevent repeated closing.
-    std::mutex m_close_mutex;
-};
@@ -0,0 +1,87 @@
+// Tests FrameArena's slot allocation and layout, with and without large pages.
+#include "check.h"
+#include <Streams/arena.h>
+#include <cstring>
+#include <set>
+
+/// @brief Every slot is handed out once, and freed slots are reused most recent first
+static void TestAllocate()
+{
+    FrameArena arena(1000, 4, false);
+    CHECK(arena.IsValid());
+    CHECK(arena.GetNumFree() == 4);
+
+    std::set<size_t> slots;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        size_t slot = arena.Allocate();
+        CHECK(slot == i);
+        slots.insert(slot);
+    }
+    CHECK(slots.size() == 4);
+    CHECK(arena.GetNumFree() == 0);
+    CHECK(arena.Allocate() == FrameArena::NO_SLOT);
+
+    arena.Free(1);
+    arena.Free(3);
+    CHECK(arena.GetNumFree() == 2);
+    CHECK(arena.Allocate() == 3);
+    CHECK(arena.Allocate() == 1);
+    CHECK(arena.Allocate() == FrameArena::NO_SLOT);
+}
+
+/// @brief Slots start on cache lines, and filling one doesn't touch its neighbors
+static void TestSlotLayout()
+{
+    constexpr size_t SLOT_SIZE = 100;
+    constexpr size_t NUM_SLOTS = 5;
+    FrameArena arena(SLOT_SIZE, NUM_SLOTS, false);
+    CHECK(arena.IsValid());
+
+    for (size_t i = 0; i < NUM_SLOTS; ++i)
+    {
+        CHECK((uintptr_t)arena.GetSlot(i) % 64 == 0);
+        if (i > 0)
+            CHECK(arena.GetSlot(i) >= arena.GetSlot(i - 1) + SLOT_SIZE);
+        memset(arena.GetSlot(i), (int)i + 1, SLOT_SIZE);
+    }
+    for (size_t i = 0; i < NUM_SLOTS; ++i)
+    {
+        const uint8_t* slot = arena.GetSlot(i);
+        bool intact = true;
+        for (size_t j = 0; j < SLOT_SIZE; ++j)
+            intact = intact && slot[j] == i + 1;
+        CHECK(intact);
+    }
+}
+
+/// @brief Asking for large pages always gives a usable arena, falling back to normal pages if they're refused
+static void TestLargePages()
+{
+    constexpr size_t SLOT_SIZE = 3 << 20;
+    FrameArena arena(SLOT_SIZE, 2, true);
+    CHECK(arena.IsValid());
+    CHECK(arena.GetSlotSize() == SLOT_SIZE);
+    CHECK(arena.GetNumSlots() == 2);
+
+    size_t first = arena.Allocate();
+    size_t second = arena.Allocate();
+    CHECK(first != FrameArena::NO_SLOT && second != FrameArena::NO_SLOT);
+    memset(arena.GetSlot(first), 0xAB, SLOT_SIZE);
+    memset(arena.GetSlot(second), 0xCD, SLOT_SIZE);
+    CHECK(arena.GetSlot(first)[SLOT_SIZE - 1] == 0xAB);
+    CHECK(arena.GetSlot(second)[0] == 0xCD);
+
+    // Without large pages, the arena never reports them
+    FrameArena small(SLOT_SIZE, 1, false);
+    CHECK(small.IsValid());
+    CHECK(!small.HasLargePages());
+}
+
+int main()
+{
+    TestAllocate();
+    TestSlotLayout();
+    TestLargePages();
+    return Check::Result();
+}
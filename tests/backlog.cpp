@@ -0,0 +1,170 @@
+// Tests that FrameBacklog fills its tiers in order, and restores every frame it stored.
+#include "check.h"
+#include "fake-writer.h"
+#include <Streams/backlog.h>
+#include <filesystem>
+#include <iterator>
+
+static constexpr uint32_t WIDTH = 32;
+static constexpr uint32_t HEIGHT = 16;
+static constexpr size_t RAW_SIZE = (size_t)WIDTH * HEIGHT * 4;
+
+static FrameBufferMem MakeFrame(size_t index)
+{
+    FrameBufferMem buffer(WIDTH, HEIGHT, D3DFMT_A8R8G8B8);
+    std::vector<uint8_t> pixels = MakeFramePixels(buffer.GetDataLength(), index);
+    memcpy(buffer.GetData(), pixels.data(), pixels.size());
+    return buffer;
+}
+
+/// @brief Reserve room for a frame, like a worker does before storing it
+static FrameBacklog::Entry Reserve(FrameBacklog& backlog, size_t index)
+{
+    FrameBacklog::Entry entry;
+    backlog.TryReserve(RAW_SIZE, &entry);
+    entry.index = index;
+    return entry;
+}
+
+/// @brief Store a reserved frame, and push it
+static void Store(FrameBacklog& backlog, FrameBacklog::Entry&& entry)
+{
+    CHECK(backlog.Store(MakeFrame(entry.index), &entry));
+    backlog.Push(std::move(entry), RAW_SIZE);
+}
+
+/// @brief Reserve, store, and push a frame. Returns the entry's tier, or NONE if it didn't fit.
+static FrameBacklog::Tier StoreFrame(FrameBacklog& backlog, size_t index)
+{
+    FrameBacklog::Entry entry = Reserve(backlog, index);
+    FrameBacklog::Tier tier = entry.tier;
+    if (tier != FrameBacklog::Tier::NONE)
+        Store(backlog, std::move(entry));
+    return tier;
+}
+
+/// @brief Take and restore the oldest entry, and check its pixels
+static void RestoreOldest(FrameBacklog& backlog, size_t expected_index)
+{
+    CHECK(!backlog.IsEmpty());
+    FrameBacklog::Entry entry = backlog.Take(0);
+    CHECK(entry.index == expected_index);
+    FrameBufferMem buffer(entry.width, entry.height, entry.format);
+    CHECK(backlog.Restore(&entry, &buffer));
+    std::vector<uint8_t> expected = MakeFramePixels(buffer.GetDataLength(), expected_index);
+    CHECK(memcmp(buffer.GetData(), expected.data(), expected.size()) == 0);
+    backlog.Release(entry);
+}
+
+/// @brief The arena is used first, then RAM, then the spill file
+static void TestTiers()
+{
+    const auto spill_path = std::filesystem::temp_directory_path() / "sf-test-backlog.tmp";
+    {
+        // Reservations are uncompressed, so RAM and disk fit exactly two reserved frames each
+        FrameBacklog backlog(2 * RAW_SIZE);
+        CHECK(backlog.SetArena(RAW_SIZE, 2, false));
+        CHECK(backlog.SetSpillFile(spill_path, 2 * RAW_SIZE));
+
+        const FrameBacklog::Tier expected[] = {
+            FrameBacklog::Tier::ARENA, FrameBacklog::Tier::ARENA,
+            FrameBacklog::Tier::RAM, FrameBacklog::Tier::RAM,
+            FrameBacklog::Tier::DISK, FrameBacklog::Tier::DISK,
+        };
+        std::vector<FrameBacklog::Entry> entries;
+        for (size_t i = 0; i < std::size(expected); ++i)
+        {
+            entries.push_back(Reserve(backlog, i));
+            CHECK(entries.back().tier == expected[i]);
+        }
+        CHECK(Reserve(backlog, 6).tier == FrameBacklog::Tier::NONE);
+
+        for (FrameBacklog::Entry& entry : entries)
+            Store(backlog, std::move(entry));
+        CHECK(backlog.GetEntries().size() == 6);
+        CHECK(backlog.GetStats().find("spilled 2 frames") != std::string::npos);
+
+        // Once compressed, frames only take up their compressed size
+        CHECK(StoreFrame(backlog, 6) == FrameBacklog::Tier::RAM);
+        // Each tier frees its room once an entry is taken
+        RestoreOldest(backlog, 0);
+        CHECK(StoreFrame(backlog, 7) == FrameBacklog::Tier::ARENA);
+        for (size_t i = 1; i <= 7; ++i)
+            RestoreOldest(backlog, i);
+        CHECK(backlog.IsEmpty());
+        CHECK(StoreFrame(backlog, 8) == FrameBacklog::Tier::ARENA);
+    }
+    CHECK(!std::filesystem::exists(spill_path));
+}
+
+/// @brief Unreserved room can be reserved again, in every tier, while the other tiers are full
+static void TestUnreserve()
+{
+    const auto spill_path = std::filesystem::temp_directory_path() / "sf-test-unreserve.tmp";
+    FrameBacklog backlog(RAW_SIZE);
+    CHECK(backlog.SetArena(RAW_SIZE, 1, false));
+    CHECK(backlog.SetSpillFile(spill_path, RAW_SIZE));
+
+    FrameBacklog::Entry entries[3];
+    for (FrameBacklog::Entry& entry : entries)
+        CHECK(backlog.TryReserve(RAW_SIZE, &entry));
+    FrameBacklog::Entry overflow;
+    CHECK(!backlog.TryReserve(RAW_SIZE, &overflow));
+    CHECK(overflow.tier == FrameBacklog::Tier::NONE);
+
+    for (FrameBacklog::Entry& entry : entries)
+    {
+        FrameBacklog::Tier tier = entry.tier;
+        backlog.Unreserve(entry, RAW_SIZE);
+        FrameBacklog::Entry again;
+        CHECK(backlog.TryReserve(RAW_SIZE, &again));
+        CHECK(again.tier == tier);
+        entry = std::move(again);
+    }
+}
+
+/// @brief The spill file's budget and space are reclaimed once its entries drain
+static void TestSpillReclaimed()
+{
+    const auto spill_path = std::filesystem::temp_directory_path() / "sf-test-spill.tmp";
+    FrameBacklog backlog(0);
+    CHECK(backlog.SetSpillFile(spill_path, 2 * RAW_SIZE));
+
+    for (size_t round = 0; round < 3; ++round)
+    {
+        const size_t first = round * 2;
+        std::vector<FrameBacklog::Entry> entries;
+        entries.push_back(Reserve(backlog, first));
+        entries.push_back(Reserve(backlog, first + 1));
+        CHECK(entries[0].tier == FrameBacklog::Tier::DISK && entries[1].tier == FrameBacklog::Tier::DISK);
+        CHECK(Reserve(backlog, first + 2).tier == FrameBacklog::Tier::NONE);
+        for (FrameBacklog::Entry& entry : entries)
+            Store(backlog, std::move(entry));
+        CHECK(std::filesystem::file_size(spill_path) > 0);
+
+        // The file is kept while one entry still needs it
+        RestoreOldest(backlog, first);
+        CHECK(std::filesystem::file_size(spill_path) > 0);
+        RestoreOldest(backlog, first + 1);
+        CHECK(std::filesystem::file_size(spill_path) == 0);
+    }
+    CHECK(backlog.GetStats().find("spilled 6 frames") != std::string::npos);
+}
+
+/// @brief Frames larger than the arena's slots are compressed instead
+static void TestArenaSlotSize()
+{
+    FrameBacklog backlog(4 * RAW_SIZE);
+    CHECK(backlog.SetArena(RAW_SIZE / 2, 4, false));
+    CHECK(StoreFrame(backlog, 0) == FrameBacklog::Tier::RAM);
+    RestoreOldest(backlog, 0);
+}
+
+int main()
+{
+    TestTiers();
+    TestUnreserve();
+    TestSpillReclaimed();
+    TestArenaSlotSize();
+    return Check::Result();
+}
@@ -0,0 +1,134 @@
+// Tests parsing batch job files, and the actions BatchScheduler takes as the demo plays.
+#include "check.h"
+#include <Streams/batch.h>
+#include <sstream>
+
+using Action = BatchScheduler::Action;
+using Observation = BatchScheduler::Observation;
+
+static std::optional<BatchJob> Parse(const char* text, std::string* error)
+{
+    std::istringstream input(text);
+    return BatchJob::Parse(input, error);
+}
+
+static void TestParse()
+{
+    std::string error;
+    auto job = Parse(R"([{"demo": "a.dem", "start_tick": 10, "end_tick": 20}])", &error);
+    CHECK(job && job->clips.size() == 1);
+    CHECK(job && job->clips[0].name == "clip00" && job->clips[0].streams.empty());
+
+    job = Parse(R"({"output": "out", "clips": [
+        {"demo": "a.dem", "start_tick": 0, "end_tick": 5, "name": "intro", "streams": ["color", "depth"]}
+    ]})", &error);
+    CHECK(job && job->output == "out");
+    CHECK(job && job->clips[0].name == "intro" && job->clips[0].streams.size() == 2);
+
+    CHECK(!Parse("not json", &error) && error.find("Failed to parse JSON") == 0);
+    CHECK(!Parse("[]", &error) && error == "The job has no clips");
+    CHECK(!Parse(R"({"clips": 1})", &error) && error == "Expected a list of clips");
+    CHECK(!Parse(R"([{"start_tick": 0, "end_tick": 5}])", &error) && error == "Clip 0 has no demo");
+    CHECK(!Parse(R"([{"demo": "a.dem", "start_tick": 0}])", &error) && error == "Clip 0 needs a start_tick and an end_tick");
+    CHECK(!Parse(R"([{"demo": "a.dem", "start_tick": 5, "end_tick": 5}])", &error) && error == "Clip 0 must end after it starts");
+    CHECK(!Parse(R"([{"demo": "a.dem", "start_tick": 0, "end_tick": 5, "streams": "color"}])", &error)
+        && error == "Clip 0 has streams that aren't a list of names");
+}
+
+/// @brief Observe a demo that has loaded and is at `tick`
+static Observation Playing(int tick) { return {true, false, tick}; }
+
+static void TestSchedule()
+{
+    BatchScheduler scheduler({
+        {"first", "a.dem", 100, 200, {}},
+        {"second", "a.dem", 300, 400, {}},
+        {"third", "b.dem", 0, 50, {}},
+    });
+    Observation idle;
+
+    // Load the first demo, and wait while it loads
+    CHECK(scheduler.Update(idle) == Action::PLAY_DEMO);
+    CHECK(scheduler.Update(idle) == Action::NONE);
+    CHECK(scheduler.Update({true, true, 0}) == Action::NONE);
+    CHECK(scheduler.Update(Playing(0)) == Action::SEEK);
+
+    // Wait for the seek, and retry it if it takes too long
+    for (size_t i = 1; i < BatchScheduler::SEEK_RETRY_UPDATES; ++i)
+        CHECK(scheduler.Update(Playing(50)) == Action::NONE);
+    CHECK(scheduler.Update(Playing(50)) == Action::SEEK);
+    CHECK(scheduler.Update(Playing(100 - BatchScheduler::SEEK_TOLERANCE)) == Action::START);
+    CHECK(scheduler.IsRecording());
+
+    CHECK(scheduler.Update(Playing(199)) == Action::NONE);
+    CHECK(scheduler.Update(Playing(200)) == Action::STOP);
+    CHECK(scheduler.GetClipIndex() == 1);
+
+    // The same demo is still playing, so only seek
+    CHECK(scheduler.Update(Playing(200)) == Action::SEEK);
+    // The demo was stopped during the seek, so it's loaded again
+    CHECK(scheduler.Update(idle) == Action::NONE);
+    CHECK(scheduler.Update(idle) == Action::PLAY_DEMO);
+    CHECK(scheduler.Update(Playing(0)) == Action::SEEK);
+    CHECK(scheduler.Update(Playing(300)) == Action::START);
+    // Stopping the demo ends the clip early
+    CHECK(scheduler.Update(idle) == Action::STOP);
+
+    // A different demo is loaded
+    CHECK(scheduler.Update(Playing(400)) == Action::PLAY_DEMO);
+    CHECK(scheduler.Update(Playing(0)) == Action::SEEK);
+    CHECK(scheduler.Update(Playing(0)) == Action::START);
+    CHECK(scheduler.Update(Playing(50)) == Action::STOP);
+
+    CHECK(scheduler.Update(idle) == Action::FINISHED);
+    CHECK(scheduler.IsFinished());
+    CHECK(scheduler.GetClip() == nullptr);
+    CHECK(scheduler.Update(idle) == Action::FINISHED);
+}
+
+/// @brief A demo that never loads skips its clip, and the next clip loads its demo again
+static void TestLoadTimeout()
+{
+    BatchScheduler scheduler({{"missing", "a.dem", 0, 100, {}}, {"retry", "a.dem", 0, 100, {}}});
+    Observation idle;
+    CHECK(scheduler.Update(idle) == Action::PLAY_DEMO);
+    for (size_t i = 1; i < BatchScheduler::LOAD_TIMEOUT_UPDATES; ++i)
+        CHECK(scheduler.Update(i % 2 ? idle : Observation{true, true, 0}) == Action::NONE);
+    CHECK(scheduler.Update(idle) == Action::SKIP);
+    CHECK(scheduler.GetClipIndex() == 1);
+    CHECK(!scheduler.IsRecording());
+
+    // Waiting again starts a new count
+    CHECK(scheduler.Update(idle) == Action::PLAY_DEMO);
+    for (size_t i = 1; i < BatchScheduler::LOAD_TIMEOUT_UPDATES; ++i)
+        CHECK(scheduler.Update(idle) == Action::NONE);
+    CHECK(scheduler.Update(idle) == Action::SKIP);
+    CHECK(scheduler.Update(idle) == Action::FINISHED);
+}
+
+static void TestAbort()
+{
+    BatchScheduler recording({{"a", "a.dem", 0, 100, {}}, {"b", "a.dem", 200, 300, {}}});
+    CHECK(recording.Update({}) == Action::PLAY_DEMO);
+    CHECK(recording.Update(Playing(0)) == Action::SEEK);
+    CHECK(recording.Update(Playing(0)) == Action::START);
+    recording.Abort();
+    CHECK(recording.IsRecording());
+    CHECK(recording.Update(Playing(10)) == Action::STOP);
+    CHECK(recording.IsFinished());
+    CHECK(recording.Update(Playing(10)) == Action::FINISHED);
+
+    BatchScheduler loading({{"a", "a.dem", 0, 100, {}}});
+    CHECK(loading.Update({}) == Action::PLAY_DEMO);
+    loading.Abort();
+    CHECK(loading.Update({}) == Action::FINISHED);
+}
+
+int main()
+{
+    TestParse();
+    TestSchedule();
+    TestLoadTimeout();
+    TestAbort();
+    return Check::Result();
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdio>
+
+/**
+ * @file
+ * @brief The smallest test harness that works: each test is an executable, and failed checks are printed.
+ *
+ * End `main` with `return Check::Result();`, so CTest sees the failures.
+ */
+
+namespace Check
+{
+    inline int num_failed = 0;
+
+    inline void Fail(const char* file, int line, const char* expr)
+    {
+        std::printf("%s:%d: CHECK(%s) failed\n", file, line, expr);
+        num_failed += 1;
+    }
+
+    /// @brief Print a summary, and return the exit code for `main`
+    inline int Result()
+    {
+        if (num_failed > 0)
+            std::printf("%d checks failed\n", num_failed);
+        return num_failed > 0 ? 1 : 0;
+    }
+}
+
+#define CHECK(expr) ((expr) ? (void)0 : Check::Fail(__FILE__, __LINE__, #expr))
@@ -0,0 +1,353 @@
+// Tests that OpenEXR files written by Exr::Write and Depth::WriteExr read back to the values they were given.
+#include "check.h"
+#include <Streams/exr.h>
+#include <Streams/depth.h>
+#include <Streams/hdr.h>
+#include <miniz.h>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/// @brief What a minimal reader finds in a single-part scanline EXR
+struct ExrImage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<std::string> channels;
+    /// @brief 1 for half floats, 2 for full floats
+    uint32_t pixel_type = 0;
+    uint8_t compression = 0xFF;
+    /// @brief Each channel's values, in channel order, then row by row
+    std::vector<std::vector<float>> values;
+    /// @brief Blocks that were deflated, instead of stored as they are
+    size_t num_compressed = 0;
+};
+
+class Reader
+{
+public:
+    explicit Reader(const std::string& data) : m_data(data) {}
+
+    bool Ok() const { return m_ok; }
+    size_t GetPos() const { return m_pos; }
+
+    const uint8_t* Bytes(size_t size)
+    {
+        if (m_pos + size > m_data.size())
+        {
+            m_ok = false;
+            return nullptr;
+        }
+        const uint8_t* bytes = (const uint8_t*)m_data.data() + m_pos;
+        m_pos += size;
+        return bytes;
+    }
+    template <class T>
+    T Read()
+    {
+        T value{};
+        if (const uint8_t* bytes = Bytes(sizeof(T)))
+            memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+    std::string String()
+    {
+        size_t end = m_data.find('\0', m_pos);
+        if (end == std::string::npos)
+        {
+            m_ok = false;
+            return {};
+        }
+        std::string str = m_data.substr(m_pos, end - m_pos);
+        m_pos = end + 1;
+        return str;
+    }
+    void Seek(size_t pos)
+    {
+        m_ok = m_ok && pos <= m_data.size();
+        m_pos = pos;
+    }
+
+private:
+    const std::string& m_data;
+    size_t m_pos = 0;
+    bool m_ok = true;
+};
+
+/// @brief Undo the delta and the interleaving of a ZIP block
+static std::vector<uint8_t> UnpredictBlock(const std::vector<uint8_t>& predicted)
+{
+    std::vector<uint8_t> deltas = predicted;
+    for (size_t i = 1; i < deltas.size(); ++i)
+        deltas[i] = (uint8_t)(deltas[i - 1] + deltas[i] - 128);
+
+    std::vector<uint8_t> raw(deltas.size());
+    const size_t half = (raw.size() + 1) / 2;
+    for (size_t i = 0; i < raw.size(); ++i)
+        raw[i] = i % 2 == 0 ? deltas[i / 2] : deltas[half + i / 2];
+    return raw;
+}
+
+/// @brief Parse an EXR written by Exr::Write. Returns `false` if anything is out of place.
+static bool ReadExr(const std::string& data, ExrImage* image)
+{
+    Reader reader(data);
+    if (reader.Read<uint32_t>() != 20000630 || reader.Read<uint32_t>() != 2)
+        return false;
+
+    for (std::string name = reader.String(); reader.Ok() && !name.empty(); name = reader.String())
+    {
+        std::string type = reader.String();
+        uint32_t size = reader.Read<uint32_t>();
+        size_t end = reader.GetPos() + size;
+        if (name == "channels")
+        {
+            for (std::string channel = reader.String(); reader.Ok() && !channel.empty(); channel = reader.String())
+            {
+                image->channels.push_back(channel);
+                image->pixel_type = reader.Read<uint32_t>();
+                reader.Bytes(12);
+            }
+        }
+        else if (name == "compression")
+            image->compression = reader.Read<uint8_t>();
+        else if (name == "dataWindow")
+        {
+            int32_t box[4];
+            for (int32_t& value : box)
+                value = reader.Read<int32_t>();
+            image->width = (uint32_t)(box[2] - box[0] + 1);
+            image->height = (uint32_t)(box[3] - box[1] + 1);
+        }
+        reader.Seek(end);
+    }
+
+    const size_t num_channels = image->channels.size();
+    const size_t value_size = image->pixel_type == 1 ? 2 : 4;
+    const uint32_t num_blocks = (image->height + 15) / 16;
+    std::vector<uint64_t> offsets(num_blocks);
+    for (uint64_t& offset : offsets)
+        offset = reader.Read<uint64_t>();
+    if (!reader.Ok() || num_channels == 0)
+        return false;
+
+    image->values.assign(num_channels, std::vector<float>((size_t)image->width * image->height));
+    for (uint32_t block = 0; block < num_blocks; ++block)
+    {
+        reader.Seek(offsets[block]);
+        uint32_t y = reader.Read<uint32_t>();
+        uint32_t size = reader.Read<uint32_t>();
+        const uint8_t* bytes = reader.Bytes(size);
+        if (!reader.Ok() || y != block * 16)
+            return false;
+
+        uint32_t num_lines = image->height - y < 16 ? image->height - y : 16;
+        size_t raw_size = (size_t)image->width * num_lines * num_channels * value_size;
+        std::vector<uint8_t> raw(bytes, bytes + size);
+        if (size < raw_size)
+        {
+            std::vector<uint8_t> predicted(raw_size);
+            mz_ulong out_size = (mz_ulong)raw_size;
+            if (mz_uncompress(predicted.data(), &out_size, bytes, size) != MZ_OK || out_size != raw_size)
+                return false;
+            raw = UnpredictBlock(predicted);
+            image->num_compressed += 1;
+        }
+        else if (size != raw_size)
+            return false;
+
+        const uint8_t* src = raw.data();
+        for (uint32_t line = y; line < y + num_lines; ++line)
+        {
+            for (size_t c = 0; c < num_channels; ++c)
+            {
+                float* dst = image->values[c].data() + (size_t)line * image->width;
+                if (value_size == 2)
+                    Hdr::HalfToFloat((const uint16_t*)src, image->width, dst);
+                else
+                    memcpy(dst, src, image->width * sizeof(float));
+                src += image->width * value_size;
+            }
+        }
+    }
+    return true;
+}
+
+/// @brief Deterministic values spread over the exponents of normal halves, including negatives
+static std::vector<float> MakeValues(size_t count, uint32_t seed)
+{
+    std::vector<float> values(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        seed = seed * 1664525 + 1013904223;
+        float mantissa = 1.0f + (float)(seed >> 8) / (1 << 24);
+        int exponent = (int)(seed % 24) - 14;
+        values[i] = std::ldexp(mantissa, exponent) * (seed & 0x80 ? -1.0f : 1.0f);
+    }
+    return values;
+}
+
+/// @brief Smooth values over the exponents of normal halves, which compress well
+static std::vector<float> MakeGradient(uint32_t width, uint32_t height, size_t pixel_stride)
+{
+    std::vector<float> values((size_t)width * height * pixel_stride);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            for (size_t c = 0; c < pixel_stride; ++c)
+                values[((size_t)y * width + x) * pixel_stride + c] = std::ldexp(1.0f + (float)x / width, (int)(y + c) % 24 - 14);
+        }
+    }
+    return values;
+}
+
+/// @brief Full floats come back bit for bit, in the channels they were written to
+static void TestFloatRoundTrip()
+{
+    // 37 rows, so the last block is partial
+    constexpr uint32_t WIDTH = 23, HEIGHT = 37;
+    std::vector<float> pixels = MakeGradient(WIDTH, HEIGHT, 4);
+    // Only A, B and R, in a different order than they're stored
+    const Exr::Channel channels[] = {{"A", 3}, {"B", 0}, {"R", 2}};
+
+    std::ostringstream output;
+    CHECK(Exr::Write(output, WIDTH, HEIGHT, pixels.data(), 4, channels, 3, false));
+    ExrImage image;
+    CHECK(ReadExr(output.str(), &image));
+    CHECK(image.width == WIDTH && image.height == HEIGHT);
+    CHECK(image.compression == 3);
+    CHECK(image.pixel_type == 2);
+    CHECK((image.channels == std::vector<std::string>{"A", "B", "R"}));
+    CHECK(image.num_compressed == 3);
+
+    bool exact = image.values.size() == 3;
+    for (size_t c = 0; c < image.values.size(); ++c)
+    {
+        for (size_t i = 0; i < (size_t)WIDTH * HEIGHT; ++i)
+            exact = exact && memcmp(&image.values[c][i], &pixels[i * 4 + channels[c].offset], sizeof(float)) == 0;
+    }
+    CHECK(exact);
+}
+
+/// @brief Half floats are within half a unit in the last place, and match Hdr's rounding
+static void TestHalfRoundTrip()
+{
+    constexpr uint32_t WIDTH = 64, HEIGHT = 20;
+    std::vector<float> noise = MakeValues((size_t)WIDTH * HEIGHT, 2);
+    noise[0] = 0.0f;
+    noise[1] = 1.0f;
+    noise[2] = 65504.0f; // The largest half
+    noise[3] = 1.0f / 16384; // The smallest normal half
+
+    // Noise covers every rounding case, and the gradient is deflated
+    const std::vector<float> gradient = MakeGradient(WIDTH, HEIGHT, 1);
+    const std::vector<float>* inputs[] = {&noise, &gradient};
+    for (const std::vector<float>* input : inputs)
+    {
+        const std::vector<float>& pixels = *input;
+        std::ostringstream output;
+        const Exr::Channel channel = {"Y", 0};
+        CHECK(Exr::Write(output, WIDTH, HEIGHT, pixels.data(), 1, &channel, 1, true));
+        ExrImage image;
+        CHECK(ReadExr(output.str(), &image));
+        CHECK(image.pixel_type == 1);
+        CHECK(image.values.size() == 1);
+        if (image.values.size() != 1)
+            continue;
+
+        size_t num_inaccurate = 0, num_unrounded = 0;
+        for (size_t i = 0; i < image.values[0].size(); ++i)
+        {
+            float value = pixels[i], result = image.values[0][i];
+            // Halves have 11 significant bits
+            if (std::fabs(result - value) > std::fabs(value) / 2048)
+                num_inaccurate += 1;
+            if (result != Hdr::HalfToFloat(Hdr::FloatToHalf(value)))
+                num_unrounded += 1;
+        }
+        CHECK(num_inaccurate == 0);
+        CHECK(num_unrounded == 0);
+        if (input == &gradient)
+            CHECK(image.num_compressed == 2);
+    }
+    CHECK(Hdr::HalfToFloat(Hdr::FloatToHalf(1.0f)) == 1.0f && Hdr::HalfToFloat(Hdr::FloatToHalf(65504.0f)) == 65504.0f);
+}
+
+/// @brief Noise doesn't compress, so its blocks are stored as they are
+static void TestUncompressedBlocks()
+{
+    constexpr uint32_t WIDTH = 8, HEIGHT = 16;
+    std::vector<float> pixels = MakeValues((size_t)WIDTH * HEIGHT, 3);
+    std::ostringstream output;
+    const Exr::Channel channel = {"Y", 0};
+    CHECK(Exr::Write(output, WIDTH, HEIGHT, pixels.data(), 1, &channel, 1, false, 0));
+    ExrImage image;
+    CHECK(ReadExr(output.str(), &image));
+    CHECK(image.num_compressed == 0);
+    CHECK(image.values.size() == 1 && image.values[0] == pixels);
+}
+
+/// @brief Packed 24-bit depth decodes and writes without losing precision
+static void TestDepth()
+{
+    constexpr uint32_t WIDTH = 19, HEIGHT = 5;
+    constexpr size_t NUM_PIXELS = (size_t)WIDTH * HEIGHT;
+    std::vector<uint32_t> depths(NUM_PIXELS);
+    for (size_t i = 0; i < NUM_PIXELS; ++i)
+        depths[i] = (uint32_t)(i * 176419 % (Depth::MAX_VALUE + 1));
+    depths[0] = 0;
+    depths[1] = Depth::MAX_VALUE;
+
+    // Blue first with 4 bytes is vectorized, and packed RGB isn't
+    std::vector<uint8_t> bgrx(NUM_PIXELS * 4), rgb(NUM_PIXELS * 3);
+    for (size_t i = 0; i < NUM_PIXELS; ++i)
+    {
+        uint8_t r = (uint8_t)(depths[i] >> 16), g = (uint8_t)(depths[i] >> 8), b = (uint8_t)depths[i];
+        uint8_t* p = &bgrx[i * 4];
+        p[0] = b, p[1] = g, p[2] = r, p[3] = 0xFF;
+        p = &rgb[i * 3];
+        p[0] = r, p[1] = g, p[2] = b;
+    }
+    const Depth::PixelLayout bgrx_layout = {4, {2, 1, 0}};
+    const Depth::PixelLayout rgb_layout = {3, {0, 1, 2}};
+
+    for (const auto& [pixels, layout] : {std::pair{&bgrx, bgrx_layout}, std::pair{&rgb, rgb_layout}})
+    {
+        std::vector<float> depth(NUM_PIXELS);
+        Depth::UnpackFloat(pixels->data(), NUM_PIXELS, layout, depth.data());
+        std::vector<uint16_t> depth16(NUM_PIXELS);
+        Depth::UnpackU16BE(pixels->data(), NUM_PIXELS, layout, depth16.data());
+
+        size_t num_wrong = 0;
+        for (size_t i = 0; i < NUM_PIXELS; ++i)
+        {
+            // Every 24-bit value fits exactly in a float's mantissa
+            if ((uint32_t)std::lround(depth[i] * Depth::MAX_VALUE) != depths[i])
+                num_wrong += 1;
+            uint16_t top = (uint16_t)(depths[i] >> 8);
+            if (depth16[i] != (uint16_t)((top << 8) | (top >> 8)))
+                num_wrong += 1;
+        }
+        CHECK(num_wrong == 0);
+        CHECK(depth[0] == 0.0f && depth[1] == 1.0f);
+
+        std::ostringstream output;
+        CHECK(Depth::WriteExr(output, WIDTH, HEIGHT, depth.data(), false));
+        ExrImage image;
+        CHECK(ReadExr(output.str(), &image));
+        CHECK((image.channels == std::vector<std::string>{"Z"}));
+        CHECK(image.values.size() == 1 && image.values[0] == depth);
+    }
+}
+
+int main()
+{
+    TestFloatRoundTrip();
+    TestHalfRoundTrip();
+    TestUncompressedBlocks();
+    TestDepth();
+    return Check::Result();
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <Streams/framepool.h>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdint>
+
+/**
+ * @file
+ * @brief A @ref VideoWriter that checks each frame's pixels instead of encoding them.
+ */
+
+/// @brief The tightly packed pixels of frame `index`, distinct for every index
+inline std::vector<uint8_t> MakeFramePixels(size_t size, size_t index)
+{
+    std::vector<uint8_t> pixels(size);
+    for (size_t i = 0; i < size; ++i)
+        pixels[i] = (uint8_t)(index * 7 + i % 13 + 1);
+    memcpy(pixels.data(), &index, size < sizeof(index) ? size : sizeof(index));
+    return pixels;
+}
+
+class FakeWriter : public VideoWriter
+{
+public:
+    /// @param write_time How long each frame takes to write
+    FakeWriter(bool async, std::chrono::microseconds write_time = {}) : m_async(async), m_write_time(write_time) {}
+
+    bool WriteFrame(const FrameBufferBase& buffer, size_t frame_index) override
+    {
+        if (m_write_time.count() > 0)
+            std::this_thread::sleep_for(IsDegraded() ? m_write_time / 4 : m_write_time);
+
+        size_t pitch;
+        const uint8_t* pixels = buffer.LockRead(&pitch);
+        const size_t row_size = buffer.GetRowSize();
+        std::vector<uint8_t> expected = MakeFramePixels(row_size * buffer.GetHeight(), frame_index);
+        bool matches = true;
+        for (uint32_t y = 0; y < buffer.GetHeight(); ++y)
+            matches = matches && memcmp(pixels + y * pitch, expected.data() + y * row_size, row_size) == 0;
+        buffer.UnlockRead();
+
+        std::scoped_lock lock{m_mutex};
+        m_written.push_back(frame_index);
+        m_num_mismatched += !matches;
+        return frame_index != m_fail_index;
+    }
+    bool IsAsync() const override { return m_async; }
+    bool SetDegraded(bool degraded) override
+    {
+        std::scoped_lock lock{m_mutex};
+        m_degraded = degraded;
+        m_num_degraded += degraded;
+        return true;
+    }
+
+    /// @brief Fail the frame with this index, after checking it
+    void FailAt(size_t frame_index) { m_fail_index = frame_index; }
+    /// @brief Indices of the written frames, in the order they were written
+    std::vector<size_t> GetWritten()
+    {
+        std::scoped_lock lock{m_mutex};
+        return m_written;
+    }
+    /// @brief The number of frames whose pixels weren't the ones pushed for their index
+    size_t GetNumMismatched()
+    {
+        std::scoped_lock lock{m_mutex};
+        return m_num_mismatched;
+    }
+    bool IsDegraded()
+    {
+        std::scoped_lock lock{m_mutex};
+        return m_degraded;
+    }
+    /// @brief The number of times @ref SetDegraded turned degrading on
+    size_t GetNumDegraded()
+    {
+        std::scoped_lock lock{m_mutex};
+        return m_num_degraded;
+    }
+
+private:
+    const bool m_async;
+    const std::chrono::microseconds m_write_time;
+    size_t m_fail_index = ~(size_t)0;
+    std::mutex m_mutex;
+    std::vector<size_t> m_written;
+    size_t m_num_mismatched = 0;
+    bool m_degraded = false;
+    size_t m_num_degraded = 0;
+};
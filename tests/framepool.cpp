@@ -0,0 +1,273 @@
+// Tests FramePool's stall policies and adaptive sizing, with writers that are slower than the game.
+#include "check.h"
+#include "readback-cpu.h"
+#include <Streams/videolog.h>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+static constexpr uint32_t WIDTH = 16;
+static constexpr uint32_t HEIGHT = 8;
+
+static bool LogContains(const char* text)
+{
+    return VideoLog::GetLog()->find(text) != std::string::npos;
+}
+
+/// @brief Wait for a failed job to close the pool
+static bool WaitUntilClosed(FramePool& pool)
+{
+    for (int i = 0; i < 1000 && !pool.IsClosed(); ++i)
+        std::this_thread::sleep_for(1ms);
+    return pool.IsClosed();
+}
+
+/// @brief A frame buffer that can be filled, but not locked while it holds frame `unlockable_index`
+class UnlockableBuffer : public FrameBufferMem
+{
+public:
+    /// @param unlockable_index Index of the frame that can't be locked, or `~0` for every frame
+    UnlockableBuffer(uint32_t width, uint32_t height, D3DFORMAT format, size_t unlockable_index)
+        : FrameBufferMem(width, height, format), m_unlockable_index(unlockable_index) {}
+
+    const uint8_t* LockRead(size_t* pitch) const override
+    {
+        const uint8_t* pixels = FrameBufferMem::LockRead(pitch);
+        // MakeFramePixels starts with the frame's index
+        size_t index;
+        memcpy(&index, pixels, sizeof(index));
+        return m_unlockable_index == ~(size_t)0 || index == m_unlockable_index ? nullptr : pixels;
+    }
+
+private:
+    const size_t m_unlockable_index;
+};
+
+class UnlockableDevice : public ReadbackDeviceCpu
+{
+public:
+    UnlockableDevice(size_t unlockable_index = ~(size_t)0) : ReadbackDeviceCpu(0us), m_unlockable_index(unlockable_index) {}
+    std::unique_ptr<FrameBufferBase> CreateBuffer(uint32_t width, uint32_t height, D3DFORMAT format) override {
+        return std::make_unique<UnlockableBuffer>(width, height, format, m_unlockable_index);
+    }
+
+private:
+    const size_t m_unlockable_index;
+};
+
+/// @brief Check that a writer got every frame once, in order
+static void CheckWrittenInOrder(FakeWriter& writer, size_t num_frames)
+{
+    std::vector<size_t> written = writer.GetWritten();
+    CHECK(written.size() == num_frames);
+    for (size_t i = 0; i < written.size(); ++i)
+        CHECK(written[i] == i);
+    CHECK(writer.GetNumMismatched() == 0);
+}
+
+/// @brief Blocking waits for every frame, and never counts a stall
+static void TestBlock()
+{
+    auto device = std::make_shared<ReadbackDeviceCpu>(0us);
+    auto writer = std::make_shared<FakeWriter>(false, 1ms);
+    FramePool pool(device, 2, 2, WIDTH, HEIGHT);
+    pool.SetStallPolicy(FramePool::StallPolicy::BLOCK, 100us);
+    for (size_t i = 0; i < 20; ++i)
+        CHECK(RecordFrame(pool, *device, writer, i));
+    FramePool::StallStats stats = pool.GetStallStats();
+    pool.Finish();
+
+    CheckWrittenInOrder(*writer, 20);
+    CHECK(stats.num_stalls == 0);
+}
+
+/// @brief Dropping gives up on frames, and the rest are still written in order
+static void TestDrop()
+{
+    auto device = std::make_shared<ReadbackDeviceCpu>(0us);
+    auto writer = std::make_shared<FakeWriter>(true, 5ms);
+    FramePool pool(device, 1, 1, WIDTH, HEIGHT);
+    pool.SetStallPolicy(FramePool::StallPolicy::DROP, 500us);
+    size_t num_recorded = 0;
+    for (size_t i = 0; i < 20; ++i)
+    {
+        if (RecordFrame(pool, *device, writer, num_recorded))
+            num_recorded += 1;
+        CHECK(!pool.IsClosed());
+    }
+    FramePool::StallStats stats = pool.GetStallStats();
+    pool.Finish();
+
+    CHECK(stats.num_dropped > 0);
+    CHECK(stats.num_dropped == stats.num_stalls);
+    CHECK(num_recorded + stats.num_dropped == 20);
+    CheckWrittenInOrder(*writer, num_recorded);
+}
+
+/// @brief Borrowing stores a full frame on the game thread, and its writer still gets it in order
+static void TestBorrow()
+{
+    auto device = std::make_shared<ReadbackDeviceCpu>(200us);
+    auto writer = std::make_shared<FakeWriter>(false, 3ms);
+    FramePool pool(device, 1, 2, WIDTH, HEIGHT);
+    pool.SetBacklog(1 << 20);
+    pool.SetStallPolicy(FramePool::StallPolicy::BORROW, 500us);
+    for (size_t i = 0; i < 20; ++i)
+        CHECK(RecordFrame(pool, *device, writer, i));
+    FramePool::StallStats stats = pool.GetStallStats();
+    pool.Finish();
+
+    CHECK(stats.num_borrowed > 0);
+    CHECK(stats.num_dropped == 0);
+    CheckWrittenInOrder(*writer, 20);
+}
+
+/// @brief Borrowing needs a backlog, so without one it blocks
+static void TestBorrowWithoutBacklog()
+{
+    auto device = std::make_shared<ReadbackDeviceCpu>(0us);
+    auto writer = std::make_shared<FakeWriter>(false, 2ms);
+    FramePool pool(device, 1, 1, WIDTH, HEIGHT);
+    pool.SetStallPolicy(FramePool::StallPolicy::BORROW, 200us);
+    for (size_t i = 0; i < 10; ++i)
+        CHECK(RecordFrame(pool, *device, writer, i));
+    FramePool::StallStats stats = pool.GetStallStats();
+    pool.Finish();
+
+    CHECK(stats.num_stalls > 0);
+    CHECK(stats.num_borrowed == 0);
+    CheckWrittenInOrder(*writer, 10);
+}
+
+/// @brief Degrading picks the slowest writer, and restores it when capture ends
+static void TestDegrade()
+{
+    auto device = std::make_shared<ReadbackDeviceCpu>(0us);
+    auto slow = std::make_shared<FakeWriter>(false, 8ms);
+    auto fast = std::make_shared<FakeWriter>(false, 100us);
+    FramePool pool(device, 2, 2, WIDTH, HEIGHT);
+    pool.SetStallPolicy(FramePool::StallPolicy::DEGRADE, 1ms);
+    for (size_t i = 0; i < 20; ++i)
+    {
+        CHECK(RecordFrame(pool, *device, slow, i));
+        CHECK(RecordFrame(pool, *device, fast, i));
+    }
+    FramePool::StallStats stats = pool.GetStallStats();
+    bool slow_degraded = slow->GetNumDegraded() > 0;
+    pool.Finish();
+
+    CHECK(stats.num_degraded > 0);
+    CHECK(slow_degraded);
+    CHECK(!slow->IsDegraded());
+    CHECK(!fast->IsDegraded());
+    CheckWrittenInOrder(*slow, 20);
+    CheckWrittenInOrder(*fast, 20);
+}
+
+/// @brief The pool grows while the game waits on frames, up to its limit
+static void TestAdaptGrow()
+{
+    auto device = std::make_shared<ReadbackDeviceCpu>(0us);
+    auto writer = std::make_shared<FakeWriter>(true, 2ms);
+    FramePool pool(device, 1, 2, WIDTH, HEIGHT);
+    pool.SetAdaptiveLimits(1, 4);
+    for (size_t i = 0; i < 150; ++i)
+    {
+        CHECK(RecordFrame(pool, *device, writer, i));
+        pool.Adapt();
+    }
+    size_t num_frames = pool.GetNumFrames();
+    pool.Finish();
+
+    CHECK(num_frames == 4);
+    CHECK(LogContains("Frame pool grew from 2 to 3 frames"));
+    CHECK(writer->GetWritten().size() == 150);
+}
+
+/// @brief The pool shrinks one frame at a time while frames go unused, but not below its limit
+static void TestAdaptShrink()
+{
+    auto device = std::make_shared<ReadbackDeviceCpu>(0us);
+    auto writer = std::make_shared<FakeWriter>(true);
+    FramePool pool(device, 2, 5, WIDTH, HEIGHT);
+    pool.SetAdaptiveLimits(2, 8);
+    for (size_t i = 0; i < 300; ++i)
+    {
+        CHECK(RecordFrame(pool, *device, writer, i));
+        pool.Adapt();
+        std::this_thread::sleep_for(200us);
+    }
+    size_t num_frames = pool.GetNumFrames();
+    pool.Finish();
+
+    // Usually it reaches the limit, unless a busy machine made the game wait
+    CHECK(num_frames >= 2 && num_frames < 5);
+    CHECK(LogContains("Frame pool shrank from 5 to 4 frames"));
+    CHECK(writer->GetWritten().size() == 300);
+}
+
+/// @brief A failed write names the frame, and closes the pool
+static void TestFailedWrite()
+{
+    VideoLog::Clear();
+    auto device = std::make_shared<ReadbackDeviceCpu>(0us);
+    auto writer = std::make_shared<FakeWriter>(false);
+    writer->FailAt(3);
+    FramePool pool(device, 2, 2, WIDTH, HEIGHT);
+    for (size_t i = 0; i < 10 && RecordFrame(pool, *device, writer, i); ++i)
+        std::this_thread::sleep_for(1ms);
+
+    CHECK(WaitUntilClosed(pool));
+    CHECK(LogContains("Failed to write frame 3. The FramePool will close."));
+    CHECK(pool.GetNumPending(writer.get()) == 0);
+}
+
+/// @brief A failed store is reported as a backlog failure, not as a failed write
+static void TestFailedStore()
+{
+    VideoLog::Clear();
+    auto device = std::make_shared<UnlockableDevice>();
+    auto writer = std::make_shared<FakeWriter>(false);
+    FramePool pool(device, 1, 2, WIDTH, HEIGHT);
+    CHECK(pool.SetBurst(1 << 20, false));
+    CHECK(RecordFrame(pool, *device, writer, 0));
+
+    CHECK(WaitUntilClosed(pool));
+    CHECK(LogContains("Failed to store frame 0 in the backlog. The FramePool will close."));
+    CHECK(!LogContains("Failed to write frame"));
+    CHECK(writer->GetWritten().empty());
+    CHECK(pool.GetNumPending(writer.get()) == 0);
+}
+
+/// @brief A frame lost by a failed store doesn't leave a synchronous writer waiting for it
+static void TestFailedStoreSync()
+{
+    VideoLog::Clear();
+    auto device = std::make_shared<UnlockableDevice>(3);
+    auto writer = std::make_shared<FakeWriter>(false, 1ms);
+    FramePool pool(device, 4, 2, WIDTH, HEIGHT);
+    CHECK(pool.SetBurst(1 << 20, false));
+    for (size_t i = 0; i < 8 && RecordFrame(pool, *device, writer, i); ++i) {}
+    pool.Finish();
+
+    CHECK(LogContains("Failed to store frame 3 in the backlog. The FramePool will close."));
+    std::vector<size_t> written = writer->GetWritten();
+    for (size_t i = 0; i < written.size(); ++i)
+        CHECK(written[i] != 3 && (i == 0 || written[i] > written[i - 1]));
+    CHECK(writer->GetNumMismatched() == 0);
+}
+
+int main()
+{
+    TestBlock();
+    TestDrop();
+    TestBorrow();
+    TestBorrowWithoutBacklog();
+    TestDegrade();
+    TestAdaptGrow();
+    TestAdaptShrink();
+    TestFailedWrite();
+    TestFailedStore();
+    TestFailedStoreSync();
+    return Check::Result();
+}
@@ -0,0 +1,153 @@
+// Tests that Hdr's half float conversions round correctly, and that the F16C path matches the scalar one bit for bit.
+// Also tests decoding 8-bit pixels for EXR.
+#include "check.h"
+#include <Streams/hdr.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static uint32_t FloatToBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float BitsToFloat(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/// @brief Check that `half` is the nearest half to a finite `value`, with ties going to the even one
+static bool IsRoundedToNearestEven(float value, uint16_t half)
+{
+    // Halfway between the largest half and the next power of 2, which would be the next half
+    constexpr double OVERFLOW_THRESHOLD = 65520.0;
+    const uint16_t sign = value < 0 || (value == 0 && std::signbit(value)) ? 0x8000 : 0;
+    if (std::fabs((double)value) >= OVERFLOW_THRESHOLD)
+        return half == (sign | 0x7C00);
+    if ((half & 0x8000) != sign || (half & 0x7C00) == 0x7C00)
+        return false;
+
+    // Halves of one sign are ordered like their bits, so the neighbors are one step away
+    const double error = std::fabs((double)Hdr::HalfToFloat(half) - value);
+    for (int step : {-1, 1})
+    {
+        uint16_t magnitude = half & 0x7FFF;
+        if ((step < 0 && magnitude == 0) || (step > 0 && magnitude == 0x7BFF))
+            continue;
+        double neighbor_error = std::fabs((double)Hdr::HalfToFloat((uint16_t)(sign | (magnitude + step))) - value);
+        if (neighbor_error < error || (neighbor_error == error && (half & 1)))
+            return false;
+    }
+    return true;
+}
+
+/// @brief Every half converts to the same float bits on both paths, and back to itself
+static void TestHalfToFloat()
+{
+    std::vector<uint16_t> halves(0x10000);
+    for (size_t i = 0; i < halves.size(); ++i)
+        halves[i] = (uint16_t)i;
+    std::vector<float> floats(halves.size());
+    Hdr::HalfToFloat(halves.data(), halves.size(), floats.data());
+
+    size_t num_mismatched = 0, num_changed = 0;
+    for (size_t i = 0; i < halves.size(); ++i)
+    {
+        if (FloatToBits(floats[i]) != FloatToBits(Hdr::HalfToFloat(halves[i])))
+            num_mismatched += 1;
+        // NaNs are quieted, so only their payload's top bit may change
+        uint16_t back = Hdr::FloatToHalf(floats[i]);
+        bool is_nan = (halves[i] & 0x7C00) == 0x7C00 && (halves[i] & 0x3FF);
+        if (is_nan ? back != (halves[i] | 0x200) : back != halves[i])
+            num_changed += 1;
+    }
+    CHECK(num_mismatched == 0);
+    CHECK(num_changed == 0);
+}
+
+/// @brief Floats spread over every exponent, plus the values at and next to every tie between two halves
+static std::vector<float> MakeFloats()
+{
+    std::vector<float> floats;
+    // A prime stride, so every exponent gets a mix of mantissas
+    for (uint64_t bits = 0; bits <= 0xFFFFFFFF; bits += 4099)
+        floats.push_back(BitsToFloat((uint32_t)bits));
+
+    for (uint32_t half = 0; half < 0x7C00; ++half)
+    {
+        for (uint32_t sign : {0u, 0x8000u})
+        {
+            double low = Hdr::HalfToFloat((uint16_t)(sign | half));
+            double high = half == 0x7BFF ? (sign ? -65536.0 : 65536.0) : Hdr::HalfToFloat((uint16_t)(sign | (half + 1)));
+            float tie = (float)((low + high) / 2); // Exact, since floats have more precision than halves
+            floats.push_back(tie);
+            floats.push_back(std::nextafter(tie, -INFINITY));
+            floats.push_back(std::nextafter(tie, INFINITY));
+        }
+    }
+    for (float special : {0.0f, -0.0f, INFINITY, -INFINITY, NAN, 1e-30f, -1e30f, 65504.0f, 65519.99f, 65520.0f})
+        floats.push_back(special);
+    return floats;
+}
+
+/// @brief Floats round to the nearest half, and both paths agree on every bit
+static void TestFloatToHalf()
+{
+    std::vector<float> floats = MakeFloats();
+    // Leave a tail of 3, which the vectorized path hands to the scalar one
+    floats.resize(floats.size() / 4 * 4 + 3, 1.0f);
+    std::vector<uint16_t> halves(floats.size());
+    Hdr::FloatToHalf(floats.data(), floats.size(), halves.data());
+
+    size_t num_mismatched = 0, num_misrounded = 0;
+    for (size_t i = 0; i < floats.size(); ++i)
+    {
+        uint16_t scalar = Hdr::FloatToHalf(floats[i]);
+        if (halves[i] != scalar)
+            num_mismatched += 1;
+        if (std::isfinite(floats[i]) && !IsRoundedToNearestEven(floats[i], scalar))
+            num_misrounded += 1;
+    }
+    CHECK(num_mismatched == 0);
+    CHECK(num_misrounded == 0);
+
+    CHECK(Hdr::FloatToHalf(INFINITY) == 0x7C00 && Hdr::FloatToHalf(-INFINITY) == 0xFC00);
+    CHECK((Hdr::FloatToHalf(NAN) & 0x7E00) == 0x7E00);
+    CHECK(Hdr::FloatToHalf(-0.0f) == 0x8000);
+}
+
+/// @brief 8-bit pixels decode from each layout, and only formats with alpha keep their fourth byte
+static void TestRgb8ToLinear()
+{
+    const size_t BGR[3] = {2, 1, 0}, RGB[3] = {0, 1, 2};
+    const uint8_t bgra[] = {0, 128, 255, 51, 255, 0, 0, 200};
+    const uint8_t rgb[] = {255, 128, 0, 0, 0, 255};
+    float out[8];
+
+    Hdr::Rgb8ToLinear(bgra, 2, 4, BGR, true, out);
+    CHECK(out[0] == 1.f && out[1] > 0.2f && out[1] < 0.22f && out[2] == 0.f && out[3] == 0.2f);
+    CHECK(out[4] == 0.f && out[5] == 0.f && out[6] == 1.f && out[7] == 200 / 255.f);
+
+    // X8 formats have undefined bytes in place of alpha
+    Hdr::Rgb8ToLinear(bgra, 2, 4, BGR, false, out);
+    CHECK(out[3] == 1.f && out[7] == 1.f);
+
+    Hdr::Rgb8ToLinear(rgb, 2, 3, RGB, false, out);
+    CHECK(out[0] == 1.f && out[1] > 0.2f && out[1] < 0.22f && out[2] == 0.f && out[3] == 1.f);
+    CHECK(out[4] == 0.f && out[5] == 0.f && out[6] == 1.f && out[7] == 1.f);
+}
+
+int main()
+{
+    // Without F16C, both paths are scalar and only the rounding is really tested
+    printf("F16C: %s\n", Hdr::HasF16C() ? "yes" : "no");
+    TestHalfToFloat();
+    TestFloatToHalf();
+    TestRgb8ToLinear();
+    return Check::Result();
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <Streams/readback.h>
+#include <Streams/framebuffer.h>
+#include <Streams/framepool.h>
+#include "fake-writer.h"
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+
+/**
+ * @file
+ * @brief A CPU stand-in for the GPU readback, so @ref FramePool can be tested without D3D.
+ *
+ * Copies queued with @ref ReadbackDeviceCpu::Copy behave like the game thread's GPU copies:
+ * they only land in the buffer once the next issued fence completes, after the device's latency.
+ * A worker that reads a buffer without waiting on its fence sees the previous frame's pixels.
+ */
+
+class ReadbackDeviceCpu;
+
+class ReadbackFenceCpu : public ReadbackFence
+{
+public:
+    ReadbackFenceCpu(ReadbackDeviceCpu* device) : m_device(device) {}
+
+    void Issue() override;
+    bool IsComplete() override;
+
+private:
+    struct PendingCopy
+    {
+        FrameBufferMem* buffer;
+        std::vector<uint8_t> pixels;
+    };
+
+    friend ReadbackDeviceCpu;
+    ReadbackDeviceCpu* m_device;
+    std::mutex m_mutex;
+    std::vector<PendingCopy> m_copies;
+    std::chrono::steady_clock::time_point m_issue_time;
+};
+
+class ReadbackDeviceCpu : public ReadbackDevice
+{
+public:
+    /// @param latency How long each copy takes to land, after its fence is issued
+    ReadbackDeviceCpu(std::chrono::microseconds latency) : m_latency(latency) {}
+
+    std::unique_ptr<FrameBufferBase> CreateBuffer(uint32_t width, uint32_t height, D3DFORMAT format) override {
+        return std::make_unique<FrameBufferMem>(width, height, format);
+    }
+    ReadbackFence::Ptr CreateFence() override { return std::make_unique<ReadbackFenceCpu>(this); }
+
+    /// @brief Queue a copy of tightly packed `pixels` into a buffer from @ref CreateBuffer. Only call this from the game thread.
+    void Copy(FrameBufferBase& buffer, std::vector<uint8_t> pixels) {
+        m_unfenced.push_back({static_cast<FrameBufferMem*>(&buffer), std::move(pixels)});
+    }
+    /// @brief The number of times a fence was checked before its copies landed
+    size_t GetNumEarlyChecks() {
+        std::scoped_lock lock{m_mutex};
+        return m_num_early_checks;
+    }
+
+private:
+    friend ReadbackFenceCpu;
+    std::chrono::microseconds m_latency;
+    /// @brief Copies since the last issued fence
+    std::vector<ReadbackFenceCpu::PendingCopy> m_unfenced;
+    std::mutex m_mutex;
+    size_t m_num_early_checks = 0;
+};
+
+inline void ReadbackFenceCpu::Issue()
+{
+    std::scoped_lock lock{m_mutex};
+    for (PendingCopy& copy : m_device->m_unfenced)
+        m_copies.push_back(std::move(copy));
+    m_device->m_unfenced.clear();
+    m_issue_time = std::chrono::steady_clock::now();
+}
+
+inline bool ReadbackFenceCpu::IsComplete()
+{
+    std::scoped_lock lock{m_mutex};
+    if (m_copies.empty())
+        return true;
+    if (std::chrono::steady_clock::now() - m_issue_time < m_device->m_latency)
+    {
+        std::scoped_lock device_lock{m_device->m_mutex};
+        m_device->m_num_early_checks += 1;
+        return false;
+    }
+    for (const PendingCopy& copy : m_copies)
+        memcpy(copy.buffer->GetData(), copy.pixels.data(), copy.pixels.size());
+    m_copies.clear();
+    return true;
+}
+
+/**
+ * @brief Record a frame like the recorder does: pop an empty frame, queue a copy into it, and push it.
+ * @return `false` if no frame was popped
+ */
+inline bool RecordFrame(FramePool& pool, ReadbackDeviceCpu& device, const std::shared_ptr<VideoWriter>& writer, size_t index)
+{
+    FramePool::FramePtr frame = pool.PopEmptyFrame();
+    if (!frame)
+        return false;
+    const FrameBufferBase& buffer = *frame->buffer;
+    device.Copy(*frame->buffer, MakeFramePixels(buffer.GetRowSize() * buffer.GetHeight(), index));
+    pool.PushFullFrame(frame, index, writer);
+    return true;
+}
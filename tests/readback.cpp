@@ -0,0 +1,80 @@
+// Tests that FramePool's workers wait on each frame's fence before reading it,
+// and keep synchronous writers in order, with a CPU stand-in for the GPU readback.
+#include "check.h"
+#include "readback-cpu.h"
+#include <algorithm>
+
+using namespace std::chrono_literals;
+
+static constexpr uint32_t WIDTH = 16;
+static constexpr uint32_t HEIGHT = 8;
+static constexpr size_t NUM_FRAMES = 64;
+
+/// @brief Workers must not read a frame until its copy has landed
+static void TestFenceWait()
+{
+    auto device = std::make_shared<ReadbackDeviceCpu>(2ms);
+    auto writer = std::make_shared<FakeWriter>(true);
+    FramePool pool(device, 4, 4, WIDTH, HEIGHT);
+    for (size_t i = 0; i < NUM_FRAMES; ++i)
+        CHECK(RecordFrame(pool, *device, writer, i));
+    pool.Finish();
+
+    std::vector<size_t> written = writer->GetWritten();
+    std::sort(written.begin(), written.end());
+    CHECK(written.size() == NUM_FRAMES);
+    for (size_t i = 0; i < written.size(); ++i)
+        CHECK(written[i] == i);
+    CHECK(writer->GetNumMismatched() == 0);
+    // The fences were checked before completing, so the workers really waited
+    CHECK(device->GetNumEarlyChecks() > 0);
+}
+
+/// @brief Synchronous writers get their frames one at a time, in the order they were pushed
+static void TestSyncOrder()
+{
+    auto device = std::make_shared<ReadbackDeviceCpu>(500us);
+    auto sync_writer = std::make_shared<FakeWriter>(false, 200us);
+    auto async_writer = std::make_shared<FakeWriter>(true, 100us);
+    FramePool pool(device, 4, 6, WIDTH, HEIGHT);
+    for (size_t i = 0; i < NUM_FRAMES; ++i)
+    {
+        CHECK(RecordFrame(pool, *device, sync_writer, i));
+        CHECK(RecordFrame(pool, *device, async_writer, i));
+    }
+    pool.Finish();
+
+    std::vector<size_t> written = sync_writer->GetWritten();
+    CHECK(written.size() == NUM_FRAMES);
+    for (size_t i = 0; i < written.size(); ++i)
+        CHECK(written[i] == i);
+    CHECK(sync_writer->GetNumMismatched() == 0);
+    CHECK(async_writer->GetWritten().size() == NUM_FRAMES);
+    CHECK(async_writer->GetNumMismatched() == 0);
+}
+
+/// @brief The backlog's workers also wait on the fence before storing a frame
+static void TestBacklogFenceWait()
+{
+    auto device = std::make_shared<ReadbackDeviceCpu>(1ms);
+    auto writer = std::make_shared<FakeWriter>(false, 300us);
+    FramePool pool(device, 4, 2, WIDTH, HEIGHT);
+    pool.SetBacklog(64 << 10);
+    for (size_t i = 0; i < NUM_FRAMES; ++i)
+        CHECK(RecordFrame(pool, *device, writer, i));
+    pool.Finish();
+
+    std::vector<size_t> written = writer->GetWritten();
+    CHECK(written.size() == NUM_FRAMES);
+    for (size_t i = 0; i < written.size(); ++i)
+        CHECK(written[i] == i);
+    CHECK(writer->GetNumMismatched() == 0);
+}
+
+int main()
+{
+    TestFenceWait();
+    TestSyncOrder();
+    TestBacklogFenceWait();
+    return Check::Result();
+}
@@ -0,0 +1,83 @@
+// Compresses 1080p frames into the backlog's RAM tier and back, to weigh LZ4's speed against the memory it saves.
+#include "bench.h"
+#include <Streams/backlog.h>
+#include <Streams/framebuffer.h>
+#include <cstring>
+#include <vector>
+
+static constexpr uint32_t WIDTH = 1920;
+static constexpr uint32_t HEIGHT = 1080;
+
+enum class Content { FLAT, TEXTURED, NOISE };
+
+/// @brief Fill a frame with content that compresses like part of a game frame
+static void FillFrame(FrameBufferMem* buffer, Content content)
+{
+    uint8_t* pixels = buffer->GetData();
+    uint32_t seed = 12345;
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+        {
+            seed = seed * 1664525 + 1013904223;
+            uint8_t* p = pixels + ((size_t)y * WIDTH + x) * 4;
+            switch (content)
+            {
+            case Content::FLAT: // Sky and HUD: large areas of one color, with a slow gradient
+                p[0] = (uint8_t)(y / 8);
+                p[1] = x < WIDTH / 3 ? 40 : 120;
+                p[2] = (uint8_t)(200 - y / 16);
+                break;
+            case Content::TEXTURED: // Surfaces: smooth shading, with noise in the low bits
+                p[0] = (uint8_t)((x + y) / 16 + (seed >> 30));
+                p[1] = (uint8_t)(x / 8 + (seed >> 29 & 3));
+                p[2] = (uint8_t)(y / 5 + (seed >> 27 & 3));
+                break;
+            case Content::NOISE: // Particles and film grain, which don't compress at all
+                memcpy(p, &seed, 3);
+                break;
+            }
+            p[3] = 0xFF;
+        }
+    }
+}
+
+void BenchBacklog()
+{
+    const size_t raw_size = (size_t)WIDTH * HEIGHT * 4;
+    const struct { const char* name; Content content; } CONTENTS[] = {
+        {"flat", Content::FLAT}, {"textured", Content::TEXTURED}, {"noise", Content::NOISE}
+    };
+
+    FrameBufferMem frame(WIDTH, HEIGHT, D3DFMT_A8R8G8B8);
+    FrameBufferMem restored(WIDTH, HEIGHT, D3DFMT_A8R8G8B8);
+
+    // The arena tier is a plain copy, which is the most compression has to compete with
+    double copy = Bench::Time([&] {
+        memcpy(restored.GetData(), frame.GetData(), raw_size);
+        Bench::Keep(restored.GetData()[raw_size - 1]);
+    });
+    Bench::ReportBytes("memcpy (arena tier)", copy, raw_size);
+
+    for (const auto& [name, content] : CONTENTS)
+    {
+        FillFrame(&frame, content);
+        FrameBacklog::Entry entry;
+        double compress = Bench::Time([&] {
+            FrameBacklog::Compress(frame, &entry);
+            Bench::Keep(entry.data.size());
+        });
+        double decompress = Bench::Time([&] {
+            FrameBacklog::Decompress(entry, &restored);
+            Bench::Keep(restored.GetData()[0]);
+        });
+        bool intact = memcmp(frame.GetData(), restored.GetData(), raw_size) == 0;
+
+        std::string label = std::string("LZ4 compress, ") + name;
+        Bench::ReportBytes(label.c_str(), compress, raw_size);
+        label = std::string("LZ4 decompress, ") + name;
+        Bench::ReportBytes(label.c_str(), decompress, raw_size);
+        std::printf("  %-44s %10.2f : 1%s\n", (std::string("Ratio, ") + name).c_str(),
+            (double)raw_size / entry.data.size(), intact ? "" : " (MISMATCHED)");
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+
+/**
+ * @file
+ * @brief Timing helpers for the benchmarks: each one is timed several times, and the fastest run is reported.
+ *
+ * The fastest run is the one least disturbed by other processes, so it's the most repeatable on a busy machine.
+ */
+
+namespace Bench
+{
+    /// @brief Results are added here, so the compiler can't skip the work that made them
+    inline volatile size_t sink = 0;
+
+    inline void Keep(size_t value) { sink = sink + value; }
+
+    /// @brief Call `fn` once to warm up, then `num_runs` times
+    /// @return The fastest call, in seconds
+    template <class F>
+    double Time(F&& fn, size_t num_runs = 5)
+    {
+        fn();
+        double best = 0;
+        for (size_t i = 0; i < num_runs; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            best = i == 0 || seconds < best ? seconds : best;
+        }
+        return best;
+    }
+
+    /// @brief Print the time of each of the `num_ops` operations in a run
+    inline void ReportOps(const char* name, double seconds, size_t num_ops) {
+        std::printf("  %-44s %10.1f ns/op\n", name, seconds * 1e9 / num_ops);
+    }
+
+    /// @brief Print how many bytes a run got through each second
+    inline void ReportBytes(const char* name, double seconds, size_t num_bytes) {
+        std::printf("  %-44s %10.1f MB/s\n", name, num_bytes / seconds / (1024.0 * 1024.0));
+    }
+}
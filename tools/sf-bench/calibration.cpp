@@ -0,0 +1,73 @@
+// Runs EncoderCalibration headless, with encoders from this tree and a reference whose cost is known,
+// to see how long calibration takes and how closely it measures.
+#include "bench.h"
+#include <Streams/calibration.h>
+#include <Streams/delta.h>
+#include <Helper/lz4.h>
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+static constexpr uint32_t WIDTH = 1920;
+static constexpr uint32_t HEIGHT = 1080;
+static constexpr size_t NUM_FRAMES = 4;
+/// @brief Each encode of the reference candidate spins for this long
+static constexpr std::chrono::microseconds REFERENCE_TIME{2000};
+
+static std::vector<uint8_t> MakeFrame(size_t index)
+{
+    std::vector<uint8_t> rgb((size_t)WIDTH * HEIGHT * 3);
+    uint32_t seed = 4242 + (uint32_t)index;
+    for (size_t i = 0; i < rgb.size(); i += 3)
+    {
+        seed = seed * 1664525 + 1013904223;
+        size_t x = i / 3 % WIDTH, y = i / 3 / WIDTH;
+        rgb[i] = (uint8_t)((x + y + index * 8) / 16 + (seed >> 30));
+        rgb[i + 1] = (uint8_t)(x / 8);
+        rgb[i + 2] = (uint8_t)(y / 5);
+    }
+    return rgb;
+}
+
+void BenchCalibration()
+{
+    std::vector<std::vector<uint8_t>> frames;
+    for (size_t i = 0; i < NUM_FRAMES; ++i)
+        frames.push_back(MakeFrame(i));
+
+    EncoderCalibration calibration{NUM_FRAMES};
+    calibration.AddCandidate("Reference, 2 ms", [](size_t) {
+        auto end = std::chrono::steady_clock::now() + REFERENCE_TIME;
+        while (std::chrono::steady_clock::now() < end)
+            continue;
+        return (size_t)1;
+    });
+    calibration.AddCandidate("LZ4", [&](size_t i) {
+        thread_local std::vector<uint8_t> out;
+        out.resize(Helper::LZ4CompressBound(frames[i].size()));
+        return Helper::LZ4Compress(frames[i].data(), frames[i].size(), out.data(), out.size());
+    });
+    calibration.AddCandidate("Delta keyframe", [&](size_t i) {
+        thread_local std::vector<uint8_t> out;
+        Delta::Encoder encoder(WIDTH, HEIGHT);
+        encoder.Encode(frames[i].data(), true, &out);
+        return out.size();
+    });
+
+    // 1000 FPS isn't sustained by anything, so every thread count is measured
+    EncoderCalibration::Report report;
+    double run = Bench::Time([&] { report = calibration.Run(1000, 4, {}); }, 1);
+    std::printf("%s", calibration.FormatReport(report).c_str());
+    std::printf("  %-44s %10.2f s\n", "Calibration run, 3 candidates", run);
+
+    // Spinning scales with cores, so only one thread is predictable
+    const double expected_fps = 1.0 / std::chrono::duration<double>(REFERENCE_TIME).count();
+    for (const EncoderCalibration::Measurement& measurement : report.measurements)
+    {
+        if (measurement.candidate == 0 && measurement.num_threads == 1)
+            std::printf("  %-44s %10.1f%%\n", "Reference error, 1 thread", 100.0 * (measurement.fps - expected_fps) / expected_fps);
+    }
+
+    double disk = EncoderCalibration::MeasureDiskSpeed(std::filesystem::temp_directory_path(), 64 << 20);
+    std::printf("  %-44s %10.1f MB/s\n", "Flushed writes to the temp folder", disk / (1024.0 * 1024.0));
+}
@@ -0,0 +1,100 @@
+// Encodes and decodes 1080p sequences with the delta codec, from a still image to a frame where everything moves.
+#include "bench.h"
+#include <Streams/delta.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static constexpr uint32_t WIDTH = 1920;
+static constexpr uint32_t HEIGHT = 1080;
+static constexpr size_t NUM_FRAMES = 8;
+
+/// @brief A textured RGB background, shifted right by `shift` pixels
+static void FillBackground(uint8_t* rgb, uint32_t shift)
+{
+    uint32_t seed = 6789;
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        for (uint32_t x = 0; x < WIDTH; ++x)
+        {
+            seed = seed * 1664525 + 1013904223;
+            uint32_t u = x + shift;
+            uint8_t* p = rgb + ((size_t)y * WIDTH + x) * 3;
+            p[0] = (uint8_t)((u + y) / 16 + ((u * 7 + y * 13) % 5));
+            p[1] = (uint8_t)(u / 8);
+            p[2] = (uint8_t)(y / 5);
+        }
+    }
+}
+
+/// @brief Draw a solid square, like a moving marker or HUD element
+static void DrawSquare(uint8_t* rgb, uint32_t left, uint32_t top, uint32_t size)
+{
+    for (uint32_t y = top; y < top + size && y < HEIGHT; ++y)
+    {
+        for (uint32_t x = left; x < left + size && x < WIDTH; ++x)
+        {
+            uint8_t* p = rgb + ((size_t)y * WIDTH + x) * 3;
+            p[0] = 250, p[1] = 40, p[2] = 40;
+        }
+    }
+}
+
+void BenchDelta()
+{
+    const size_t raw_size = (size_t)WIDTH * HEIGHT * 3;
+    enum class Motion { STILL, SQUARE, PAN };
+    const struct { const char* name; Motion motion; } SCENES[] = {
+        {"still", Motion::STILL}, {"moving square", Motion::SQUARE}, {"camera pan", Motion::PAN}
+    };
+
+    for (const auto& [name, motion] : SCENES)
+    {
+        std::vector<std::vector<uint8_t>> frames(NUM_FRAMES, std::vector<uint8_t>(raw_size));
+        for (size_t i = 0; i < NUM_FRAMES; ++i)
+        {
+            FillBackground(frames[i].data(), motion == Motion::PAN ? (uint32_t)i * 3 : 0);
+            if (motion == Motion::SQUARE)
+                DrawSquare(frames[i].data(), 200 + (uint32_t)i * 40, 300, 120);
+        }
+
+        // Only the first frame is a keyframe, like a stream between keyframe intervals
+        std::vector<std::vector<uint8_t>> encoded(NUM_FRAMES);
+        size_t num_tiles = 0, num_stored = 0;
+        double encode = Bench::Time([&] {
+            Delta::Encoder encoder(WIDTH, HEIGHT);
+            num_tiles = num_stored = 0;
+            for (size_t i = 0; i < NUM_FRAMES; ++i)
+            {
+                size_t stored = encoder.Encode(frames[i].data(), i == 0, &encoded[i]);
+                if (i > 0)
+                {
+                    num_stored += stored;
+                    num_tiles += encoder.GetNumTiles();
+                }
+            }
+        }, 3);
+
+        bool intact = true;
+        double decode = Bench::Time([&] {
+            Delta::Decoder decoder(WIDTH, HEIGHT);
+            intact = true;
+            for (size_t i = 0; i < NUM_FRAMES; ++i)
+            {
+                intact = decoder.Decode(encoded[i].data(), encoded[i].size()) && intact;
+                intact = intact && memcmp(decoder.GetFrame(), frames[i].data(), raw_size) == 0;
+            }
+        }, 3);
+
+        size_t encoded_size = 0;
+        for (size_t i = 1; i < NUM_FRAMES; ++i)
+            encoded_size += encoded[i].size();
+
+        std::string label = std::string("Encode, ") + name;
+        Bench::ReportBytes(label.c_str(), encode, raw_size * NUM_FRAMES);
+        label = std::string("Decode and compare, ") + name;
+        Bench::ReportBytes(label.c_str(), decode, raw_size * NUM_FRAMES);
+        std::printf("  %-44s %10.2f : 1, %.1f%% of tiles stored%s\n", (std::string("Ratio after the keyframe, ") + name).c_str(),
+            (double)raw_size * (NUM_FRAMES - 1) / encoded_size, 100.0 * num_stored / num_tiles, intact ? "" : " (MISMATCHED)");
+    }
+}
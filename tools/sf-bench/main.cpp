@@ -0,0 +1,60 @@
+/**
+ * @file
+ * @brief Microbenchmarks of the capture and render tweak code that has no D3D or game dependencies.
+ *
+ * Each benchmark compares the current code with the approach it replaced, or measures it on synthetic data.
+ * Run every benchmark, or only the ones named on the command line.
+ */
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+void BenchPathSet();
+void BenchTweaks();
+void BenchBacklog();
+void BenchDelta();
+void BenchCalibration();
+
+struct Benchmark
+{
+    const char* name;
+    const char* description;
+    void (*run)();
+};
+
+static const Benchmark BENCHMARKS[] = {
+    {"pathset", "Model path lookups in 10k paths", BenchPathSet},
+    {"tweaks", "Visiting a stream's tweaks by type, like RenderPlan", BenchTweaks},
+    {"backlog", "LZ4 compression of 1080p frames for the backlog", BenchBacklog},
+    {"delta", "The delta codec on 1080p sequences", BenchDelta},
+    {"calibration", "A headless encoder calibration, and the disk test", BenchCalibration},
+};
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        bool found = false;
+        for (const Benchmark& benchmark : BENCHMARKS)
+            found = found || !strcmp(argv[i], benchmark.name);
+        if (!found)
+        {
+            fprintf(stderr, "Unknown benchmark '%s'. Usage: sf-bench [names...]\n", argv[i]);
+            for (const Benchmark& benchmark : BENCHMARKS)
+                fprintf(stderr, "  %-12s %s\n", benchmark.name, benchmark.description);
+            return 1;
+        }
+    }
+
+    for (const Benchmark& benchmark : BENCHMARKS)
+    {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; ++i)
+            selected = selected || !strcmp(argv[i], benchmark.name);
+        if (!selected)
+            continue;
+        printf("%s: %s\n", benchmark.name, benchmark.description);
+        benchmark.run();
+    }
+    return 0;
+}
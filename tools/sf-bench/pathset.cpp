@@ -0,0 +1,64 @@
+// Looks up model paths the way ModelTweak::IsModelAffected does, before and after it used Helper::PathSet.
+#include "bench.h"
+#include <Helper/str.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+static constexpr size_t NUM_PATHS = 10000;
+static constexpr size_t NUM_QUERIES = 20000;
+
+/// @brief A path like the ones in a studiohdr_t, with mixed case and backslashes
+static std::string MakeRawPath(size_t index)
+{
+    static const char* const FOLDERS[] = {"Player", "Weapons\\c_models", "props_Gameplay", "bots\\Heavy_Boss"};
+    return Helper::sprintf("models\\%s\\Model_%05zu.mdl", FOLDERS[index % 4], index);
+}
+
+void BenchPathSet()
+{
+    std::vector<std::string> normalized;
+    for (size_t i = 0; i < NUM_PATHS; ++i)
+        normalized.push_back(Helper::NormalizePath(MakeRawPath(i * 2)));
+    // Half of the queries are in the set
+    std::vector<std::string> queries;
+    for (size_t i = 0; i < NUM_QUERIES; ++i)
+        queries.push_back(MakeRawPath(i * 7919 % (NUM_PATHS * 2)));
+
+    // The linear scan is much slower, so it gets fewer queries
+    const size_t num_scanned = NUM_QUERIES / 100;
+    double scan = Bench::Time([&] {
+        size_t found = 0;
+        for (size_t i = 0; i < num_scanned; ++i)
+        {
+            for (const std::string& path : normalized)
+            {
+                if (Helper::CaseInsensitivePathCompare(queries[i].c_str(), path.c_str()) == 0)
+                {
+                    found += 1;
+                    break;
+                }
+            }
+        }
+        Bench::Keep(found);
+    }, 3);
+    Bench::ReportOps("Linear CaseInsensitivePathCompare", scan, num_scanned);
+
+    std::unordered_set<std::string> plain_set(normalized.begin(), normalized.end());
+    double normalize = Bench::Time([&] {
+        size_t found = 0;
+        for (const std::string& query : queries)
+            found += plain_set.count(Helper::NormalizePath(query));
+        Bench::Keep(found);
+    });
+    Bench::ReportOps("NormalizePath + std::unordered_set", normalize, NUM_QUERIES);
+
+    Helper::PathSet path_set(normalized.begin(), normalized.end());
+    double hashed = Bench::Time([&] {
+        size_t found = 0;
+        for (const std::string& query : queries)
+            found += path_set.find(std::string_view(query)) != path_set.end();
+        Bench::Keep(found);
+    });
+    Bench::ReportOps("Helper::PathSet", hashed, NUM_QUERIES);
+}
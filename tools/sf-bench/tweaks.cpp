@@ -0,0 +1,167 @@
+// Iterates a stream's tweaks by type, like RenderPlan does, with the dynamic_pointer_cast scan that
+// Stream::const_type_iterator used before, and with the per-type buckets it uses now.
+// The real tweaks need the game to link, so these stand-ins copy their shape: a polymorphic base with a type ID.
+#include "bench.h"
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+enum class TweakType : size_t { COMMAND, MODEL, MATERIAL, CAMERA, FOG, _COUNT };
+
+class Tweak
+{
+public:
+    virtual ~Tweak() {}
+    virtual TweakType GetType() const = 0;
+    int value = 0;
+};
+
+template <TweakType Type>
+class TypedTweak : public Tweak
+{
+public:
+    static constexpr TweakType TYPE = Type;
+    TweakType GetType() const override { return TYPE; }
+};
+
+using CommandTweak = TypedTweak<TweakType::COMMAND>;
+using ModelTweak = TypedTweak<TweakType::MODEL>;
+using MaterialTweak = TypedTweak<TweakType::MATERIAL>;
+using CameraTweak = TypedTweak<TweakType::CAMERA>;
+using FogTweak = TypedTweak<TweakType::FOG>;
+
+/// @brief The tweaks of one stream, in order, and grouped by type
+struct TweakList
+{
+    std::vector<std::shared_ptr<Tweak>> tweaks;
+    std::array<std::vector<Tweak*>, (size_t)TweakType::_COUNT> buckets;
+
+    void Add(std::shared_ptr<Tweak> tweak)
+    {
+        buckets[(size_t)tweak->GetType()].push_back(tweak.get());
+        tweaks.push_back(std::move(tweak));
+    }
+};
+
+/// @brief The iterator from before the buckets: each step casts its way to the next tweak of type `T`
+template <class T>
+class ScanIterator
+{
+public:
+    static ScanIterator begin(const TweakList& list)
+    {
+        const auto* end = list.tweaks.data() + list.tweaks.size();
+        const auto* ptr = list.tweaks.data();
+        while (ptr < end && std::dynamic_pointer_cast<T>(*ptr) == nullptr)
+            ++ptr;
+        return ScanIterator(ptr, end);
+    }
+    static ScanIterator end(const TweakList& list)
+    {
+        const auto* end = list.tweaks.data() + list.tweaks.size();
+        return ScanIterator(end, end);
+    }
+    ScanIterator& operator++()
+    {
+        do {
+            ++m_ptr;
+        } while (m_ptr < m_end && std::dynamic_pointer_cast<T>(*m_ptr) == nullptr);
+        return *this;
+    }
+    std::shared_ptr<T> operator->() const { return std::dynamic_pointer_cast<T>(*m_ptr); }
+    bool operator!=(const ScanIterator& other) const { return m_ptr != other.m_ptr; }
+
+private:
+    ScanIterator(const std::shared_ptr<Tweak>* ptr, const std::shared_ptr<Tweak>* end) : m_ptr(ptr), m_end(end) {}
+    const std::shared_ptr<Tweak>* m_ptr;
+    const std::shared_ptr<Tweak>* m_end;
+};
+
+/// @brief The iterator over a bucket, which only casts statically
+template <class T>
+class BucketIterator
+{
+public:
+    static BucketIterator begin(const TweakList& list) { return BucketIterator(list.buckets[(size_t)T::TYPE].data()); }
+    static BucketIterator end(const TweakList& list)
+    {
+        auto& bucket = list.buckets[(size_t)T::TYPE];
+        return BucketIterator(bucket.data() + bucket.size());
+    }
+    BucketIterator& operator++()
+    {
+        ++m_ptr;
+        return *this;
+    }
+    T* operator->() const { return static_cast<T*>(*m_ptr); }
+    bool operator!=(const BucketIterator& other) const { return m_ptr != other.m_ptr; }
+
+private:
+    explicit BucketIterator(Tweak* const* ptr) : m_ptr(ptr) {}
+    Tweak* const* m_ptr;
+};
+
+/// @brief Visit the tweaks the way RenderPlan::Compile does: every model, material and camera tweak, and the first command tweak
+template <template <class> class Iterator>
+size_t VisitLikeRenderPlan(const TweakList& list)
+{
+    size_t sum = 0;
+    for (auto it = Iterator<ModelTweak>::begin(list); it != Iterator<ModelTweak>::end(list); ++it)
+        sum += it->value;
+    auto cmd = Iterator<CommandTweak>::begin(list);
+    if (cmd != Iterator<CommandTweak>::end(list))
+        sum += cmd->value;
+    for (auto it = Iterator<MaterialTweak>::begin(list); it != Iterator<MaterialTweak>::end(list); ++it)
+        sum += it->value;
+    for (auto it = Iterator<CameraTweak>::begin(list); it != Iterator<CameraTweak>::end(list); ++it)
+        sum += it->value;
+    // ActiveStream looks up the fog tweak each frame
+    auto fog = Iterator<FogTweak>::begin(list);
+    if (fog != Iterator<FogTweak>::end(list))
+        sum += fog->value;
+    return sum;
+}
+
+}
+
+void BenchTweaks()
+{
+    constexpr size_t NUM_TWEAKS = 50;
+    constexpr size_t NUM_VISITS = 100000;
+
+    // Mostly model and material tweaks, like a stream with many per-model effects
+    TweakList list;
+    for (size_t i = 0; i < NUM_TWEAKS; ++i)
+    {
+        std::shared_ptr<Tweak> tweak;
+        switch (i % 10)
+        {
+        case 0: tweak = std::make_shared<CommandTweak>(); break;
+        case 1: tweak = std::make_shared<CameraTweak>(); break;
+        case 2: case 3: case 4: tweak = std::make_shared<MaterialTweak>(); break;
+        default: tweak = std::make_shared<ModelTweak>(); break;
+        }
+        tweak->value = (int)i;
+        list.Add(std::move(tweak));
+    }
+    list.Add(std::make_shared<FogTweak>());
+
+    double scan = Bench::Time([&] {
+        size_t sum = 0;
+        for (size_t i = 0; i < NUM_VISITS; ++i)
+            sum += VisitLikeRenderPlan<ScanIterator>(list);
+        Bench::Keep(sum);
+    });
+    Bench::ReportOps("dynamic_pointer_cast scan, 51 tweaks", scan, NUM_VISITS);
+
+    double buckets = Bench::Time([&] {
+        size_t sum = 0;
+        for (size_t i = 0; i < NUM_VISITS; ++i)
+            sum += VisitLikeRenderPlan<BucketIterator>(list);
+        Bench::Keep(sum);
+    });
+    Bench::ReportOps("Type buckets, 51 tweaks", buckets, NUM_VISITS);
+}
@@ -0,0 +1,368 @@
+/**
+ * @file
+ * @brief Transcode a dump from the "raw" encoder into a PNG or QOI sequence, or into a video with FFmpeg.
+ *
+ * Images are encoded on every core. Videos are piped to FFmpeg in order, which does its own threading.
+ */
+#include <Streams/rawdump.h>
+#include <Streams/pixels.h>
+#include <Streams/palette.h>
+#include <Streams/calibration.h>
+#include <spng.h>
+#define QOI_IMPLEMENTATION
+#define QOI_NO_STDIO
+#include <qoi.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const char* USAGE =
+    "Usage: sf-transcode <dump.sfraw> <png|qoi> <output folder> [-j threads] [-c png compression]\n"
+    "       sf-transcode <dump.sfraw> ffmpeg <output file> [FFmpeg output args...]\n"
+    "       sf-transcode <dump.sfraw> calibrate <output folder> [target fps]\n";
+
+/// @brief Sample frames taken from the start of the dump, for calibrating
+static constexpr size_t CALIBRATION_FRAMES = 4;
+
+struct Job
+{
+    RawDump::FrameHeader frame;
+    std::vector<uint8_t> data;
+};
+
+/// @brief Frames read from the dump, waiting for a worker
+class JobQueue
+{
+public:
+    explicit JobQueue(size_t capacity) : m_capacity(capacity) {}
+
+    void Push(Job&& job)
+    {
+        std::unique_lock lock{m_mutex};
+        m_cv.wait(lock, [&] { return m_jobs.size() < m_capacity; });
+        m_jobs.push_back(std::move(job));
+        m_cv.notify_all();
+    }
+    /// @return `false` when the queue is closed and empty
+    bool Pop(Job* job)
+    {
+        std::unique_lock lock{m_mutex};
+        m_cv.wait(lock, [&] { return !m_jobs.empty() || m_closed; });
+        if (m_jobs.empty())
+            return false;
+        *job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        m_cv.notify_all();
+        return true;
+    }
+    void Close()
+    {
+        std::scoped_lock lock{m_mutex};
+        m_closed = true;
+        m_cv.notify_all();
+    }
+
+private:
+    const size_t m_capacity;
+    std::deque<Job> m_jobs;
+    bool m_closed = false;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+};
+
+static void ToRgb(const RawDump::Header& header, const uint8_t* pixels, uint8_t* rgb)
+{
+    const size_t num_pixels = (size_t)header.width * header.height;
+    switch (header.format)
+    {
+    case RawDump::PixelFormat::BGRA: Pixels::BgraToRgb(pixels, num_pixels, rgb); break;
+    case RawDump::PixelFormat::RGBA: Pixels::RgbaToRgb(pixels, num_pixels, rgb); break;
+    case RawDump::PixelFormat::BGR: Pixels::BgrToRgb(pixels, num_pixels, rgb); break;
+    case RawDump::PixelFormat::RGB: memcpy(rgb, pixels, num_pixels * 3); break;
+    }
+}
+
+static int WritePngStream(spng_ctx* ctx, void* user, void* data, size_t n)
+{
+    std::ostream& output = *(std::ostream*)user;
+    output.write((const char*)data, n);
+    return output ? 0 : SPNG_IO_ERROR;
+}
+
+/// @brief Encode a PNG the same way as the in-game PNG writer, including indexed colors
+static bool WritePng(const uint8_t* rgb, uint32_t width, uint32_t height, int compression, std::ostream& output)
+{
+    thread_local IndexedImage indexed;
+    const bool is_indexed = indexed.Build(rgb, width, height);
+
+    spng_ihdr ihdr = {0};
+    ihdr.width = width;
+    ihdr.height = height;
+    ihdr.bit_depth = is_indexed ? indexed.GetBitDepth() : 8;
+    ihdr.color_type = is_indexed ? SPNG_COLOR_TYPE_INDEXED : SPNG_COLOR_TYPE_TRUECOLOR;
+
+    spng_ctx* ctx = spng_ctx_new(SPNG_CTX_ENCODER);
+    spng_set_ihdr(ctx, &ihdr);
+    const void* data = rgb;
+    size_t data_size = (size_t)width * height * 3;
+    if (is_indexed)
+    {
+        spng_plte plte = {0};
+        plte.n_entries = indexed.GetPalette().size();
+        for (size_t i = 0; i < plte.n_entries; ++i)
+        {
+            plte.entries[i].red = indexed.GetPalette()[i][0];
+            plte.entries[i].green = indexed.GetPalette()[i][1];
+            plte.entries[i].blue = indexed.GetPalette()[i][2];
+        }
+        spng_set_plte(ctx, &plte);
+        spng_set_option(ctx, SPNG_FILTER_CHOICE, SPNG_DISABLE_FILTERING);
+        data = indexed.GetData().data();
+        data_size = indexed.GetData().size();
+    }
+    spng_set_png_stream(ctx, WritePngStream, (void*)&output);
+    spng_set_option(ctx, SPNG_IMG_COMPRESSION_LEVEL, compression);
+    int err = spng_encode_image(ctx, data, data_size, SPNG_FMT_PNG, SPNG_ENCODE_FINALIZE);
+    spng_ctx_free(ctx);
+    return err == 0;
+}
+
+static bool WriteQoi(const uint8_t* rgb, uint32_t width, uint32_t height, std::ostream& output)
+{
+    qoi_desc desc;
+    desc.channels = 3;
+    desc.colorspace = QOI_SRGB;
+    desc.width = width;
+    desc.height = height;
+
+    int encoded_len;
+    void* encoded = qoi_encode(rgb, &desc, &encoded_len);
+    if (!encoded)
+        return false;
+    output.write((const char*)encoded, encoded_len);
+    free(encoded);
+    return (bool)output;
+}
+
+static int TranscodeImages(
+    std::ifstream& input, const RawDump::Header& header, bool png,
+    const std::filesystem::path& output_dir, size_t num_threads, int compression)
+{
+    std::error_code err;
+    std::filesystem::create_directories(output_dir, err);
+    if (err)
+    {
+        std::cerr << "Failed to create folder " << output_dir << ": " << err.message() << '\n';
+        return 1;
+    }
+
+    JobQueue queue{num_threads * 2};
+    std::atomic<size_t> num_failed = 0;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        threads.emplace_back([&] {
+            std::vector<uint8_t> pixels(header.GetFrameSize());
+            std::vector<uint8_t> rgb((size_t)header.width * header.height * 3);
+            Job job;
+            while (queue.Pop(&job))
+            {
+                std::filesystem::path path = output_dir / ("frame_" + std::to_string(job.frame.frame_index) + (png ? ".png" : ".qoi"));
+                std::ofstream file(path, std::ios::binary);
+                bool ok = file && RawDump::DecodeFrame(header, job.frame, job.data.data(), pixels.data());
+                if (ok)
+                {
+                    ToRgb(header, pixels.data(), rgb.data());
+                    ok = png ? WritePng(rgb.data(), header.width, header.height, compression, file)
+                        : WriteQoi(rgb.data(), header.width, header.height, file);
+                }
+                if (!ok)
+                {
+                    std::cerr << "Failed to transcode frame " << job.frame.frame_index << '\n';
+                    ++num_failed;
+                }
+            }
+        });
+    }
+
+    size_t num_frames = 0;
+    Job job;
+    while (RawDump::ReadFrameHeader(input, &job.frame))
+    {
+        job.data.resize(job.frame.size);
+        if (!input.read((char*)job.data.data(), job.frame.size))
+        {
+            std::cerr << "The dump ends in the middle of frame " << job.frame.frame_index << '\n';
+            ++num_failed;
+            break;
+        }
+        queue.Push(std::move(job));
+        ++num_frames;
+    }
+    queue.Close();
+    for (std::thread& thread : threads)
+        thread.join();
+
+    std::cout << "Transcoded " << num_frames - num_failed << " of " << num_frames << " frames\n";
+    return num_failed ? 1 : 0;
+}
+
+static int TranscodeVideo(std::ifstream& input, const RawDump::Header& header, const std::string& output, const std::string& output_args)
+{
+    const char* pix_fmt = "bgra";
+    switch (header.format)
+    {
+    case RawDump::PixelFormat::BGRA: pix_fmt = "bgra"; break;
+    case RawDump::PixelFormat::RGBA: pix_fmt = "rgba"; break;
+    case RawDump::PixelFormat::BGR: pix_fmt = "bgr24"; break;
+    case RawDump::PixelFormat::RGB: pix_fmt = "rgb24"; break;
+    }
+
+    std::string command = "ffmpeg -y -loglevel warning -f rawvideo -pix_fmt " + std::string(pix_fmt)
+        + " -s:v " + std::to_string(header.width) + 'x' + std::to_string(header.height)
+        + " -framerate " + std::to_string(header.framerate) + " -i - " + output_args + " \"" + output + '"';
+    FILE* pipe = popen(command.c_str(), "w");
+    if (!pipe)
+    {
+        std::cerr << "Failed to start FFmpeg: " << command << '\n';
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> pixels(header.GetFrameSize());
+    RawDump::FrameHeader frame;
+    size_t num_frames = 0;
+    bool ok = true;
+    while (ok && RawDump::ReadFrameHeader(input, &frame))
+    {
+        data.resize(frame.size);
+        ok = input.read((char*)data.data(), frame.size)
+            && RawDump::DecodeFrame(header, frame, data.data(), pixels.data())
+            && fwrite(pixels.data(), 1, pixels.size(), pipe) == pixels.size();
+        if (!ok)
+            std::cerr << "Failed to transcode frame " << frame.frame_index << '\n';
+        else
+            ++num_frames;
+    }
+
+    int status = pclose(pipe);
+    std::cout << "Piped " << num_frames << " frames to FFmpeg\n";
+    return ok && status == 0 ? 0 : 1;
+}
+
+/// @brief Benchmark the image encoders on the first frames of the dump, like the in-game calibration
+static int Calibrate(std::ifstream& input, const RawDump::Header& header, const std::filesystem::path& output_dir, double target_fps)
+{
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> pixels(header.GetFrameSize());
+    RawDump::FrameHeader frame;
+    while (frames.size() < CALIBRATION_FRAMES && RawDump::ReadFrameHeader(input, &frame))
+    {
+        data.resize(frame.size);
+        if (!input.read((char*)data.data(), frame.size) || !RawDump::DecodeFrame(header, frame, data.data(), pixels.data()))
+            break;
+        std::vector<uint8_t>& rgb = frames.emplace_back((size_t)header.width * header.height * 3);
+        ToRgb(header, pixels.data(), rgb.data());
+    }
+    if (frames.empty())
+    {
+        std::cerr << "The dump has no frames to calibrate with\n";
+        return 1;
+    }
+
+    EncoderCalibration calibration{frames.size()};
+    for (int compression : {0, 1, 3, 5, 7})
+    {
+        calibration.AddCandidate("PNG, compression " + std::to_string(compression), [&, compression](size_t i) {
+            thread_local std::ostringstream output;
+            output.str({});
+            WritePng(frames[i].data(), header.width, header.height, compression, output);
+            return (size_t)output.tellp();
+        });
+    }
+    calibration.AddCandidate("QOI", [&](size_t i) {
+        thread_local std::ostringstream output;
+        output.str({});
+        WriteQoi(frames[i].data(), header.width, header.height, output);
+        return (size_t)output.tellp();
+    });
+
+    std::error_code err;
+    std::filesystem::create_directories(output_dir, err);
+    auto report = calibration.Run(target_fps, std::thread::hardware_concurrency(), output_dir);
+    std::cout << calibration.FormatReport(report);
+    if (report.best < 0)
+        return 1;
+    const auto& best = report.measurements[report.best];
+    std::cout << (report.sustains_target ? "Recommended: " : "Nothing sustains the target. Fastest: ")
+        << calibration.GetCandidateName(best.candidate) << " with " << best.num_threads << " threads\n";
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        std::cerr << USAGE;
+        return 1;
+    }
+
+    std::ifstream input(argv[1], std::ios::binary);
+    RawDump::Header header;
+    if (!input || !RawDump::ReadHeader(input, &header))
+    {
+        std::cerr << "Not a raw dump: " << argv[1] << '\n';
+        return 1;
+    }
+    std::cout << "Stream '" << header.stream_name << "': " << header.width << 'x' << header.height
+        << " at " << header.framerate << " FPS\n";
+
+    const std::string mode = argv[2];
+    if (mode == "ffmpeg")
+    {
+        std::string output_args;
+        for (int i = 4; i < argc; ++i)
+            output_args += std::string(argv[i]) + ' ';
+        return TranscodeVideo(input, header, argv[3], output_args);
+    }
+    if (mode == "calibrate")
+        return Calibrate(input, header, argv[3], argc > 4 ? std::atof(argv[4]) : header.framerate);
+    if (mode != "png" && mode != "qoi")
+    {
+        std::cerr << USAGE;
+        return 1;
+    }
+
+    size_t num_threads = std::thread::hardware_concurrency();
+    int compression = 6;
+    for (int i = 4; i + 1 < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        if (flag == "-j")
+            num_threads = std::strtoul(argv[i + 1], nullptr, 10);
+        else if (flag == "-c")
+            compression = std::atoi(argv[i + 1]);
+        else
+        {
+            std::cerr << USAGE;
+            return 1;
+        }
+    }
+    if (num_threads == 0)
+        num_threads = 1;
+    compression = compression < 0 ? 0 : compression > 9 ? 9 : compression;
+
+    return TranscodeImages(input, header, mode == "png", argv[3], num_threads, compression);
+}